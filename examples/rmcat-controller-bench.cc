@@ -0,0 +1,216 @@
+/******************************************************************************
+ * Copyright 2016-2017 cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Micro-benchmark of the feedback processing path of the congestion
+ * controllers. It feeds a NADA controller with synthetic feedback batches
+ * (no ns3 simulation is run) and reports the cost per feedback item of:
+ *  - calling processFeedback once per item
+ *  - calling processFeedbackBatch once per batch
+ *
+ * Batch sizes correspond to a 100 ms feedback interval with 1000-byte
+ * packets, at media rates from 1 Mbps (12 packets) to 50 Mbps (625 packets).
+ *
+ * It then simulates many 1 Mbps flows whose feedback arrives in the same
+ * scheduler tick, and reports the cost per flow and tick of processing the
+ * feedback and updating the rate, with:
+ *  - one NadaController object per flow
+ *  - one NadaBank holding the state of all flows
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "ns3/nada-controller.h"
+#include "ns3/nada-bank.h"
+#include "ns3/stats-sink.h"
+#include "ns3/core-module.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+
+const uint32_t BENCH_PACKET_SIZE     = 1000;    // in bytes
+const uint64_t BENCH_FB_INTERVAL_US  = 100000;  // in us: 100ms
+const uint64_t BENCH_OWD_US          = 50000;   // in us: 50ms
+const uint32_t BENCH_LOSS_PERIOD     = 97;      // one in 97 packets is lost
+
+using namespace ns3;
+
+static void NoLog (const std::string&) {}
+
+/**
+ * Run nBatches feedback intervals of batchSize packets each through a fresh
+ * NADA controller, and return the average time per feedback item in ns
+ */
+static double BenchFeedback (size_t batchSize, size_t nBatches, bool useBatch)
+{
+    typedef rmcat::SenderBasedController::FeedbackItem FeedbackItem;
+    rmcat::NadaController controller;
+    controller.setLogCallback (NoLog);
+    controller.setMaxBw (100e6);
+
+    const uint64_t startUs = 1000000;
+    uint16_t sequence = 0;
+    std::vector<FeedbackItem> batch;
+    batch.reserve (batchSize);
+
+    std::chrono::steady_clock::duration elapsed{0};
+    size_t nItems = 0;
+    for (size_t i = 0; i < nBatches; ++i) {
+        batch.clear ();
+        const uint64_t batchStartUs = startUs + i * BENCH_FB_INTERVAL_US;
+        for (size_t j = 0; j < batchSize; ++j) {
+            const uint64_t nowUs = batchStartUs + j * BENCH_FB_INTERVAL_US / batchSize;
+            controller.processSendPacket (nowUs, sequence, BENCH_PACKET_SIZE);
+            if (sequence % BENCH_LOSS_PERIOD != 0) {
+                const uint64_t rxTimestampUs = nowUs + BENCH_OWD_US + (j % 7) * 100;
+                batch.push_back (FeedbackItem{sequence, rxTimestampUs, 0});
+            }
+            ++sequence;
+        }
+        // Feedback is sent at the end of the interval, and takes one OWD to arrive
+        const uint64_t fbTimeUs = batchStartUs + BENCH_FB_INTERVAL_US + 2 * BENCH_OWD_US;
+
+        const auto start = std::chrono::steady_clock::now ();
+        if (useBatch) {
+            controller.processFeedbackBatch (fbTimeUs, batch);
+        } else {
+            for (const auto& item : batch) {
+                controller.processFeedback (fbTimeUs, item.sequence,
+                                            item.rxTimestampUs, item.ecn);
+            }
+        }
+        elapsed += std::chrono::steady_clock::now () - start;
+        nItems += batch.size ();
+    }
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds> (elapsed).count ();
+    return nItems > 0 ? double (ns) / double (nItems) : 0.;
+}
+
+/**
+ * Run nTicks feedback intervals of nFlows flows, whose feedback batches
+ * arrive in the same tick. Return the average time per flow and tick in ns
+ */
+static double BenchFlows (size_t nFlows, size_t nTicks, bool useBank)
+{
+    typedef rmcat::SenderBasedController::FeedbackItem FeedbackItem;
+    const size_t batchSize = 12; // 1 Mbps
+    rmcat::NadaBank bank;
+    // Discards the stats, so that formatting them is not measured
+    const auto sink = std::make_shared<rmcat::NullStatsSink> ();
+    std::vector<std::shared_ptr<rmcat::SenderBasedController> > controllers;
+    for (size_t f = 0; f < nFlows; ++f) {
+        if (useBank) {
+            controllers.push_back (bank.addFlow ());
+        } else {
+            controllers.push_back (std::make_shared<rmcat::NadaController> ());
+        }
+        controllers.back ()->setStatsSink (sink);
+        controllers.back ()->setMaxBw (100e6);
+    }
+
+    const uint64_t startUs = 1000000;
+    uint16_t sequence = 0;
+    std::vector<std::vector<FeedbackItem> > batches (nFlows);
+    std::chrono::steady_clock::duration elapsed{0};
+    for (size_t i = 0; i < nTicks; ++i) {
+        const uint64_t batchStartUs = startUs + i * BENCH_FB_INTERVAL_US;
+        for (size_t j = 0; j < batchSize; ++j) {
+            const uint64_t nowUs = batchStartUs + j * BENCH_FB_INTERVAL_US / batchSize;
+            for (size_t f = 0; f < nFlows; ++f) {
+                controllers[f]->processSendPacket (nowUs, sequence, BENCH_PACKET_SIZE);
+                if ((sequence + f) % BENCH_LOSS_PERIOD != 0) {
+                    const uint64_t rxTimestampUs = nowUs + BENCH_OWD_US + ((j + f) % 7) * 100;
+                    batches[f].push_back (FeedbackItem{sequence, rxTimestampUs, 0});
+                }
+            }
+            ++sequence;
+        }
+        const uint64_t fbTimeUs = batchStartUs + BENCH_FB_INTERVAL_US + 2 * BENCH_OWD_US;
+
+        float sum = 0.f;
+        const auto start = std::chrono::steady_clock::now ();
+        for (size_t f = 0; f < nFlows; ++f) {
+            controllers[f]->processFeedbackBatch (fbTimeUs, batches[f]);
+        }
+        if (useBank) {
+            bank.runPending ();
+        }
+        // The senders then query their new rates
+        for (size_t f = 0; f < nFlows; ++f) {
+            sum += controllers[f]->getBandwidth (fbTimeUs);
+        }
+        elapsed += std::chrono::steady_clock::now () - start;
+        for (auto& batch : batches) {
+            batch.clear ();
+        }
+        if (sum < 0.f) {
+            std::cerr << "Negative rate" << std::endl;
+        }
+    }
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds> (elapsed).count ();
+    return double (ns) / double (nFlows * nTicks);
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t nBatches = 2000;
+    uint32_t nTicks = 200;
+
+    CommandLine cmd;
+    cmd.AddValue ("batches", "Number of feedback batches per measurement", nBatches);
+    cmd.AddValue ("ticks", "Number of feedback intervals per multi-flow measurement", nTicks);
+    cmd.Parse (argc, argv);
+
+    const size_t batchSizes[] = {12, 62, 125, 312, 625}; // 1, 5, 10, 25, 50 Mbps
+
+    std::cout << std::setw (10) << "rate(Mbps)"
+              << std::setw (8) << "batch"
+              << std::setw (16) << "per-item(ns)"
+              << std::setw (16) << "batched(ns)" << std::endl;
+    for (const size_t batchSize : batchSizes) {
+        const double perItemNs = BenchFeedback (batchSize, nBatches, false);
+        const double batchedNs = BenchFeedback (batchSize, nBatches, true);
+        const double rateMbps = double (batchSize) * BENCH_PACKET_SIZE * 8.
+                                / double (BENCH_FB_INTERVAL_US);
+        std::cout << std::fixed << std::setprecision (1)
+                  << std::setw (10) << rateMbps
+                  << std::setw (8) << batchSize
+                  << std::setw (16) << perItemNs
+                  << std::setw (16) << batchedNs << std::endl;
+    }
+
+    const size_t flowCounts[] = {1000, 10000};
+
+    std::cout << std::endl
+              << std::setw (10) << "flows"
+              << std::setw (16) << "objects(ns)"
+              << std::setw (16) << "bank(ns)" << std::endl;
+    for (const size_t nFlows : flowCounts) {
+        const double objectsNs = BenchFlows (nFlows, nTicks, false);
+        const double bankNs = BenchFlows (nFlows, nTicks, true);
+        std::cout << std::fixed << std::setprecision (1)
+                  << std::setw (10) << nFlows
+                  << std::setw (16) << objectsNs
+                  << std::setw (16) << bankNs << std::endl;
+    }
+    return 0;
+}
@@ -35,7 +35,11 @@ const uint32_t DEFAULT_PACKET_SIZE = 1000;
 const uint32_t IPV4_HEADER_SIZE = 20;
 const uint32_t UDP_HEADER_SIZE = 8;
 const uint32_t IPV4_UDP_OVERHEAD = IPV4_HEADER_SIZE + UDP_HEADER_SIZE;
+const uint32_t RTP_HEADER_SIZE = 12; // fixed part, no CSRCs nor extensions
 const uint64_t RMCAT_FEEDBACK_PERIOD_US = 100 * 1000;
+// a packet held back by the controller's window (see
+// rmcat::SenderBasedController::canSend ) is retried upon feedback, or after this
+const uint64_t RMCAT_SEND_RETRY_US = 10 * 1000;
 
 // syncodec parameters
 const uint32_t SYNCODEC_DEFAULT_FPS = 30;
@@ -48,13 +52,22 @@ enum SyncodecType {
     SYNCODEC_TYPE_HYBRID
 };
 
+/* receive rate estimators (see rmcat::SenderBasedController::setRecvRateEstimator ) */
+enum RecvRateEstimatorType {
+    RRATE_ESTIMATOR_HISTORY = 0, // over the whole packet history (default)
+    RRATE_ESTIMATOR_WINDOW,
+    RRATE_ESTIMATOR_EWMA,
+    RRATE_ESTIMATOR_FRAME
+};
+
 /**
  * Parameters for the rate shaping buffer as specified in draft-ietf-rmcat-nada
  * These are the default values according to the draft
  * The rate shaping buffer is currently implemented in the sender ns3
  * application (#ns3::RmcatSender ). For other congestion controllers
  * that do not need the rate shaping buffer, you can disable it by
- * setting USE_BUFFER to false.
+ * setting USE_BUFFER to false, or per sender (see
+ * #ns3::RmcatSender::SetUseBuffer ).
  */
 const bool USE_BUFFER = true;
 const float BETA_V = 0.0;
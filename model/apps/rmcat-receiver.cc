@@ -46,6 +46,7 @@ RmcatReceiver::RmcatReceiver ()
 , m_header{}
 , m_sendEvent{}
 , m_periodUs{RMCAT_FEEDBACK_PERIOD_US}
+, m_clockDriftPpm{0.}
 {}
 
 RmcatReceiver::~RmcatReceiver () {}
@@ -56,12 +57,19 @@ void RmcatReceiver::Setup (uint16_t port)
     auto local = InetSocketAddress{Ipv4Address::GetAny (), port};
     auto ret = m_socket->Bind (local);
     NS_ASSERT (ret == 0);
+    // Have the TOS byte of received packets tagged, to read their ECN codepoint
+    m_socket->SetIpRecvTos (true);
     m_socket->SetRecvCallback (MakeCallback (&RmcatReceiver::RecvPacket, this));
 
     m_running = false;
     m_waiting = true;
 }
 
+void RmcatReceiver::SetClockDrift (double ppm)
+{
+    m_clockDriftPpm = ppm;
+}
+
 void RmcatReceiver::StartApplication ()
 {
     m_running = true;
@@ -90,6 +98,11 @@ void RmcatReceiver::RecvPacket (Ptr<Socket> socket)
     NS_ASSERT (packet);
     RtpHeader header{};
     NS_LOG_INFO ("RmcatReceiver::RecvPacket, " << packet->ToString ());
+    SocketIpTosTag tosTag{};
+    uint8_t ecn = 0;
+    if (packet->RemovePacketTag (tosTag)) {
+        ecn = tosTag.GetTos () & 0x03;
+    }
     packet->RemoveHeader (header);
     auto srcIp = InetSocketAddress::ConvertFrom (remoteAddr).GetIpv4 ();
     const auto srcPort = InetSocketAddress::ConvertFrom (remoteAddr).GetPort ();
@@ -106,16 +119,19 @@ void RmcatReceiver::RecvPacket (Ptr<Socket> socket)
     }
 
     uint64_t recvTimestampUs = Simulator::Now ().GetMicroSeconds ();
-    AddFeedback (header.GetSequence (), recvTimestampUs);
+    // This addition will wrap properly if the drift is negative
+    recvTimestampUs += int64_t (double (recvTimestampUs) * m_clockDriftPpm * 1e-6);
+    AddFeedback (header.GetSequence (), recvTimestampUs, ecn);
 }
 
 void RmcatReceiver::AddFeedback (uint16_t sequence,
-                                 uint64_t recvTimestampUs)
+                                 uint64_t recvTimestampUs,
+                                 uint8_t ecn)
 {
-    auto res = m_header.AddFeedback (m_remoteSsrc, sequence, recvTimestampUs);
+    auto res = m_header.AddFeedback (m_remoteSsrc, sequence, recvTimestampUs, ecn);
     if (res == CCFeedbackHeader::CCFB_TOO_LONG) {
         SendFeedback (false);
-        res = m_header.AddFeedback (m_remoteSsrc, sequence, recvTimestampUs);
+        res = m_header.AddFeedback (m_remoteSsrc, sequence, recvTimestampUs, ecn);
     }
     NS_ASSERT (res == CCFeedbackHeader::CCFB_NONE);
 }
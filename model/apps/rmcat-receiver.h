@@ -42,13 +42,24 @@ public:
 
     void Setup (uint16_t port);
 
+    /**
+     * Simulate a drift of the receiver's clock w.r.t. the simulator's
+     * (and thus the sender's) clock. The receive timestamps reported in
+     * the feedback are skewed accordingly
+     *
+     * @param [in] ppm Drift, in parts per million; positive values make the
+     *                 receiver's clock run faster
+     */
+    void SetClockDrift (double ppm);
+
 private:
     virtual void StartApplication ();
     virtual void StopApplication ();
 
     void RecvPacket (Ptr<Socket> socket);
     void AddFeedback (uint16_t sequence,
-                      uint64_t recvTimestampUs);
+                      uint64_t recvTimestampUs,
+                      uint8_t ecn);
     void SendFeedback (bool reschedule);
 
 private:
@@ -62,6 +73,7 @@ private:
     CCFeedbackHeader m_header;
     EventId m_sendEvent;
     uint64_t m_periodUs;
+    double m_clockDriftPpm;
 };
 
 }
@@ -36,6 +36,7 @@
 #include "ns3/log.h"
 
 #include <sys/stat.h>
+#include <sstream>
 
 NS_LOG_COMPONENT_DEFINE ("RmcatSender");
 
@@ -48,6 +49,10 @@ RmcatSender::RmcatSender ()
 , m_minBw{0}
 , m_maxBw{0}
 , m_paused{false}
+, m_pauseTstmpUs{0}
+, m_warmStartState{}
+, m_ecnCapable{false}
+, m_useBuffer{USE_BUFFER}
 , m_ssrc{0}
 , m_sequence{0}
 , m_rtpTsOffset{0}
@@ -60,19 +65,33 @@ RmcatSender::RmcatSender ()
 , m_rSend{0.}
 , m_rateShapingBytes{0}
 , m_nextSendTstmpUs{0}
+, m_sendBlocked{false}
 {}
 
 RmcatSender::~RmcatSender () {}
 
-void RmcatSender::PauseResume (bool pause)
+void RmcatSender::PauseResume (bool pause, bool restoreState)
 {
     NS_ASSERT (pause != m_paused);
+    const uint64_t nowUs = Simulator::Now ().GetMicroSeconds ();
     if (pause) {
         Simulator::Cancel (m_enqueueEvent);
         Simulator::Cancel (m_sendEvent);
         Simulator::Cancel (m_sendOversleepEvent);
         m_rateShapingBuf.clear ();
         m_rateShapingBytes = 0;
+        m_sendBlocked = false;
+        m_pauseTstmpUs = nowUs;
+    } else if (restoreState) {
+        // Shift the controller's timeline by the pause duration, so that
+        // it resumes as if no time had elapsed
+        std::stringstream state;
+        m_controller->saveState (state, m_pauseTstmpUs);
+        const bool res = m_controller->loadState (state, nowUs);
+        NS_ASSERT (res);
+        SetRatesFromController (nowUs);
+        m_enqueueEvent = Simulator::ScheduleNow (&RmcatSender::EnqueuePacket, this);
+        m_nextSendTstmpUs = 0;
     } else {
         m_rVin = m_initBw;
         m_rSend = m_initBw;
@@ -171,6 +190,31 @@ void RmcatSender::SetController (std::shared_ptr<rmcat::SenderBasedController> c
     m_controller = controller;
 }
 
+std::shared_ptr<rmcat::SenderBasedController> RmcatSender::GetController () const
+{
+    return m_controller;
+}
+
+void RmcatSender::SetWarmStartState (const std::string& state)
+{
+    m_warmStartState = state;
+}
+
+std::string RmcatSender::GetControllerState () const
+{
+    NS_ASSERT (m_controller);
+    std::ostringstream state;
+    m_controller->saveState (state, Simulator::Now ().GetMicroSeconds ());
+    return state.str ();
+}
+
+void RmcatSender::SetRatesFromController (uint64_t nowUs)
+{
+    const float bw = m_controller->getBandwidth (nowUs);
+    m_rVin = std::max<float> (m_minBw, std::min<float> (m_maxBw, bw));
+    m_rSend = m_rVin;
+}
+
 void RmcatSender::Setup (Ipv4Address destIP,
                          uint16_t destPort)
 {
@@ -206,6 +250,21 @@ void RmcatSender::SetRmax (float r)
     if (m_controller) m_controller->setMaxBw (m_maxBw);
 }
 
+void RmcatSender::SetEcnCapable (bool ecnCapable)
+{
+    m_ecnCapable = ecnCapable;
+}
+
+void RmcatSender::SetUseBuffer (bool useBuffer)
+{
+    m_useBuffer = useBuffer;
+}
+
+uint32_t RmcatSender::GetBufferBytes () const
+{
+    return m_rateShapingBytes;
+}
+
 void RmcatSender::StartApplication ()
 {
     m_ssrc = rand ();
@@ -219,11 +278,23 @@ void RmcatSender::StartApplication ()
     m_rVin = m_initBw;
     m_rSend = m_initBw;
 
+    if (!m_warmStartState.empty ()) {
+        const uint64_t nowUs = Simulator::Now ().GetMicroSeconds ();
+        std::istringstream state{m_warmStartState};
+        const bool res = m_controller->loadState (state, nowUs);
+        NS_ASSERT (res);
+        SetRatesFromController (nowUs);
+    }
+
     if (m_socket == NULL) {
         m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
         auto res = m_socket->Bind ();
         NS_ASSERT (res == 0);
     }
+    if (m_ecnCapable) {
+        // The ECN field is the two lower bits of the TOS byte
+        m_socket->SetIpTos (rmcat::ECN_ECT0);
+    }
     m_socket->SetRecvCallback (MakeCallback (&RmcatSender::RecvPacket, this));
 
     m_enqueueEvent = Simulator::Schedule (Seconds (0.0), &RmcatSender::EnqueuePacket, this);
@@ -237,6 +308,7 @@ void RmcatSender::StopApplication ()
     Simulator::Cancel (m_sendOversleepEvent);
     m_rateShapingBuf.clear ();
     m_rateShapingBytes = 0;
+    m_sendBlocked = false;
 }
 
 void RmcatSender::EnqueuePacket ()
@@ -259,7 +331,7 @@ void RmcatSender::EnqueuePacket ()
     Time tNext{Seconds (secsToNextEnqPacket)};
     m_enqueueEvent = Simulator::Schedule (tNext, &RmcatSender::EnqueuePacket, this);
 
-    if (!USE_BUFFER) {
+    if (!m_useBuffer) {
         m_sendEvent = Simulator::ScheduleNow (&RmcatSender::SendPacket, this,
                                               secsToNextEnqPacket * 1000. * 1000.);
         return;
@@ -290,6 +362,29 @@ void RmcatSender::SendPacket (uint64_t usSlept)
     const auto bytesToSend = m_rateShapingBuf.front ();
     NS_ASSERT (bytesToSend > 0);
     NS_ASSERT (bytesToSend <= DEFAULT_PACKET_SIZE);
+
+    // Window-based controllers may hold the packet back: it stays at the
+    // head of the buffer until the next feedback (see RecvPacket), or
+    // until the retry timer fires, should the feedback be lost. Without
+    // the buffer, nothing else would send it: it is dropped
+    if (!m_controller->canSend (Simulator::Now ().GetMicroSeconds (), bytesToSend)) {
+        if (!m_useBuffer) {
+            m_rateShapingBuf.pop_front ();
+            NS_ASSERT (m_rateShapingBytes >= bytesToSend);
+            m_rateShapingBytes -= bytesToSend;
+            NS_LOG_INFO ("RmcatSender::SendPacket, packet dropped by the controller, bytes in flight: "
+                         << m_controller->getBytesInFlight ());
+            return;
+        }
+        NS_LOG_INFO ("RmcatSender::SendPacket, packet held back by the controller, bytes in flight: "
+                     << m_controller->getBytesInFlight ());
+        m_sendBlocked = true;
+        Time tRetry{MicroSeconds (RMCAT_SEND_RETRY_US)};
+        m_sendEvent = Simulator::Schedule (tRetry, &RmcatSender::SendPacket, this, RMCAT_SEND_RETRY_US);
+        return;
+    }
+    m_sendBlocked = false;
+
     m_rateShapingBuf.pop_front ();
     NS_ASSERT (m_rateShapingBytes >= bytesToSend);
     m_rateShapingBytes -= bytesToSend;
@@ -308,7 +403,7 @@ void RmcatSender::SendPacket (uint64_t usSlept)
     const double usToNextSentPacketD = double (bytesToSend) * 8. * 1000. * 1000. / m_rSend;
     const uint64_t usToNextSentPacket = uint64_t (usToNextSentPacketD);
 
-    if (!USE_BUFFER || m_rateShapingBuf.size () == 0) {
+    if (!m_useBuffer || m_rateShapingBuf.size () == 0) {
         // Buffer became empty
         const auto nowUs = Simulator::Now ().GetMicroSeconds ();
         m_nextSendTstmpUs = nowUs + usToNextSentPacket;
@@ -377,6 +472,12 @@ void RmcatSender::RecvPacket (Ptr<Socket> socket)
     }
     m_controller->processFeedbackBatch (nowUs, fbBatch);
     CalcBufferParams (nowUs);
+
+    if (m_sendBlocked) {
+        // The window may have opened: retry the packet held back right away
+        Simulator::Cancel (m_sendEvent);
+        m_sendEvent = Simulator::ScheduleNow (&RmcatSender::SendPacket, this, 0);
+    }
 }
 
 void RmcatSender::CalcBufferParams (uint64_t nowUs)
@@ -395,7 +496,7 @@ void RmcatSender::CalcBufferParams (uint64_t nowUs)
     syncodecs::Codec& codec = *m_codec;
 
     // TODO (deferred): encapsulate rate shaping buffer in a separate class
-    if (USE_BUFFER && static_cast<bool> (codec)) {
+    if (m_useBuffer && static_cast<bool> (codec)) {
         float r_diff = 8. * bufferLen * m_fps;
         float r_diff_v = std::min<float>(BETA_V*r_diff, r_ref*0.05);  // limit change to 5% of reference rate
         float r_diff_s = std::min<float>(BETA_S*r_diff, r_ref*0.05);  // limit change to 5% of reference rate
@@ -34,6 +34,7 @@
 #include "ns3/socket.h"
 #include "ns3/application.h"
 #include <memory>
+#include <string>
 
 namespace ns3 {
 
@@ -44,17 +45,69 @@ public:
     RmcatSender ();
     virtual ~RmcatSender ();
 
-    void PauseResume (bool pause);
+    /**
+     * Pause or resume sending media
+     *
+     * @param [in] pause True to pause, false to resume
+     * @param [in] restoreState Only used when resuming. If true, the
+     *             controller resumes from its state at the time of the
+     *             pause, shifted by the pause duration, and so does the
+     *             sending rate. Otherwise, the sending rate restarts from
+     *             the initial bandwidth
+     */
+    void PauseResume (bool pause, bool restoreState = false);
 
     void SetCodec (std::shared_ptr<syncodecs::Codec> codec);
     void SetCodecType (SyncodecType codecType);
 
     void SetController (std::shared_ptr<rmcat::SenderBasedController> controller);
+    std::shared_ptr<rmcat::SenderBasedController> GetController () const;
 
     void SetRinit (float Rinit);
     void SetRmin (float Rmin);
     void SetRmax (float Rmax);
 
+    /**
+     * Mark the media packets as ECN-capable, ECT(0), so that the ECN-capable
+     * queues on the path mark them instead of dropping them. It must be
+     * called before the application starts
+     *
+     * @param [in] ecnCapable Whether the packets are sent ECN-capable
+     */
+    void SetEcnCapable (bool ecnCapable);
+
+    /**
+     * Enable or disable the rate shaping buffer (USE_BUFFER by default).
+     * Without it, each packet is sent as soon as the codec produces it, and
+     * a packet held back by the controller's window (see
+     * rmcat::SenderBasedController::canSend ) is dropped, as there is
+     * nowhere to keep it. It must be called before the application starts
+     *
+     * @param [in] useBuffer Whether packets go through the rate shaping buffer
+     */
+    void SetUseBuffer (bool useBuffer);
+
+    /** @retval Bytes waiting in the rate shaping buffer */
+    uint32_t GetBufferBytes () const;
+
+    /**
+     * Warm-start the controller from a snapshot of a previous flow's
+     * controller (see rmcat::SenderBasedController::saveState ), rather
+     * than from the initial bandwidth. The snapshot is loaded when the
+     * application starts
+     *
+     * @param [in] state The snapshot; an empty string disables warm start
+     */
+    void SetWarmStartState (const std::string& state);
+
+    /**
+     * Take a snapshot of the controller's current state, e.g., to
+     * warm-start a later flow (see #SetWarmStartState )
+     *
+     * @retval The snapshot, as text
+     */
+    std::string GetControllerState () const;
+
     void Setup (Ipv4Address dest_ip, uint16_t dest_port);
 
 private:
@@ -66,6 +119,7 @@ private:
     void SendOverSleep (uint32_t bytesToSend);
     void RecvPacket (Ptr<Socket> socket);
     void CalcBufferParams (uint64_t nowUs);
+    void SetRatesFromController (uint64_t nowUs);
 
 private:
     std::shared_ptr<syncodecs::Codec> m_codec;
@@ -76,6 +130,10 @@ private:
     float m_minBw;
     float m_maxBw;
     bool m_paused;
+    uint64_t m_pauseTstmpUs;
+    std::string m_warmStartState;
+    bool m_ecnCapable;
+    bool m_useBuffer;
     uint32_t m_ssrc;
     uint16_t m_sequence;
     uint32_t m_rtpTsOffset;
@@ -90,6 +148,7 @@ private:
     std::deque<uint32_t> m_rateShapingBuf;
     uint32_t m_rateShapingBytes;
     uint64_t m_nextSendTstmpUs;
+    bool m_sendBlocked; // the controller's window holds back the next packet
 };
 
 }
@@ -0,0 +1,145 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Sliding-window base delay tracker implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "base-delay-tracker.h"
+#include "windowed-filter.h"
+#include <cassert>
+
+namespace rmcat {
+
+const size_t BaseDelayTracker::DEFAULT_N_BUCKETS;
+const uint64_t BaseDelayTracker::DEFAULT_BUCKET_US;
+
+BaseDelayTracker::BaseDelayTracker(size_t nBuckets, uint64_t bucketUs)
+: m_buckets{},
+  m_head{0},
+  m_count{0},
+  m_bucketUs{0},
+  m_baseUs{0} {
+    setWindow(nBuckets, bucketUs);
+}
+
+void BaseDelayTracker::setWindow(size_t nBuckets, uint64_t bucketUs) {
+    assert(nBuckets > 0);
+    m_buckets.assign(nBuckets, Bucket{0, 0});
+    m_bucketUs = bucketUs;
+    reset();
+}
+
+void BaseDelayTracker::reset() {
+    m_head = 0;
+    m_count = 0;
+    m_baseUs = 0;
+}
+
+/*
+ * Buckets are written from the oldest to the newest. Timestamps are
+ * written as ages, i.e., nowUs minus the timestamp, which wraps properly
+ */
+void BaseDelayTracker::saveState(std::ostream& os, uint64_t nowUs) const {
+    const size_t n = m_buckets.size();
+    os << n << ' ' << m_bucketUs << ' ' << m_count << ' ' << m_baseUs;
+    for (size_t i = m_count; i > 0; --i) {
+        const Bucket& bucket = m_buckets[(m_head + n - (i - 1)) % n];
+        os << ' ' << (nowUs - bucket.startUs) << ' ' << bucket.minUs;
+    }
+    os << '\n';
+}
+
+bool BaseDelayTracker::loadState(std::istream& is, uint64_t nowUs) {
+    size_t nBuckets = 0;
+    uint64_t bucketUs = 0;
+    size_t count = 0;
+    uint64_t baseUs = 0;
+    if (!(is >> nBuckets >> bucketUs >> count >> baseUs) ||
+        nBuckets == 0 || count > nBuckets) {
+        return false;
+    }
+    setWindow(nBuckets, bucketUs);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t ageUs = 0;
+        uint64_t minUs = 0;
+        if (!(is >> ageUs >> minUs)) {
+            reset();
+            return false;
+        }
+        m_buckets[i] = Bucket{nowUs - ageUs, minUs};
+    }
+    m_head = (count == 0) ? 0 : count - 1;
+    m_count = count;
+    m_baseUs = baseUs;
+    return true;
+}
+
+void BaseDelayTracker::update(uint64_t delayUs, uint64_t timestampUs) {
+    const WrapLess<uint64_t> lessThan{};
+    if (m_count == 0) {
+        m_buckets[m_head] = Bucket{timestampUs, delayUs};
+        m_count = 1;
+        m_baseUs = delayUs;
+        return;
+    }
+
+    Bucket& newest = m_buckets[m_head];
+    // Samples older than the newest bucket (e.g., late feedback) also go
+    // into the newest bucket
+    if (lessThan(timestampUs, newest.startUs + m_bucketUs)) {
+        if (lessThan(delayUs, newest.minUs)) {
+            newest.minUs = delayUs;
+        }
+        if (lessThan(delayUs, m_baseUs)) {
+            m_baseUs = delayUs;
+        }
+        return;
+    }
+
+    // Start a new bucket; the oldest one expires if the ring is full
+    const size_t n = m_buckets.size();
+    m_head = (m_head + 1) % n;
+    m_buckets[m_head] = Bucket{timestampUs, delayUs};
+    if (m_count < n) {
+        ++m_count;
+    }
+    // After a period without samples, buckets may expire before the ring is full
+    const uint64_t windowUs = getWindowLength();
+    while (m_count > 1) {
+        const Bucket& oldest = m_buckets[(m_head + n - (m_count - 1)) % n];
+        if (lessThan(timestampUs, oldest.startUs + windowUs)) {
+            break;
+        }
+        --m_count;
+    }
+    m_baseUs = delayUs;
+    for (size_t i = 1; i < m_count; ++i) {
+        const Bucket& bucket = m_buckets[(m_head + n - i) % n];
+        if (lessThan(bucket.minUs, m_baseUs)) {
+            m_baseUs = bucket.minUs;
+        }
+    }
+}
+
+}
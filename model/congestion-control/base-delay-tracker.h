@@ -0,0 +1,132 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Sliding-window base delay tracker for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef BASE_DELAY_TRACKER_H
+#define BASE_DELAY_TRACKER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <iostream>
+
+namespace rmcat {
+
+/**
+ * This class estimates the base delay of a path (i.e., its propagation
+ * delay, plus the clock offset between the endpoints) as the minimum one
+ * way delay observed over a sliding window, in the way LEDBAT does (see
+ * rfc6817, section 3.4.2).
+ *
+ * Time is divided into buckets of fixed length, and the minimum delay of
+ * each bucket is kept for the last N buckets only. Thus, a minimum becomes
+ * stale (e.g., after a route change, or due to clock drift) after at most N
+ * bucket lengths, unlike a minimum kept since the beginning of the flow.
+ *
+ * Both delays and timestamps may wrap (see #rmcat::PacketRecord ).
+ * Updating the tracker and querying the base delay take O(1) time, except
+ * when a new bucket is started, which takes O(N).
+ */
+class BaseDelayTracker {
+public:
+    static const size_t DEFAULT_N_BUCKETS = 10;           /**< as LEDBAT's BASE_HISTORY */
+    static const uint64_t DEFAULT_BUCKET_US = 60 * 1000 * 1000; /**< one minute */
+
+    /**
+     * Class constructor
+     *
+     * @param [in] nBuckets Number of buckets kept, must be positive
+     * @param [in] bucketUs Length of each bucket, in microseconds
+     */
+    explicit BaseDelayTracker(size_t nBuckets=DEFAULT_N_BUCKETS,
+                              uint64_t bucketUs=DEFAULT_BUCKET_US);
+
+    /**
+     * Change the window of the tracker. This clears the tracker
+     *
+     * @param [in] nBuckets Number of buckets kept, must be positive
+     * @param [in] bucketUs Length of each bucket, in microseconds
+     */
+    void setWindow(size_t nBuckets, uint64_t bucketUs);
+
+    /** Forget all delays observed so far */
+    void reset();
+
+    /**
+     * Account for a new delay sample. A sample older than the newest bucket
+     * (e.g., late feedback) goes into the newest bucket: it may lower the
+     * base delay, but it never expires buckets
+     *
+     * @param [in] delayUs The delay sample (e.g., one way delay), in microseconds
+     * @param [in] timestampUs Time at which the sample was taken (e.g., the
+     *                         packet's send time), in microseconds
+     */
+    void update(uint64_t delayUs, uint64_t timestampUs);
+
+    /** @retval True if no delay has been observed within the window */
+    bool empty() const { return m_count == 0; }
+
+    /** @retval The current base delay. Only valid if not #empty */
+    uint64_t get() const { return m_baseUs; }
+
+    /** @retval The length, in microseconds, of the whole window */
+    uint64_t getWindowLength() const { return m_bucketUs * m_buckets.size(); }
+
+    /**
+     * Write the window and its buckets to a stream, as text. Timestamps are
+     * written relative to nowUs, so that they can be loaded on another timeline
+     *
+     * @param [in,out] os Output stream
+     * @param [in] nowUs Current time, in microseconds
+     */
+    void saveState(std::ostream& os, uint64_t nowUs) const;
+
+    /**
+     * Read a window and buckets written by #saveState
+     *
+     * @param [in,out] is Input stream
+     * @param [in] nowUs Current time, in microseconds: the one passed to
+     *                   #saveState is mapped to it
+     * @retval False if the stream does not contain a valid tracker
+     */
+    bool loadState(std::istream& is, uint64_t nowUs);
+
+private:
+    struct Bucket {
+        uint64_t startUs; /**< timestamp of the first sample in the bucket */
+        uint64_t minUs;   /**< minimum delay in the bucket */
+    };
+
+    std::vector<Bucket> m_buckets; /**< ring of buckets; the newest is at m_head */
+    size_t m_head;
+    size_t m_count;
+    uint64_t m_bucketUs;
+    uint64_t m_baseUs; /**< minimum over all buckets */
+};
+
+}
+
+#endif /* BASE_DELAY_TRACKER_H */
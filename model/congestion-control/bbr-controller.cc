@@ -0,0 +1,398 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * BBR-style controller implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "bbr-controller.h"
+#include <algorithm>
+#include <cassert>
+
+namespace rmcat {
+
+/* Path model */
+const uint64_t BBR_BTLBW_WINDOW_ROUNDS = 10;  /**< window of the bottleneck bandwidth filter */
+const uint64_t BBR_MIN_RTT_WINDOW_US = 10 * 1000 * 1000; /**< window of the propagation RTT */
+const uint64_t BBR_MIN_SAMPLE_US = 20 * 1000; /**< minimum interval of a delivery rate sample */
+
+/* Modes */
+const float BBR_HIGH_GAIN = 2.885f;           /**< 2/ln(2): startup gain */
+const float BBR_DRAIN_GAIN = 1.f / BBR_HIGH_GAIN;
+const float BBR_CYCLE_GAINS[] = {1.25f, 0.75f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f};
+const size_t BBR_CYCLE_LENGTH = sizeof(BBR_CYCLE_GAINS) / sizeof(BBR_CYCLE_GAINS[0]);
+const size_t BBR_CYCLE_START = 2;             /**< the gain cycle starts at a phase at 1 */
+const uint64_t BBR_MIN_PHASE_US = 200 * 1000; /**< minimum duration of a phase of the gain cycle */
+const float BBR_FULL_BW_THRESHOLD = 1.25f;    /**< significant growth of the bottleneck bandwidth */
+const uint32_t BBR_FULL_BW_ROUNDS = 3;        /**< rounds without it to leave startup */
+const uint64_t BBR_DRAIN_QDELAY_US = 10 * 1000; /**< the queue is considered drained below this */
+const uint64_t BBR_MAX_DRAIN_ROUNDS = 3;      /**< the drain mode lasts this many rounds at most */
+const float BBR_PROBE_RTT_GAIN = 0.5f;
+const uint64_t BBR_PROBE_RTT_US = 200 * 1000; /**< duration of the probe RTT mode */
+
+const uint64_t BBR_UPDATE_INTERVAL_US = 50 * 1000; /**< minimum interval between rate updates */
+
+BbrController::BbrController() :
+    SenderBasedController{},
+    m_sampleValid{false},
+    m_sampleTxUs{0},
+    m_sampleArrivalUs{0},
+    m_sampleBytes{0},
+    m_btlBwFilter{0, BBR_BTLBW_WINDOW_ROUNDS},
+    m_btlBw{m_initBw},
+    m_round{0},
+    m_roundEndBytes{0},
+    m_minRttUs{0},
+    m_minRttStampUs{0},
+    m_minRttValid{false},
+    m_minRttExpired{false},
+    m_mode{BBR_STARTUP},
+    m_pacingGain{BBR_HIGH_GAIN},
+    m_cycleIndex{BBR_CYCLE_START},
+    m_cycleStartUs{0},
+    m_probeRttDoneUs{0},
+    m_drainStartRound{0},
+    m_fullBw{0.f},
+    m_fullBwCount{0},
+    m_filledPipe{false},
+    m_lastTimeCalcUs{0},
+    m_lastTimeCalcValid{false},
+    m_fbCountAtCalc{0},
+    m_currBw{m_initBw} {}
+
+BbrController::~BbrController() {}
+
+void BbrController::setCurrentBw(float newBw) {
+    m_currBw = newBw;
+}
+
+void BbrController::reset() {
+    m_sampleValid = false;
+    m_sampleTxUs = 0;
+    m_sampleArrivalUs = 0;
+    m_sampleBytes = 0;
+    m_btlBwFilter.reset();
+    m_btlBw = m_initBw;
+    m_round = 0;
+    m_roundEndBytes = 0;
+    m_minRttUs = 0;
+    m_minRttStampUs = 0;
+    m_minRttValid = false;
+    m_minRttExpired = false;
+    m_mode = BBR_STARTUP;
+    m_pacingGain = BBR_HIGH_GAIN;
+    m_cycleIndex = BBR_CYCLE_START;
+    m_cycleStartUs = 0;
+    m_probeRttDoneUs = 0;
+    m_drainStartRound = 0;
+    m_fullBw = 0.f;
+    m_fullBwCount = 0;
+    m_filledPipe = false;
+    m_lastTimeCalcUs = 0;
+    m_lastTimeCalcValid = false;
+    m_fbCountAtCalc = 0;
+    m_currBw = m_initBw;
+    SenderBasedController::reset();
+}
+
+bool BbrController::processSendPacket(uint64_t txTimestampUs,
+                                      uint16_t sequence,
+                                      uint32_t size) { // in Bytes
+    /* First of all, call the superclass */
+    if (!SenderBasedController::processSendPacket(txTimestampUs, sequence, size)) {
+        return false;
+    }
+
+    /* As in NADA, the first rate update happens upon the first feedback */
+    if (!m_lastTimeCalcValid) {
+        m_lastTimeCalcUs = txTimestampUs;
+        m_lastTimeCalcValid = true;
+    }
+    return true;
+}
+
+bool BbrController::processFeedback(uint64_t nowUs,
+                                    uint16_t sequence,
+                                    uint64_t rxTimestampUs,
+                                    uint8_t ecn) {
+    /* First of all, call the superclass */
+    if (!SenderBasedController::processFeedback(nowUs,
+                                                sequence,
+                                                rxTimestampUs,
+                                                ecn)) {
+        return false;
+    }
+    const bool roundStart = updateRound();
+    processNewPackets(nowUs);
+    maybeUpdateRate(nowUs, roundStart);
+    return true;
+}
+
+bool BbrController::processFeedbackBatch(uint64_t nowUs,
+                                         const std::vector<FeedbackItem>& feedbackBatch) {
+    /* First of all, call the superclass */
+    if (!SenderBasedController::processFeedbackBatch(nowUs, feedbackBatch)) {
+        return false;
+    }
+    const bool roundStart = updateRound();
+    processNewPackets(nowUs);
+    maybeUpdateRate(nowUs, roundStart);
+    return true;
+}
+
+float BbrController::getBandwidth(uint64_t nowUs) const {
+    return m_currBw;
+}
+
+float BbrController::getBottleneckBw() const {
+    return m_btlBw;
+}
+
+bool BbrController::getMinRtt(uint64_t& minRttUs) const {
+    if (!m_minRttValid) {
+        return false;
+    }
+    minRttUs = m_minRttUs;
+    return true;
+}
+
+void BbrController::saveStateFields(std::ostream& os, uint64_t nowUs) const {
+    SenderBasedController::saveStateFields(os, nowUs);
+    os << "bbr " << int(m_mode) << ' ' << m_pacingGain
+       << ' ' << m_cycleIndex << ' ' << (nowUs - m_cycleStartUs)
+       << ' ' << (m_round - m_drainStartRound)
+       << ' ' << m_btlBw << ' ' << m_round
+       << ' ' << m_minRttValid << ' ' << m_minRttUs << ' ' << (nowUs - m_minRttStampUs)
+       << ' ' << m_fullBw << ' ' << m_fullBwCount << ' ' << m_filledPipe
+       << ' ' << m_lastTimeCalcValid << ' ' << (nowUs - m_lastTimeCalcUs) << ' ' << m_currBw << '\n';
+}
+
+bool BbrController::loadStateFields(std::istream& is, uint64_t nowUs) {
+    if (!SenderBasedController::loadStateFields(is, nowUs)) {
+        return false;
+    }
+    int mode = 0;
+    uint64_t cycleAgeUs = 0;
+    uint64_t drainRounds = 0;
+    uint64_t minRttAgeUs = 0;
+    uint64_t lastCalcAgeUs = 0;
+    if (!readStateTag(is, "bbr") ||
+        !(is >> mode >> m_pacingGain
+             >> m_cycleIndex >> cycleAgeUs
+             >> drainRounds
+             >> m_btlBw >> m_round
+             >> m_minRttValid >> m_minRttUs >> minRttAgeUs
+             >> m_fullBw >> m_fullBwCount >> m_filledPipe
+             >> m_lastTimeCalcValid >> lastCalcAgeUs >> m_currBw) ||
+        mode < BBR_STARTUP || mode > BBR_PROBE_RTT ||
+        m_cycleIndex >= BBR_CYCLE_LENGTH || drainRounds > m_round) {
+        return false;
+    }
+    m_mode = Mode(mode);
+    m_cycleStartUs = nowUs - cycleAgeUs;
+    m_drainStartRound = m_round - drainRounds;
+    m_minRttStampUs = nowUs - minRttAgeUs;
+    m_minRttExpired = false;
+    m_probeRttDoneUs = nowUs + BBR_PROBE_RTT_US;
+    m_lastTimeCalcUs = nowUs - lastCalcAgeUs;
+    /* The window of the bottleneck bandwidth filter restarts from its
+     * maximum, and the delivery rate sampling from the next feedback */
+    m_btlBwFilter.reset();
+    m_btlBwFilter.update(m_btlBw, m_round);
+    m_sampleValid = false;
+    m_sampleBytes = 0;
+    /* The superclass no longer counts the packets in transit as in flight:
+     * the next round starts with the next packet acknowledged */
+    m_roundEndBytes = m_sentBytes;
+    m_fbCountAtCalc = getFeedbackCount();
+    return true;
+}
+
+bool BbrController::updateRound() {
+    /* A packet sent after the start of the round has been acknowledged */
+    if (m_ackedBytes <= m_roundEndBytes) {
+        return false;
+    }
+    ++m_round;
+    m_roundEndBytes = m_sentBytes;
+    return true;
+}
+
+void BbrController::processNewPackets(uint64_t nowUs) {
+    for (size_t i = firstNewPacket(); i < m_packetHistory.size(); ++i) {
+        const uint64_t txTimestampUs = m_packetHistory.txTimestampAt(i);
+        // arrival time in the sender's clock, plus the clock offset (wraps correctly)
+        const uint64_t arrivalUs = txTimestampUs + m_packetHistory.owdAt(i);
+        updateDeliveryRate(txTimestampUs, arrivalUs, m_packetHistory.sizeAt(i));
+        updateMinRtt(nowUs, m_packetHistory.rttAt(i));
+    }
+    markPacketsProcessed();
+    if (!m_btlBwFilter.empty()) {
+        m_btlBw = m_btlBwFilter.get();
+    }
+}
+
+void BbrController::updateDeliveryRate(uint64_t txTimestampUs, uint64_t arrivalUs, uint32_t size) {
+    if (!m_sampleValid) {
+        m_sampleValid = true;
+        m_sampleTxUs = txTimestampUs;
+        m_sampleArrivalUs = arrivalUs;
+        m_sampleBytes = 0;
+        return;
+    }
+    m_sampleBytes += size;
+    /* As in BBR, the interval is the longest of the send and receive
+     * intervals, so that the rate is not overestimated when packets
+     * are sent, or received, in bursts */
+    const uint64_t sendUs = txTimestampUs - m_sampleTxUs;
+    const uint64_t recvUs = lessThan(m_sampleArrivalUs, arrivalUs) ? arrivalUs - m_sampleArrivalUs : 0;
+    const uint64_t intervalUs = std::max(sendUs, recvUs);
+    if (intervalUs < BBR_MIN_SAMPLE_US) {
+        return;
+    }
+    const float rateBps = float(m_sampleBytes) * 8.f * 1e6f / float(intervalUs);
+    m_btlBwFilter.update(rateBps, m_round);
+    m_sampleTxUs = txTimestampUs;
+    m_sampleArrivalUs = arrivalUs;
+    m_sampleBytes = 0;
+}
+
+void BbrController::updateMinRtt(uint64_t nowUs, uint64_t rttUs) {
+    const bool expired = m_minRttValid &&
+                         lessThan(m_minRttStampUs + BBR_MIN_RTT_WINDOW_US, nowUs);
+    if (!m_minRttValid || rttUs <= m_minRttUs || expired) {
+        m_minRttUs = rttUs;
+        m_minRttStampUs = nowUs;
+        m_minRttValid = true;
+    }
+    m_minRttExpired = m_minRttExpired || expired;
+}
+
+void BbrController::maybeUpdateRate(uint64_t nowUs, bool roundStart) {
+    if (roundStart && !m_filledPipe) {
+        checkFullPipe();
+    }
+
+    /* First time receiving a feedback message */
+    if (!m_lastTimeCalcValid) {
+        m_lastTimeCalcUs = nowUs;
+        m_lastTimeCalcValid = true;
+        return;
+    }
+
+    /* Nothing new to react to: skip the update altogether */
+    if (getFeedbackCount() == m_fbCountAtCalc) {
+        return;
+    }
+
+    assert(lessThan(m_lastTimeCalcUs, nowUs + 1));
+    /* calculate time since last update */
+    const uint64_t deltaUs = nowUs - m_lastTimeCalcUs; // subtraction will wrap correctly
+    if (deltaUs < BBR_UPDATE_INTERVAL_US) {
+        return;
+    }
+    updateLatestMetrics(nowUs);
+    updateMode(nowUs);
+    m_currBw = std::min(m_maxBw, std::max(m_minBw, m_pacingGain * m_btlBw));
+    logStats(nowUs, deltaUs);
+
+    m_lastTimeCalcUs = nowUs;
+    m_fbCountAtCalc = getFeedbackCount();
+}
+
+void BbrController::checkFullPipe() {
+    /* Still growing significantly: not there yet */
+    if (m_btlBw >= m_fullBw * BBR_FULL_BW_THRESHOLD) {
+        m_fullBw = m_btlBw;
+        m_fullBwCount = 0;
+        return;
+    }
+    if (++m_fullBwCount >= BBR_FULL_BW_ROUNDS) {
+        m_filledPipe = true;
+    }
+}
+
+void BbrController::updateMode(uint64_t nowUs) {
+    switch (m_mode) {
+        case BBR_STARTUP:
+            if (m_filledPipe) {
+                m_mode = BBR_DRAIN;
+                m_pacingGain = BBR_DRAIN_GAIN;
+                m_drainStartRound = m_round;
+            }
+            break;
+        case BBR_DRAIN:
+            if (m_latestMetrics.qdelayUs <= BBR_DRAIN_QDELAY_US ||
+                m_round - m_drainStartRound >= BBR_MAX_DRAIN_ROUNDS) {
+                enterProbeBw(nowUs);
+            }
+            break;
+        case BBR_PROBE_BW:
+        {
+            const uint64_t phaseUs = std::max(BBR_MIN_PHASE_US, m_minRttValid ? m_minRttUs : 0);
+            if (!lessThan(nowUs, m_cycleStartUs + phaseUs)) {
+                m_cycleIndex = (m_cycleIndex + 1) % BBR_CYCLE_LENGTH;
+                m_cycleStartUs = nowUs;
+                m_pacingGain = BBR_CYCLE_GAINS[m_cycleIndex];
+            }
+            break;
+        }
+        case BBR_PROBE_RTT:
+            if (!lessThan(nowUs, m_probeRttDoneUs)) {
+                /* The propagation RTT has been measured again */
+                m_minRttStampUs = nowUs;
+                if (m_filledPipe) {
+                    enterProbeBw(nowUs);
+                } else {
+                    m_mode = BBR_STARTUP;
+                    m_pacingGain = BBR_HIGH_GAIN;
+                }
+            }
+            break;
+    }
+
+    if (m_minRttExpired && m_mode != BBR_PROBE_RTT) {
+        m_mode = BBR_PROBE_RTT;
+        m_pacingGain = BBR_PROBE_RTT_GAIN;
+        m_probeRttDoneUs = nowUs + BBR_PROBE_RTT_US;
+    }
+    m_minRttExpired = false;
+}
+
+void BbrController::enterProbeBw(uint64_t nowUs) {
+    m_mode = BBR_PROBE_BW;
+    m_cycleIndex = BBR_CYCLE_START;
+    m_cycleStartUs = nowUs;
+    m_pacingGain = BBR_CYCLE_GAINS[m_cycleIndex];
+}
+
+void BbrController::logStats(uint64_t nowUs, uint64_t deltaUs) const {
+    /* xcurr carries BBR's pacing gain */
+    StatsRecord record;
+    fillStatsRecord(nowUs, deltaUs, record);
+    record.xcurr = m_pacingGain;
+    record.srateBps = m_currBw;
+    reportStats("bbr", record);
+}
+
+}
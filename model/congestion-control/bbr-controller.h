@@ -0,0 +1,208 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * BBR-style controller interface for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef BBR_CONTROLLER_H
+#define BBR_CONTROLLER_H
+
+#include "sender-based-controller.h"
+#include "windowed-filter.h"
+#include <functional>
+
+namespace rmcat {
+
+/**
+ * Model-based media congestion controller, in the style of TCP BBR. Rather
+ * than reacting to congestion signals (queuing delay, losses), it keeps a
+ * model of the path:
+ *  - Bottleneck bandwidth: windowed maximum (over 10 rounds) of the
+ *    delivery rate, measured on the receive timestamps of the packets
+ *    acknowledged (i.e., the packets in the history)
+ *  - Propagation round trip time: windowed minimum (over 10 s) of the
+ *    packets' RTT
+ *
+ * The rate returned by #getBandwidth is the bottleneck bandwidth times a
+ * pacing gain, which depends on the mode:
+ *  - Startup: 2/ln(2), doubling the rate every round, until the bottleneck
+ *    bandwidth stops growing (by 25% over three rounds)
+ *  - Drain: the inverse of the startup gain, until the queue built up in
+ *    startup is drained
+ *  - Probe bandwidth: cycling through 1.25 (probing for more bandwidth),
+ *    0.75 (draining the queue the probe may have built up), and six phases
+ *    at 1. Each phase lasts one propagation RTT, or 200 ms if longer, so
+ *    that feedback on the phase arrives before it ends
+ *  - Probe RTT: if the propagation RTT has not been measured for 10 s, the
+ *    rate is halved for 200 ms, so that the queue drains and it can be
+ *    measured again. This is a rate-based approximation of BBR's minimal
+ *    window of 4 packets
+ *
+ * A round starts when a packet sent after the start of the previous round
+ * is acknowledged. Losses are not reacted upon; they only reduce the
+ * delivery rate measured.
+ */
+class BbrController: public SenderBasedController {
+public:
+    /** Class constructor */
+    BbrController();
+
+    /** Class destructor */
+    virtual ~BbrController();
+
+    /**
+     * Set the current bandwidth estimation. This can be useful in test environments
+     * to temporarily disrupt the current bandwidth estimation
+     *
+     * @param [in] newBw Bandwidth estimation to overwrite the current estimation
+     */
+    virtual void setCurrentBw(float newBw);
+
+    /**
+     * Reset the internal state of the congestion controller
+     */
+    virtual void reset();
+
+    /**
+     * BBR's implementation of the #processSendPacket API
+     */
+    virtual bool processSendPacket(uint64_t txTimestampUs,
+                                   uint16_t sequence,
+                                   uint32_t size); // in Bytes
+
+    /**
+     * BBR's implementation of the #processFeedback API: the packet
+     * acknowledged updates the path model, and the rate is updated at
+     * regular intervals
+     */
+    virtual bool processFeedback(uint64_t nowUs,
+                                 uint16_t sequence,
+                                 uint64_t rxTimestampUs,
+                                 uint8_t ecn=0);
+
+    /**
+     * BBR's implementation of the #processFeedbackBatch API: all packets
+     * acknowledged update the path model, then the rate is updated
+     */
+    virtual bool processFeedbackBatch(uint64_t nowUs,
+                                      const std::vector<FeedbackItem>& feedbackBatch);
+
+    /**
+     * BBR's implementation of the #getBandwidth API: the bottleneck
+     * bandwidth times the pacing gain
+     */
+    virtual float getBandwidth(uint64_t nowUs) const;
+
+    /**
+     * Get the bottleneck bandwidth estimation
+     *
+     * @retval The bottleneck bandwidth, in bps
+     */
+    float getBottleneckBw() const;
+
+    /**
+     * Get the propagation round trip time estimation
+     *
+     * @param [out] minRttUs The propagation RTT, in microseconds
+     * @retval False if no RTT has been measured yet, true otherwise
+     */
+    bool getMinRtt(uint64_t& minRttUs) const;
+
+protected:
+    /**
+     * Append BBR's state to a snapshot: the mode, and the path model's
+     * current estimations. The delivery rate samples of the window are
+     * not part of it
+     */
+    virtual void saveStateFields(std::ostream& os, uint64_t nowUs) const;
+    virtual bool loadStateFields(std::istream& is, uint64_t nowUs);
+
+private:
+    /** Modes of operation */
+    enum Mode {
+        BBR_STARTUP,
+        BBR_DRAIN,
+        BBR_PROBE_BW,
+        BBR_PROBE_RTT,
+    };
+
+    /**
+     * Update the path model with the packets acknowledged since the last
+     * call (see #firstNewPacket )
+     */
+    void processNewPackets(uint64_t nowUs);
+    /** Take a delivery rate sample, if the packet closes the sampling interval */
+    void updateDeliveryRate(uint64_t txTimestampUs, uint64_t arrivalUs, uint32_t size);
+    void updateMinRtt(uint64_t nowUs, uint64_t rttUs);
+    /** Count the rounds, on the bytes acknowledged */
+    bool updateRound();
+
+    /** Update the mode and the rate, if due, upon reception of feedback */
+    void maybeUpdateRate(uint64_t nowUs, bool roundStart);
+    void checkFullPipe();
+    void updateMode(uint64_t nowUs);
+    void enterProbeBw(uint64_t nowUs);
+    void logStats(uint64_t nowUs, uint64_t deltaUs) const;
+
+    typedef WindowedFilter<float, std::greater<float> > MaxFilter;
+
+    /* Path model */
+    bool m_sampleValid;          /**< whether the delivery rate sampling interval has started */
+    uint64_t m_sampleTxUs;       /**< send time of the packet starting the interval */
+    uint64_t m_sampleArrivalUs;  /**< arrival time of the packet starting the interval */
+    uint32_t m_sampleBytes;      /**< bytes received since the start of the interval */
+    /**
+     * Windowed maximum of the delivery rate, in bps. The timestamps of its
+     * samples are round counts, so that its window is a number of rounds
+     */
+    MaxFilter m_btlBwFilter;
+    float m_btlBw;               /**< bottleneck bandwidth (the filter's maximum) */
+    uint64_t m_round;            /**< number of rounds since the last reset */
+    uint64_t m_roundEndBytes;    /**< the round ends when bytes sent after these are acknowledged */
+    uint64_t m_minRttUs;         /**< propagation RTT */
+    uint64_t m_minRttStampUs;    /**< when #m_minRttUs was last measured */
+    bool m_minRttValid;
+    bool m_minRttExpired;        /**< the propagation RTT was not measured for too long */
+
+    /* Modes */
+    Mode m_mode;
+    float m_pacingGain;
+    size_t m_cycleIndex;         /**< phase of the gain cycle, in probe bandwidth mode */
+    uint64_t m_cycleStartUs;     /**< start of the current phase of the gain cycle */
+    uint64_t m_probeRttDoneUs;   /**< end of the probe RTT mode */
+    uint64_t m_drainStartRound;
+    float m_fullBw;              /**< bottleneck bandwidth at the last significant growth */
+    uint32_t m_fullBwCount;      /**< rounds without significant growth */
+    bool m_filledPipe;           /**< whether the bottleneck bandwidth has been reached */
+
+    /* Rate */
+    uint64_t m_lastTimeCalcUs;
+    bool m_lastTimeCalcValid;
+    uint64_t m_fbCountAtCalc;    /**< feedback count (see #getFeedbackCount ) at the last rate update */
+    float m_currBw;              /**< rate returned: bottleneck bandwidth times the pacing gain */
+};
+
+}
+
+#endif /* BBR_CONTROLLER_H */
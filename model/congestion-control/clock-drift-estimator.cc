@@ -0,0 +1,196 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Clock drift estimator implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "clock-drift-estimator.h"
+#include "windowed-filter.h"
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+namespace rmcat {
+
+const uint64_t ClockDriftEstimator::DEFAULT_INTERVAL_US;
+const size_t ClockDriftEstimator::DEFAULT_N_POINTS;
+const size_t ClockDriftEstimator::MIN_N_POINTS;
+constexpr double ClockDriftEstimator::MAX_DRIFT_PPM;
+
+ClockDriftEstimator::ClockDriftEstimator(uint64_t intervalUs, size_t nPoints)
+: m_intervalUs{intervalUs},
+  m_nPoints{nPoints},
+  m_points{},
+  m_head{0},
+  m_started{false},
+  m_originTxUs{0},
+  m_originOwdUs{0},
+  m_inInterval{false},
+  m_intervalEndUs{0},
+  m_intervalMin{0., 0.},
+  m_valid{false},
+  m_slope{0.} {
+    assert(m_intervalUs > 0);
+    assert(m_nPoints >= 2);
+    m_points.reserve(m_nPoints);
+}
+
+void ClockDriftEstimator::reset() {
+    m_points.clear();
+    m_head = 0;
+    m_started = false;
+    m_inInterval = false;
+    m_valid = false;
+    m_slope = 0.;
+}
+
+void ClockDriftEstimator::update(uint64_t owdUs, uint64_t txTimestampUs) {
+    const WrapLess<uint64_t> lessThan{};
+    if (!m_started) {
+        m_originTxUs = txTimestampUs;
+        m_originOwdUs = owdUs;
+        m_intervalEndUs = txTimestampUs + m_intervalUs;
+        m_started = true;
+    }
+
+    if (!lessThan(txTimestampUs, m_intervalEndUs)) {
+        if (m_inInterval) {
+            addPoint(m_intervalMin);
+            fit();
+            m_inInterval = false;
+        }
+        // Skip the intervals without samples. These subtractions will wrap properly
+        const uint64_t nIntervals = (txTimestampUs - m_intervalEndUs) / m_intervalUs + 1;
+        m_intervalEndUs += nIntervals * m_intervalUs;
+    }
+
+    // These subtractions will wrap properly
+    const Point point{double(int64_t(txTimestampUs - m_originTxUs)),
+                      double(int64_t(owdUs - m_originOwdUs))};
+    if (!m_inInterval || point.yUs < m_intervalMin.yUs) {
+        m_intervalMin = point;
+        m_inInterval = true;
+    }
+}
+
+int64_t ClockDriftEstimator::getOffsetUs(uint64_t txTimestampUs) const {
+    if (!m_valid) {
+        return 0;
+    }
+    // This subtraction will wrap properly
+    const double tUs = double(int64_t(txTimestampUs - m_originTxUs));
+    return int64_t(std::llround(m_slope * tUs));
+}
+
+/*
+ * Points are written from the oldest to the newest. They are relative to
+ * the first sample, so only the origin and interval timestamps are
+ * written relative to nowUs
+ */
+void ClockDriftEstimator::saveState(std::ostream& os, uint64_t nowUs) const {
+    os << m_intervalUs << ' ' << m_nPoints << ' ' << m_points.size();
+    for (size_t i = 0; i < m_points.size(); ++i) {
+        const Point& p = m_points[(m_head + i) % m_points.size()];
+        os << ' ' << p.tUs << ' ' << p.yUs;
+    }
+    os << ' ' << m_started << ' ' << (nowUs - m_originTxUs) << ' ' << m_originOwdUs
+       << ' ' << m_inInterval << ' ' << (nowUs - m_intervalEndUs)
+       << ' ' << m_intervalMin.tUs << ' ' << m_intervalMin.yUs
+       << ' ' << m_valid << ' ' << m_slope << '\n';
+}
+
+bool ClockDriftEstimator::loadState(std::istream& is, uint64_t nowUs) {
+    uint64_t intervalUs = 0;
+    size_t nPoints = 0;
+    size_t size = 0;
+    if (!(is >> intervalUs >> nPoints >> size) ||
+        intervalUs == 0 || nPoints < 2 || size > nPoints) {
+        return false;
+    }
+    ClockDriftEstimator loaded{intervalUs, nPoints};
+    for (size_t i = 0; i < size; ++i) {
+        Point p{0., 0.};
+        if (!(is >> p.tUs >> p.yUs)) {
+            return false;
+        }
+        loaded.m_points.push_back(p);
+    }
+    uint64_t originAgeUs = 0;
+    uint64_t intervalEndAgeUs = 0;
+    if (!(is >> loaded.m_started >> originAgeUs >> loaded.m_originOwdUs
+             >> loaded.m_inInterval >> intervalEndAgeUs
+             >> loaded.m_intervalMin.tUs >> loaded.m_intervalMin.yUs
+             >> loaded.m_valid >> loaded.m_slope)) {
+        return false;
+    }
+    loaded.m_originTxUs = nowUs - originAgeUs;
+    loaded.m_intervalEndUs = nowUs - intervalEndAgeUs;
+    *this = loaded;
+    return true;
+}
+
+void ClockDriftEstimator::addPoint(const Point& point) {
+    if (m_points.size() < m_nPoints) {
+        m_points.push_back(point);
+        return;
+    }
+    m_points[m_head] = point;
+    m_head = (m_head + 1) % m_nPoints;
+}
+
+/*
+ * Least squares fit of the interval minima. The points are centered on
+ * their means before summing the products, which keeps the fit accurate
+ * however long the flow has been running
+ */
+void ClockDriftEstimator::fit() {
+    const size_t n = m_points.size();
+    if (n < MIN_N_POINTS) {
+        return;
+    }
+    double tMean = 0.;
+    double yMean = 0.;
+    for (const auto& p : m_points) {
+        tMean += p.tUs;
+        yMean += p.yUs;
+    }
+    tMean /= double(n);
+    yMean /= double(n);
+
+    double sTT = 0.;
+    double sTY = 0.;
+    for (const auto& p : m_points) {
+        const double dt = p.tUs - tMean;
+        sTT += dt * dt;
+        sTY += dt * (p.yUs - yMean);
+    }
+    if (sTT <= 0.) {
+        return;
+    }
+    const double maxSlope = MAX_DRIFT_PPM * 1e-6;
+    m_slope = std::max(-maxSlope, std::min(maxSlope, sTY / sTT));
+    m_valid = true;
+}
+
+}
@@ -0,0 +1,137 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Clock drift estimator for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef CLOCK_DRIFT_ESTIMATOR_H
+#define CLOCK_DRIFT_ESTIMATOR_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <iostream>
+
+namespace rmcat {
+
+/**
+ * This class estimates the drift between the sender's and the receiver's
+ * clocks from the one way delays measured on a flow. If the receiver's
+ * clock runs faster (resp. slower) than the sender's, one way delays grow
+ * (resp. shrink) linearly over time, which looks like a queue building up
+ * (resp. draining).
+ *
+ * Time is divided into intervals, and the minimum one way delay of each
+ * interval is taken as a sample of the path's base delay, which should
+ * contain little queuing delay. The drift is the slope of a least squares
+ * linear fit of the most recent minima against time. The fit is updated
+ * once per interval, so the per-packet cost is O(1).
+ *
+ * One way delays and timestamps may wrap (see #rmcat::PacketRecord ).
+ */
+class ClockDriftEstimator {
+public:
+    static const uint64_t DEFAULT_INTERVAL_US = 1000 * 1000; /**< one second */
+    static const size_t DEFAULT_N_POINTS = 120;   /**< fit over two minutes */
+    static const size_t MIN_N_POINTS = 10;        /**< minima needed before estimating */
+    static constexpr double MAX_DRIFT_PPM = 500.; /**< estimations are clamped to this magnitude */
+
+    /**
+     * Class constructor
+     *
+     * @param [in] intervalUs Length of the intervals, in microseconds
+     * @param [in] nPoints Number of (most recent) interval minima in the fit
+     */
+    explicit ClockDriftEstimator(uint64_t intervalUs=DEFAULT_INTERVAL_US,
+                                 size_t nPoints=DEFAULT_N_POINTS);
+
+    /** Forget all samples, and the current estimation */
+    void reset();
+
+    /**
+     * Account for a new one way delay sample
+     *
+     * @param [in] owdUs One way delay, in microseconds
+     * @param [in] txTimestampUs Send time of the packet, in microseconds
+     */
+    void update(uint64_t owdUs, uint64_t txTimestampUs);
+
+    /** @retval True if enough samples have been gathered to estimate the drift */
+    bool valid() const { return m_valid; }
+
+    /** @retval The estimated drift, in parts per million. Zero if not #valid */
+    double getDriftPpm() const { return m_slope * 1e6; }
+
+    /**
+     * Get the part of a one way delay due to the clock drift, accumulated
+     * since the first sample. Subtracting it from a one way delay leaves
+     * the delay the packet would have had without the drift
+     *
+     * @param [in] txTimestampUs Send time of the packet, in microseconds
+     * @retval The offset, in microseconds (may be negative)
+     */
+    int64_t getOffsetUs(uint64_t txTimestampUs) const;
+
+    /**
+     * Write the samples and the estimation to a stream, as text. Timestamps
+     * are written relative to nowUs (see BaseDelayTracker::saveState )
+     */
+    void saveState(std::ostream& os, uint64_t nowUs) const;
+
+    /**
+     * Read samples and estimation written by #saveState
+     *
+     * @retval False if the stream does not contain a valid estimator
+     */
+    bool loadState(std::istream& is, uint64_t nowUs);
+
+private:
+    struct Point {
+        double tUs; /**< time since the first sample */
+        double yUs; /**< one way delay, relative to the first sample's */
+    };
+
+    void addPoint(const Point& point);
+    void fit();
+
+    uint64_t m_intervalUs;
+    size_t m_nPoints;
+    std::vector<Point> m_points; /**< ring of interval minima */
+    size_t m_head;               /**< slot of the oldest point */
+
+    bool m_started;
+    uint64_t m_originTxUs;  /**< send time of the first sample */
+    uint64_t m_originOwdUs; /**< one way delay of the first sample */
+
+    bool m_inInterval;      /**< whether the current interval has samples */
+    uint64_t m_intervalEndUs;
+    Point m_intervalMin;    /**< minimum of the current interval */
+
+    bool m_valid;
+    double m_slope;         /**< estimated drift, in microseconds per microsecond */
+};
+
+}
+
+#endif /* CLOCK_DRIFT_ESTIMATOR_H */
@@ -0,0 +1,183 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Coupled controller implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "coupled-controller.h"
+#include <cassert>
+
+namespace rmcat {
+
+CoupledController::CoupledController(std::shared_ptr<FlowStateExchange> fse,
+                                     std::shared_ptr<SenderBasedController> controller,
+                                     float priority)
+: SenderBasedController{},
+  m_fse{fse},
+  m_controller{controller},
+  m_flowId{0} {
+    assert(m_fse);
+    assert(m_controller);
+    m_flowId = m_fse->registerFlow(*m_controller, priority, m_maxBw);
+}
+
+CoupledController::~CoupledController() {
+    m_fse->unregisterFlow(m_flowId);
+}
+
+void CoupledController::setId(const std::string& id) {
+    SenderBasedController::setId(id);
+    m_controller->setId(id);
+}
+
+void CoupledController::setInitBw(float initBw) {
+    SenderBasedController::setInitBw(initBw);
+    m_controller->setInitBw(initBw);
+}
+
+void CoupledController::setMinBw(float minBw) {
+    SenderBasedController::setMinBw(minBw);
+    m_controller->setMinBw(minBw);
+}
+
+void CoupledController::setMaxBw(float maxBw) {
+    SenderBasedController::setMaxBw(maxBw);
+    m_controller->setMaxBw(maxBw);
+    m_fse->setDesiredBw(m_flowId, maxBw);
+}
+
+void CoupledController::setLogCallback(logCallback f) {
+    SenderBasedController::setLogCallback(f);
+    m_controller->setLogCallback(f);
+}
+
+void CoupledController::setStatsSink(std::shared_ptr<StatsSink> sink) {
+    SenderBasedController::setStatsSink(sink);
+    m_controller->setStatsSink(sink);
+}
+
+void CoupledController::setBaseDelayWindow(size_t nBuckets, uint64_t bucketUs) {
+    SenderBasedController::setBaseDelayWindow(nBuckets, bucketUs);
+    m_controller->setBaseDelayWindow(nBuckets, bucketUs);
+}
+
+void CoupledController::setClockDriftCompensation(bool enable) {
+    SenderBasedController::setClockDriftCompensation(enable);
+    m_controller->setClockDriftCompensation(enable);
+}
+
+void CoupledController::setRecvRateEstimator(std::shared_ptr<RecvRateEstimator> estimator) {
+    // Only the wrapped controller processes packets: it owns the estimator
+    m_controller->setRecvRateEstimator(estimator);
+}
+
+void CoupledController::setRecvRateOverhead(uint32_t bytesPerPacket) {
+    SenderBasedController::setRecvRateOverhead(bytesPerPacket);
+    m_controller->setRecvRateOverhead(bytesPerPacket);
+}
+
+void CoupledController::setVerboseDiagnostics(bool verbose) {
+    SenderBasedController::setVerboseDiagnostics(verbose);
+    m_controller->setVerboseDiagnostics(verbose);
+}
+
+void CoupledController::setDiagnosticsInterval(uint64_t intervalUs) {
+    SenderBasedController::setDiagnosticsInterval(intervalUs);
+    m_controller->setDiagnosticsInterval(intervalUs);
+}
+
+void CoupledController::reset() {
+    SenderBasedController::reset();
+    m_fse->leave(m_flowId);
+    m_controller->reset();
+}
+
+const SenderBasedController::Diagnostics& CoupledController::getDiagnostics() const {
+    return m_controller->getDiagnostics();
+}
+
+bool CoupledController::getClockDrift(double& driftPpm) const {
+    return m_controller->getClockDrift(driftPpm);
+}
+
+void CoupledController::saveState(std::ostream& os, uint64_t nowUs) const {
+    m_controller->saveState(os, nowUs);
+}
+
+bool CoupledController::loadState(std::istream& is, uint64_t nowUs) {
+    m_fse->leave(m_flowId);
+    return m_controller->loadState(is, nowUs);
+}
+
+void CoupledController::setCurrentBw(float newBw) {
+    m_controller->setCurrentBw(newBw);
+}
+
+bool CoupledController::processSendPacket(uint64_t txTimestampUs,
+                                          uint16_t sequence,
+                                          uint32_t size) {
+    const bool res = m_controller->processSendPacket(txTimestampUs, sequence, size);
+    if (!m_fse->isActive(m_flowId)) {
+        m_fse->update(m_flowId, txTimestampUs);
+    }
+    return res;
+}
+
+bool CoupledController::processFeedback(uint64_t nowUs,
+                                        uint16_t sequence,
+                                        uint64_t rxTimestampUs,
+                                        uint8_t ecn) {
+    const bool res = m_controller->processFeedback(nowUs, sequence, rxTimestampUs, ecn);
+    m_fse->update(m_flowId, nowUs);
+    return res;
+}
+
+bool CoupledController::processFeedbackBatch(uint64_t nowUs,
+                                             const std::vector<FeedbackItem>& feedbackBatch) {
+    const bool res = m_controller->processFeedbackBatch(nowUs, feedbackBatch);
+    m_fse->update(m_flowId, nowUs);
+    return res;
+}
+
+bool CoupledController::canSend(uint64_t nowUs, uint32_t size) const {
+    return m_controller->canSend(nowUs, size);
+}
+
+uint64_t CoupledController::getBytesInFlight() const {
+    return m_controller->getBytesInFlight();
+}
+
+float CoupledController::getBandwidth(uint64_t nowUs) const {
+    return m_controller->getBandwidth(nowUs);
+}
+
+void CoupledController::setPriority(float priority) {
+    m_fse->setPriority(m_flowId, priority);
+}
+
+std::shared_ptr<SenderBasedController> CoupledController::getController() const {
+    return m_controller;
+}
+
+}
@@ -0,0 +1,149 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Coupled controller interface for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef COUPLED_CONTROLLER_H
+#define COUPLED_CONTROLLER_H
+
+#include "sender-based-controller.h"
+#include "flow-state-exchange.h"
+#include <memory>
+
+namespace rmcat {
+
+/**
+ * This class couples a flow's congestion controller with those of the
+ * other flows of a #FlowStateExchange group. It wraps another controller,
+ * and registers it to the group:
+ *
+ *  - The flow joins the group when it sends its first packet (after a
+ *    reset, or a snapshot is loaded)
+ *  - After the wrapped controller processes feedback, the group is
+ *    updated with its new rate, and all flows' controllers are set to
+ *    their shares of the aggregate rate
+ *  - The flow leaves the group when it is reset, or destroyed
+ *
+ * #getBandwidth thus returns the flow's share. The configuration calls
+ * (#setId , #setInitBw , etc.) are forwarded to the wrapped controller;
+ * the maximum bandwidth is also the flow's desired rate in the group.
+ *
+ * The coupling works best with controllers whose rate updates build upon
+ * their current rate, e.g., #NadaController or #GccController .
+ */
+class CoupledController: public SenderBasedController
+{
+public:
+    /**
+     * Class constructor
+     *
+     * @param [in] fse The group the flow is registered to
+     * @param [in] controller The controller to wrap
+     * @param [in] priority Weight of the flow's share of the aggregate rate
+     */
+    CoupledController(std::shared_ptr<FlowStateExchange> fse,
+                      std::shared_ptr<SenderBasedController> controller,
+                      float priority=1.f);
+
+    /** Class destructor: the flow is unregistered from the group */
+    virtual ~CoupledController();
+
+    /* Configuration: forwarded to the wrapped controller */
+    virtual void setId(const std::string& id);
+    virtual void setInitBw(float initBw);
+    virtual void setMinBw(float minBw);
+    virtual void setMaxBw(float maxBw);
+    virtual void setLogCallback(logCallback f);
+    virtual void setStatsSink(std::shared_ptr<StatsSink> sink);
+    virtual void setBaseDelayWindow(size_t nBuckets, uint64_t bucketUs);
+    virtual void setClockDriftCompensation(bool enable);
+    virtual void setRecvRateEstimator(std::shared_ptr<RecvRateEstimator> estimator);
+    virtual void setRecvRateOverhead(uint32_t bytesPerPacket);
+    virtual void setVerboseDiagnostics(bool verbose);
+    virtual void setDiagnosticsInterval(uint64_t intervalUs);
+
+    /** Reset the wrapped controller; the flow leaves the group */
+    virtual void reset();
+
+    /** Get the wrapped controller's diagnostics counters */
+    virtual const Diagnostics& getDiagnostics() const;
+
+    /** Get the wrapped controller's clock drift estimation */
+    virtual bool getClockDrift(double& driftPpm) const;
+
+    /**
+     * Snapshots (see SenderBasedController::saveState ) are taken from,
+     * and loaded into, the wrapped controller. They do not contain the
+     * flow's share: once a snapshot is loaded, the flow leaves the group,
+     * and joins it again with the restored rate
+     */
+    virtual void saveState(std::ostream& os, uint64_t nowUs) const;
+    virtual bool loadState(std::istream& is, uint64_t nowUs);
+
+    /**
+     * Set the wrapped controller's bandwidth estimation. The group takes
+     * the change into account upon the next feedback
+     */
+    virtual void setCurrentBw(float newBw);
+
+    /** Process the packet with the wrapped controller; join the group if needed */
+    virtual bool processSendPacket(uint64_t txTimestampUs,
+                                   uint16_t sequence,
+                                   uint32_t size); // in Bytes
+
+    /** Process feedback with the wrapped controller, then update the group */
+    virtual bool processFeedback(uint64_t nowUs,
+                                 uint16_t sequence,
+                                 uint64_t rxTimestampUs,
+                                 uint8_t ecn=0);
+
+    /** Process aggregated feedback with the wrapped controller, then update the group */
+    virtual bool processFeedbackBatch(uint64_t nowUs,
+                                      const std::vector<FeedbackItem>& feedbackBatch);
+
+    /** Forwarded to the wrapped controller */
+    virtual bool canSend(uint64_t nowUs, uint32_t size) const;
+
+    /** Forwarded to the wrapped controller */
+    virtual uint64_t getBytesInFlight() const;
+
+    /** Get the wrapped controller's bandwidth, i.e., the flow's share */
+    virtual float getBandwidth(uint64_t nowUs) const;
+
+    /** Set the weight of the flow's share of the aggregate rate */
+    void setPriority(float priority);
+
+    /** @retval The wrapped controller */
+    std::shared_ptr<SenderBasedController> getController() const;
+
+private:
+    std::shared_ptr<FlowStateExchange> m_fse;
+    std::shared_ptr<SenderBasedController> m_controller;
+    size_t m_flowId; /**< id of the flow in the group */
+};
+
+}
+
+#endif /* COUPLED_CONTROLLER_H */
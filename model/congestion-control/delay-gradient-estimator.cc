@@ -0,0 +1,267 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * One way delay gradient estimator implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "delay-gradient-estimator.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace rmcat {
+
+const uint32_t DGE_MAX_DELTAS = 1000;         /**< the count of delay variations is capped */
+
+/* Trendline */
+const double DGE_SMOOTHING = 0.9;             /**< smoothing factor of the accumulated delay */
+
+/* Kalman filter (see Section 5.3 of the rmcat-gcc draft), in ms */
+const double DGE_PROCESS_NOISE = 1e-3;        /**< q: variance of the offset's changes */
+const double DGE_INIT_OFFSET_VAR = 0.1;       /**< e(0) */
+const double DGE_INIT_NOISE_VAR = 50.;        /**< var_v_hat(0) */
+const double DGE_MIN_NOISE_VAR = 1.;
+const double DGE_CHI = 0.01;                  /**< forgetting factor of the noise variance, at 30 groups/s */
+const double DGE_OUTLIER_FACTOR = 3.;         /**< noise samples are capped at this many standard deviations */
+const double DGE_SEND_DELTA_SMOOTHING = 0.9;  /**< smoothing factor of the time between groups */
+
+const uint64_t DelayGradientEstimator::DEFAULT_BURST_TIME_US;
+const size_t DelayGradientEstimator::DEFAULT_TRENDLINE_WINDOW;
+
+DelayGradientEstimator::DelayGradientEstimator(Mode mode,
+                                               uint64_t burstTimeUs,
+                                               size_t trendlineWindow) :
+    m_mode{mode},
+    m_burstTimeUs{burstTimeUs},
+    m_window{trendlineWindow},
+    m_groupValid{false},
+    m_groupFirstTxUs{0},
+    m_groupLastTxUs{0},
+    m_groupArrivalUs{0},
+    m_prevGroupValid{false},
+    m_prevGroupLastTxUs{0},
+    m_prevGroupArrivalUs{0},
+    m_firstArrivalValid{false},
+    m_firstArrivalUs{0},
+    m_numDeltas{0},
+    m_sendDeltaMs{0.},
+    m_arrivalMs{0.},
+    m_gradient{0.},
+    m_accumulatedDelayMs{0.},
+    m_smoothedDelayMs{0.},
+    m_points{},
+    m_pointsSinceRefit{0},
+    m_meanX{0.},
+    m_meanY{0.},
+    m_sumXX{0.},
+    m_sumXY{0.},
+    m_offsetMs{0.},
+    m_offsetVar{DGE_INIT_OFFSET_VAR},
+    m_noiseVar{DGE_INIT_NOISE_VAR},
+    m_avgSendDeltaMs{0.} {
+    assert(m_window >= 2);
+}
+
+void DelayGradientEstimator::reset() {
+    m_groupValid = false;
+    m_groupFirstTxUs = 0;
+    m_groupLastTxUs = 0;
+    m_groupArrivalUs = 0;
+    m_prevGroupValid = false;
+    m_prevGroupLastTxUs = 0;
+    m_prevGroupArrivalUs = 0;
+    m_firstArrivalValid = false;
+    m_firstArrivalUs = 0;
+    m_numDeltas = 0;
+    m_sendDeltaMs = 0.;
+    m_arrivalMs = 0.;
+    m_gradient = 0.;
+    m_accumulatedDelayMs = 0.;
+    m_smoothedDelayMs = 0.;
+    m_points.clear();
+    m_pointsSinceRefit = 0;
+    m_meanX = 0.;
+    m_meanY = 0.;
+    m_sumXX = 0.;
+    m_sumXY = 0.;
+    m_offsetMs = 0.;
+    m_offsetVar = DGE_INIT_OFFSET_VAR;
+    m_noiseVar = DGE_INIT_NOISE_VAR;
+    m_avgSendDeltaMs = 0.;
+}
+
+bool DelayGradientEstimator::addPacket(uint64_t txTimestampUs, uint64_t arrivalUs) {
+    if (!m_firstArrivalValid) {
+        m_firstArrivalUs = arrivalUs;
+        m_firstArrivalValid = true;
+    }
+    if (m_groupValid && txTimestampUs - m_groupFirstTxUs < m_burstTimeUs) {
+        /* Same burst: the group ends with this packet */
+        m_groupLastTxUs = txTimestampUs;
+        m_groupArrivalUs = arrivalUs;
+        return false;
+    }
+
+    /* The packet starts a new group: the current one is complete */
+    bool updated = false;
+    if (m_groupValid) {
+        if (m_prevGroupValid) {
+            const int64_t sendDeltaUs = int64_t(m_groupLastTxUs - m_prevGroupLastTxUs);
+            const int64_t recvDeltaUs = int64_t(m_groupArrivalUs - m_prevGroupArrivalUs);
+            const int64_t arrivalOffsetUs = int64_t(m_groupArrivalUs - m_firstArrivalUs);
+            const double sendDeltaMs = double(sendDeltaUs) / 1000.;
+            const double recvDeltaMs = double(recvDeltaUs) / 1000.;
+            m_sendDeltaMs = sendDeltaMs;
+            m_arrivalMs = double(arrivalOffsetUs) / 1000.;
+            m_numDeltas = std::min(m_numDeltas + 1, DGE_MAX_DELTAS);
+            if (m_mode == MODE_KALMAN) {
+                updateKalman(recvDeltaMs - sendDeltaMs, sendDeltaMs);
+            } else {
+                updateTrendline(recvDeltaMs - sendDeltaMs, m_arrivalMs);
+            }
+            updated = true;
+        }
+        m_prevGroupLastTxUs = m_groupLastTxUs;
+        m_prevGroupArrivalUs = m_groupArrivalUs;
+        m_prevGroupValid = true;
+    }
+    m_groupFirstTxUs = txTimestampUs;
+    m_groupLastTxUs = txTimestampUs;
+    m_groupArrivalUs = arrivalUs;
+    m_groupValid = true;
+    return updated;
+}
+
+bool DelayGradientEstimator::addPacket(const PacketRecord& packet) {
+    // arrival time in the sender's clock, plus the clock offset (wraps correctly)
+    return addPacket(packet.txTimestampUs, packet.txTimestampUs + packet.owdUs);
+}
+
+DelayGradientEstimator::Mode DelayGradientEstimator::getMode() const {
+    return m_mode;
+}
+
+double DelayGradientEstimator::getGradient() const {
+    return m_gradient;
+}
+
+uint32_t DelayGradientEstimator::getNumDeltas() const {
+    return m_numDeltas;
+}
+
+double DelayGradientEstimator::getSendDeltaMs() const {
+    return m_sendDeltaMs;
+}
+
+double DelayGradientEstimator::getArrivalMs() const {
+    return m_arrivalMs;
+}
+
+/**
+ * Trendline: the delay variations are accumulated and smoothed, and a line
+ * is fitted (least squares) through the last points, as a function of the
+ * arrival time. The means and (co-)deviations of the points are updated
+ * as a point enters the window and another one leaves it
+ */
+void DelayGradientEstimator::updateTrendline(double deltaMs, double arrivalMs) {
+    m_accumulatedDelayMs += deltaMs;
+    m_smoothedDelayMs = DGE_SMOOTHING * m_smoothedDelayMs +
+                        (1. - DGE_SMOOTHING) * m_accumulatedDelayMs;
+
+    const double x = arrivalMs;
+    const double y = m_smoothedDelayMs;
+    m_points.push_back(std::make_pair(x, y));
+    double n = double(m_points.size());
+    double dx = x - m_meanX;
+    m_meanX += dx / n;
+    m_meanY += (y - m_meanY) / n;
+    m_sumXX += dx * (x - m_meanX);
+    m_sumXY += dx * (y - m_meanY);
+
+    if (m_points.size() > m_window) {
+        const double oldX = m_points.front().first;
+        const double oldY = m_points.front().second;
+        m_points.pop_front();
+        n = double(m_points.size());
+        dx = oldX - m_meanX;
+        m_meanX -= dx / n;
+        m_meanY -= (oldY - m_meanY) / n;
+        m_sumXX -= dx * (oldX - m_meanX);
+        m_sumXY -= dx * (oldY - m_meanY);
+    }
+    if (++m_pointsSinceRefit >= m_window) {
+        refit();
+    }
+
+    /* The gradient is only updated once the window is full */
+    if (m_points.size() == m_window && m_sumXX != 0.) {
+        m_gradient = m_sumXY / m_sumXX;
+    }
+}
+
+void DelayGradientEstimator::refit() {
+    const double n = double(m_points.size());
+    m_meanX = 0.;
+    m_meanY = 0.;
+    for (const auto& point : m_points) {
+        m_meanX += point.first;
+        m_meanY += point.second;
+    }
+    m_meanX /= n;
+    m_meanY /= n;
+    m_sumXX = 0.;
+    m_sumXY = 0.;
+    for (const auto& point : m_points) {
+        m_sumXX += (point.first - m_meanX) * (point.first - m_meanX);
+        m_sumXY += (point.first - m_meanX) * (point.second - m_meanY);
+    }
+    m_pointsSinceRefit = 0;
+}
+
+/**
+ * Kalman filter of the delay variation between groups (m_hat in the
+ * rmcat-gcc draft). The variance of the measurement noise is estimated
+ * with an exponential filter, whose forgetting factor depends on the
+ * time between groups, and which caps outliers
+ */
+void DelayGradientEstimator::updateKalman(double deltaMs, double sendDeltaMs) {
+    const double z = deltaMs - m_offsetMs;
+    const double maxNoiseMs = DGE_OUTLIER_FACTOR * std::sqrt(m_noiseVar);
+    const double noiseMs = std::min(std::fabs(z), maxNoiseMs);
+    const double alpha = std::pow(1. - DGE_CHI, 30. * std::max(sendDeltaMs, 0.) / 1000.);
+    m_noiseVar = std::max(alpha * m_noiseVar + (1. - alpha) * noiseMs * noiseMs,
+                          DGE_MIN_NOISE_VAR);
+
+    const double predictedVar = m_offsetVar + DGE_PROCESS_NOISE;
+    const double gain = predictedVar / (m_noiseVar + predictedVar);
+    m_offsetMs += gain * z;
+    m_offsetVar = (1. - gain) * predictedVar;
+
+    m_avgSendDeltaMs = m_numDeltas == 1 ? sendDeltaMs :
+                       DGE_SEND_DELTA_SMOOTHING * m_avgSendDeltaMs +
+                       (1. - DGE_SEND_DELTA_SMOOTHING) * sendDeltaMs;
+    m_gradient = m_avgSendDeltaMs > 0. ? m_offsetMs / m_avgSendDeltaMs : 0.;
+}
+
+}
@@ -0,0 +1,179 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * One way delay gradient estimator interface for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef DELAY_GRADIENT_ESTIMATOR_H
+#define DELAY_GRADIENT_ESTIMATOR_H
+
+#include "packet-history.h"
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <utility>
+
+namespace rmcat {
+
+/**
+ * This class estimates the gradient of the one way delay, i.e., how fast
+ * the queuing delay grows (positive) or shrinks (negative), in ms of delay
+ * per ms of time. It can be used by any controller, fed with the packets
+ * acknowledged, in sequence order.
+ *
+ * The packets are grouped by send burst: a group holds the packets sent
+ * within a short time (5 ms by default) of its first one. The delay
+ * variation between two consecutive groups is the difference between
+ * their inter-arrival and inter-departure times (taken at their last
+ * packets). The gradient is estimated from these variations, either:
+ *
+ *  - with a trendline (as in WebRTC's implementation of GCC): the delay
+ *    variations are accumulated and smoothed, and a line is fitted (least
+ *    squares) through the last points (20 by default), as a function of
+ *    the arrival time. The gradient is its slope. It is only updated once
+ *    the window is full
+ *  - with a Kalman filter (as in Section 5.3 of the rmcat-gcc draft),
+ *    which tracks the delay variation between groups, its measurement
+ *    noise being estimated online. The gradient is the filtered variation
+ *    over the (smoothed) time between groups
+ *
+ * Each packet takes O(1) time: the least-squares fit is maintained
+ * incrementally as points enter and leave the window (and recalculated
+ * from scratch once per window, so that rounding errors do not build up).
+ * As in the rest of the module, timestamps may wrap.
+ */
+class DelayGradientEstimator {
+public:
+    /** Estimation method */
+    enum Mode {
+        MODE_TRENDLINE,
+        MODE_KALMAN,
+    };
+
+    static const uint64_t DEFAULT_BURST_TIME_US = 5 * 1000; /**< packets sent within this time form a group */
+    static const size_t DEFAULT_TRENDLINE_WINDOW = 20;      /**< number of points in the trendline fit */
+
+    /**
+     * Class constructor
+     *
+     * @param [in] mode Estimation method
+     * @param [in] burstTimeUs Packets sent within this time of a group's
+     *                         first packet belong to the group
+     * @param [in] trendlineWindow Number of points in the trendline fit,
+     *                             at least 2 (trendline mode only)
+     */
+    explicit DelayGradientEstimator(Mode mode=MODE_TRENDLINE,
+                                    uint64_t burstTimeUs=DEFAULT_BURST_TIME_US,
+                                    size_t trendlineWindow=DEFAULT_TRENDLINE_WINDOW);
+
+    /** Forget the groups and the estimation so far; the configuration is kept */
+    void reset();
+
+    /**
+     * Add a packet acknowledged. If it starts a new group, the current one
+     * is complete, and the estimation is updated with the delay variation
+     * between it and the previous one
+     *
+     * @param [in] txTimestampUs Time at which the packet was sent
+     * @param [in] arrivalUs Time at which the packet was received, in the
+     *                       sender's clock (i.e., send time plus one way
+     *                       delay); a constant clock offset does not matter
+     * @retval True if the estimation has been updated
+     */
+    bool addPacket(uint64_t txTimestampUs, uint64_t arrivalUs);
+
+    /** Add a packet acknowledged, as recorded in the packet history */
+    bool addPacket(const PacketRecord& packet);
+
+    /** @retval The estimation method */
+    Mode getMode() const;
+
+    /**
+     * Get the delay gradient. It is zero until enough groups have been
+     * seen (a full window, in trendline mode)
+     *
+     * @retval Delay change per time unit (dimensionless)
+     */
+    double getGradient() const;
+
+    /** @retval Number of delay variations seen since the last reset, up to 1000 */
+    uint32_t getNumDeltas() const;
+
+    /** @retval Inter-departure time between the last two complete groups, in ms */
+    double getSendDeltaMs() const;
+
+    /**
+     * @retval Arrival time of the last complete group, in ms, relative to
+     *         the arrival of the first packet since the last reset
+     */
+    double getArrivalMs() const;
+
+private:
+    void updateTrendline(double deltaMs, double arrivalMs);
+    void updateKalman(double deltaMs, double sendDeltaMs);
+    /** Recalculate the least-squares sums of the points in the window */
+    void refit();
+
+    /* Configuration */
+    Mode m_mode;
+    uint64_t m_burstTimeUs;
+    size_t m_window;
+
+    /* Packet groups: the current one, and the previous (complete) one */
+    bool m_groupValid;
+    uint64_t m_groupFirstTxUs;   /**< send time of the group's first packet */
+    uint64_t m_groupLastTxUs;    /**< send time of the group's last packet */
+    uint64_t m_groupArrivalUs;   /**< arrival time of the group's last packet */
+    bool m_prevGroupValid;
+    uint64_t m_prevGroupLastTxUs;
+    uint64_t m_prevGroupArrivalUs;
+    bool m_firstArrivalValid;
+    uint64_t m_firstArrivalUs;   /**< origin of the arrival times */
+
+    uint32_t m_numDeltas;
+    double m_sendDeltaMs;
+    double m_arrivalMs;
+    double m_gradient;
+
+    /* Trendline: the points (arrival time, smoothed delay) in the window,
+     * their means and their (co-)deviations from the means */
+    double m_accumulatedDelayMs;
+    double m_smoothedDelayMs;
+    std::deque<std::pair<double, double> > m_points;
+    size_t m_pointsSinceRefit;
+    double m_meanX;
+    double m_meanY;
+    double m_sumXX;
+    double m_sumXY;
+
+    /* Kalman filter */
+    double m_offsetMs;           /**< filtered delay variation between groups (m_hat in rmcat-gcc) */
+    double m_offsetVar;          /**< variance of its estimation error (e in rmcat-gcc) */
+    double m_noiseVar;           /**< variance of the measurement noise (var_v_hat in rmcat-gcc) */
+    double m_avgSendDeltaMs;     /**< smoothed time between groups */
+};
+
+}
+
+#endif /* DELAY_GRADIENT_ESTIMATOR_H */
@@ -25,7 +25,6 @@
  * @author Xiaoqing Zhu
  */
 #include "dummy-controller.h"
-#include <sstream>
 #include <cassert>
 
 namespace rmcat {
@@ -64,11 +63,24 @@ bool DummyController::processFeedback(uint64_t nowUs,
     // First of all, call the superclass
     const bool res = SenderBasedController::processFeedback(nowUs, sequence,
                                                             rxTimestampUs, ecn);
+    periodicUpdate(nowUs);
+    return res;
+}
+
+bool DummyController::processFeedbackBatch(uint64_t nowUs,
+                                           const std::vector<FeedbackItem>& feedbackBatch) {
+    // First of all, call the superclass
+    const bool res = SenderBasedController::processFeedbackBatch(nowUs, feedbackBatch);
+    periodicUpdate(nowUs);
+    return res;
+}
+
+void DummyController::periodicUpdate(uint64_t nowUs) {
     const uint64_t calcIntervalUs = 200 * 1000;
     if (m_lastTimeCalcValid) {
         assert(lessThan(m_lastTimeCalcUs, nowUs + 1));
         if (nowUs - m_lastTimeCalcUs >= calcIntervalUs) {
-            updateMetrics();
+            updateMetrics(nowUs);
             logStats(nowUs);
             m_lastTimeCalcUs = nowUs;
         }
@@ -76,7 +88,6 @@ bool DummyController::processFeedback(uint64_t nowUs,
         m_lastTimeCalcUs = nowUs;
         m_lastTimeCalcValid = true;
     }
-    return res;
 }
 
 float DummyController::getBandwidth(uint64_t nowUs) const {
@@ -84,39 +95,29 @@ float DummyController::getBandwidth(uint64_t nowUs) const {
     return m_initBw;
 }
 
-void DummyController::updateMetrics() {
-    uint64_t qdelayUs;
-    bool qdelayOK = getCurrentQdelay(qdelayUs);
-    if (qdelayOK) m_QdelayUs = qdelayUs;
-
-    float rrate;
-    bool rrateOK = getCurrentRecvRate(rrate);
-    if (rrateOK) m_RecvR = rrate;
-
-    uint32_t nLoss;
-    float plr;
-    bool plrOK = getPktLossInfo(nLoss, plr);
-    if (plrOK) {
-        m_ploss = nLoss;
-        m_plr = plr;
+void DummyController::updateMetrics(uint64_t nowUs) {
+    MetricsSnapshot metrics;
+    computeMetrics(nowUs, metrics);
+
+    if (metrics.qdelayValid) m_QdelayUs = metrics.qdelayUs;
+    if (metrics.rrateValid) m_RecvR = metrics.rrateBps;
+    if (metrics.lossValid) {
+        m_ploss = metrics.nLoss;
+        m_plr = metrics.plr;
     }
 }
 
 void DummyController::logStats(uint64_t nowUs) const {
-
-    std::ostringstream os;
-    os << std::fixed;
-    os.precision(RMCAT_LOG_PRINT_PRECISION);
-
-    os  << " algo:dummy " << m_id
-        << " ts: "     << (nowUs / 1000)
-        << " loglen: " << m_packetHistory.size()
-        << " qdel: "   << (m_QdelayUs / 1000)
-        << " ploss: "  << m_ploss
-        << " plr: "    << m_plr
-        << " rrate: "  << m_RecvR
-        << " srate: "  << m_initBw;
-    logMessage(os.str());
+    // Metrics not calculated by this controller are reported as zero
+    StatsRecord record = StatsRecord{};
+    record.timestampUs = nowUs;
+    record.loglen = m_packetHistory.size();
+    record.qdelayUs = m_QdelayUs;
+    record.ploss = m_ploss;
+    record.plr = m_plr;
+    record.rrateBps = m_RecvR;
+    record.srateBps = m_initBw;
+    reportStats("dummy", record);
 }
 
 }
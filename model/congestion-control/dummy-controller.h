@@ -66,6 +66,14 @@ public:
                                  uint16_t sequence,
                                  uint64_t rxTimestampUs,
                                  uint8_t ecn=0);
+
+    /**
+     * Simplistic implementation of aggregated feedback processing. Like
+     * #processFeedback , it prints calculated metrics at regular intervals
+     */
+    virtual bool processFeedbackBatch(uint64_t nowUs,
+                                      const std::vector<FeedbackItem>& feedbackBatch);
+
     /**
      * Simplistic implementation of bandwidth getter. It returns a hard-coded
      * bandwidth value in bits per second
@@ -73,7 +81,8 @@ public:
     virtual float getBandwidth(uint64_t nowUs) const;
 
 private:
-    void updateMetrics();
+    void periodicUpdate(uint64_t nowUs);
+    void updateMetrics(uint64_t nowUs);
     void logStats(uint64_t nowUs) const;
 
     uint64_t m_lastTimeCalcUs;
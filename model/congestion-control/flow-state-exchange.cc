@@ -0,0 +1,191 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Flow State Exchange (coupled congestion control) implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "flow-state-exchange.h"
+#include "windowed-filter.h"
+#include <algorithm>
+#include <cassert>
+
+namespace rmcat {
+
+const uint64_t FlowStateExchange::DEFAULT_FLOW_TIMEOUT_US;
+
+FlowStateExchange::FlowStateExchange() :
+    m_flows{},
+    m_aggregateBw{0.f},
+    m_flowTimeoutUs{DEFAULT_FLOW_TIMEOUT_US} {}
+
+FlowStateExchange::~FlowStateExchange() {}
+
+size_t FlowStateExchange::registerFlow(SenderBasedController& controller,
+                                       float priority,
+                                       float desiredBw) {
+    assert(priority > 0.f);
+    const Flow flow{&controller, priority, desiredBw, 0.f, 0, false};
+    for (size_t id = 0; id < m_flows.size(); ++id) {
+        if (m_flows[id].controller == nullptr) {
+            m_flows[id] = flow;
+            return id;
+        }
+    }
+    m_flows.push_back(flow);
+    return m_flows.size() - 1;
+}
+
+void FlowStateExchange::unregisterFlow(size_t id) {
+    leave(id);
+    m_flows[id].controller = nullptr;
+}
+
+void FlowStateExchange::setPriority(size_t id, float priority) {
+    assert(id < m_flows.size() && m_flows[id].controller != nullptr);
+    assert(priority > 0.f);
+    m_flows[id].priority = priority;
+}
+
+void FlowStateExchange::setDesiredBw(size_t id, float desiredBw) {
+    assert(id < m_flows.size() && m_flows[id].controller != nullptr);
+    m_flows[id].desiredBw = desiredBw;
+}
+
+void FlowStateExchange::setFlowTimeout(uint64_t timeoutUs) {
+    m_flowTimeoutUs = timeoutUs;
+}
+
+void FlowStateExchange::update(size_t id, uint64_t nowUs) {
+    assert(id < m_flows.size() && m_flows[id].controller != nullptr);
+    expireFlows(nowUs);
+
+    Flow& flow = m_flows[id];
+    const float ccBw = flow.controller->getBandwidth(nowUs);
+    if (flow.active) {
+        // The controller's rate was set to its share at the last update:
+        // only the change since then is applied to the aggregate
+        m_aggregateBw += ccBw - flow.allocBw;
+    } else {
+        m_aggregateBw += ccBw;
+        flow.active = true;
+    }
+    flow.allocBw = ccBw;
+    flow.lastUpdateUs = nowUs;
+
+    float sumDesiredBw = 0.f;
+    for (const auto& f : m_flows) {
+        if (f.active) {
+            sumDesiredBw += f.desiredBw;
+        }
+    }
+    m_aggregateBw = std::max(0.f, std::min(m_aggregateBw, sumDesiredBw));
+    allocate();
+}
+
+void FlowStateExchange::leave(size_t id) {
+    assert(id < m_flows.size());
+    Flow& flow = m_flows[id];
+    if (!flow.active) {
+        return;
+    }
+    flow.active = false;
+    m_aggregateBw = std::max(0.f, m_aggregateBw - flow.allocBw);
+    allocate();
+}
+
+bool FlowStateExchange::isActive(size_t id) const {
+    assert(id < m_flows.size());
+    return m_flows[id].active;
+}
+
+float FlowStateExchange::getAllocatedBw(size_t id) const {
+    assert(id < m_flows.size());
+    return m_flows[id].allocBw;
+}
+
+float FlowStateExchange::getAggregateBw() const {
+    return m_aggregateBw;
+}
+
+size_t FlowStateExchange::getActiveFlows() const {
+    return size_t(std::count_if(m_flows.begin(), m_flows.end(),
+                                [](const Flow& f) { return f.active; }));
+}
+
+void FlowStateExchange::expireFlows(uint64_t nowUs) {
+    for (size_t id = 0; id < m_flows.size(); ++id) {
+        if (m_flows[id].active &&
+            WrapLess<uint64_t>{}(m_flows[id].lastUpdateUs + m_flowTimeoutUs, nowUs)) {
+            leave(id);
+        }
+    }
+}
+
+void FlowStateExchange::allocate() {
+    std::vector<size_t> uncapped{};
+    for (size_t id = 0; id < m_flows.size(); ++id) {
+        if (m_flows[id].active) {
+            uncapped.push_back(id);
+        }
+    }
+
+    // Flows whose share exceeds their desired rate get the latter; the
+    // rest is shared again among the other flows, until no share exceeds
+    float remainingBw = m_aggregateBw;
+    bool capped = true;
+    while (capped && !uncapped.empty()) {
+        float sumPriority = 0.f;
+        for (const auto id : uncapped) {
+            sumPriority += m_flows[id].priority;
+        }
+        capped = false;
+        std::vector<size_t> next{};
+        float cappedBw = 0.f;
+        for (const auto id : uncapped) {
+            Flow& flow = m_flows[id];
+            if (remainingBw * flow.priority / sumPriority >= flow.desiredBw) {
+                flow.allocBw = flow.desiredBw;
+                cappedBw += flow.desiredBw;
+                capped = true;
+            } else {
+                next.push_back(id);
+            }
+        }
+        if (!capped) {
+            for (const auto id : uncapped) {
+                m_flows[id].allocBw = remainingBw * m_flows[id].priority / sumPriority;
+            }
+        }
+        remainingBw = std::max(0.f, remainingBw - cappedBw);
+        uncapped.swap(next);
+    }
+
+    for (const auto& flow : m_flows) {
+        if (flow.active) {
+            flow.controller->setCurrentBw(flow.allocBw);
+        }
+    }
+}
+
+}
@@ -0,0 +1,156 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Flow State Exchange (coupled congestion control) interface for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef FLOW_STATE_EXCHANGE_H
+#define FLOW_STATE_EXCHANGE_H
+
+#include "sender-based-controller.h"
+#include <memory>
+#include <vector>
+
+namespace rmcat {
+
+/**
+ * Flow State Exchange (FSE) of a group of flows known to share the same
+ * bottleneck, e.g., the media streams of a session sent from the same
+ * node. It implements the active FSE algorithm of rfc8699: the flows'
+ * congestion controllers run as usual, but the group keeps the sum of
+ * their rates as the aggregate rate, and shares it among the flows in
+ * proportion to their priorities. Thus, the flows converge together,
+ * rather than each on its own.
+ *
+ *  - A flow joins the group when it starts sending: its rate is added to
+ *    the aggregate, which is then shared again among all flows
+ *  - Every time a flow updates the group (upon feedback, see #update ),
+ *    the change of rate its controller made since the last update is
+ *    applied to the aggregate, which is then shared again. The share of
+ *    each flow is set as its controller's current rate (see
+ *    SenderBasedController::setCurrentBw ), so that the next change
+ *    builds upon it
+ *  - A flow leaves the group when it stops, is reset, or has not updated
+ *    the group for a while (e.g., it is paused, see #setFlowTimeout ). Its
+ *    share is removed from the aggregate
+ *
+ * A flow never gets more than its desired rate (its maximum bandwidth);
+ * what it leaves is shared among the other flows.
+ *
+ * Flows are usually added to the group via #CoupledController . The group
+ * is not thread-safe.
+ */
+class FlowStateExchange {
+public:
+    static const uint64_t DEFAULT_FLOW_TIMEOUT_US = 1000 * 1000; /**< default timeout of a flow: 1s */
+
+    /** Class constructor */
+    FlowStateExchange();
+
+    /** Class destructor */
+    ~FlowStateExchange();
+
+    /**
+     * Register a flow to the group. It only joins the group (i.e.,
+     * contributes to the aggregate rate) upon its first #update
+     *
+     * @param [in,out] controller The flow's congestion controller. It must
+     *                            stay alive until the flow is unregistered
+     * @param [in] priority Weight of the flow's share of the aggregate
+     *                      rate, must be positive
+     * @param [in] desiredBw Maximum rate of the flow, in bps
+     * @retval Id of the flow in the group
+     */
+    size_t registerFlow(SenderBasedController& controller, float priority, float desiredBw);
+
+    /** Unregister a flow: it leaves the group, and its id can be reused */
+    void unregisterFlow(size_t id);
+
+    /** Set the priority of a flow, which must be positive */
+    void setPriority(size_t id, float priority);
+
+    /** Set the desired (maximum) rate of a flow, in bps */
+    void setDesiredBw(size_t id, float desiredBw);
+
+    /**
+     * Set the time after which a flow that does not update the group
+     * leaves it
+     *
+     * @param [in] timeoutUs Timeout, in microseconds
+     */
+    void setFlowTimeout(uint64_t timeoutUs);
+
+    /**
+     * Update the group with the current rate of a flow's controller, and
+     * set the flows' controllers to their new shares. The flow joins the
+     * group if it had not yet, or had left it
+     *
+     * @param [in] id Id of the flow
+     * @param [in] nowUs The time (in microseconds) at which this function is called
+     */
+    void update(size_t id, uint64_t nowUs);
+
+    /** Make a flow leave the group, e.g., when it stops */
+    void leave(size_t id);
+
+    /** @retval Whether a flow has joined the group and not left it since */
+    bool isActive(size_t id) const;
+
+    /** @retval The share of the aggregate rate last allocated to a flow, in bps */
+    float getAllocatedBw(size_t id) const;
+
+    /** @retval The aggregate rate of the flows in the group, in bps */
+    float getAggregateBw() const;
+
+    /** @retval The number of flows in the group */
+    size_t getActiveFlows() const;
+
+private:
+    struct Flow {
+        SenderBasedController* controller; /**< null if the id is not in use */
+        float priority;
+        float desiredBw;
+        float allocBw;         /**< share last set to the flow's controller */
+        uint64_t lastUpdateUs; /**< time of the flow's last update */
+        bool active;
+    };
+
+    /** Make the flows that have not updated the group for too long leave it */
+    void expireFlows(uint64_t nowUs);
+
+    /**
+     * Share the aggregate rate among the flows in proportion to their
+     * priorities; the share a flow would get beyond its desired rate is
+     * shared again among the others
+     */
+    void allocate();
+
+    std::vector<Flow> m_flows;
+    float m_aggregateBw;       /**< sum of the flows' rates (S_CR in rfc8699) */
+    uint64_t m_flowTimeoutUs;
+};
+
+}
+
+#endif /* FLOW_STATE_EXCHANGE_H */
@@ -0,0 +1,442 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * GCC controller implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "gcc-controller.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace rmcat {
+
+/* Delay-based controller: trendline estimator (see #DelayGradientEstimator ) */
+const double GCC_THRESHOLD_GAIN = 4.;         /**< gain of the trend compared to the threshold */
+const uint32_t GCC_MAX_DELTAS = 60;           /**< the trend is scaled by the number of deltas, up to this */
+
+/* Over-use detector and adaptive threshold (in ms) */
+const double GCC_OVERUSE_TIME_MS = 10.;       /**< over-use must last this long to be signaled */
+const double GCC_K_UP = 0.0087;               /**< gain of the threshold when the trend exceeds it */
+const double GCC_K_DOWN = 0.039;              /**< gain of the threshold when the trend is below it */
+const double GCC_THRESHOLD_INIT = 12.5;
+const double GCC_THRESHOLD_MIN = 6.;
+const double GCC_THRESHOLD_MAX = 600.;
+const double GCC_MAX_ADAPT_OFFSET_MS = 15.;   /**< the threshold ignores trends further away than this */
+const double GCC_MAX_TIME_DELTA_MS = 100.;    /**< maximum time step of the threshold update */
+
+/* AIMD rate controller */
+const uint64_t GCC_UPDATE_INTERVAL_US = 50 * 1000; /**< minimum interval between rate updates */
+const float GCC_BETA = 0.85f;                 /**< decrease factor, applied to the receive rate */
+const double GCC_ETA = 1.08;                  /**< multiplicative increase, per second */
+const float GCC_MIN_MULT_INCREASE_BPS = 1000.f;
+const uint64_t GCC_RESPONSE_TIME_US = 100 * 1000; /**< added to the RTT in the additive increase */
+const float GCC_PACKET_SIZE_BITS = 1200.f * 8.f;  /**< packet size assumed in the additive increase */
+const float GCC_MIN_ADD_INCREASE_BPS = 4000.f;    /**< minimum additive increase, per second */
+const float GCC_MAX_RECV_FACTOR = 1.5f;       /**< the rate may not grow further above the receive rate */
+const float GCC_MAX_RECV_OFFSET_BPS = 10000.f;
+const float GCC_MAX_RATE_ALPHA = 0.05f;       /**< smoothing of the link capacity estimation */
+
+/* Loss-based controller */
+const float GCC_LOSS_LOW = 0.02f;             /**< below this loss ratio, the rate increases */
+const float GCC_LOSS_HIGH = 0.1f;             /**< above this loss ratio, the rate decreases */
+const float GCC_LOSS_INCREASE = 1.05f;        /**< multiplicative increase, per rate update */
+const uint64_t GCC_LOSS_DECREASE_INTERVAL_US = 300 * 1000; /**< added to the RTT between decreases */
+
+GccController::GccController() :
+    SenderBasedController{},
+    m_trendline{DelayGradientEstimator::MODE_TRENDLINE},
+    m_prevTrend{0.},
+    m_modifiedTrend{0.},
+    m_threshold{GCC_THRESHOLD_INIT},
+    m_lastThresholdUpdateValid{false},
+    m_lastThresholdUpdateMs{0.},
+    m_timeOverUsingMs{-1.},
+    m_overuseCounter{0},
+    m_usage{BW_NORMAL},
+    m_overuseSeen{false},
+    m_lastTimeCalcUs{0},
+    m_lastTimeCalcValid{false},
+    m_fbCountAtCalc{0},
+    m_rateState{RATE_HOLD},
+    m_delayBasedBw{m_initBw},
+    m_currBw{m_initBw},
+    m_maxRateValid{false},
+    m_avgMaxRateKbps{0.f},
+    m_varMaxRate{0.4f},
+    m_lastLossDecreaseUs{0},
+    m_lastLossDecreaseValid{false} {}
+
+GccController::~GccController() {}
+
+void GccController::setCurrentBw(float newBw) {
+    m_currBw = newBw;
+    m_delayBasedBw = newBw;
+}
+
+void GccController::reset() {
+    resetTrendline();
+    m_threshold = GCC_THRESHOLD_INIT;
+    m_lastThresholdUpdateValid = false;
+    m_lastThresholdUpdateMs = 0.;
+    m_lastTimeCalcUs = 0;
+    m_lastTimeCalcValid = false;
+    m_fbCountAtCalc = 0;
+    m_rateState = RATE_HOLD;
+    m_delayBasedBw = m_initBw;
+    m_currBw = m_initBw;
+    m_maxRateValid = false;
+    m_avgMaxRateKbps = 0.f;
+    m_varMaxRate = 0.4f;
+    m_lastLossDecreaseUs = 0;
+    m_lastLossDecreaseValid = false;
+    SenderBasedController::reset();
+}
+
+void GccController::resetTrendline() {
+    m_trendline.reset();
+    m_prevTrend = 0.;
+    m_modifiedTrend = 0.;
+    m_timeOverUsingMs = -1.;
+    m_overuseCounter = 0;
+    m_usage = BW_NORMAL;
+    m_overuseSeen = false;
+}
+
+bool GccController::processSendPacket(uint64_t txTimestampUs,
+                                      uint16_t sequence,
+                                      uint32_t size) { // in Bytes
+    /* First of all, call the superclass */
+    if (!SenderBasedController::processSendPacket(txTimestampUs, sequence, size)) {
+        return false;
+    }
+
+    /* As in NADA, the first rate update happens upon the first feedback */
+    if (!m_lastTimeCalcValid) {
+        m_lastTimeCalcUs = txTimestampUs;
+        m_lastTimeCalcValid = true;
+    }
+    return true;
+}
+
+bool GccController::processFeedback(uint64_t nowUs,
+                                    uint16_t sequence,
+                                    uint64_t rxTimestampUs,
+                                    uint8_t ecn) {
+    /* First of all, call the superclass */
+    if (!SenderBasedController::processFeedback(nowUs,
+                                                sequence,
+                                                rxTimestampUs,
+                                                ecn)) {
+        return false;
+    }
+    processNewPackets();
+    maybeUpdateRate(nowUs);
+    return true;
+}
+
+bool GccController::processFeedbackBatch(uint64_t nowUs,
+                                         const std::vector<FeedbackItem>& feedbackBatch) {
+    /* First of all, call the superclass */
+    if (!SenderBasedController::processFeedbackBatch(nowUs, feedbackBatch)) {
+        return false;
+    }
+    processNewPackets();
+    maybeUpdateRate(nowUs);
+    return true;
+}
+
+float GccController::getBandwidth(uint64_t nowUs) const {
+    return m_currBw;
+}
+
+void GccController::saveStateFields(std::ostream& os, uint64_t nowUs) const {
+    SenderBasedController::saveStateFields(os, nowUs);
+    os << "gcc " << m_lastTimeCalcValid << ' ' << (nowUs - m_lastTimeCalcUs)
+       << ' ' << int(m_rateState) << ' ' << m_delayBasedBw << ' ' << m_currBw
+       << ' ' << m_maxRateValid << ' ' << m_avgMaxRateKbps << ' ' << m_varMaxRate
+       << ' ' << m_lastLossDecreaseValid << ' ' << (nowUs - m_lastLossDecreaseUs)
+       << ' ' << m_threshold << '\n';
+}
+
+bool GccController::loadStateFields(std::istream& is, uint64_t nowUs) {
+    if (!SenderBasedController::loadStateFields(is, nowUs)) {
+        return false;
+    }
+    uint64_t lastCalcAgeUs = 0;
+    uint64_t lastLossDecreaseAgeUs = 0;
+    int rateState = 0;
+    if (!readStateTag(is, "gcc") ||
+        !(is >> m_lastTimeCalcValid >> lastCalcAgeUs
+             >> rateState >> m_delayBasedBw >> m_currBw
+             >> m_maxRateValid >> m_avgMaxRateKbps >> m_varMaxRate
+             >> m_lastLossDecreaseValid >> lastLossDecreaseAgeUs
+             >> m_threshold) ||
+        rateState < RATE_HOLD || rateState > RATE_DECREASE) {
+        return false;
+    }
+    m_rateState = RateState(rateState);
+    m_lastTimeCalcUs = nowUs - lastCalcAgeUs;
+    m_lastLossDecreaseUs = nowUs - lastLossDecreaseAgeUs;
+    m_lastThresholdUpdateValid = false;
+    /* The packets in the snapshot's history are not fed to the trendline
+     * estimator again: it restarts with the next feedback */
+    resetTrendline();
+    m_fbCountAtCalc = getFeedbackCount();
+    return true;
+}
+
+void GccController::processNewPackets() {
+    for (size_t i = firstNewPacket(); i < m_packetHistory.size(); ++i) {
+        if (m_trendline.addPacket(m_packetHistory.at(i))) {
+            detect(m_trendline.getGradient(), m_trendline.getSendDeltaMs(),
+                   m_trendline.getArrivalMs());
+        }
+    }
+    markPacketsProcessed();
+}
+
+/**
+ * Over-use detector: the (scaled) trend is compared to the adaptive
+ * threshold. Over-use is only signaled if it lasts and the trend keeps
+ * growing
+ */
+void GccController::detect(double trend, double sendDeltaMs, double nowMs) {
+    const uint32_t numDeltas = m_trendline.getNumDeltas();
+    if (numDeltas < 2) {
+        m_usage = BW_NORMAL;
+        return;
+    }
+    m_modifiedTrend = std::min(numDeltas, GCC_MAX_DELTAS) * trend * GCC_THRESHOLD_GAIN;
+
+    if (m_modifiedTrend > m_threshold) {
+        if (m_timeOverUsingMs < 0.) {
+            /* Assume over-use started halfway between this sample and the previous one */
+            m_timeOverUsingMs = sendDeltaMs / 2.;
+        } else {
+            m_timeOverUsingMs += sendDeltaMs;
+        }
+        ++m_overuseCounter;
+        if (m_timeOverUsingMs > GCC_OVERUSE_TIME_MS && m_overuseCounter > 1 &&
+            trend >= m_prevTrend) {
+            m_timeOverUsingMs = 0.;
+            m_overuseCounter = 0;
+            m_usage = BW_OVERUSING;
+            m_overuseSeen = true;
+        }
+    } else if (m_modifiedTrend < -m_threshold) {
+        m_timeOverUsingMs = -1.;
+        m_overuseCounter = 0;
+        m_usage = BW_UNDERUSING;
+    } else {
+        m_timeOverUsingMs = -1.;
+        m_overuseCounter = 0;
+        m_usage = BW_NORMAL;
+    }
+    m_prevTrend = trend;
+    updateThreshold(m_modifiedTrend, nowMs);
+}
+
+/**
+ * Adaptive threshold (see Section 5.4 of the rmcat-gcc draft): it follows
+ * the magnitude of the trend, faster downwards than upwards, so that
+ * GCC does not starve when competing with loss-based flows
+ */
+void GccController::updateThreshold(double modifiedTrend, double nowMs) {
+    if (!m_lastThresholdUpdateValid) {
+        m_lastThresholdUpdateMs = nowMs;
+        m_lastThresholdUpdateValid = true;
+    }
+    const double absTrend = std::fabs(modifiedTrend);
+    if (absTrend > m_threshold + GCC_MAX_ADAPT_OFFSET_MS) {
+        /* Avoid adapting the threshold to sudden spikes */
+        m_lastThresholdUpdateMs = nowMs;
+        return;
+    }
+    const double k = absTrend < m_threshold ? GCC_K_DOWN : GCC_K_UP;
+    const double dtMs = std::min(nowMs - m_lastThresholdUpdateMs, GCC_MAX_TIME_DELTA_MS);
+    m_threshold += k * (absTrend - m_threshold) * dtMs;
+    m_threshold = std::max(m_threshold, GCC_THRESHOLD_MIN);
+    m_threshold = std::min(m_threshold, GCC_THRESHOLD_MAX);
+    m_lastThresholdUpdateMs = nowMs;
+}
+
+void GccController::maybeUpdateRate(uint64_t nowUs) {
+    /* First time receiving a feedback message */
+    if (!m_lastTimeCalcValid) {
+        m_lastTimeCalcUs = nowUs;
+        m_lastTimeCalcValid = true;
+        return;
+    }
+
+    /* Nothing new to react to: skip the update altogether */
+    if (getFeedbackCount() == m_fbCountAtCalc) {
+        return;
+    }
+
+    assert(lessThan(m_lastTimeCalcUs, nowUs + 1));
+    /* calculate time since last update; over-use is reacted upon at once */
+    const uint64_t deltaUs = nowUs - m_lastTimeCalcUs; // subtraction will wrap correctly
+    if (deltaUs < GCC_UPDATE_INTERVAL_US && !m_overuseSeen) {
+        return;
+    }
+    updateLatestMetrics(nowUs);
+    updateDelayBasedBw(deltaUs);
+    updateLossBasedBw(nowUs);
+    logStats(nowUs, deltaUs);
+
+    m_overuseSeen = false;
+    m_lastTimeCalcUs = nowUs;
+    m_fbCountAtCalc = getFeedbackCount();
+}
+
+/**
+ * AIMD rate control (see Section 5.5 of the rmcat-gcc draft). The
+ * detector's signal drives a state machine: over-use -> decrease,
+ * under-use -> hold, normal -> increase (after a hold)
+ */
+void GccController::updateDelayBasedBw(uint64_t deltaUs) {
+    const MetricsSnapshot& metrics = m_latestMetrics;
+    const BwUsage usage = m_overuseSeen ? BW_OVERUSING : m_usage;
+    switch (usage) {
+    case BW_NORMAL:
+        if (m_rateState == RATE_HOLD) {
+            m_rateState = RATE_INCREASE;
+        }
+        break;
+    case BW_OVERUSING:
+        if (m_rateState != RATE_DECREASE) {
+            m_rateState = RATE_DECREASE;
+        }
+        break;
+    case BW_UNDERUSING:
+        m_rateState = RATE_HOLD;
+        break;
+    }
+
+    float newBw = m_delayBasedBw;
+    switch (m_rateState) {
+    case RATE_HOLD:
+        break;
+    case RATE_INCREASE: {
+        if (metrics.rrateValid && m_maxRateValid) {
+            /* The link capacity has changed: forget its estimation */
+            const float stdMaxRateKbps = std::sqrt(m_varMaxRate * m_avgMaxRateKbps);
+            if (metrics.rrateBps / 1000.f > m_avgMaxRateKbps + 3.f * stdMaxRateKbps) {
+                m_maxRateValid = false;
+            }
+        }
+        const float deltaS = std::min(float(deltaUs) / 1.e6f, 1.f);
+        if (m_maxRateValid) {
+            /* Near the link capacity: additive increase, about one packet per response time */
+            const float responseTimeS = float(metrics.rttUs + GCC_RESPONSE_TIME_US) / 1.e6f;
+            const float increaseBps = std::max(GCC_MIN_ADD_INCREASE_BPS,
+                                               GCC_PACKET_SIZE_BITS / responseTimeS);
+            newBw += increaseBps * deltaS;
+        } else {
+            /* Far from it: multiplicative increase */
+            const float alpha = float(std::pow(GCC_ETA, double(deltaS)));
+            newBw += std::max(m_delayBasedBw * (alpha - 1.f), GCC_MIN_MULT_INCREASE_BPS);
+        }
+        if (metrics.rrateValid) {
+            /* Do not grow too far above what is actually received */
+            const float maxBw = GCC_MAX_RECV_FACTOR * metrics.rrateBps + GCC_MAX_RECV_OFFSET_BPS;
+            if (newBw > maxBw) {
+                newBw = std::max(m_delayBasedBw, maxBw);
+            }
+        }
+        break;
+    }
+    case RATE_DECREASE:
+        if (metrics.rrateValid) {
+            newBw = std::min(GCC_BETA * metrics.rrateBps, m_delayBasedBw);
+            updateMaxRate(metrics.rrateBps);
+        } else {
+            newBw = GCC_BETA * m_delayBasedBw;
+        }
+        m_rateState = RATE_HOLD;
+        break;
+    }
+
+    m_delayBasedBw = std::min(newBw, m_maxBw);
+    m_delayBasedBw = std::max(m_delayBasedBw, m_minBw);
+}
+
+/**
+ * Estimation of the link capacity, as the average of the receive rates
+ * upon over-use, along with its variance (normalized by the average)
+ */
+void GccController::updateMaxRate(float ackedBps) {
+    const float ackedKbps = ackedBps / 1000.f;
+    if (!m_maxRateValid) {
+        m_avgMaxRateKbps = ackedKbps;
+        m_maxRateValid = true;
+    } else {
+        m_avgMaxRateKbps = (1.f - GCC_MAX_RATE_ALPHA) * m_avgMaxRateKbps +
+                           GCC_MAX_RATE_ALPHA * ackedKbps;
+    }
+    const float norm = std::max(m_avgMaxRateKbps, 1.f);
+    const float error = m_avgMaxRateKbps - ackedKbps;
+    m_varMaxRate = (1.f - GCC_MAX_RATE_ALPHA) * m_varMaxRate +
+                   GCC_MAX_RATE_ALPHA * error * error / norm;
+    m_varMaxRate = std::max(m_varMaxRate, 0.4f);
+    m_varMaxRate = std::min(m_varMaxRate, 2.5f);
+}
+
+/**
+ * Loss-based rate control (see Section 6 of the rmcat-gcc draft), applied
+ * to the current rate, then capped by the delay-based rate. As in the
+ * draft, the rate increases by 5% per update (i.e., per feedback report
+ * reacted upon) while losses are low
+ */
+void GccController::updateLossBasedBw(uint64_t nowUs) {
+    const MetricsSnapshot& metrics = m_latestMetrics;
+    float newBw = m_currBw;
+    if (metrics.plr < GCC_LOSS_LOW) {
+        newBw = newBw * GCC_LOSS_INCREASE;
+    } else if (metrics.plr > GCC_LOSS_HIGH) {
+        /* At most one decrease per RTT (plus some margin) */
+        if (!m_lastLossDecreaseValid ||
+            nowUs - m_lastLossDecreaseUs >= GCC_LOSS_DECREASE_INTERVAL_US + metrics.rttUs) {
+            newBw = newBw * (1.f - .5f * metrics.plr);
+            m_lastLossDecreaseUs = nowUs;
+            m_lastLossDecreaseValid = true;
+        }
+    }
+    m_currBw = std::min(newBw, m_delayBasedBw);
+    m_currBw = std::min(m_currBw, m_maxBw);
+    m_currBw = std::max(m_currBw, m_minBw);
+}
+
+void GccController::logStats(uint64_t nowUs, uint64_t deltaUs) const {
+    /* xcurr carries GCC's congestion signal: the trend, as compared
+     * to the adaptive threshold (in ms) */
+    StatsRecord record;
+    fillStatsRecord(nowUs, deltaUs, record);
+    record.xcurr = float(m_modifiedTrend);
+    record.srateBps = m_currBw;
+    reportStats("gcc", record);
+}
+
+}
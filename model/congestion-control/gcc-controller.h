@@ -0,0 +1,183 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * GCC controller interface for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef GCC_CONTROLLER_H
+#define GCC_CONTROLLER_H
+
+#include "sender-based-controller.h"
+#include "delay-gradient-estimator.h"
+
+namespace rmcat {
+
+/**
+ * Sender-side implementation of Google Congestion Control (GCC), as
+ * specified in the rmcat-gcc draft, with the delay-gradient trendline
+ * estimator of its WebRTC implementation (which has replaced the draft's
+ * Kalman filter). It is provided as a reference to compare NADA against.
+ *
+ * The delay-based controller groups the packets acknowledged into bursts
+ * sent within 5 ms, and measures the one way delay variation between
+ * consecutive groups. The trendline estimator fits a line through the
+ * (smoothed) accumulated delay variation; its slope, compared to an
+ * adaptive threshold, tells whether the path is over-used, under-used or
+ * neither. An AIMD rate controller reacts to these signals: it increases
+ * the rate multiplicatively (or additively, near the link capacity seen
+ * at the last over-use), and decreases it to a fraction of the receive
+ * rate upon over-use.
+ *
+ * The loss-based controller increases the rate while the loss ratio
+ * is below 2%, and decreases it in proportion to the loss ratio above
+ * 10%. The rate returned is the minimum of both controllers' rates.
+ */
+class GccController: public SenderBasedController {
+public:
+    /** Class constructor */
+    GccController();
+
+    /** Class destructor */
+    virtual ~GccController();
+
+    /**
+     * Set the current bandwidth estimation. This can be useful in test environments
+     * to temporarily disrupt the current bandwidth estimation
+     *
+     * @param [in] newBw Bandwidth estimation to overwrite the current estimation
+     */
+    virtual void setCurrentBw(float newBw);
+
+    /**
+     * Reset the internal state of the congestion controller
+     */
+    virtual void reset();
+
+    /**
+     * GCC's implementation of the #processSendPacket API
+     */
+    virtual bool processSendPacket(uint64_t txTimestampUs,
+                                   uint16_t sequence,
+                                   uint32_t size); // in Bytes
+
+    /**
+     * GCC's implementation of the #processFeedback API: the packet
+     * acknowledged is fed to the delay-based controller, and the rate
+     * is updated at regular intervals
+     */
+    virtual bool processFeedback(uint64_t nowUs,
+                                 uint16_t sequence,
+                                 uint64_t rxTimestampUs,
+                                 uint8_t ecn=0);
+
+    /**
+     * GCC's implementation of the #processFeedbackBatch API: all
+     * packets acknowledged are fed to the delay-based controller,
+     * then the rate is updated
+     */
+    virtual bool processFeedbackBatch(uint64_t nowUs,
+                                      const std::vector<FeedbackItem>& feedbackBatch);
+
+    /**
+     * GCC's implementation of the #getBandwidth API: minimum of the
+     * delay-based and loss-based rates
+     */
+    virtual float getBandwidth(uint64_t nowUs) const;
+
+protected:
+    /**
+     * Append GCC's state to a snapshot: the rate controllers and the
+     * adaptive threshold. The trendline estimator restarts from scratch
+     * when the snapshot is loaded
+     */
+    virtual void saveStateFields(std::ostream& os, uint64_t nowUs) const;
+    virtual bool loadStateFields(std::istream& is, uint64_t nowUs);
+
+private:
+    /** Output of the over-use detector */
+    enum BwUsage {
+        BW_NORMAL,
+        BW_UNDERUSING,
+        BW_OVERUSING,
+    };
+
+    /** State of the AIMD rate controller */
+    enum RateState {
+        RATE_HOLD,
+        RATE_INCREASE,
+        RATE_DECREASE,
+    };
+
+    /**
+     * Feed the delay-based controller with the packets acknowledged since
+     * the last call (see #firstNewPacket )
+     */
+    void processNewPackets();
+    /** Over-use detector, run whenever the trend is updated */
+    void detect(double trend, double sendDeltaMs, double nowMs);
+    void updateThreshold(double modifiedTrend, double nowMs);
+
+    /** Update the rate, if due, upon reception of feedback */
+    void maybeUpdateRate(uint64_t nowUs);
+    /** AIMD rate control of the delay-based controller */
+    void updateDelayBasedBw(uint64_t deltaUs);
+    /** Loss-based rate control, applied to the current rate */
+    void updateLossBasedBw(uint64_t nowUs);
+    /** Update the estimation of the link capacity upon over-use */
+    void updateMaxRate(float ackedBps);
+    void logStats(uint64_t nowUs, uint64_t deltaUs) const;
+    /** Restart the trendline estimator (i.e., the packet groups, the fit) */
+    void resetTrendline();
+
+    /* Trendline estimator (packet groups and fit) */
+    DelayGradientEstimator m_trendline;
+    double m_prevTrend;
+    double m_modifiedTrend;      /**< trend scaled as compared to the threshold (in ms) */
+
+    /* Over-use detector, with adaptive threshold */
+    double m_threshold;          /**< in ms */
+    bool m_lastThresholdUpdateValid;
+    double m_lastThresholdUpdateMs;
+    double m_timeOverUsingMs;    /**< negative if not over-using */
+    uint32_t m_overuseCounter;
+    BwUsage m_usage;
+    bool m_overuseSeen;          /**< over-use detected since the last rate update */
+
+    /* Rate controllers */
+    uint64_t m_lastTimeCalcUs;
+    bool m_lastTimeCalcValid;
+    uint64_t m_fbCountAtCalc;    /**< feedback count (see #getFeedbackCount ) at the last rate update */
+    RateState m_rateState;
+    float m_delayBasedBw;        /**< rate of the delay-based controller */
+    float m_currBw;              /**< rate returned: minimum of both controllers' rates */
+    bool m_maxRateValid;         /**< whether the link capacity estimation is valid */
+    float m_avgMaxRateKbps;      /**< link capacity estimated upon over-use */
+    float m_varMaxRate;          /**< normalized variance of the estimation */
+    uint64_t m_lastLossDecreaseUs;
+    bool m_lastLossDecreaseValid;
+};
+
+}
+
+#endif /* GCC_CONTROLLER_H */
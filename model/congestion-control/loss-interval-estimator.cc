@@ -0,0 +1,131 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * TFRC-style inter-loss interval estimator implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "loss-interval-estimator.h"
+#include <algorithm>
+#include <limits>
+#include <cassert>
+
+namespace rmcat {
+
+/*
+ * TFRC weights 1, 1, 1, 1, .8, .6, .4, .2, scaled by 5 so that the
+ * weighted sums are exact integers
+ */
+constexpr uint32_t TFRC_WEIGHTS[LossIntervalEstimator::N_INTERVALS - 1] = { 5, 5, 5, 5, 4, 3, 2, 1 };
+
+const size_t LossIntervalEstimator::N_INTERVALS;
+
+LossIntervalEstimator::LossIntervalEstimator()
+: m_intervals{},
+  m_head{0},
+  m_count{1},
+  m_expectedSeq{0},
+  m_initialized{false},
+  m_closedSum0{0},
+  m_closedSum1{0},
+  m_weightSum{0} {}
+
+void LossIntervalEstimator::reset(uint64_t expectedSeq) {
+    *this = LossIntervalEstimator{};
+    m_expectedSeq = expectedSeq;
+}
+
+void LossIntervalEstimator::addReceived(uint64_t firstSeq, uint32_t length) {
+    assert(length > 0);
+    if (firstSeq == m_expectedSeq) {
+        assert(m_intervals[m_head] <= std::numeric_limits<uint32_t>::max() - length);
+        m_intervals[m_head] += length;
+        m_expectedSeq += length;
+        return;
+    }
+    assert(m_expectedSeq < firstSeq);
+    // Start new interval; the oldest one is overwritten once the array is full
+    m_head = (m_head == 0) ? N_INTERVALS - 1 : m_head - 1;
+    m_intervals[m_head] = length;
+    m_count = std::min(m_count + 1, N_INTERVALS);
+    updateClosedSums();
+
+    m_expectedSeq = firstSeq + length;
+    m_initialized = true;
+}
+
+/*
+ * Only called upon a loss event, on at most eight closed intervals
+ */
+void LossIntervalEstimator::updateClosedSums() {
+    m_closedSum0 = 0;
+    m_closedSum1 = 0;
+    m_weightSum = TFRC_WEIGHTS[0];
+    for (size_t i = 1; i < m_count; ++i) {
+        const uint64_t closed = interval(i);
+        if (i < m_count - 1) {
+            m_closedSum0 += TFRC_WEIGHTS[i] * closed;
+            m_weightSum += TFRC_WEIGHTS[i];
+        }
+        m_closedSum1 += TFRC_WEIGHTS[i - 1] * closed;
+    }
+}
+
+void LossIntervalEstimator::saveState(std::ostream& os) const {
+    os << m_initialized << ' ' << m_expectedSeq << ' ' << m_count;
+    for (size_t i = 0; i < m_count; ++i) {
+        os << ' ' << interval(i);
+    }
+    os << '\n';
+}
+
+bool LossIntervalEstimator::loadState(std::istream& is) {
+    LossIntervalEstimator loaded{};
+    if (!(is >> loaded.m_initialized >> loaded.m_expectedSeq >> loaded.m_count) ||
+        loaded.m_count == 0 || loaded.m_count > N_INTERVALS) {
+        return false;
+    }
+    // The current interval goes to slot 0, the closed ones follow
+    for (size_t i = 0; i < loaded.m_count; ++i) {
+        if (!(is >> loaded.m_intervals[i])) {
+            return false;
+        }
+    }
+    loaded.updateClosedSums();
+    *this = loaded;
+    return true;
+}
+
+bool LossIntervalEstimator::getLossIntervalInfo(float& avgInterval, uint32_t& currentInterval) const {
+    if (!m_initialized) {
+        return false; // No losses yet --> no intervals
+    }
+    assert(m_count >= 2 && m_count <= N_INTERVALS);
+
+    currentInterval = m_intervals[m_head];
+    const uint64_t iSum0 = m_closedSum0 + TFRC_WEIGHTS[0] * uint64_t(currentInterval);
+    avgInterval = float(std::max(iSum0, m_closedSum1)) / float(m_weightSum);
+    return true;
+}
+
+}
@@ -0,0 +1,126 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * TFRC-style inter-loss interval estimator for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef LOSS_INTERVAL_ESTIMATOR_H
+#define LOSS_INTERVAL_ESTIMATOR_H
+
+#include <cstdint>
+#include <iostream>
+#include <cstddef>
+
+namespace rmcat {
+
+/**
+ * This class keeps track of the length of intervals between two packet
+ * loss events, in the way TCP-friendly Rate Control (TFRC, RFC 5348,
+ * section 5.4) calculates it.
+ *
+ * The current (open) interval and the last eight closed intervals are kept
+ * in a fixed-size circular array. The weighted sums of the closed intervals
+ * are updated upon each new loss event, so that #getLossIntervalInfo takes
+ * constant time, and no memory is allocated after construction.
+ */
+class LossIntervalEstimator {
+public:
+    static const size_t N_INTERVALS = 9; /**< current interval plus 8 closed ones */
+
+    /** Class constructor */
+    LossIntervalEstimator();
+
+    /**
+     * Forget all intervals, and restart the current one
+     *
+     * @param [in] expectedSeq Extended sequence the current interval starts at
+     */
+    void reset(uint64_t expectedSeq);
+
+    /**
+     * Account for a run of consecutive packets that were received. If the
+     * run does not start where the previous one ended, the sequences in
+     * between are considered lost, and a new interval starts
+     *
+     * @param [in] firstSeq Extended sequence of the first packet in the run
+     * @param [in] length Number of packets in the run, must be positive
+     */
+    void addReceived(uint64_t firstSeq, uint32_t length);
+
+    /**
+     * Get the average and current inter-loss intervals
+     *
+     * @param [out] avgInterval Average interval, as defined by TFRC
+     * @param [out] currentInterval Number of packets since the last loss
+     * @retval False if no loss happened yet, true otherwise
+     */
+    bool getLossIntervalInfo(float& avgInterval, uint32_t& currentInterval) const;
+
+    /**
+     * Add an offset to the extended sequences kept, when the sequences of
+     * the flow are renumbered (see SenderBasedController::loadState )
+     *
+     * @param [in] delta Offset added to the sequences
+     */
+    void shiftSequences(uint64_t delta) { m_expectedSeq += delta; }
+
+    /** Write the intervals to a stream, as text */
+    void saveState(std::ostream& os) const;
+
+    /**
+     * Read intervals written by #saveState
+     *
+     * @retval False if the stream does not contain valid intervals
+     */
+    bool loadState(std::istream& is);
+
+private:
+    /** @retval The i-th most recent interval; index 0 is the current one */
+    uint32_t interval(size_t i) const {
+        const size_t s = m_head + i;
+        return m_intervals[s < N_INTERVALS ? s : s - N_INTERVALS];
+    }
+
+    void updateClosedSums();
+
+    uint32_t m_intervals[N_INTERVALS];
+    size_t m_head;          /**< Slot of the current interval */
+    size_t m_count;         /**< Number of intervals, including the current one */
+    uint64_t m_expectedSeq; /**< Sequence that would extend the current interval */
+    bool m_initialized;     /**< Did the first loss happen? */
+    /**
+     * Weighted sums of the closed intervals, with the weights scaled to
+     * integers: the sum of intervals 1..k-2 weighted as for the first
+     * TFRC average (which also includes the current interval), the sum of
+     * intervals 1..k-1 weighted as for the second TFRC average, and the
+     * sum of the weights of the first average
+     */
+    uint64_t m_closedSum0;
+    uint64_t m_closedSum1;
+    uint32_t m_weightSum;
+};
+
+}
+
+#endif /* LOSS_INTERVAL_ESTIMATOR_H */
@@ -0,0 +1,475 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Multi-flow NADA engine implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "nada-bank.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace rmcat {
+
+typedef NadaBank::Params Params;
+
+NadaBankFlow::NadaBankFlow(NadaBank& bank, size_t index) :
+    SenderBasedController{},
+    m_bank(bank),
+    m_index{index},
+    m_fbCountAtCalc{0} {
+    m_bank.resetFlow(m_index, m_initBw);
+    m_bank.m_minBw[m_index] = m_minBw;
+    m_bank.m_maxBw[m_index] = m_maxBw;
+}
+
+NadaBankFlow::~NadaBankFlow() {}
+
+void NadaBankFlow::setMinBw(float minBw) {
+    SenderBasedController::setMinBw(minBw);
+    m_bank.m_minBw[m_index] = minBw;
+}
+
+void NadaBankFlow::setMaxBw(float maxBw) {
+    SenderBasedController::setMaxBw(maxBw);
+    m_bank.m_maxBw[m_index] = maxBw;
+}
+
+void NadaBankFlow::setCurrentBw(float newBw) {
+    if (m_bank.isPending(m_index)) {
+        m_bank.runPending();
+    }
+    m_bank.m_currBw[m_index] = newBw;
+}
+
+void NadaBankFlow::reset() {
+    m_bank.resetFlow(m_index, m_initBw);
+    m_fbCountAtCalc = 0;
+    SenderBasedController::reset();
+    m_bank.m_minBw[m_index] = m_minBw;
+    m_bank.m_maxBw[m_index] = m_maxBw;
+}
+
+bool NadaBankFlow::processSendPacket(uint64_t txTimestampUs,
+                                     uint16_t sequence,
+                                     uint32_t size) { // in Bytes
+    if (!SenderBasedController::processSendPacket(txTimestampUs, sequence, size)) {
+        return false;
+    }
+    /* See NadaController::processSendPacket */
+    if (!m_bank.m_lastTimeCalcValid[m_index]) {
+        m_bank.m_lastTimeCalcUs[m_index] = txTimestampUs;
+        m_bank.m_lastTimeCalcValid[m_index] = 1;
+    }
+    return true;
+}
+
+bool NadaBankFlow::processFeedback(uint64_t nowUs,
+                                   uint16_t sequence,
+                                   uint64_t rxTimestampUs,
+                                   uint8_t ecn) {
+    if (!SenderBasedController::processFeedback(nowUs,
+                                                sequence,
+                                                rxTimestampUs,
+                                                ecn)) {
+        return false;
+    }
+    if (!m_bank.m_lastTimeCalcValid[m_index]) {
+        m_bank.m_lastTimeCalcUs[m_index] = nowUs;
+        m_bank.m_lastTimeCalcValid[m_index] = 1;
+        return true;
+    }
+    /* Nothing new to react to: skip the update altogether */
+    if (getFeedbackCount() == m_fbCountAtCalc) {
+        return true;
+    }
+
+    const uint64_t lastTimeCalcUs = m_bank.m_lastTimeCalcUs[m_index];
+    assert(lessThan(lastTimeCalcUs, nowUs + 1));
+    const uint64_t deltaUs = nowUs - lastTimeCalcUs; // subtraction will wrap correctly
+    if (deltaUs >= Params::deltaUs) {
+        scheduleUpdate(nowUs, deltaUs);
+        m_bank.m_lastTimeCalcUs[m_index] = nowUs;
+        m_fbCountAtCalc = getFeedbackCount();
+    }
+    return true;
+}
+
+bool NadaBankFlow::processFeedbackBatch(uint64_t nowUs,
+                                        const std::vector<FeedbackItem>& feedbackBatch) {
+    if (!SenderBasedController::processFeedbackBatch(nowUs, feedbackBatch)) {
+        return false;
+    }
+    if (!m_bank.m_lastTimeCalcValid[m_index]) {
+        m_bank.m_lastTimeCalcUs[m_index] = nowUs;
+        m_bank.m_lastTimeCalcValid[m_index] = 1;
+        return true;
+    }
+    /* Nothing new to react to: skip the update altogether */
+    if (getFeedbackCount() == m_fbCountAtCalc) {
+        return true;
+    }
+
+    const uint64_t lastTimeCalcUs = m_bank.m_lastTimeCalcUs[m_index];
+    assert(lessThan(lastTimeCalcUs, nowUs + 1));
+    const uint64_t deltaUs = nowUs - lastTimeCalcUs; // subtraction will wrap correctly
+    /* 50% leniency, see NadaController::processFeedbackBatch */
+    if (deltaUs < Params::deltaUs * .5) {
+        return true;
+    }
+    scheduleUpdate(nowUs, deltaUs);
+    m_bank.m_lastTimeCalcUs[m_index] = nowUs;
+    m_fbCountAtCalc = getFeedbackCount();
+    return true;
+}
+
+float NadaBankFlow::getBandwidth(uint64_t nowUs) const {
+    if (m_bank.isPending(m_index)) {
+        m_bank.runPending();
+    }
+    return m_bank.m_currBw[m_index];
+}
+
+void NadaBankFlow::scheduleUpdate(uint64_t nowUs, uint64_t deltaUs) {
+    NadaBank& bank = m_bank;
+    const size_t i = m_index;
+    // Two updates of the same flow in one tick: the first one must complete
+    if (bank.isPending(i)) {
+        bank.runPending();
+    }
+
+    MetricsSnapshot metrics;
+    computeMetrics(nowUs, metrics);
+
+    if (metrics.qdelayValid) bank.m_QdelayUs[i] = metrics.qdelayUs;
+    if (metrics.rttValid) bank.m_RttUs[i] = metrics.rttUs;
+    if (metrics.rrateValid) bank.m_RecvR[i] = metrics.rrateBps;
+
+    if (metrics.lossValid) {
+        bank.m_ploss[i] = metrics.nLoss;
+        bank.m_plr[i] += Params::alpha * (metrics.plr - bank.m_plr[i]);
+    }
+    if (metrics.markValid) {
+        bank.m_pmark[i] = metrics.nMarked;
+        bank.m_pmr[i] += Params::alpha * (metrics.pmr - bank.m_pmr[i]);
+    }
+
+    bank.m_lossesSeen[i] = metrics.lossIntervalValid;
+    if (metrics.lossIntervalValid) {
+        bank.m_avgInt[i] = metrics.avgInterval;
+        bank.m_currInt[i] = metrics.currentInterval;
+    }
+
+    bank.m_QdelayMaxValid[i] = metrics.qdelayMaxValid;
+    if (metrics.qdelayMaxValid) bank.m_QdelayMaxUs[i] = metrics.qdelayMaxUs;
+
+    bank.m_Xprev[i] = bank.m_Xcurr[i];
+    bank.m_qdelayValid[i] = metrics.qdelayValid;
+
+    bank.m_isPending[i] = 1;
+    bank.m_updateUs[i] = nowUs;
+    bank.m_updateDeltaUs[i] = deltaUs;
+    bank.m_pending.push_back(uint32_t(i));
+}
+
+void NadaBankFlow::logStats(uint64_t nowUs, uint64_t deltaUs) const {
+    const NadaBank& bank = m_bank;
+    const size_t i = m_index;
+    StatsRecord record = StatsRecord{};
+    record.timestampUs = nowUs;
+    record.deltaUs = deltaUs;
+    record.loglen = m_packetHistory.size();
+    record.qdelayUs = bank.m_QdelayUs[i];
+    record.rttUs = bank.m_RttUs[i];
+    record.ploss = bank.m_ploss[i];
+    record.plr = bank.m_plr[i];
+    record.pmr = bank.m_pmr[i];
+    record.xcurr = bank.m_Xcurr[i];
+    record.rrateBps = bank.m_RecvR[i];
+    record.srateBps = bank.m_currBw[i];
+    record.avgInt = bank.m_avgInt[i];
+    record.currInt = bank.m_currInt[i];
+    reportStats("nada", record);
+}
+
+void NadaBankFlow::saveStateFields(std::ostream& os, uint64_t nowUs) const {
+    if (m_bank.isPending(m_index)) {
+        m_bank.runPending();
+    }
+    const NadaBank& bank = m_bank;
+    const size_t i = m_index;
+    SenderBasedController::saveStateFields(os, nowUs);
+    os << "nada " << bool(bank.m_lastTimeCalcValid[i]) << ' ' << (nowUs - bank.m_lastTimeCalcUs[i])
+       << ' ' << bank.m_currBw[i] << ' ' << bank.m_Xcurr[i] << ' ' << bank.m_Xprev[i]
+       << ' ' << bank.m_ploss[i] << ' ' << bank.m_plr[i] << ' ' << bank.m_pmark[i] << ' ' << bank.m_pmr[i]
+       << ' ' << bank.m_QdelayUs[i] << ' ' << bank.m_RttUs[i]
+       << ' ' << bool(bank.m_QdelayMaxValid[i]) << ' ' << bank.m_QdelayMaxUs[i]
+       << ' ' << bank.m_RecvR[i] << ' ' << bank.m_avgInt[i] << ' ' << bank.m_currInt[i]
+       << ' ' << bool(bank.m_lossesSeen[i]) << ' ' << bool(bank.m_warpMode[i]) << '\n';
+}
+
+bool NadaBankFlow::loadStateFields(std::istream& is, uint64_t nowUs) {
+    if (m_bank.isPending(m_index)) {
+        m_bank.runPending();
+    }
+    if (!SenderBasedController::loadStateFields(is, nowUs)) {
+        return false;
+    }
+    NadaBank& bank = m_bank;
+    const size_t i = m_index;
+    bool lastTimeCalcValid = false;
+    uint64_t lastCalcAgeUs = 0;
+    bool qdelayMaxValid = false;
+    bool lossesSeen = false;
+    bool warpMode = false;
+    if (!readStateTag(is, "nada") ||
+        !(is >> lastTimeCalcValid >> lastCalcAgeUs
+             >> bank.m_currBw[i] >> bank.m_Xcurr[i] >> bank.m_Xprev[i]
+             >> bank.m_ploss[i] >> bank.m_plr[i] >> bank.m_pmark[i] >> bank.m_pmr[i]
+             >> bank.m_QdelayUs[i] >> bank.m_RttUs[i]
+             >> qdelayMaxValid >> bank.m_QdelayMaxUs[i]
+             >> bank.m_RecvR[i] >> bank.m_avgInt[i] >> bank.m_currInt[i]
+             >> lossesSeen >> warpMode)) {
+        return false;
+    }
+    bank.m_lastTimeCalcValid[i] = lastTimeCalcValid;
+    bank.m_lastTimeCalcUs[i] = nowUs - lastCalcAgeUs;
+    bank.m_QdelayMaxValid[i] = qdelayMaxValid;
+    bank.m_lossesSeen[i] = lossesSeen;
+    bank.m_warpMode[i] = warpMode;
+    m_fbCountAtCalc = getFeedbackCount();
+    return true;
+}
+
+NadaBank::NadaBank() {}
+
+NadaBank::~NadaBank() {}
+
+std::shared_ptr<NadaBankFlow> NadaBank::addFlow() {
+    const size_t i = m_flows.size();
+    const size_t n = i + 1;
+    m_ploss.resize(n);
+    m_plr.resize(n);
+    m_pmark.resize(n);
+    m_pmr.resize(n);
+    m_warpMode.resize(n);
+    m_lastTimeCalcUs.resize(n);
+    m_lastTimeCalcValid.resize(n);
+    m_currBw.resize(n);
+    m_QdelayUs.resize(n);
+    m_RttUs.resize(n);
+    m_QdelayMaxUs.resize(n);
+    m_QdelayMaxValid.resize(n);
+    m_Xcurr.resize(n);
+    m_Xprev.resize(n);
+    m_RecvR.resize(n);
+    m_avgInt.resize(n);
+    m_currInt.resize(n);
+    m_lossesSeen.resize(n);
+    m_minBw.resize(n);
+    m_maxBw.resize(n);
+    m_isPending.resize(n);
+    m_qdelayValid.resize(n);
+    m_updateUs.resize(n);
+    m_updateDeltaUs.resize(n);
+
+    // The handle's constructor initializes its row
+    m_flows.push_back(std::make_shared<NadaBankFlow>(*this, i));
+    return m_flows.back();
+}
+
+void NadaBank::resetFlow(size_t i, float initBw) {
+    if (isPending(i)) {
+        m_pending.erase(std::find(m_pending.begin(), m_pending.end(), uint32_t(i)));
+    }
+    m_ploss[i] = 0;
+    m_plr[i] = 0.f;
+    m_pmark[i] = 0;
+    m_pmr[i] = 0.f;
+    m_warpMode[i] = 0;
+    m_lastTimeCalcUs[i] = 0;
+    m_lastTimeCalcValid[i] = 0;
+    m_currBw[i] = initBw;
+    m_QdelayUs[i] = 0;
+    m_RttUs[i] = 0;
+    m_QdelayMaxUs[i] = 0;
+    m_QdelayMaxValid[i] = 0;
+    m_Xcurr[i] = 0.f;
+    m_Xprev[i] = 0.f;
+    m_RecvR[i] = 0.f;
+    m_avgInt[i] = 0.f;
+    m_currInt[i] = 0;
+    m_lossesSeen[i] = 0;
+    m_isPending[i] = 0;
+    m_qdelayValid[i] = 0;
+    m_updateUs[i] = 0;
+    m_updateDeltaUs[i] = 0;
+}
+
+void NadaBank::Lanes::resize(size_t n) {
+    qdelayMs.resize(n);
+    xtilde.resize(n);
+    currInt.resize(n);
+    avgInt.resize(n);
+    lossesSeen.resize(n);
+    qdelayValid.resize(n);
+    warpMode.resize(n);
+    pmr.resize(n);
+    plr.resize(n);
+    xcurr.resize(n);
+    xprev.resize(n);
+    currBw.resize(n);
+    minBw.resize(n);
+    maxBw.resize(n);
+    recvR.resize(n);
+    deltaMs.resize(n);
+    rttUs.resize(n);
+    gradual.resize(n);
+}
+
+/*
+ * The pending flows are gathered into the lanes, updated by the loops
+ * below, and scattered back. Each loop computes the same expressions, in
+ * the same order, as the corresponding NadaController member function,
+ * so that the rates are the same
+ */
+void NadaBank::runPending() {
+    const size_t n = m_pending.size();
+    if (n == 0) {
+        return;
+    }
+    Lanes& l = m_lanes;
+    l.resize(n);
+    for (size_t k = 0; k < n; ++k) {
+        const size_t i = m_pending[k];
+        /* non-linear warping of the queuing delay (see NadaController::calcDtilde ) */
+        const float qDelay = float(m_QdelayUs[i]) / 1000.f;
+        float xval = qDelay;
+        if (m_QdelayUs[i] / 1000 > Params::qth) {
+            float ratio = (qDelay - Params::qth) / Params::qth;
+            ratio = Params::lambda * ratio;
+            xval = float(Params::qth * exp(-ratio));
+        }
+        l.qdelayMs[k] = qDelay;
+        l.xtilde[k] = xval;
+        l.currInt[k] = float(m_currInt[i]);
+        l.avgInt[k] = m_avgInt[i];
+        l.lossesSeen[k] = m_lossesSeen[i];
+        l.qdelayValid[k] = m_qdelayValid[i];
+        l.warpMode[k] = m_warpMode[i];
+        l.pmr[k] = m_pmr[i];
+        l.plr[k] = m_plr[i];
+        l.xcurr[k] = m_Xcurr[i];
+        l.xprev[k] = m_Xprev[i];
+        l.currBw[k] = m_currBw[i];
+        l.minBw[k] = m_minBw[i];
+        l.maxBw[k] = m_maxBw[i];
+        l.recvR[k] = m_RecvR[i];
+        l.deltaMs[k] = float(m_updateDeltaUs[i]) / 1000.;
+        l.rttUs[k] = m_RttUs[i];
+        /* see NadaController::getRampUpMode */
+        l.gradual[k] = (m_ploss[i] > 0 || m_pmark[i] > 0 ||
+                        (m_QdelayMaxValid[i] && m_QdelayMaxUs[i] > Params::qepsUs));
+    }
+
+    updateXcurr(n);
+    updateRates(n);
+
+    for (size_t k = 0; k < n; ++k) {
+        const size_t i = m_pending[k];
+        m_Xcurr[i] = l.xcurr[k];
+        m_warpMode[i] = l.warpMode[k];
+        m_currBw[i] = l.currBw[k];
+        m_isPending[i] = 0;
+    }
+    for (size_t k = 0; k < n; ++k) {
+        const size_t i = m_pending[k];
+        m_flows[i]->logStats(m_updateUs[i], m_updateDeltaUs[i]);
+    }
+    m_pending.clear();
+}
+
+/* See NadaController::updateXcurr */
+void NadaBank::updateXcurr(size_t n) {
+    Lanes& l = m_lanes;
+    for (size_t k = 0; k < n; ++k) {
+        const float xdel = l.qdelayMs[k];
+        const float xtilde = l.xtilde[k];
+        const float currInt = l.currInt[k];
+        const float avgInt = l.avgInt[k];
+        const bool seen = l.lossesSeen[k] != 0;
+        const bool warp = seen && currInt < Params::multiloss * avgInt;
+        const bool blend = seen && !warp && currInt < (Params::multiloss + 1.f) * avgInt;
+        const float alpha = (currInt - Params::multiloss * avgInt) / avgInt;
+        float x = warp ? xtilde : (blend ? alpha * xdel + (1.f - alpha) * xtilde : xdel);
+        const uint8_t warpMode = warp ? 1 : (blend ? l.warpMode[k] : 0);
+
+        const float pmr0 = l.pmr[k] / Params::pmrref;
+        x += Params::dmark * pmr0 * pmr0;
+        const float plr0 = l.plr[k] / Params::plrref;
+        x += Params::dloss * plr0 * plr0;
+        x = x > Params::xmax ? Params::xmax : x;
+
+        const bool valid = l.qdelayValid[k] != 0;
+        l.xcurr[k] = valid ? x : l.xcurr[k];
+        l.warpMode[k] = valid ? warpMode : l.warpMode[k];
+    }
+}
+
+/*
+ * See NadaController::calcGradualRateUpdate , calcAcceleratedRampUp and
+ * updateBw . Both rates are computed for every lane; the mode selects one
+ */
+void NadaBank::updateRates(size_t n) {
+    Lanes& l = m_lanes;
+    for (size_t k = 0; k < n; ++k) {
+        const float currBw = l.currBw[k];
+
+        float x_offset = l.xcurr[k];
+        const float x_diff = l.xcurr[k] - l.xprev[k];
+        float r_offset = currBw;
+        float r_diff = currBw;
+        x_offset -= Params::prio * Params::xref * l.maxBw[k] / currBw;
+        r_offset *= Params::kappa;
+        r_offset *= l.deltaMs[k] / Params::tau;
+        r_offset *= x_offset / Params::tau;
+        r_diff *= Params::kappa;
+        r_diff *= Params::eta;
+        r_diff *= x_diff / Params::tau;
+        const float gradualBw = currBw - r_offset - r_diff;
+
+        const uint64_t denom = (l.rttUs[k] + Params::deltaUs + Params::dfiltUs) / 1000; // Us --> ms
+        float gamma = Params::qbound / float(denom);
+        gamma = gamma > Params::gammaMax ? Params::gammaMax : gamma;
+        const float rnew = (1.f + gamma) * l.recvR[k];
+        const float rampUpBw = currBw < rnew ? rnew : currBw;
+
+        float bw = l.gradual[k] ? gradualBw : rampUpBw;
+        bw = std::min(bw, l.maxBw[k]);
+        bw = std::max(bw, l.minBw[k]);
+        l.currBw[k] = bw;
+    }
+}
+
+}
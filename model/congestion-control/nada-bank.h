@@ -0,0 +1,220 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Multi-flow NADA engine interface for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef NADA_BANK_H
+#define NADA_BANK_H
+
+#include "nada-controller.h"
+#include <memory>
+#include <vector>
+
+namespace rmcat {
+
+class NadaBank;
+
+/**
+ * Handle to one of the flows of a #NadaBank . It implements the
+ * #SenderBasedController interface, so it can be used wherever a
+ * #NadaController is: the packet history and metrics of the flow are kept
+ * by the superclass, as usual, whereas NADA's own state lives in the bank.
+ *
+ * When a rate update is due, the metrics are calculated right away, but
+ * the update itself is deferred until the bank runs the updates of all
+ * flows due (see NadaBank::runPending ). The bandwidth is always
+ * consistent, though: if an update of the flow is pending, #getBandwidth
+ * runs the pending updates first. Both algorithms produce the same rates.
+ *
+ * Handles are created by NadaBank::addFlow ; the bank must outlive them.
+ */
+class NadaBankFlow: public SenderBasedController {
+public:
+    /** Class constructor; see NadaBank::addFlow */
+    NadaBankFlow(NadaBank& bank, size_t index);
+
+    /* class destructor */
+    virtual ~NadaBankFlow();
+
+    virtual void setMinBw(float minBw);
+    virtual void setMaxBw(float maxBw);
+    virtual void setCurrentBw(float newBw);
+
+    virtual void reset();
+
+    virtual bool processSendPacket(uint64_t txTimestampUs,
+                                   uint16_t sequence,
+                                   uint32_t size); // in Bytes
+
+    virtual bool processFeedback(uint64_t nowUs,
+                                 uint16_t sequence,
+                                 uint64_t rxTimestampUs,
+                                 uint8_t ecn=0);
+
+    virtual bool processFeedbackBatch(uint64_t nowUs,
+                                      const std::vector<FeedbackItem>& feedbackBatch);
+
+    virtual float getBandwidth(uint64_t nowUs) const;
+
+protected:
+    /** Same snapshot format as #NadaController : they are interchangeable */
+    virtual void saveStateFields(std::ostream& os, uint64_t nowUs) const;
+    virtual bool loadStateFields(std::istream& is, uint64_t nowUs);
+
+private:
+    friend class NadaBank;
+
+    /**
+     * Copy the metrics calculated by the superclass to the bank, and
+     * enqueue the flow's rate update (see NadaController::updateMetrics )
+     */
+    void scheduleUpdate(uint64_t nowUs, uint64_t deltaUs);
+
+    /** Report the flow's stats after its rate update */
+    void logStats(uint64_t nowUs, uint64_t deltaUs) const;
+
+    NadaBank& m_bank;
+    size_t m_index; /**< row of the flow in the bank's arrays */
+    uint64_t m_fbCountAtCalc; /**< feedback count (see #getFeedbackCount ) at the last rate update */
+};
+
+/**
+ * State of many NADA controllers (see #NadaController ), stored as a
+ * structure of arrays: one array per state variable, indexed by flow.
+ * When hundreds or thousands of flows are simulated, the rate updates of
+ * all flows due in the same scheduler tick are run as a batch: the
+ * aggregated congestion signal, the gradual update and the accelerated
+ * ramp-up are calculated by loops over contiguous arrays (which the
+ * compiler can vectorize), rather than by a virtual call per flow,
+ * each touching a different heap object.
+ *
+ * All flows use the default parameters (see #NadaDefaultParams ). The
+ * bank is not thread-safe.
+ */
+class NadaBank {
+public:
+    typedef NadaDefaultParams Params;
+
+    /** Class constructor */
+    NadaBank();
+
+    /* class destructor */
+    ~NadaBank();
+
+    /**
+     * Add a flow to the bank
+     *
+     * @retval Handle to the new flow, to be passed to the sender
+     *         application as its controller
+     */
+    std::shared_ptr<NadaBankFlow> addFlow();
+
+    /** @retval The number of flows in the bank */
+    size_t size() const { return m_flows.size(); }
+
+    /** @retval The number of flows whose rate update is pending */
+    size_t pendingCount() const { return m_pending.size(); }
+
+    /**
+     * Run the rate updates of all flows due (i.e., whose feedback has been
+     * processed since the last call). The caller should call it once per
+     * scheduler tick, after all feedback of the tick has been processed
+     */
+    void runPending();
+
+private:
+    friend class NadaBankFlow;
+
+    /** Set the flow's state to its initial values */
+    void resetFlow(size_t i, float initBw);
+    bool isPending(size_t i) const { return m_isPending[i] != 0; }
+
+    std::vector<std::shared_ptr<NadaBankFlow> > m_flows;
+
+    /*
+     * Per-flow state (see the members of #NadaControllerT of the same name)
+     */
+    std::vector<uint32_t> m_ploss;
+    std::vector<float> m_plr;
+    std::vector<uint32_t> m_pmark;
+    std::vector<float> m_pmr;
+    std::vector<uint8_t> m_warpMode;
+    std::vector<uint64_t> m_lastTimeCalcUs;
+    std::vector<uint8_t> m_lastTimeCalcValid;
+    std::vector<float> m_currBw;
+    std::vector<uint64_t> m_QdelayUs;
+    std::vector<uint64_t> m_RttUs;
+    std::vector<uint64_t> m_QdelayMaxUs;
+    std::vector<uint8_t> m_QdelayMaxValid;
+    std::vector<float> m_Xcurr;
+    std::vector<float> m_Xprev;
+    std::vector<float> m_RecvR;
+    std::vector<float> m_avgInt;
+    std::vector<uint32_t> m_currInt;
+    std::vector<uint8_t> m_lossesSeen;
+    std::vector<float> m_minBw;
+    std::vector<float> m_maxBw;
+
+    /* Pending rate updates */
+    std::vector<uint8_t> m_isPending;
+    std::vector<uint8_t> m_qdelayValid;   /**< whether to update the congestion signal */
+    std::vector<uint64_t> m_updateUs;     /**< time of the pending update */
+    std::vector<uint64_t> m_updateDeltaUs; /**< time since the previous update */
+    std::vector<uint32_t> m_pending;      /**< flows with a pending update */
+
+    /*
+     * Inputs and outputs of the pending updates, gathered into contiguous
+     * arrays (one lane per pending flow), so that the loops vectorize
+     */
+    struct Lanes {
+        void resize(size_t n);
+        std::vector<float> qdelayMs;
+        std::vector<float> xtilde;
+        std::vector<float> currInt;
+        std::vector<float> avgInt;
+        std::vector<uint8_t> lossesSeen;
+        std::vector<uint8_t> qdelayValid;
+        std::vector<uint8_t> warpMode;
+        std::vector<float> pmr;
+        std::vector<float> plr;
+        std::vector<float> xcurr;
+        std::vector<float> xprev;
+        std::vector<float> currBw;
+        std::vector<float> minBw;
+        std::vector<float> maxBw;
+        std::vector<float> recvR;
+        std::vector<float> deltaMs;
+        std::vector<uint64_t> rttUs;
+        std::vector<uint8_t> gradual;
+    };
+    Lanes m_lanes;
+
+    void updateXcurr(size_t n);
+    void updateRates(size_t n);
+};
+
+}
+
+#endif /* NADA_BANK_H */
@@ -34,86 +34,246 @@
 
 #include "nada-controller.h"
 #include <iostream>
-#include <sstream>
 #include <iomanip>
 #include <cassert>
 #include <cmath>
+#include <limits>
+#include <sstream>
+#include <vector>
 
 
-/*
- * Default parameter values of the NADA algorithm,
- * corresponding to Figure 3 in the rmcat-nada draft
- */
-/* default parameters for core algorithm (gradual rate update) */
-
-const float NADA_PARAM_PRIO = 1.0;  /**< Weight of priority of the flow  */
-const float  NADA_PARAM_XREF = 10.0; /**< Reference congestion level (in ms) */
-
-const float NADA_PARAM_KAPPA = 0.5; /**< Scaling parameter for gradual rate update calculation (dimensionless) */
-const float NADA_PARAM_ETA = 2.0; /**< Scaling parameter for gradual rate update calculation (dimensionless) */
-const float NADA_PARAM_TAU = 500.; /**< Upper bound of RTT (in ms) in gradual rate update calculation */
-
-/**
- * Target interval for receiving feedback from receiver
- * or update rate calculation (in microseconds)
- */
-const uint64_t NADA_PARAM_DELTA_US = 100 * 1000;
-
-/* default parameters for accelerated ramp-up */
+namespace rmcat {
 
-/**  Threshold (microseconds) for allowed queuing delay build up at receiver during accelerated ramp-up mode */
-const uint64_t NADA_PARAM_QEPS_US = 10 * 1000;
-const uint64_t NADA_PARAM_DFILT_US = 120 * 1000; /**< Bound on filtering delay (in microseconds) */
-/** Upper bound on rate increase ratio in accelerated ramp-up mode (dimensionless) */
-const float NADA_PARAM_GAMMA_MAX = 0.5;
-/** Upper bound on self-inflicted queuing delay during ramp up (in ms) */
-const float NADA_PARAM_QBOUND = 50.;
+constexpr float NadaDefaultParams::prio;
+constexpr float NadaDefaultParams::xref;
+constexpr float NadaDefaultParams::kappa;
+constexpr float NadaDefaultParams::eta;
+constexpr float NadaDefaultParams::tau;
+constexpr uint64_t NadaDefaultParams::deltaUs;
+constexpr bool NadaDefaultParams::adaptiveDelta;
+constexpr uint64_t NadaDefaultParams::deltaMinUs;
+constexpr uint64_t NadaDefaultParams::qepsUs;
+constexpr uint64_t NadaDefaultParams::dfiltUs;
+constexpr float NadaDefaultParams::gammaMax;
+constexpr float NadaDefaultParams::qbound;
+constexpr float NadaDefaultParams::multiloss;
+constexpr float NadaDefaultParams::qth;
+constexpr float NadaDefaultParams::lambda;
+constexpr float NadaDefaultParams::dloss;
+constexpr float NadaDefaultParams::plrref;
+constexpr float NadaDefaultParams::dmark;
+constexpr float NadaDefaultParams::pmrref;
+constexpr float NadaDefaultParams::xmax;
+constexpr float NadaDefaultParams::dgrad;
+constexpr bool NadaDefaultParams::dgradKalman;
+constexpr float NadaDefaultParams::alpha;
+
+NadaParams::NadaParams() :
+    prio{NadaDefaultParams::prio},
+    xref{NadaDefaultParams::xref},
+    kappa{NadaDefaultParams::kappa},
+    eta{NadaDefaultParams::eta},
+    tau{NadaDefaultParams::tau},
+    deltaUs{NadaDefaultParams::deltaUs},
+    adaptiveDelta{NadaDefaultParams::adaptiveDelta},
+    deltaMinUs{NadaDefaultParams::deltaMinUs},
+    qepsUs{NadaDefaultParams::qepsUs},
+    dfiltUs{NadaDefaultParams::dfiltUs},
+    gammaMax{NadaDefaultParams::gammaMax},
+    qbound{NadaDefaultParams::qbound},
+    multiloss{NadaDefaultParams::multiloss},
+    qth{NadaDefaultParams::qth},
+    lambda{NadaDefaultParams::lambda},
+    dloss{NadaDefaultParams::dloss},
+    plrref{NadaDefaultParams::plrref},
+    dmark{NadaDefaultParams::dmark},
+    pmrref{NadaDefaultParams::pmrref},
+    xmax{NadaDefaultParams::xmax},
+    dgrad{NadaDefaultParams::dgrad},
+    dgradKalman{NadaDefaultParams::dgradKalman},
+    alpha{NadaDefaultParams::alpha} {}
+
+/* Range checks of the parameters' values: NaN fails all of them */
+static bool isPositive(double value) {
+    return value > 0. && value <= std::numeric_limits<float>::max();
+}
 
-/* default parameters for non-linear warping of queuing delay */
+static bool isNonNegative(double value) {
+    return value >= 0. && value <= std::numeric_limits<float>::max();
+}
 
-/** multiplier of observed average loss intervals, as a measure
- * of tolerance of missing observed loss events (dimensionless)
- */
-const float NADA_PARAM_MULTILOSS = 7.;
+/* Durations must convert to uint64_t, and be at least minUs */
+static bool isDuration(double value, double minUs) {
+    return value >= minUs && value < double(std::numeric_limits<uint64_t>::max());
+}
 
-const float NADA_PARAM_QTH = 50.; /**< Queuing delay threshold for invoking non-linear warping (in ms) */
-const float NADA_PARAM_LAMBDA = 0.5; /**< Exponent of the non-linear warping (dimensionless) */
+template <typename T>
+static bool setIfValid(T& field, double value, bool valid) {
+    if (!valid) {
+        return false;
+    }
+    field = T(value);
+    return true;
+}
 
-/* default parameters for calculating aggregated congestion signal */
+bool NadaParams::set(const std::string& name, double value) {
+    if (name == "prio") {
+        return setIfValid(prio, value, isPositive(value));
+    }
+    if (name == "xref") {
+        return setIfValid(xref, value, isPositive(value));
+    }
+    if (name == "kappa") {
+        return setIfValid(kappa, value, isPositive(value));
+    }
+    if (name == "eta") {
+        return setIfValid(eta, value, isNonNegative(value));
+    }
+    if (name == "tau") {
+        return setIfValid(tau, value, isPositive(value));
+    }
+    if (name == "deltaUs") {
+        return setIfValid(deltaUs, value, isDuration(value, 1.));
+    }
+    if (name == "adaptiveDelta") {
+        adaptiveDelta = (value != 0.);
+        return true;
+    }
+    if (name == "deltaMinUs") {
+        return setIfValid(deltaMinUs, value, isDuration(value, 1.));
+    }
+    if (name == "qepsUs") {
+        return setIfValid(qepsUs, value, isDuration(value, 0.));
+    }
+    if (name == "dfiltUs") {
+        /* The accelerated ramp-up divides by a sum of milliseconds including it */
+        return setIfValid(dfiltUs, value, isDuration(value, 1000.));
+    }
+    if (name == "gammaMax") {
+        return setIfValid(gammaMax, value, isNonNegative(value));
+    }
+    if (name == "qbound") {
+        return setIfValid(qbound, value, isNonNegative(value));
+    }
+    if (name == "multiloss") {
+        return setIfValid(multiloss, value, isNonNegative(value));
+    }
+    if (name == "qth") {
+        return setIfValid(qth, value, isPositive(value));
+    }
+    if (name == "lambda") {
+        return setIfValid(lambda, value, isNonNegative(value));
+    }
+    if (name == "dloss") {
+        return setIfValid(dloss, value, isNonNegative(value));
+    }
+    if (name == "plrref") {
+        return setIfValid(plrref, value, isPositive(value));
+    }
+    if (name == "dmark") {
+        return setIfValid(dmark, value, isNonNegative(value));
+    }
+    if (name == "pmrref") {
+        return setIfValid(pmrref, value, isPositive(value));
+    }
+    if (name == "xmax") {
+        return setIfValid(xmax, value, isPositive(value));
+    }
+    if (name == "dgrad") {
+        return setIfValid(dgrad, value, isNonNegative(value));
+    }
+    if (name == "dgradKalman") {
+        dgradKalman = (value != 0.);
+        return true;
+    }
+    if (name == "alpha") {
+        return setIfValid(alpha, value, isPositive(value) && value <= 1.);
+    }
+    return false;
+}
 
-/**
- * Reference delay penalty (in ms) in terms of value
- * of congestion price when packet loss ratio is at PLRREF
- */
-const float NADA_PARAM_DLOSS = 10.;
-const float NADA_PARAM_PLRREF = 0.01; /**> Reference packet loss ratio (dimensionless) */
-const float NADA_PARAM_XMAX = 500.; /**> Maximum value of aggregate congestion signal (in ms) */
+bool NadaParams::load(std::istream& is, const std::string& id) {
+    std::string line;
+    while (std::getline(is, line)) {
+        std::istringstream words{line};
+        std::vector<std::string> tokens;
+        std::string word;
+        while (words >> word) {
+            tokens.push_back(word);
+        }
+        if (tokens.empty() || tokens[0][0] == '#') {
+            continue;
+        }
+        if (tokens.size() == 3) {
+            if (tokens[0] != id) {
+                continue;
+            }
+            tokens.erase(tokens.begin());
+        }
+        std::istringstream value{tokens.size() == 2 ? tokens[1] : ""};
+        double v = 0.;
+        if (tokens.size() != 2 || !(value >> v) || !set(tokens[0], v)) {
+            std::cerr << "NadaParams::load, invalid line: " << line << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
 
-/** Smoothing factor in exponential smoothing of packet loss and marking ratios */
-const float NADA_PARAM_ALPHA = 0.1;
 
-namespace rmcat {
-
-NadaController::NadaController() :
+template <typename Params>
+NadaControllerT<Params>::NadaControllerT(const Params& params) :
     SenderBasedController{},
     m_ploss{0},
     m_plr{0.f},
+    m_pmark{0},
+    m_pmr{0.f},
     m_warpMode{false},
     m_lastTimeCalcUs{0},
     m_lastTimeCalcValid{false},
     m_currBw{m_initBw},
     m_QdelayUs{0},
     m_RttUs{0},
+    m_QdelayMaxUs{0},
+    m_QdelayMaxValid{false},
     m_Xcurr{0.f},
     m_Xprev{0.f},
     m_RecvR{0.f},
     m_avgInt{0.f},
     m_currInt{0},
-    m_lossesSeen{false} {}
+    m_lossesSeen{false},
+    m_fbCountAtCalc{0},
+    m_fbCountSeen{0},
+    m_lastFbArrivalUs{0},
+    m_lastFbArrivalValid{false},
+    m_fbIntervalValid{false},
+    m_fbIntervalUs{0},
+    m_gradEstimator{params.dgradKalman ? DelayGradientEstimator::MODE_KALMAN :
+                                         DelayGradientEstimator::MODE_TRENDLINE},
+    m_gradLastSeq{0},
+    m_gradLastSeqValid{false},
+    m_params(params) {}
+
+template <typename Params>
+NadaControllerT<Params>::~NadaControllerT() {}
+
+template <typename Params>
+void NadaControllerT<Params>::setParams(const Params& params) {
+    m_params = params;
+    if (m_gradEstimator.getMode() != getGradientMode()) {
+        m_gradEstimator = DelayGradientEstimator{getGradientMode()};
+        m_gradLastSeqValid = !m_packetHistory.empty();
+        m_gradLastSeq = m_gradLastSeqValid ? m_packetHistory.back().sequence : 0;
+    }
+}
 
-NadaController::~NadaController() {}
+template <typename Params>
+const Params& NadaControllerT<Params>::getParams() const {
+    return m_params;
+}
 
-void NadaController::setCurrentBw(float newBw) {
+template <typename Params>
+void NadaControllerT<Params>::setCurrentBw(float newBw) {
     m_currBw = newBw;
 }
 
@@ -121,32 +281,56 @@ void NadaController::setCurrentBw(float newBw) {
  * Implementation of the #reset API: reset all state variables
  * to default values
  */
-void NadaController::reset() {
+template <typename Params>
+void NadaControllerT<Params>::reset() {
     m_ploss = 0;
     m_plr = 0.f;
+    m_pmark = 0;
+    m_pmr = 0.f;
     m_warpMode = false;
     m_lastTimeCalcUs = 0;
     m_lastTimeCalcValid = false;
     m_currBw = m_initBw;
     m_QdelayUs = 0;
     m_RttUs = 0;
+    m_QdelayMaxUs = 0;
+    m_QdelayMaxValid = false;
     m_Xcurr = 0.f;
     m_Xprev = 0.f;
     m_RecvR = 0.f;
     m_avgInt = 0.f;
     m_currInt = 0;
     m_lossesSeen = false;
+    m_fbCountAtCalc = 0;
+    m_fbCountSeen = 0;
+    m_lastFbArrivalUs = 0;
+    m_lastFbArrivalValid = false;
+    m_fbIntervalValid = false;
+    m_fbIntervalUs = 0;
+    m_gradEstimator.reset();
+    m_gradLastSeq = 0;
+    m_gradLastSeqValid = false;
     SenderBasedController::reset();
 }
 
-bool NadaController::processSendPacket(uint64_t txTimestampUs,
+template <typename Params>
+bool NadaControllerT<Params>::processSendPacket(uint64_t txTimestampUs,
                                        uint16_t sequence,
                                        uint32_t size) { // in Bytes
+    /* The superclass renumbers the sequences after a snapshot is loaded:
+     * so must the last sequence fed to the delay gradient estimator */
+    const bool rebase = m_rebaseSequence;
+    const uint64_t lastSequence = m_lastSequence;
+
     /* First of all, call the superclass */
     if (!SenderBasedController::processSendPacket(txTimestampUs, sequence, size)) {
         return false;
     }
 
+    if (rebase && m_gradLastSeqValid) {
+        m_gradLastSeq += m_lastSequence - 1 - lastSequence;
+    }
+
     /* Optimization: to avoid skipping the rate update upon the first received feedback
      * batch, we initialize the last time the rate was updated to the first media packet sent
      */
@@ -160,10 +344,9 @@ bool NadaController::processSendPacket(uint64_t txTimestampUs,
 /**
  * Implementation of the #processFeedback API
  * in the SenderBasedController class
- *
- * TODO (deferred): Add support for ECN marking
  */
-bool NadaController::processFeedback(uint64_t nowUs,
+template <typename Params>
+bool NadaControllerT<Params>::processFeedback(uint64_t nowUs,
                                      uint16_t sequence,
                                      uint64_t rxTimestampUs,
                                      uint8_t ecn) {
@@ -174,11 +357,15 @@ bool NadaController::processFeedback(uint64_t nowUs,
                                                 ecn)) {
         return false;
     }
+    if (m_params.dgrad != 0.f) {
+        updateGradient();
+    }
 
     /* Update calculation of reference rate (r_ref)
-     * if last calculation occurred more than NADA_PARAM_DELTA_US
+     * if last calculation occurred more than DELTA
      * (target update interval in microseconds) ago
      */
+    const bool newFeedback = trackFeedback(nowUs);
 
     /* First time receiving a feedback message */
     if (!m_lastTimeCalcValid) {
@@ -187,33 +374,44 @@ bool NadaController::processFeedback(uint64_t nowUs,
         return true;
     }
 
+    /* Nothing new to react to: skip the update altogether */
+    if (!newFeedback) {
+        return true;
+    }
+
     assert(lessThan(m_lastTimeCalcUs, nowUs + 1));
     /* calculate time since last update */
     const uint64_t deltaUs = nowUs - m_lastTimeCalcUs; // subtraction will wrap correctly
-    if (deltaUs >= NADA_PARAM_DELTA_US) {
+    if (deltaUs >= getUpdateInterval()) {
         /* log & update rate calculation */
-        updateMetrics();
+        updateMetrics(nowUs);
         updateBw(deltaUs);
         logStats(nowUs, deltaUs);
 
         m_lastTimeCalcUs = nowUs;
+        m_fbCountAtCalc = getFeedbackCount();
     }
     return true;
 }
 
-bool NadaController::processFeedbackBatch(uint64_t nowUs,
+template <typename Params>
+bool NadaControllerT<Params>::processFeedbackBatch(uint64_t nowUs,
                                           const std::vector<FeedbackItem>& feedbackBatch) {
     /* First of all, call the superclass */
     if (!SenderBasedController::processFeedbackBatch(nowUs, feedbackBatch)) {
         return false;
     }
+    if (m_params.dgrad != 0.f) {
+        updateGradient();
+    }
 
     /* Update calculation of reference rate (r_ref)
-     * Make sure that last calculation occurred more than NADA_PARAM_DELTA_US
+     * Make sure that last calculation occurred more than DELTA
      * (target update interval in microseconds) ago. Apply with some leniency
      * so that calculation time coincides with aggregate feedback processing
      * most of the time.
      */
+    const bool newFeedback = trackFeedback(nowUs);
 
     /* First time receiving a feedback message */
     if (!m_lastTimeCalcValid) {
@@ -222,19 +420,25 @@ bool NadaController::processFeedbackBatch(uint64_t nowUs,
         return true;
     }
 
+    /* Nothing new to react to: skip the update altogether */
+    if (!newFeedback) {
+        return true;
+    }
+
     assert(lessThan(m_lastTimeCalcUs, nowUs + 1));
     /* calculate time since last update */
     const uint64_t deltaUs = nowUs - m_lastTimeCalcUs; // subtraction will wrap correctly
     /* 50% leniency */
-    if (deltaUs < NADA_PARAM_DELTA_US * .5) {
+    if (deltaUs < getUpdateInterval() * .5) {
         return true;
     }
     /* log & update rate calculation */
-    updateMetrics();
+    updateMetrics(nowUs);
     updateBw(deltaUs);
     logStats(nowUs, deltaUs);
 
     m_lastTimeCalcUs = nowUs;
+    m_fbCountAtCalc = getFeedbackCount();
     return true;
 }
 
@@ -244,17 +448,61 @@ bool NadaController::processFeedbackBatch(uint64_t nowUs,
  * returns the calculated reference rate
  * (r_ref in rmcat-nada)
  */
-float NadaController::getBandwidth(uint64_t nowUs) const {
+template <typename Params>
+float NadaControllerT<Params>::getBandwidth(uint64_t nowUs) const {
     return m_currBw;
 }
 
+template <typename Params>
+void NadaControllerT<Params>::saveStateFields(std::ostream& os, uint64_t nowUs) const {
+    SenderBasedController::saveStateFields(os, nowUs);
+    os << "nada " << m_lastTimeCalcValid << ' ' << (nowUs - m_lastTimeCalcUs)
+       << ' ' << m_currBw << ' ' << m_Xcurr << ' ' << m_Xprev
+       << ' ' << m_ploss << ' ' << m_plr << ' ' << m_pmark << ' ' << m_pmr
+       << ' ' << m_QdelayUs << ' ' << m_RttUs
+       << ' ' << m_QdelayMaxValid << ' ' << m_QdelayMaxUs
+       << ' ' << m_RecvR << ' ' << m_avgInt << ' ' << m_currInt
+       << ' ' << m_lossesSeen << ' ' << m_warpMode << '\n';
+}
+
+template <typename Params>
+bool NadaControllerT<Params>::loadStateFields(std::istream& is, uint64_t nowUs) {
+    if (!SenderBasedController::loadStateFields(is, nowUs)) {
+        return false;
+    }
+    uint64_t lastCalcAgeUs = 0;
+    if (!readStateTag(is, "nada") ||
+        !(is >> m_lastTimeCalcValid >> lastCalcAgeUs
+             >> m_currBw >> m_Xcurr >> m_Xprev
+             >> m_ploss >> m_plr >> m_pmark >> m_pmr
+             >> m_QdelayUs >> m_RttUs
+             >> m_QdelayMaxValid >> m_QdelayMaxUs
+             >> m_RecvR >> m_avgInt >> m_currInt
+             >> m_lossesSeen >> m_warpMode)) {
+        return false;
+    }
+    m_lastTimeCalcUs = nowUs - lastCalcAgeUs;
+    /* The feedback tracking restarts: the snapshot's state is up to date */
+    m_fbCountAtCalc = getFeedbackCount();
+    m_fbCountSeen = m_fbCountAtCalc;
+    m_lastFbArrivalValid = false;
+    m_fbIntervalValid = false;
+    /* The packets in the snapshot's history are not fed to the delay
+     * gradient estimator again: it restarts with the next feedback */
+    m_gradEstimator.reset();
+    m_gradLastSeqValid = !m_packetHistory.empty();
+    m_gradLastSeq = m_gradLastSeqValid ? m_packetHistory.back().sequence : 0;
+    return true;
+}
+
 
 /**
  * The following implements the core congestion
  * control algorithm as specified in the rmcat-nada
  * draft (see Section 4)
  */
-void NadaController::updateBw(uint64_t deltaUs) {
+template <typename Params>
+void NadaControllerT<Params>::updateBw(uint64_t deltaUs) {
 
     int rmode = getRampUpMode();
     if (rmode == 0) {
@@ -274,69 +522,67 @@ void NadaController::updateBw(uint64_t deltaUs) {
  * rate from the base class SenderBasedController
  * and saves them to local member variables.
  */
-void NadaController::updateMetrics() {
-
-    /* Obtain packet stats in terms of loss and delay */
-    uint64_t qdelayUs = 0;
-    bool qdelayOK = getCurrentQdelay(qdelayUs);
-    if (qdelayOK) m_QdelayUs = qdelayUs;
-
-    uint64_t rttUs = 0;
-    bool rttOK = getCurrentRTT(rttUs);
-    if (rttOK) m_RttUs = rttUs;
-
-    float rrate = 0.f;
-    bool rrateOK = getCurrentRecvRate(rrate);
-    if (rrateOK) m_RecvR = rrate;
-
-    float plr = 0.f;
-    uint32_t nLoss = 0;
-    bool plrOK = getPktLossInfo(nLoss, plr);
-    if (plrOK) {
-        m_ploss = nLoss;
+template <typename Params>
+void NadaControllerT<Params>::updateMetrics(uint64_t nowUs) {
+
+    /* Obtain packet stats in terms of loss and delay,
+     * all calculated in one go by the base class */
+    MetricsSnapshot metrics;
+    computeMetrics(nowUs, metrics);
+
+    if (metrics.qdelayValid) m_QdelayUs = metrics.qdelayUs;
+    if (metrics.rttValid) m_RttUs = metrics.rttUs;
+    if (metrics.rrateValid) m_RecvR = metrics.rrateBps;
+
+    if (metrics.lossValid) {
+        m_ploss = metrics.nLoss;
         // Exponential filtering of loss stats
-        m_plr += NADA_PARAM_ALPHA * (plr - m_plr);
+        m_plr += m_params.alpha * (metrics.plr - m_plr);
+    }
+
+    if (metrics.markValid) {
+        m_pmark = metrics.nMarked;
+        // Exponential filtering of marking stats
+        m_pmr += m_params.alpha * (metrics.pmr - m_pmr);
     }
 
-    float avgInt;
-    uint32_t currentInt;
-    bool avgIntOK = getLossIntervalInfo(avgInt, currentInt);
-    m_lossesSeen = avgIntOK;
-    if (avgIntOK) {
-        m_avgInt = avgInt;
-        m_currInt = currentInt;
+    m_lossesSeen = metrics.lossIntervalValid;
+    if (metrics.lossIntervalValid) {
+        m_avgInt = metrics.avgInterval;
+        m_currInt = metrics.currentInterval;
     }
 
+    m_QdelayMaxValid = metrics.qdelayMaxValid;
+    if (metrics.qdelayMaxValid) m_QdelayMaxUs = metrics.qdelayMaxUs;
+
     /* update aggregate congestion signal */
     m_Xprev = m_Xcurr;
-    if (qdelayOK) updateXcurr();
+    if (metrics.qdelayValid) updateXcurr();
 
 }
 
-void NadaController::logStats(uint64_t nowUs, uint64_t deltaUs) const {
-
-    std::ostringstream os;
-    os << std::fixed;
-    os.precision(RMCAT_LOG_PRINT_PRECISION);
+template <typename Params>
+void NadaControllerT<Params>::logStats(uint64_t nowUs, uint64_t deltaUs) const {
 
     /* log packet stats: including common stats
      * (e.g., receiving rate, loss, delay) needed
      * by all controllers and algorithm-specific
      * ones (e.g., xcurr for NADA) */
-    os << " algo:nada " << m_id
-       << " ts: "     << (nowUs / 1000)
-       << " loglen: " << m_packetHistory.size()
-       << " qdel: "   << (m_QdelayUs / 1000)
-       << " rtt: "    << (m_RttUs / 1000)
-       << " ploss: "  << m_ploss
-       << " plr: "    << m_plr
-       << " xcurr: "  << m_Xcurr
-       << " rrate: "  << m_RecvR
-       << " srate: "  << m_currBw
-       << " avgint: " << m_avgInt
-       << " curint: " << m_currInt
-       << " delta: "  << (deltaUs / 1000);
-    logMessage(os.str());
+    StatsRecord record = StatsRecord{};
+    record.timestampUs = nowUs;
+    record.deltaUs = deltaUs;
+    record.loglen = m_packetHistory.size();
+    record.qdelayUs = m_QdelayUs;
+    record.rttUs = m_RttUs;
+    record.ploss = m_ploss;
+    record.plr = m_plr;
+    record.pmr = m_pmr;
+    record.xcurr = m_Xcurr;
+    record.rrateBps = m_RecvR;
+    record.srateBps = m_currBw;
+    record.avgInt = m_avgInt;
+    record.currInt = m_currInt;
+    reportStats("nada", record);
 }
 
 /**
@@ -351,14 +597,15 @@ void NadaController::logStats(uint64_t nowUs, uint64_t deltaUs) const {
  *            \ QTH exp(-LAMBDA ---------------), otherwise.
  *                                    QTH
  */
-float NadaController::calcDtilde() const {
+template <typename Params>
+float NadaControllerT<Params>::calcDtilde() const {
     const float qDelay = float(m_QdelayUs) / 1000.f;
     float xval = qDelay;
 
-    if (m_QdelayUs / 1000 > NADA_PARAM_QTH) {
-        float ratio = (qDelay - NADA_PARAM_QTH) / NADA_PARAM_QTH;
-        ratio = NADA_PARAM_LAMBDA * ratio;
-        xval = float(NADA_PARAM_QTH * exp(-ratio));
+    if (m_QdelayUs / 1000 > m_params.qth) {
+        float ratio = (qDelay - m_params.qth) / m_params.qth;
+        ratio = m_params.lambda * ratio;
+        xval = float(m_params.qth * exp(-ratio));
     }
 
     return xval;
@@ -371,7 +618,8 @@ float NadaController::calcDtilde() const {
  * invoking the non-linear warping of queuing
  * delay is described in Sec. 4.2 of the draft.
  */
-void NadaController::updateXcurr() {
+template <typename Params>
+void NadaControllerT<Params>::updateXcurr() {
 
     float xdel = float(m_QdelayUs) / 1000.f; // pure delay-based
     float xtilde = calcDtilde();             // warped version
@@ -382,10 +630,10 @@ void NadaController::updateXcurr() {
      * time window for last observed loss self-adapts
      * with previously observed loss intervals
      * */
-    if (m_lossesSeen && currInt < NADA_PARAM_MULTILOSS * m_avgInt) {
+    if (m_lossesSeen && currInt < m_params.multiloss * m_avgInt) {
         /* last loss observed within the time window
-         * NADA_PARAM_MULTILOSS * m_avgInt; allowing us to
-         * miss up to NADA_PARAM_MULTILOSS-1 loss events
+         * MULTILOSS * m_avgInt; allowing us to
+         * miss up to MULTILOSS-1 loss events
          */
         m_Xcurr = xtilde;
         m_warpMode = true;
@@ -394,11 +642,11 @@ void NadaController::updateXcurr() {
           * to non-warped queuing delay over the course
           * of one average packet loss interval (m_avgInt)
           */
-        if (currInt < (NADA_PARAM_MULTILOSS + 1.f) * m_avgInt) {
+        if (currInt < (m_params.multiloss + 1.f) * m_avgInt) {
             /* transition period: linearly blending
              * warped and non-warped values for congestion
              * price */
-            const float alpha = (currInt - NADA_PARAM_MULTILOSS * m_avgInt) / m_avgInt;
+            const float alpha = (currInt - m_params.multiloss * m_avgInt) / m_avgInt;
             m_Xcurr = alpha * xdel + (1.f - alpha) * xtilde;
         } else {
             /* after transition period: switch completely
@@ -413,19 +661,52 @@ void NadaController::updateXcurr() {
         m_warpMode = false;
     }
 
-    /* Add additional loss penalty for the aggregate
-     * congestion signal, following Eq.(2) in Sec.4.2 of
-     * rmcat-nada draft */
-    float plr0 = m_plr / NADA_PARAM_PLRREF;
-    m_Xcurr += NADA_PARAM_DLOSS * plr0 * plr0;
+    /* Add additional marking and loss penalties for the
+     * aggregate congestion signal, following Eq.(2) in
+     * Sec.4.2 of rmcat-nada draft */
+    float pmr0 = m_pmr / m_params.pmrref;
+    m_Xcurr += m_params.dmark * pmr0 * pmr0;
+    float plr0 = m_plr / m_params.plrref;
+    m_Xcurr += m_params.dloss * plr0 * plr0;
+
+    /* Optional delay gradient penalty (not in rmcat-nada): a growing
+     * queue raises the congestion signal, a draining one lowers it */
+    if (m_params.dgrad != 0.f) {
+        m_Xcurr += m_params.dgrad * float(m_gradEstimator.getGradient());
+        m_Xcurr = std::max(m_Xcurr, 0.f);
+    }
 
     /* Clip final congestion signal within range */
-    if (m_Xcurr > NADA_PARAM_XMAX) {
-        m_Xcurr = NADA_PARAM_XMAX;
+    if (m_Xcurr > m_params.xmax) {
+        m_Xcurr = m_params.xmax;
     }
 
 }
 
+template <typename Params>
+void NadaControllerT<Params>::updateGradient() {
+    /* The history is ordered by sequence: the packets not fed yet are
+     * at the back. Packets inserted late (reordered) are skipped */
+    size_t first = m_packetHistory.size();
+    while (first > 0 &&
+           (!m_gradLastSeqValid || m_gradLastSeq < m_packetHistory.sequenceAt(first - 1))) {
+        --first;
+    }
+    for (size_t i = first; i < m_packetHistory.size(); ++i) {
+        m_gradEstimator.addPacket(m_packetHistory.at(i));
+    }
+    if (first < m_packetHistory.size()) {
+        m_gradLastSeq = m_packetHistory.back().sequence;
+        m_gradLastSeqValid = true;
+    }
+}
+
+template <typename Params>
+DelayGradientEstimator::Mode NadaControllerT<Params>::getGradientMode() const {
+    return m_params.dgradKalman ? DelayGradientEstimator::MODE_KALMAN :
+                                  DelayGradientEstimator::MODE_TRENDLINE;
+}
+
 /**
  * This function implements the calculation of reference
  * rate (r_ref) in the gradual update mode, following
@@ -444,7 +725,8 @@ void NadaController::updateXcurr() {
  *               - KAPPA*ETA*---------*r_ref         (7)
  *                              TAU
  */
-void NadaController::calcGradualRateUpdate(uint64_t deltaUs) {
+template <typename Params>
+void NadaControllerT<Params>::calcGradualRateUpdate(uint64_t deltaUs) {
 
     float x_curr = m_Xcurr;
     float x_prev = m_Xprev;
@@ -454,16 +736,16 @@ void NadaController::calcGradualRateUpdate(uint64_t deltaUs) {
     float r_offset = m_currBw;
     float r_diff = m_currBw;
 
-    x_offset -= NADA_PARAM_PRIO * NADA_PARAM_XREF * m_maxBw / m_currBw;
+    x_offset -= m_params.prio * m_params.xref * m_maxBw / m_currBw;
 
-    r_offset *= NADA_PARAM_KAPPA;
+    r_offset *= m_params.kappa;
     const float delta = float(deltaUs) / 1000.;
-    r_offset *= delta / NADA_PARAM_TAU;
-    r_offset *= x_offset / NADA_PARAM_TAU;
+    r_offset *= delta / m_params.tau;
+    r_offset *= x_offset / m_params.tau;
 
-    r_diff *= NADA_PARAM_KAPPA;
-    r_diff *= NADA_PARAM_ETA;
-    r_diff *= x_diff / NADA_PARAM_TAU;
+    r_diff *= m_params.kappa;
+    r_diff *= m_params.eta;
+    r_diff *= x_diff / m_params.tau;
 
     m_currBw = m_currBw - r_offset - r_diff;
 }
@@ -479,25 +761,61 @@ void NadaController::calcGradualRateUpdate(uint64_t deltaUs) {
  *
  * r_ref = max(r_ref, (1+gamma) r_recv)           (4)
  */
-void NadaController::calcAcceleratedRampUp( ) {
+template <typename Params>
+void NadaControllerT<Params>::calcAcceleratedRampUp( ) {
 
     float gamma = 1.0;
 
     uint64_t denom = m_RttUs;
-    denom += NADA_PARAM_DELTA_US;
-    denom += NADA_PARAM_DFILT_US;
+    denom += getUpdateInterval();
+    denom += m_params.dfiltUs;
     denom /= 1000; // Us --> ms
 
-    gamma = NADA_PARAM_QBOUND / float(denom);
+    gamma = m_params.qbound / float(denom);
 
-    if (gamma > NADA_PARAM_GAMMA_MAX) {
-        gamma = NADA_PARAM_GAMMA_MAX;
+    if (gamma > m_params.gammaMax) {
+        gamma = m_params.gammaMax;
     }
 
     float rnew = (1.f + gamma) * m_RecvR;
     if (m_currBw < rnew) m_currBw = rnew;
 }
 
+/**
+ * Feedback arrivals are detected by changes in the number of feedback
+ * records taken into account by the superclass, so that empty batches,
+ * or batches only containing duplicates, are not counted
+ */
+template <typename Params>
+bool NadaControllerT<Params>::trackFeedback(uint64_t nowUs) {
+    const uint64_t fbCount = getFeedbackCount();
+    if (m_params.adaptiveDelta && fbCount != m_fbCountSeen) {
+        if (m_lastFbArrivalValid) {
+            /* smooth the inter-arrival time (EWMA with weight 1/8) */
+            const uint64_t intervalUs = nowUs - m_lastFbArrivalUs;
+            m_fbIntervalUs = m_fbIntervalValid ? (7 * m_fbIntervalUs + intervalUs) / 8 : intervalUs;
+            m_fbIntervalValid = true;
+        }
+        m_lastFbArrivalUs = nowUs;
+        m_lastFbArrivalValid = true;
+    }
+    m_fbCountSeen = fbCount;
+    return fbCount != m_fbCountAtCalc;
+}
+
+template <typename Params>
+uint64_t NadaControllerT<Params>::getUpdateInterval() const {
+    if (!m_params.adaptiveDelta) {
+        return m_params.deltaUs;
+    }
+    uint64_t intervalUs = m_RttUs;
+    if (m_fbIntervalValid) {
+        intervalUs = std::max(intervalUs, m_fbIntervalUs);
+    }
+    intervalUs = std::max(intervalUs, m_params.deltaMinUs);
+    return std::min(intervalUs, m_params.deltaUs);
+}
+
 /**
  * This function determines whether the congestion control
  * algorithm should operate in the accelerated ramp up mode
@@ -508,27 +826,32 @@ void NadaController::calcAcceleratedRampUp( ) {
  *
  * o No recent packet losses within the observation window LOGWIN; and
  *
+ * o No recent ECN marks within the observation window LOGWIN (an
+ *   ECN-capable queue marks packets instead of dropping them); and
+ *
  * o No build-up of queuing delay: d_fwd-d_base < QEPS for all previous
  *   delay samples within the observation window LOGWIN.
  */
-int NadaController::getRampUpMode() {
+template <typename Params>
+int NadaControllerT<Params>::getRampUpMode() {
     int rmode = 0;
 
-    /* If losses are observed, stay with gradual update */
-    if (m_ploss > 0) rmode = 1;
-
-    /* check all raw queuing delay samples in
-     * packet history log */
-    for (auto rit = m_packetHistory.rbegin();
-              rit != m_packetHistory.rend() && rmode == 0;
-              ++rit) {
+    /* If losses or marks are observed, stay with gradual update */
+    if (m_ploss > 0 || m_pmark > 0) rmode = 1;
 
-        const uint64_t qDelayCurrentUs = rit->owdUs - m_baseDelayUs;
-        if (qDelayCurrentUs > NADA_PARAM_QEPS_US ) {
+    /* check the maximum raw queuing delay sample in
+     * packet history log, as obtained in the last
+     * metrics update */
+    if (rmode == 0 && m_QdelayMaxValid) {
+        if (m_QdelayMaxUs > m_params.qepsUs) {
             rmode = 1;  /* Gradual update if queuing delay exceeds threshold*/
         }
     }
     return rmode;
 }
 
+// Only these instantiations are compiled (see NadaControllerT )
+template class NadaControllerT<NadaDefaultParams>;
+template class NadaControllerT<NadaParams>;
+
 }
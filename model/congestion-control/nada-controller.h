@@ -29,9 +29,161 @@
 #define NADA_CONTROLLER_H
 
 #include "sender-based-controller.h"
+#include "delay-gradient-estimator.h"
+#include <iostream>
+#include <string>
 
 namespace rmcat {
 
+/**
+ * Default parameter values of the NADA algorithm,
+ * corresponding to Figure 3 in the rmcat-nada draft.
+ * They are compile-time constants, so a controller
+ * instantiated with them (see #NadaController ) is
+ * as efficient as if they were hard-coded
+ */
+struct NadaDefaultParams {
+    /* default parameters for core algorithm (gradual rate update) */
+
+    static constexpr float prio = 1.0f;  /**< Weight of priority of the flow  */
+    static constexpr float xref = 10.0f; /**< Reference congestion level (in ms) */
+
+    static constexpr float kappa = 0.5f; /**< Scaling parameter for gradual rate update calculation (dimensionless) */
+    static constexpr float eta = 2.0f;   /**< Scaling parameter for gradual rate update calculation (dimensionless) */
+    static constexpr float tau = 500.f;  /**< Upper bound of RTT (in ms) in gradual rate update calculation */
+
+    /**
+     * Target interval for receiving feedback from receiver
+     * or update rate calculation (in microseconds)
+     */
+    static constexpr uint64_t deltaUs = 100 * 1000;
+
+    /**
+     * Whether the interval between rate updates adapts to the feedback
+     * arrival rate and the RTT, between deltaMinUs and deltaUs. If not,
+     * it is deltaUs
+     */
+    static constexpr bool adaptiveDelta = false;
+    /** Lower bound of the adaptive update interval (in microseconds) */
+    static constexpr uint64_t deltaMinUs = 20 * 1000;
+
+    /* default parameters for accelerated ramp-up */
+
+    /**  Threshold (microseconds) for allowed queuing delay build up at receiver during accelerated ramp-up mode */
+    static constexpr uint64_t qepsUs = 10 * 1000;
+    static constexpr uint64_t dfiltUs = 120 * 1000; /**< Bound on filtering delay (in microseconds) */
+    /** Upper bound on rate increase ratio in accelerated ramp-up mode (dimensionless) */
+    static constexpr float gammaMax = 0.5f;
+    /** Upper bound on self-inflicted queuing delay during ramp up (in ms) */
+    static constexpr float qbound = 50.f;
+
+    /* default parameters for non-linear warping of queuing delay */
+
+    /** multiplier of observed average loss intervals, as a measure
+     * of tolerance of missing observed loss events (dimensionless)
+     */
+    static constexpr float multiloss = 7.f;
+
+    static constexpr float qth = 50.f;    /**< Queuing delay threshold for invoking non-linear warping (in ms) */
+    static constexpr float lambda = 0.5f; /**< Exponent of the non-linear warping (dimensionless) */
+
+    /* default parameters for calculating aggregated congestion signal */
+
+    /**
+     * Reference delay penalty (in ms) in terms of value
+     * of congestion price when packet loss ratio is at PLRREF
+     */
+    static constexpr float dloss = 10.f;
+    static constexpr float plrref = 0.01f; /**< Reference packet loss ratio (dimensionless) */
+    /**
+     * Reference delay penalty (in ms) in terms of value
+     * of congestion price when ECN marking ratio is at PMRREF
+     */
+    static constexpr float dmark = 2.f;
+    static constexpr float pmrref = 0.01f; /**< Reference packet marking ratio (dimensionless) */
+    static constexpr float xmax = 500.f;   /**< Maximum value of aggregate congestion signal (in ms) */
+
+    /**
+     * Delay penalty (in ms) per unit of one way delay gradient (see
+     * #DelayGradientEstimator ), added to the aggregate congestion signal,
+     * so that the rate reacts to a queue building up before the queuing
+     * delay itself is large. Not in rmcat-nada: zero disables it
+     */
+    static constexpr float dgrad = 0.f;
+    /** Whether the delay gradient is estimated with a Kalman filter, instead of a trendline */
+    static constexpr bool dgradKalman = false;
+
+    /** Smoothing factor in exponential smoothing of packet loss and marking ratios */
+    static constexpr float alpha = 0.1f;
+};
+
+/**
+ * Parameters of the NADA algorithm set at run time, e.g., to sweep their
+ * values in a single binary, or to give flows different priorities.
+ * See #NadaDefaultParams for their meaning; they are initialized to the
+ * defaults
+ */
+struct NadaParams {
+    /** Class constructor: all parameters take their default values */
+    NadaParams();
+
+    /**
+     * Set a parameter by name. Names are those of the members,
+     * e.g., "prio" or "deltaUs"
+     *
+     * @param [in] name Name of the parameter
+     * @param [in] value New value of the parameter
+     * @retval False if there is no parameter with that name, or if the
+     *         value is out of the parameter's range (e.g., negative, or
+     *         zero for a divisor such as tau or plrref). The parameter
+     *         is then left unchanged
+     */
+    bool set(const std::string& name, double value);
+
+    /**
+     * Read parameters from a configuration stream. Each line contains
+     * a parameter name and its value, optionally preceded by a flow id,
+     * in which case the parameter is only set if the id matches the
+     * one passed. Blank lines and lines starting with '#' are ignored.
+     * For instance:
+     *
+     *     # all flows
+     *     kappa 0.4
+     *     # one flow gets twice the weight of the others
+     *     rmcat_fixfps_fwd_1 prio 2
+     *
+     * @param [in,out] is Input stream
+     * @param [in] id Id of the flow whose parameters are being read
+     * @retval False if a line is malformed, names an unknown parameter,
+     *         or sets a parameter out of its range (see #set )
+     */
+    bool load(std::istream& is, const std::string& id="");
+
+    float prio;
+    float xref;
+    float kappa;
+    float eta;
+    float tau;
+    uint64_t deltaUs;
+    bool adaptiveDelta;
+    uint64_t deltaMinUs;
+    uint64_t qepsUs;
+    uint64_t dfiltUs;
+    float gammaMax;
+    float qbound;
+    float multiloss;
+    float qth;
+    float lambda;
+    float dloss;
+    float plrref;
+    float dmark;
+    float pmrref;
+    float xmax;
+    float dgrad;
+    bool dgradKalman;
+    float alpha;
+};
+
 /**
  * This class corresponds to the congestion control scheme
  * named Network-Assisted Dynamic Adaptation (NADA). Details
@@ -41,14 +193,34 @@ namespace rmcat {
  * NADA: A Unified Congestion Control Scheme for Real-Time Media
  * https://tools.ietf.org/html/draft-ietf-rmcat-nada-04
  *
+ * The algorithm's parameters are provided by the Params type, which has
+ * the members of #NadaDefaultParams , either as compile-time constants
+ * (#NadaController ) or as run-time values (#ConfigurableNadaController ).
+ * Only these two instantiations are compiled
  */
-class NadaController: public SenderBasedController {
+template <typename Params>
+class NadaControllerT: public SenderBasedController {
 public:
-    /* class constructor */
-    NadaController();
+    /**
+     * Class constructor
+     *
+     * @param [in] params Parameters of the algorithm
+     */
+    explicit NadaControllerT(const Params& params=Params{});
 
     /* class destructor */
-    virtual ~NadaController();
+    virtual ~NadaControllerT();
+
+    /**
+     * Set the parameters of the algorithm. They are kept upon #reset .
+     * The delay gradient estimation restarts if its method changes
+     *
+     * @param [in] params New parameters
+     */
+    void setParams(const Params& params);
+
+    /** @retval The parameters of the algorithm */
+    const Params& getParams() const;
 
     /**
      * Set the current bandwidth estimation. This can be useful in test environments
@@ -82,6 +254,16 @@ public:
     /** NADA's realization of the #getBandwidth API */
     virtual float getBandwidth(uint64_t nowUs) const;
 
+protected:
+    /**
+     * Append NADA's state (reference rate, congestion signal, metrics) to
+     * a snapshot. The delay gradient estimation, if any, restarts from
+     * scratch when the snapshot is loaded
+     */
+    virtual void saveStateFields(std::ostream& os, uint64_t nowUs) const;
+    /** Read NADA's state from a snapshot */
+    virtual bool loadStateFields(std::istream& is, uint64_t nowUs);
+
 private:
 
     /**
@@ -89,8 +271,10 @@ private:
      * (by the base class SenderBasedController) of
      * delay, loss, and receiving rate metrics and
      * copying them to local member variables
+     *
+     * @param [in] nowUs current timestamp in microseconds
      */
-    void updateMetrics();
+    void updateMetrics(uint64_t nowUs);
 
     /**
      * Function for printing losses, delay, and rate
@@ -134,6 +318,27 @@ private:
      */
     void calcAcceleratedRampUp();
 
+    /**
+     * Function for checking whether new feedback has arrived since the
+     * last rate update, and, if so, for tracking the feedback's
+     * inter-arrival time
+     *
+     * @param [in] nowUs current timestamp in microseconds
+     * @retval True if new feedback has arrived since the last rate update
+     */
+    bool trackFeedback(uint64_t nowUs);
+
+    /**
+     * Function for calculating the target interval between rate updates.
+     * If the interval is adaptive, it is the longer of the feedback's
+     * inter-arrival time and the RTT: updating more often than feedback
+     * arrives is wasted work, and the effect of a rate change cannot be
+     * observed before one RTT. It is bounded by deltaMinUs and deltaUs
+     *
+     * @retval target interval between rate updates, in microseconds
+     */
+    uint64_t getUpdateInterval() const;
+
     /**
      * Function for determining wether the sender should
      * operate in accelerated ramp-up mode or gradual
@@ -165,6 +370,15 @@ private:
      */
     float calcDtilde() const;
 
+    /**
+     * Feed the delay gradient estimator with the packets acknowledged since
+     * the last call, i.e., those newer than #m_gradLastSeq in the history
+     */
+    void updateGradient();
+
+    /** @retval The delay gradient estimation method set in the parameters */
+    DelayGradientEstimator::Mode getGradientMode() const;
+
     /**
      * Following are local member variables recording current
      * packet loss/delay information, as well as operational
@@ -172,6 +386,8 @@ private:
      */
     uint32_t m_ploss; /**< packet loss count within configured window */
     float m_plr;     /**< packet loss ratio within packet history window */
+    uint32_t m_pmark; /**< ECN-marked packet count within configured window */
+    float m_pmr;     /**< ECN marking ratio within packet history window */
     bool m_warpMode;  /**< whether to perform non-linear warping of queuing delay */
 
     /** timestamp of when r_ref is last calculated (t_last in rmcat-nada), in microseconds  */
@@ -183,14 +399,38 @@ private:
 
     uint64_t m_QdelayUs; /**< estimated queuing delay in microseconds */
     uint64_t m_RttUs; /**< estimated RTT value in microseconds */
+    uint64_t m_QdelayMaxUs; /**< maximum queuing delay within packet history, in microseconds */
+    bool m_QdelayMaxValid; /**< whether m_QdelayMaxUs is valid: packet history not empty at last update */
     float m_Xcurr;  /**< aggregated congestion signal (x_curr in rmcat-nada) in ms */
     float m_Xprev;  /**< previous value of the aggregated congestion signal (x_prev in rmcat-nada), in ms */
     float m_RecvR;  /**< updated receiving rate in bps */
     float m_avgInt; /**< Average inter-loss interval in packets, according to RFC 5348 */
     uint32_t m_currInt; /**< Most recent (currently growing) inter-loss interval in packets; called I_0 in RFC 5348 */
     bool m_lossesSeen; /**< Whether packet losses/reorderings have been detected so far */
+
+    uint64_t m_fbCountAtCalc;   /**< feedback count (see #getFeedbackCount ) at the last rate update */
+    uint64_t m_fbCountSeen;     /**< feedback count when feedback last arrived */
+    uint64_t m_lastFbArrivalUs; /**< time when feedback last arrived, in microseconds */
+    bool m_lastFbArrivalValid;  /**< whether m_lastFbArrivalUs is valid */
+    bool m_fbIntervalValid;     /**< whether m_fbIntervalUs is valid: feedback arrived twice */
+    uint64_t m_fbIntervalUs;    /**< smoothed inter-arrival time of the feedback, in microseconds */
+
+    /* Delay gradient term of the congestion signal (if dgrad is not zero) */
+    DelayGradientEstimator m_gradEstimator;
+    uint64_t m_gradLastSeq;     /**< extended sequence of the newest packet fed to m_gradEstimator */
+    bool m_gradLastSeqValid;    /**< whether m_gradLastSeq is valid */
+
+    Params m_params; /**< parameters of the algorithm */
 };
 
+extern template class NadaControllerT<NadaDefaultParams>;
+extern template class NadaControllerT<NadaParams>;
+
+/** NADA with the default parameters of the rmcat-nada draft */
+typedef NadaControllerT<NadaDefaultParams> NadaController;
+/** NADA with parameters set at run time (see #NadaParams ) */
+typedef NadaControllerT<NadaParams> ConfigurableNadaController;
+
 }
 
 #endif /* NADA_CONTROLLER_H */
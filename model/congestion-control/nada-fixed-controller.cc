@@ -0,0 +1,520 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Fixed-point NADA controller implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "nada-fixed-controller.h"
+#include "stats-sink.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <sstream>
+
+namespace rmcat {
+
+const int64_t FIX_SHIFT = 16;
+const int64_t FIX_ONE = int64_t(1) << FIX_SHIFT; /**< 1.0 in Q16 */
+
+/**
+ * exp(-k/32) in Q16, for k = 0..256: the exponent of the non-linear
+ * warping is looked up in steps of 1/32, and interpolated linearly in
+ * between (relative error below 0.05%). Beyond 8, the last value is used
+ */
+const int64_t EXP_LUT_STEP_SHIFT = 11; /**< step of 1/32, in Q16 */
+const size_t EXP_LUT_SIZE = 257;
+static const int64_t EXP_LUT[EXP_LUT_SIZE] = {
+    65536, 63520, 61565, 59671, 57835, 56056, 54331, 52660,
+    51039, 49469, 47947, 46472, 45042, 43656, 42313, 41011,
+    39750, 38527, 37341, 36192, 35079, 34000, 32954, 31940,
+    30957, 30005, 29081, 28187, 27319, 26479, 25664, 24875,
+    24109, 23368, 22649, 21952, 21276, 20622, 19987, 19372,
+    18776, 18199, 17639, 17096, 16570, 16060, 15566, 15087,
+    14623, 14173, 13737, 13314, 12905, 12508, 12123, 11750,
+    11388, 11038, 10698, 10369, 10050,  9741,  9441,  9151,
+     8869,  8596,  8332,  8076,  7827,  7586,  7353,  7127,
+     6907,  6695,  6489,  6289,  6096,  5908,  5726,  5550,
+     5380,  5214,  5054,  4898,  4747,  4601,  4460,  4323,
+     4190,  4061,  3936,  3815,  3697,  3584,  3473,  3366,
+     3263,  3162,  3065,  2971,  2879,  2791,  2705,  2622,
+     2541,  2463,  2387,  2314,  2243,  2174,  2107,  2042,
+     1979,  1918,  1859,  1802,  1746,  1693,  1641,  1590,
+     1541,  1494,  1448,  1403,  1360,  1318,  1278,  1238,
+     1200,  1163,  1128,  1093,  1059,  1027,   995,   964,
+      935,   906,   878,   851,   825,   800,   775,   751,
+      728,   706,   684,   663,   642,   623,   604,   585,
+      567,   550,   533,   516,   500,   485,   470,   456,
+      442,   428,   415,   402,   390,   378,   366,   355,
+      344,   333,   323,   313,   303,   294,   285,   276,
+      268,   260,   252,   244,   236,   229,   222,   215,
+      209,   202,   196,   190,   184,   178,   173,   168,
+      162,   157,   153,   148,   143,   139,   135,   131,
+      127,   123,   119,   115,   112,   108,   105,   102,
+       99,    95,    93,    90,    87,    84,    82,    79,
+       77,    74,    72,    70,    68,    66,    64,    62,
+       60,    58,    56,    54,    53,    51,    50,    48,
+       47,    45,    44,    42,    41,    40,    39,    37,
+       36,    35,    34,    33,    32,    31,    30,    29,
+       28,    27,    27,    26,    25,    24,    23,    23,
+       22,
+};
+
+/* Conversion of a parameter, or a metric, to an integer in the given scale */
+static int64_t toFixed(double value, double scale) {
+    return int64_t(std::llround(value * scale));
+}
+
+NadaFixedController::FixedParams::FixedParams(const NadaParams& params) :
+    prioXrefUs{toFixed(double(params.prio) * params.xref, 1e3)},
+    kappaQ16{toFixed(params.kappa, FIX_ONE)},
+    kappaEtaQ16{toFixed(double(params.kappa) * params.eta, FIX_ONE)},
+    tauUs{toFixed(params.tau, 1e3)},
+    deltaUs{params.deltaUs},
+    qepsUs{params.qepsUs},
+    dfiltUs{params.dfiltUs},
+    gammaMaxQ16{toFixed(params.gammaMax, FIX_ONE)},
+    qboundQ16{toFixed(params.qbound, FIX_ONE)},
+    multilossQ8{toFixed(params.multiloss, 256.)},
+    qthUs{toFixed(params.qth, 1e3)},
+    lambdaQ16{toFixed(params.lambda, FIX_ONE)},
+    dlossUs{toFixed(params.dloss, 1e3)},
+    plrrefPpb{toFixed(params.plrref, 1e9)},
+    dmarkUs{toFixed(params.dmark, 1e3)},
+    pmrrefPpb{toFixed(params.pmrref, 1e9)},
+    xmaxUs{toFixed(params.xmax, 1e3)},
+    alphaQ16{toFixed(params.alpha, FIX_ONE)} {
+    assert(tauUs > 0 && qthUs > 0 && plrrefPpb > 0 && pmrrefPpb > 0);
+}
+
+NadaFixedController::NadaFixedController(const NadaParams& params) :
+    SenderBasedController{},
+    m_fixedParams{params},
+    m_ploss{0},
+    m_plrPpb{0},
+    m_pmark{0},
+    m_pmrPpb{0},
+    m_warpMode{false},
+    m_lastTimeCalcUs{0},
+    m_lastTimeCalcValid{false},
+    m_currBps{int64_t(m_initBw)},
+    m_QdelayUs{0},
+    m_RttUs{0},
+    m_QdelayMaxUs{0},
+    m_QdelayMaxValid{false},
+    m_XcurrUs{0},
+    m_XprevUs{0},
+    m_RecvBps{0},
+    m_avgIntQ8{0},
+    m_currInt{0},
+    m_lossesSeen{false},
+    m_fbCountAtCalc{0},
+    m_params(params),
+    m_shadow{},
+    m_tolerance{0.f},
+    m_divergence{} {
+    /* Not supported: see the class documentation */
+    assert(!params.adaptiveDelta);
+    assert(params.dgrad == 0.f);
+}
+
+NadaFixedController::~NadaFixedController() {}
+
+void NadaFixedController::setValidation(bool enable, float tolerance) {
+    m_shadow.reset();
+    m_tolerance = tolerance;
+    m_divergence = Divergence{};
+    if (enable) {
+        m_shadow.reset(new ConfigurableNadaController{m_params});
+        /* The floating-point controller does not log */
+        m_shadow->setStatsSink(std::make_shared<NullStatsSink>());
+        m_shadow->setInitBw(m_initBw);
+        m_shadow->setMinBw(m_minBw);
+        m_shadow->setMaxBw(m_maxBw);
+        m_shadow->setCurrentBw(float(m_currBps));
+    }
+}
+
+const NadaFixedController::Divergence& NadaFixedController::getDivergence() const {
+    return m_divergence;
+}
+
+void NadaFixedController::setInitBw(float initBw) {
+    SenderBasedController::setInitBw(initBw);
+    if (m_shadow) m_shadow->setInitBw(initBw);
+}
+
+void NadaFixedController::setMinBw(float minBw) {
+    SenderBasedController::setMinBw(minBw);
+    if (m_shadow) m_shadow->setMinBw(minBw);
+}
+
+void NadaFixedController::setMaxBw(float maxBw) {
+    SenderBasedController::setMaxBw(maxBw);
+    if (m_shadow) m_shadow->setMaxBw(maxBw);
+}
+
+void NadaFixedController::setCurrentBw(float newBw) {
+    m_currBps = int64_t(newBw);
+    if (m_shadow) m_shadow->setCurrentBw(newBw);
+}
+
+void NadaFixedController::reset() {
+    m_ploss = 0;
+    m_plrPpb = 0;
+    m_pmark = 0;
+    m_pmrPpb = 0;
+    m_warpMode = false;
+    m_lastTimeCalcUs = 0;
+    m_lastTimeCalcValid = false;
+    m_currBps = int64_t(m_initBw);
+    m_QdelayUs = 0;
+    m_RttUs = 0;
+    m_QdelayMaxUs = 0;
+    m_QdelayMaxValid = false;
+    m_XcurrUs = 0;
+    m_XprevUs = 0;
+    m_RecvBps = 0;
+    m_avgIntQ8 = 0;
+    m_currInt = 0;
+    m_lossesSeen = false;
+    m_fbCountAtCalc = 0;
+    SenderBasedController::reset();
+    if (m_shadow) {
+        // The superclass restores the default rates
+        m_shadow->reset();
+        m_shadow->setStatsSink(std::make_shared<NullStatsSink>());
+        m_shadow->setInitBw(m_initBw);
+        m_shadow->setMinBw(m_minBw);
+        m_shadow->setMaxBw(m_maxBw);
+        m_shadow->setCurrentBw(float(m_currBps));
+    }
+}
+
+bool NadaFixedController::processSendPacket(uint64_t txTimestampUs,
+                                            uint16_t sequence,
+                                            uint32_t size) { // in Bytes
+    if (m_shadow) m_shadow->processSendPacket(txTimestampUs, sequence, size);
+    if (!SenderBasedController::processSendPacket(txTimestampUs, sequence, size)) {
+        return false;
+    }
+    /* See NadaController::processSendPacket */
+    if (!m_lastTimeCalcValid) {
+        m_lastTimeCalcUs = txTimestampUs;
+        m_lastTimeCalcValid = true;
+    }
+    return true;
+}
+
+bool NadaFixedController::processFeedback(uint64_t nowUs,
+                                          uint16_t sequence,
+                                          uint64_t rxTimestampUs,
+                                          uint8_t ecn) {
+    if (m_shadow) m_shadow->processFeedback(nowUs, sequence, rxTimestampUs, ecn);
+    if (!SenderBasedController::processFeedback(nowUs,
+                                                sequence,
+                                                rxTimestampUs,
+                                                ecn)) {
+        return false;
+    }
+    if (!m_lastTimeCalcValid) {
+        m_lastTimeCalcUs = nowUs;
+        m_lastTimeCalcValid = true;
+        return true;
+    }
+    /* Nothing new to react to: skip the update altogether */
+    if (getFeedbackCount() == m_fbCountAtCalc) {
+        return true;
+    }
+
+    assert(lessThan(m_lastTimeCalcUs, nowUs + 1));
+    const uint64_t deltaUs = nowUs - m_lastTimeCalcUs; // subtraction will wrap correctly
+    if (deltaUs >= m_fixedParams.deltaUs) {
+        updateMetrics(nowUs);
+        updateBw(deltaUs);
+        logStats(nowUs, deltaUs);
+        validate(nowUs);
+
+        m_lastTimeCalcUs = nowUs;
+        m_fbCountAtCalc = getFeedbackCount();
+    }
+    return true;
+}
+
+bool NadaFixedController::processFeedbackBatch(uint64_t nowUs,
+                                               const std::vector<FeedbackItem>& feedbackBatch) {
+    if (m_shadow) m_shadow->processFeedbackBatch(nowUs, feedbackBatch);
+    if (!SenderBasedController::processFeedbackBatch(nowUs, feedbackBatch)) {
+        return false;
+    }
+    if (!m_lastTimeCalcValid) {
+        m_lastTimeCalcUs = nowUs;
+        m_lastTimeCalcValid = true;
+        return true;
+    }
+    /* Nothing new to react to: skip the update altogether */
+    if (getFeedbackCount() == m_fbCountAtCalc) {
+        return true;
+    }
+
+    assert(lessThan(m_lastTimeCalcUs, nowUs + 1));
+    const uint64_t deltaUs = nowUs - m_lastTimeCalcUs; // subtraction will wrap correctly
+    /* 50% leniency, see NadaController::processFeedbackBatch */
+    if (deltaUs < m_fixedParams.deltaUs / 2) {
+        return true;
+    }
+    updateMetrics(nowUs);
+    updateBw(deltaUs);
+    logStats(nowUs, deltaUs);
+    validate(nowUs);
+
+    m_lastTimeCalcUs = nowUs;
+    m_fbCountAtCalc = getFeedbackCount();
+    return true;
+}
+
+float NadaFixedController::getBandwidth(uint64_t nowUs) const {
+    return float(m_currBps);
+}
+
+void NadaFixedController::saveStateFields(std::ostream& os, uint64_t nowUs) const {
+    SenderBasedController::saveStateFields(os, nowUs);
+    os << "nadafixed " << m_lastTimeCalcValid << ' ' << (nowUs - m_lastTimeCalcUs)
+       << ' ' << m_currBps << ' ' << m_XcurrUs << ' ' << m_XprevUs
+       << ' ' << m_ploss << ' ' << m_plrPpb << ' ' << m_pmark << ' ' << m_pmrPpb
+       << ' ' << m_QdelayUs << ' ' << m_RttUs
+       << ' ' << m_QdelayMaxValid << ' ' << m_QdelayMaxUs
+       << ' ' << m_RecvBps << ' ' << m_avgIntQ8 << ' ' << m_currInt
+       << ' ' << m_lossesSeen << ' ' << m_warpMode << '\n';
+}
+
+bool NadaFixedController::loadStateFields(std::istream& is, uint64_t nowUs) {
+    if (m_shadow) {
+        logMessage("NadaFixedController::loadStateFields, validation mode disabled");
+        setValidation(false);
+    }
+    if (!SenderBasedController::loadStateFields(is, nowUs)) {
+        return false;
+    }
+    uint64_t lastCalcAgeUs = 0;
+    if (!readStateTag(is, "nadafixed") ||
+        !(is >> m_lastTimeCalcValid >> lastCalcAgeUs
+             >> m_currBps >> m_XcurrUs >> m_XprevUs
+             >> m_ploss >> m_plrPpb >> m_pmark >> m_pmrPpb
+             >> m_QdelayUs >> m_RttUs
+             >> m_QdelayMaxValid >> m_QdelayMaxUs
+             >> m_RecvBps >> m_avgIntQ8 >> m_currInt
+             >> m_lossesSeen >> m_warpMode)) {
+        return false;
+    }
+    m_lastTimeCalcUs = nowUs - lastCalcAgeUs;
+    m_fbCountAtCalc = getFeedbackCount();
+    return true;
+}
+
+void NadaFixedController::updateBw(uint64_t deltaUs) {
+    if (getRampUpMode() == 0) {
+        calcAcceleratedRampUp();
+    } else {
+        calcGradualRateUpdate(deltaUs);
+    }
+
+    /* clip final rate within range */
+    m_currBps = std::min(m_currBps, int64_t(m_maxBw));
+    m_currBps = std::max(m_currBps, int64_t(m_minBw));
+}
+
+/*
+ * The floating-point metrics are converted here, each with a single
+ * rounding; from then on, all arithmetic is integer
+ */
+void NadaFixedController::updateMetrics(uint64_t nowUs) {
+    const FixedParams& fp = m_fixedParams;
+    MetricsSnapshot metrics;
+    computeMetrics(nowUs, metrics);
+
+    if (metrics.qdelayValid) m_QdelayUs = metrics.qdelayUs;
+    if (metrics.rttValid) m_RttUs = metrics.rttUs;
+    if (metrics.rrateValid) m_RecvBps = toFixed(metrics.rrateBps, 1.);
+
+    if (metrics.lossValid) {
+        m_ploss = metrics.nLoss;
+        m_plrPpb += (toFixed(metrics.plr, 1e9) - m_plrPpb) * fp.alphaQ16 / FIX_ONE;
+    }
+
+    if (metrics.markValid) {
+        m_pmark = metrics.nMarked;
+        m_pmrPpb += (toFixed(metrics.pmr, 1e9) - m_pmrPpb) * fp.alphaQ16 / FIX_ONE;
+    }
+
+    m_lossesSeen = metrics.lossIntervalValid;
+    if (metrics.lossIntervalValid) {
+        m_avgIntQ8 = toFixed(metrics.avgInterval, 256.);
+        m_currInt = metrics.currentInterval;
+    }
+
+    m_QdelayMaxValid = metrics.qdelayMaxValid;
+    if (metrics.qdelayMaxValid) m_QdelayMaxUs = metrics.qdelayMaxUs;
+
+    m_XprevUs = m_XcurrUs;
+    if (metrics.qdelayValid) updateXcurr();
+}
+
+void NadaFixedController::logStats(uint64_t nowUs, uint64_t deltaUs) const {
+    StatsRecord record = StatsRecord{};
+    record.timestampUs = nowUs;
+    record.deltaUs = deltaUs;
+    record.loglen = m_packetHistory.size();
+    record.qdelayUs = m_QdelayUs;
+    record.rttUs = m_RttUs;
+    record.ploss = m_ploss;
+    record.plr = float(m_plrPpb) / 1e9f;
+    record.pmr = float(m_pmrPpb) / 1e9f;
+    record.xcurr = float(m_XcurrUs) / 1000.f;
+    record.rrateBps = float(m_RecvBps);
+    record.srateBps = float(m_currBps);
+    record.avgInt = float(m_avgIntQ8) / 256.f;
+    record.currInt = m_currInt;
+    reportStats("nada", record);
+}
+
+void NadaFixedController::validate(uint64_t nowUs) {
+    if (!m_shadow) {
+        return;
+    }
+    const float fixedBw = float(m_currBps);
+    const float floatBw = m_shadow->getBandwidth(nowUs);
+    const float relDiff = std::fabs(fixedBw - floatBw) / std::max(floatBw, 1.f);
+    ++m_divergence.updates;
+    m_divergence.maxRelDiff = std::max(m_divergence.maxRelDiff, relDiff);
+    if (relDiff > m_tolerance) {
+        ++m_divergence.divergent;
+        std::ostringstream os;
+        os << "NadaFixedController::validate, rates diverge at " << nowUs
+           << " us: fixed-point " << fixedBw << " bps, floating-point " << floatBw << " bps";
+        logMessage(os.str());
+    }
+}
+
+/* See NadaController::calcDtilde */
+int64_t NadaFixedController::calcDtilde() const {
+    const FixedParams& fp = m_fixedParams;
+    const int64_t qdelayUs = int64_t(m_QdelayUs);
+    // Same threshold as the floating-point version: whole milliseconds
+    if (qdelayUs / 1000 * 1000 <= fp.qthUs) {
+        return qdelayUs;
+    }
+
+    const int64_t ratioQ16 = (qdelayUs - fp.qthUs) * fp.lambdaQ16 / fp.qthUs;
+    const int64_t index = ratioQ16 >> EXP_LUT_STEP_SHIFT;
+    if (index >= int64_t(EXP_LUT_SIZE) - 1) {
+        return fp.qthUs * EXP_LUT[EXP_LUT_SIZE - 1] / FIX_ONE;
+    }
+    const int64_t frac = ratioQ16 & ((int64_t(1) << EXP_LUT_STEP_SHIFT) - 1);
+    const int64_t expQ16 = EXP_LUT[index] -
+                           (((EXP_LUT[index] - EXP_LUT[index + 1]) * frac) >> EXP_LUT_STEP_SHIFT);
+    return fp.qthUs * expQ16 / FIX_ONE;
+}
+
+/* See NadaController::updateXcurr */
+void NadaFixedController::updateXcurr() {
+    const FixedParams& fp = m_fixedParams;
+    const int64_t xdel = int64_t(m_QdelayUs);
+    const int64_t xtilde = calcDtilde();
+    const int64_t currIntQ8 = int64_t(m_currInt) << 8;
+    const int64_t warpIntQ8 = fp.multilossQ8 * m_avgIntQ8 / 256; // multiloss * avgInt
+
+    if (m_lossesSeen && currIntQ8 < warpIntQ8) {
+        m_XcurrUs = xtilde;
+        m_warpMode = true;
+    } else if (m_lossesSeen) {
+        if (currIntQ8 < warpIntQ8 + m_avgIntQ8) {
+            /* transition period: linearly blending warped and non-warped values */
+            const int64_t alphaQ16 = (currIntQ8 - warpIntQ8) * FIX_ONE / m_avgIntQ8;
+            m_XcurrUs = (alphaQ16 * xdel + (FIX_ONE - alphaQ16) * xtilde) / FIX_ONE;
+        } else {
+            m_XcurrUs = xdel;
+            m_warpMode = false;
+        }
+    } else {
+        m_XcurrUs = xdel;
+        m_warpMode = false;
+    }
+
+    /* marking and loss penalties: d * (ratio / ratio_ref)^2 */
+    const int64_t pmrQ16 = m_pmrPpb * FIX_ONE / fp.pmrrefPpb;
+    m_XcurrUs += fp.dmarkUs * pmrQ16 / FIX_ONE * pmrQ16 / FIX_ONE;
+    const int64_t plrQ16 = m_plrPpb * FIX_ONE / fp.plrrefPpb;
+    m_XcurrUs += fp.dlossUs * plrQ16 / FIX_ONE * plrQ16 / FIX_ONE;
+
+    if (m_XcurrUs > fp.xmaxUs) {
+        m_XcurrUs = fp.xmaxUs;
+    }
+}
+
+/*
+ * See NadaController::calcGradualRateUpdate . The products are divided
+ * as they go, so that they fit in 64 bits for rates up to tens of Gbps
+ */
+void NadaFixedController::calcGradualRateUpdate(uint64_t deltaUs) {
+    const FixedParams& fp = m_fixedParams;
+    const int64_t currBps = std::max(m_currBps, int64_t(1));
+
+    const int64_t xOffsetUs = m_XcurrUs - fp.prioXrefUs * int64_t(m_maxBw) / currBps;
+    const int64_t xDiffUs = m_XcurrUs - m_XprevUs;
+
+    int64_t rOffset = currBps * int64_t(deltaUs) / fp.tauUs;
+    rOffset = rOffset * xOffsetUs / fp.tauUs;
+    rOffset = rOffset * fp.kappaQ16 / FIX_ONE;
+
+    int64_t rDiff = currBps * xDiffUs / fp.tauUs;
+    rDiff = rDiff * fp.kappaEtaQ16 / FIX_ONE;
+
+    m_currBps = currBps - rOffset - rDiff;
+}
+
+/* See NadaController::calcAcceleratedRampUp */
+void NadaFixedController::calcAcceleratedRampUp() {
+    const FixedParams& fp = m_fixedParams;
+    const uint64_t denomMs = (m_RttUs + fp.deltaUs + fp.dfiltUs) / 1000;
+    int64_t gammaQ16 = fp.gammaMaxQ16;
+    if (denomMs > 0) {
+        gammaQ16 = std::min(fp.qboundQ16 / int64_t(denomMs), fp.gammaMaxQ16);
+    }
+
+    const int64_t rnew = m_RecvBps * (FIX_ONE + gammaQ16) / FIX_ONE;
+    m_currBps = std::max(m_currBps, rnew);
+}
+
+/* See NadaController::getRampUpMode */
+int NadaFixedController::getRampUpMode() const {
+    if (m_ploss > 0 || m_pmark > 0) {
+        return 1;
+    }
+    if (m_QdelayMaxValid && m_QdelayMaxUs > m_fixedParams.qepsUs) {
+        return 1;
+    }
+    return 0;
+}
+
+}
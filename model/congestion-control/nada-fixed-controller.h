@@ -0,0 +1,188 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Fixed-point NADA controller interface for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef NADA_FIXED_CONTROLLER_H
+#define NADA_FIXED_CONTROLLER_H
+
+#include "nada-controller.h"
+#include <memory>
+
+namespace rmcat {
+
+/**
+ * NADA (see #NadaController ) with the rate update done in integer
+ * arithmetic: rates in bps, delays and the congestion signal in
+ * microseconds, ratios in fixed point. The non-linear warping of the
+ * queuing delay uses a lookup table of the exponential, instead of exp().
+ * Hence, the rates calculated are the same, bit by bit, whatever the
+ * compiler, its flags, or the platform's floating-point unit (if any).
+ *
+ * The metrics are still calculated by the superclass; they are converted
+ * to integers once per rate update, with basic (hence reproducible)
+ * floating-point operations. The parameters, set at construction, are
+ * converted too. The update interval is always deltaUs: adaptiveDelta is
+ * not supported, nor is the delay gradient term (dgrad).
+ *
+ * In validation mode (see #setValidation ), the controller also runs a
+ * #ConfigurableNadaController with the same parameters, packets and
+ * feedback, and compares both rates after every update. The rate returned
+ * is always the fixed-point one.
+ */
+class NadaFixedController: public SenderBasedController {
+public:
+    /** Divergence between both implementations, in validation mode */
+    struct Divergence {
+        uint64_t updates;    /**< Rate updates compared */
+        uint64_t divergent;  /**< Updates whose rates differ more than the tolerance */
+        float maxRelDiff;    /**< Maximum relative difference between the rates */
+    };
+
+    /**
+     * Class constructor
+     *
+     * @param [in] params Parameters of the algorithm. adaptiveDelta and
+     *                    dgrad must keep their defaults (disabled)
+     */
+    explicit NadaFixedController(const NadaParams& params=NadaParams{});
+
+    /* class destructor */
+    virtual ~NadaFixedController();
+
+    /**
+     * Enable or disable the validation mode. Enabling it (re)starts the
+     * floating-point controller: it should be done before the first packet
+     * is sent. Divergent updates are logged
+     *
+     * @param [in] enable Whether to run both implementations
+     * @param [in] tolerance Relative difference between the rates above
+     *                       which an update is divergent
+     */
+    void setValidation(bool enable, float tolerance=0.01f);
+
+    /** @retval The divergence observed so far in validation mode */
+    const Divergence& getDivergence() const;
+
+    virtual void setInitBw(float initBw);
+    virtual void setMinBw(float minBw);
+    virtual void setMaxBw(float maxBw);
+    virtual void setCurrentBw(float newBw);
+
+    virtual void reset();
+
+    virtual bool processSendPacket(uint64_t txTimestampUs,
+                                   uint16_t sequence,
+                                   uint32_t size); // in Bytes
+
+    virtual bool processFeedback(uint64_t nowUs,
+                                 uint16_t sequence,
+                                 uint64_t rxTimestampUs,
+                                 uint8_t ecn=0);
+
+    virtual bool processFeedbackBatch(uint64_t nowUs,
+                                      const std::vector<FeedbackItem>& feedbackBatch);
+
+    virtual float getBandwidth(uint64_t nowUs) const;
+
+protected:
+    /**
+     * Append NADA's integer state to a snapshot. Loading a snapshot
+     * disables the validation mode: the floating-point controller's
+     * state is not part of it
+     */
+    virtual void saveStateFields(std::ostream& os, uint64_t nowUs) const;
+    virtual bool loadStateFields(std::istream& is, uint64_t nowUs);
+
+private:
+    /** Parameters of #NadaParams , converted to the units used here */
+    struct FixedParams {
+        explicit FixedParams(const NadaParams& params);
+        int64_t prioXrefUs;    /**< prio * xref */
+        int64_t kappaQ16;
+        int64_t kappaEtaQ16;   /**< kappa * eta */
+        int64_t tauUs;
+        uint64_t deltaUs;
+        uint64_t qepsUs;
+        uint64_t dfiltUs;
+        int64_t gammaMaxQ16;
+        int64_t qboundQ16;     /**< qbound in ms, in Q16 */
+        int64_t multilossQ8;
+        int64_t qthUs;
+        int64_t lambdaQ16;
+        int64_t dlossUs;
+        int64_t plrrefPpb;     /**< in parts per billion */
+        int64_t dmarkUs;
+        int64_t pmrrefPpb;
+        int64_t xmaxUs;
+        int64_t alphaQ16;
+    };
+
+    /** Copy the metrics calculated by the superclass, converted to integers */
+    void updateMetrics(uint64_t nowUs);
+    void logStats(uint64_t nowUs, uint64_t deltaUs) const;
+    /** See NadaController::updateBw */
+    void updateBw(uint64_t deltaUs);
+    void calcGradualRateUpdate(uint64_t deltaUs);
+    void calcAcceleratedRampUp();
+    int getRampUpMode() const;
+    void updateXcurr();
+    /** Warped queuing delay (d_tilde in rmcat-nada), in microseconds */
+    int64_t calcDtilde() const;
+    /** Compare the rates of both implementations, in validation mode */
+    void validate(uint64_t nowUs);
+
+    const FixedParams m_fixedParams;
+
+    uint32_t m_ploss;
+    int64_t m_plrPpb;      /**< filtered packet loss ratio, in parts per billion */
+    uint32_t m_pmark;
+    int64_t m_pmrPpb;      /**< filtered ECN marking ratio, in parts per billion */
+    bool m_warpMode;
+    uint64_t m_lastTimeCalcUs;
+    bool m_lastTimeCalcValid;
+    int64_t m_currBps;     /**< reference rate (r_ref in rmcat-nada) */
+    uint64_t m_QdelayUs;
+    uint64_t m_RttUs;
+    uint64_t m_QdelayMaxUs;
+    bool m_QdelayMaxValid;
+    int64_t m_XcurrUs;     /**< aggregated congestion signal (x_curr in rmcat-nada) */
+    int64_t m_XprevUs;
+    int64_t m_RecvBps;
+    int64_t m_avgIntQ8;    /**< average inter-loss interval in packets, in Q8 */
+    uint32_t m_currInt;
+    bool m_lossesSeen;
+    uint64_t m_fbCountAtCalc; /**< feedback count (see #getFeedbackCount ) at the last rate update */
+
+    /* Validation mode */
+    const NadaParams m_params;
+    std::unique_ptr<ConfigurableNadaController> m_shadow; /**< floating-point controller */
+    float m_tolerance;
+    Divergence m_divergence;
+};
+
+}
+
+#endif /* NADA_FIXED_CONTROLLER_H */
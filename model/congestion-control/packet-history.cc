@@ -0,0 +1,142 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Structure-of-arrays packet history implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "packet-history.h"
+#include <cassert>
+
+namespace rmcat {
+
+const size_t PACKET_HISTORY_INITIAL_CAPACITY = 64; /**< must be a power of two */
+
+PacketHistory::PacketHistory()
+: m_capacity{0},
+  m_head{0},
+  m_count{0},
+  m_sequence{},
+  m_txTimestampUs{},
+  m_size{},
+  m_owdUs{},
+  m_rttUs{},
+  m_ecn{} {}
+
+void PacketHistory::clear() {
+    m_head = 0;
+    m_count = 0;
+}
+
+void PacketHistory::grow() {
+    const size_t newCapacity = m_capacity == 0 ? PACKET_HISTORY_INITIAL_CAPACITY
+                                               : m_capacity * 2;
+    std::vector<uint64_t> sequence(newCapacity);
+    std::vector<uint64_t> txTimestampUs(newCapacity);
+    std::vector<uint32_t> size(newCapacity);
+    std::vector<uint64_t> owdUs(newCapacity);
+    std::vector<uint64_t> rttUs(newCapacity);
+    std::vector<uint8_t> ecn(newCapacity);
+    // Linearize: the front record goes to physical slot 0
+    for (size_t i = 0; i < m_count; ++i) {
+        const size_t s = slot(i);
+        sequence[i] = m_sequence[s];
+        txTimestampUs[i] = m_txTimestampUs[s];
+        size[i] = m_size[s];
+        owdUs[i] = m_owdUs[s];
+        rttUs[i] = m_rttUs[s];
+        ecn[i] = m_ecn[s];
+    }
+    m_sequence.swap(sequence);
+    m_txTimestampUs.swap(txTimestampUs);
+    m_size.swap(size);
+    m_owdUs.swap(owdUs);
+    m_rttUs.swap(rttUs);
+    m_ecn.swap(ecn);
+    m_capacity = newCapacity;
+    m_head = 0;
+}
+
+void PacketHistory::push_back(const PacketRecord& record) {
+    if (m_count == m_capacity) {
+        grow();
+    }
+    const size_t s = slot(m_count);
+    m_sequence[s] = record.sequence;
+    m_txTimestampUs[s] = record.txTimestampUs;
+    m_size[s] = record.size;
+    m_owdUs[s] = record.owdUs;
+    m_rttUs[s] = record.rttUs;
+    m_ecn[s] = record.ecn;
+    ++m_count;
+}
+
+void PacketHistory::pop_front() {
+    assert(m_count > 0);
+    m_head = (m_head + 1) & (m_capacity - 1);
+    --m_count;
+}
+
+void PacketHistory::insert(size_t pos, const PacketRecord& record) {
+    assert(pos <= m_count);
+    if (m_count == m_capacity) {
+        grow();
+    }
+    for (size_t i = m_count; i > pos; --i) {
+        const size_t dst = slot(i);
+        const size_t src = slot(i - 1);
+        m_sequence[dst] = m_sequence[src];
+        m_txTimestampUs[dst] = m_txTimestampUs[src];
+        m_size[dst] = m_size[src];
+        m_owdUs[dst] = m_owdUs[src];
+        m_rttUs[dst] = m_rttUs[src];
+        m_ecn[dst] = m_ecn[src];
+    }
+    const size_t s = slot(pos);
+    m_sequence[s] = record.sequence;
+    m_txTimestampUs[s] = record.txTimestampUs;
+    m_size[s] = record.size;
+    m_owdUs[s] = record.owdUs;
+    m_rttUs[s] = record.rttUs;
+    m_ecn[s] = record.ecn;
+    ++m_count;
+}
+
+void PacketHistory::shiftSequences(uint64_t delta) {
+    for (size_t i = 0; i < m_count; ++i) {
+        m_sequence[slot(i)] += delta;
+    }
+}
+
+PacketRecord PacketHistory::at(size_t i) const {
+    assert(i < m_count);
+    const size_t s = slot(i);
+    return PacketRecord{m_sequence[s],
+                        m_txTimestampUs[s],
+                        m_size[s],
+                        m_owdUs[s],
+                        m_rttUs[s],
+                        m_ecn[s]};
+}
+
+}
@@ -0,0 +1,146 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Structure-of-arrays packet history for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef PACKET_HISTORY_H
+#define PACKET_HISTORY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace rmcat {
+
+/** To avoid future complexity and defects, we make the following
+ *  assumptions regarding wrapping of unsigned integers:
+ *    - sequences, uint16_t, can wrap (just like TCP) on the wire. Internally,
+ *      they are extended to 64 bits (as RTP receivers do), which never wrap
+ *    - timestamps (microseconds), uint64_t, can wrap (despite being 64 bits long)
+ *    - delays (microseconds), uint64_t, can wrap (easily), as they are
+ *      obtained from subtraction of timestamps obtained at different endpoints,
+ *      which may have non-synchronized clocks.
+ */
+/* ECN codepoints, i.e., the two lower bits of the IP TOS field (see rfc3168) */
+const uint8_t ECN_NOT_ECT = 0x00; /**< Not ECN-capable transport */
+const uint8_t ECN_ECT1 = 0x01;    /**< ECN-capable transport, ECT(1) */
+const uint8_t ECN_ECT0 = 0x02;    /**< ECN-capable transport, ECT(0) */
+const uint8_t ECN_CE = 0x03;      /**< Congestion experienced */
+
+struct PacketRecord {
+    uint64_t sequence; /**< extended sequence */
+    uint64_t txTimestampUs;
+    uint32_t size;
+    uint64_t owdUs;
+    uint64_t rttUs;
+    uint8_t ecn; /**< ECN codepoint read at the receiver (see #ECN_CE ) */
+};
+
+/**
+ * This class stores the records of the packets for which feedback has been
+ * received, ordered by sequence. It behaves like a double-ended queue of
+ * #PacketRecord , but it is implemented as a ring buffer with one contiguous
+ * array per field (structure of arrays). This keeps each field contiguous
+ * in memory, so that scanning a field (e.g., when the windowed filters are
+ * rebuilt) stays cache-friendly even when the history holds many thousands
+ * of packets. The metrics themselves are maintained incrementally by the
+ * controllers (see #WindowedFilter ), not recalculated from the history.
+ *
+ * The ring grows (doubling its capacity) when full; it never shrinks.
+ *
+ * Indices passed to the member functions are logical: index 0 is the
+ * oldest packet (front), and index #size - 1 is the newest one (back).
+ */
+class PacketHistory {
+public:
+    /** Class constructor */
+    PacketHistory();
+
+    /** @retval Number of packet records in the history */
+    size_t size() const { return m_count; }
+
+    /** @retval True if the history contains no records */
+    bool empty() const { return m_count == 0; }
+
+    /** Remove all records from the history (its capacity is kept) */
+    void clear();
+
+    /** Append a record at the back (newest end) of the history */
+    void push_back(const PacketRecord& record);
+
+    /** Remove the record at the front (oldest end) of the history */
+    void pop_front();
+
+    /**
+     * Insert a record before position pos, shifting the newer records. The
+     * cost is linear in the number of records shifted (size - pos)
+     *
+     * @param [in] pos Logical index the inserted record will have
+     * @param [in] record The record to insert
+     */
+    void insert(size_t pos, const PacketRecord& record);
+
+    /**
+     * Add an offset to the sequences of all records, when the sequences of
+     * the flow are renumbered (see SenderBasedController::loadState )
+     *
+     * @param [in] delta Offset added to the sequences
+     */
+    void shiftSequences(uint64_t delta);
+
+    /** @retval The record at logical index i */
+    PacketRecord at(size_t i) const;
+    /** @retval The oldest record in the history */
+    PacketRecord front() const { return at(0); }
+    /** @retval The newest record in the history */
+    PacketRecord back() const { return at(m_count - 1); }
+
+    /* Per-field accessors, cheaper than #at when only one field is needed */
+    uint64_t sequenceAt(size_t i) const { return m_sequence[slot(i)]; }
+    uint64_t txTimestampAt(size_t i) const { return m_txTimestampUs[slot(i)]; }
+    uint32_t sizeAt(size_t i) const { return m_size[slot(i)]; }
+    uint64_t owdAt(size_t i) const { return m_owdUs[slot(i)]; }
+    uint64_t rttAt(size_t i) const { return m_rttUs[slot(i)]; }
+    uint8_t ecnAt(size_t i) const { return m_ecn[slot(i)]; }
+
+private:
+    size_t slot(size_t i) const { return (m_head + i) & (m_capacity - 1); }
+    void grow();
+
+    size_t m_capacity; /**< Capacity of each array; always a power of two */
+    size_t m_head;     /**< Physical slot of the front record */
+    size_t m_count;    /**< Number of records in the history */
+
+    std::vector<uint64_t> m_sequence;
+    std::vector<uint64_t> m_txTimestampUs;
+    std::vector<uint32_t> m_size;
+    std::vector<uint64_t> m_owdUs;
+    std::vector<uint64_t> m_rttUs;
+    std::vector<uint8_t> m_ecn;
+};
+
+}
+
+#endif /* PACKET_HISTORY_H */
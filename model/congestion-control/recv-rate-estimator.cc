@@ -0,0 +1,217 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Receive rate estimators implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "recv-rate-estimator.h"
+#include "windowed-filter.h"
+#include <cmath>
+#include <cassert>
+
+namespace rmcat {
+
+const uint64_t WindowRecvRateEstimator::DEFAULT_WINDOW_US;
+const uint64_t EwmaRecvRateEstimator::DEFAULT_TIME_CONSTANT_US;
+const uint64_t FrameRecvRateEstimator::DEFAULT_WINDOW_US;
+const uint64_t FrameRecvRateEstimator::DEFAULT_GAP_US;
+
+WindowRecvRateEstimator::WindowRecvRateEstimator(uint64_t windowUs)
+: m_windowUs{windowUs},
+  m_samples{},
+  m_bytes{0},
+  m_full{false},
+  m_lastRxUs{0} {
+    assert(m_windowUs > 0);
+}
+
+void WindowRecvRateEstimator::reset() {
+    m_samples.clear();
+    m_bytes = 0;
+    m_full = false;
+    m_lastRxUs = 0;
+}
+
+void WindowRecvRateEstimator::update(uint64_t rxTimestampUs, uint32_t bytes) {
+    const WrapLess<uint64_t> lessThan{};
+    // Packets whose feedback arrives out of order count as received now
+    if (m_samples.empty() || lessThan(m_lastRxUs, rxTimestampUs)) {
+        m_lastRxUs = rxTimestampUs;
+    }
+    m_samples.push_back(Sample{m_lastRxUs, bytes});
+    m_bytes += bytes;
+    // The newest sample never expires
+    while (!lessThan(m_lastRxUs, m_samples.front().rxTimestampUs + m_windowUs)) {
+        assert(m_bytes >= m_samples.front().bytes);
+        m_bytes -= m_samples.front().bytes;
+        m_samples.pop_front();
+        m_full = true;
+    }
+}
+
+bool WindowRecvRateEstimator::getRate(float& rateBps) const {
+    if (m_full) {
+        rateBps = float(double(m_bytes * 8) * 1000. * 1000. / double(m_windowUs));
+        return true;
+    }
+    if (m_samples.empty()) {
+        return false;
+    }
+    // Technically, the first packet is out of the elapsed time span
+    const Sample& first = m_samples.front();
+    const uint64_t spanUs = m_lastRxUs - first.rxTimestampUs;
+    if (spanUs == 0) {
+        return false;
+    }
+    rateBps = float(double((m_bytes - first.bytes) * 8) * 1000. * 1000. / double(spanUs));
+    return true;
+}
+
+EwmaRecvRateEstimator::EwmaRecvRateEstimator(uint64_t timeConstantUs)
+: m_timeConstantUs{timeConstantUs},
+  m_started{false},
+  m_firstRxUs{0},
+  m_lastRxUs{0},
+  m_sumBps{0.} {
+    assert(m_timeConstantUs > 0);
+}
+
+void EwmaRecvRateEstimator::reset() {
+    m_started = false;
+    m_firstRxUs = 0;
+    m_lastRxUs = 0;
+    m_sumBps = 0.;
+}
+
+/*
+ * Each packet contributes bytes * 8 / timeConstant to the sum, and the sum
+ * decays by exp(-dt / timeConstant). At a constant rate, the sum converges
+ * to that rate. The first packet only marks the start of the flow
+ */
+void EwmaRecvRateEstimator::update(uint64_t rxTimestampUs, uint32_t bytes) {
+    const WrapLess<uint64_t> lessThan{};
+    if (!m_started) {
+        m_firstRxUs = rxTimestampUs;
+        m_lastRxUs = rxTimestampUs;
+        m_started = true;
+        return;
+    }
+    // Packets whose feedback arrives out of order count as received now
+    if (lessThan(m_lastRxUs, rxTimestampUs)) {
+        const double dtUs = double(rxTimestampUs - m_lastRxUs);
+        m_sumBps *= std::exp(-dtUs / double(m_timeConstantUs));
+        m_lastRxUs = rxTimestampUs;
+    }
+    m_sumBps += double(bytes) * 8. * 1000. * 1000. / double(m_timeConstantUs);
+}
+
+bool EwmaRecvRateEstimator::getRate(float& rateBps) const {
+    if (!m_started || m_lastRxUs == m_firstRxUs) {
+        return false;
+    }
+    // Total weight of the samples since the first packet
+    const double elapsedUs = double(m_lastRxUs - m_firstRxUs);
+    const double weight = 1. - std::exp(-elapsedUs / double(m_timeConstantUs));
+    rateBps = float(m_sumBps / weight);
+    return true;
+}
+
+FrameRecvRateEstimator::FrameRecvRateEstimator(uint64_t windowUs, uint64_t gapUs)
+: m_windowUs{windowUs},
+  m_gapUs{gapUs},
+  m_bursts{},
+  m_bytes{0},
+  m_started{false},
+  m_current{0, 0},
+  m_currentLastUs{0},
+  m_currentFirstBytes{0} {
+    assert(m_gapUs > 0);
+    assert(m_windowUs >= 4 * m_gapUs);
+}
+
+void FrameRecvRateEstimator::reset() {
+    m_bursts.clear();
+    m_bytes = 0;
+    m_started = false;
+    m_current = Burst{0, 0};
+    m_currentLastUs = 0;
+    m_currentFirstBytes = 0;
+}
+
+void FrameRecvRateEstimator::update(uint64_t rxTimestampUs, uint32_t bytes) {
+    const WrapLess<uint64_t> lessThan{};
+    if (!m_started) {
+        m_current = Burst{rxTimestampUs, bytes};
+        m_currentLastUs = rxTimestampUs;
+        m_currentFirstBytes = bytes;
+        m_started = true;
+        return;
+    }
+    // Packets whose feedback arrives out of order count as received now
+    if (lessThan(rxTimestampUs, m_currentLastUs)) {
+        rxTimestampUs = m_currentLastUs;
+    }
+    // These subtractions will wrap properly
+    const bool gap = rxTimestampUs - m_currentLastUs >= m_gapUs;
+    const bool tooLong = rxTimestampUs - m_current.startUs >= m_windowUs / 4;
+    if (!gap && !tooLong) {
+        m_current.bytes += bytes;
+        m_currentLastUs = rxTimestampUs;
+        return;
+    }
+
+    // The current burst is complete: a new one starts with this packet
+    m_bursts.push_back(m_current);
+    m_bytes += m_current.bytes;
+    m_current = Burst{rxTimestampUs, bytes};
+    m_currentLastUs = rxTimestampUs;
+    m_currentFirstBytes = bytes;
+    while (!m_bursts.empty() &&
+           lessThan(m_bursts.front().startUs + m_windowUs, m_current.startUs)) {
+        assert(m_bytes >= m_bursts.front().bytes);
+        m_bytes -= m_bursts.front().bytes;
+        m_bursts.pop_front();
+    }
+}
+
+bool FrameRecvRateEstimator::getRate(float& rateBps) const {
+    if (!m_started) {
+        return false;
+    }
+    if (!m_bursts.empty()) {
+        const uint64_t spanUs = m_current.startUs - m_bursts.front().startUs;
+        assert(spanUs > 0);
+        rateBps = float(double(m_bytes * 8) * 1000. * 1000. / double(spanUs));
+        return true;
+    }
+    // No complete burst in the window yet: use the current one
+    const uint64_t spanUs = m_currentLastUs - m_current.startUs;
+    if (spanUs == 0) {
+        return false;
+    }
+    rateBps = float(double((m_current.bytes - m_currentFirstBytes) * 8) * 1000. * 1000. / double(spanUs));
+    return true;
+}
+
+}
@@ -0,0 +1,189 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Receive rate estimators for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef RECV_RATE_ESTIMATOR_H
+#define RECV_RATE_ESTIMATOR_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+
+namespace rmcat {
+
+/**
+ * Interface of the estimators of the rate at which the receiver is
+ * receiving the media packets (see SenderBasedController::setRecvRateEstimator ).
+ *
+ * Samples are fed in the order their feedback is processed. All times are
+ * receive timestamps, i.e., they come from the receiver's clock, which is
+ * never compared with the sender's. Timestamps may wrap (see #rmcat::PacketRecord ).
+ */
+class RecvRateEstimator {
+public:
+    virtual ~RecvRateEstimator() {}
+
+    /** Forget all samples */
+    virtual void reset() =0;
+
+    /**
+     * Account for a packet received. Packets reordered by the network, or
+     * whose feedback arrives out of order, may have a receive time older
+     * than that of previous packets: they count as received at the newest
+     * receive time seen so far, so time never goes backwards
+     *
+     * @param [in] rxTimestampUs Receive time of the packet, in microseconds
+     * @param [in] bytes Size of the packet, in bytes (including the
+     *                   overhead, if the controller is configured to count it)
+     */
+    virtual void update(uint64_t rxTimestampUs, uint32_t bytes) =0;
+
+    /**
+     * Get the current receive rate
+     *
+     * @param [out] rateBps Current receive rate in bps
+     * @retval False if there are not enough samples to calculate the rate
+     *         (output parameter is not valid). True otherwise
+     */
+    virtual bool getRate(float& rateBps) const =0;
+};
+
+/**
+ * Bytes received within a sliding time window, ending at the most recent
+ * receive time, divided by the window length. Until the flow has been
+ * running for a whole window, the bytes received after the first packet
+ * are divided by the time elapsed since then.
+ */
+class WindowRecvRateEstimator: public RecvRateEstimator {
+public:
+    static const uint64_t DEFAULT_WINDOW_US = 500 * 1000; /**< half a second */
+
+    /**
+     * Class constructor
+     *
+     * @param [in] windowUs Length of the window, in microseconds
+     */
+    explicit WindowRecvRateEstimator(uint64_t windowUs=DEFAULT_WINDOW_US);
+
+    virtual void reset();
+    virtual void update(uint64_t rxTimestampUs, uint32_t bytes);
+    virtual bool getRate(float& rateBps) const;
+
+private:
+    struct Sample {
+        uint64_t rxTimestampUs;
+        uint32_t bytes;
+    };
+
+    uint64_t m_windowUs;
+    std::deque<Sample> m_samples; /**< samples within the window, oldest first */
+    uint64_t m_bytes;             /**< sum of the bytes of m_samples */
+    bool m_full;                  /**< whether samples have already expired */
+    uint64_t m_lastRxUs;          /**< most recent receive time */
+};
+
+/**
+ * Exponentially weighted moving average of the receive rate. The weights
+ * decay with time (rather than with the number of samples), with the
+ * configured time constant, so that bursts of packets received at once do
+ * not bias the average. The average is normalized by the total weight
+ * accumulated since the first packet, so it is not biased towards zero
+ * while the flow is younger than the time constant.
+ */
+class EwmaRecvRateEstimator: public RecvRateEstimator {
+public:
+    static const uint64_t DEFAULT_TIME_CONSTANT_US = 500 * 1000; /**< half a second */
+
+    /**
+     * Class constructor
+     *
+     * @param [in] timeConstantUs Time constant of the average, in microseconds
+     */
+    explicit EwmaRecvRateEstimator(uint64_t timeConstantUs=DEFAULT_TIME_CONSTANT_US);
+
+    virtual void reset();
+    virtual void update(uint64_t rxTimestampUs, uint32_t bytes);
+    virtual bool getRate(float& rateBps) const;
+
+private:
+    uint64_t m_timeConstantUs;
+    bool m_started;
+    uint64_t m_firstRxUs;   /**< receive time of the first packet */
+    uint64_t m_lastRxUs;    /**< most recent receive time */
+    double m_sumBps;        /**< decayed sum of the samples (not normalized) */
+};
+
+/**
+ * Frame-aware receive rate. Video frames are sent as bursts of packets, and
+ * reach the receiver as bursts, separated by idle gaps. The rate is
+ * calculated over the complete bursts within a sliding window: their bytes
+ * are divided by the time from the start of the oldest one to the start of
+ * the current (incomplete) one. Thus, the window never splits a frame, and
+ * the estimation does not oscillate with the position of the window within
+ * the frame period.
+ *
+ * If the link is saturated, there are no gaps: bursts are then split every
+ * quarter of the window. Until a burst is complete, the bytes of the current
+ * burst received after its first packet are divided by its duration.
+ */
+class FrameRecvRateEstimator: public RecvRateEstimator {
+public:
+    static const uint64_t DEFAULT_WINDOW_US = 500 * 1000; /**< half a second */
+    static const uint64_t DEFAULT_GAP_US = 2 * 1000;      /**< minimum gap between bursts */
+
+    /**
+     * Class constructor
+     *
+     * @param [in] windowUs Length of the window, in microseconds
+     * @param [in] gapUs Minimum time, in microseconds, without packets
+     *                   between two bursts
+     */
+    explicit FrameRecvRateEstimator(uint64_t windowUs=DEFAULT_WINDOW_US,
+                                    uint64_t gapUs=DEFAULT_GAP_US);
+
+    virtual void reset();
+    virtual void update(uint64_t rxTimestampUs, uint32_t bytes);
+    virtual bool getRate(float& rateBps) const;
+
+private:
+    struct Burst {
+        uint64_t startUs;   /**< receive time of the first packet */
+        uint64_t bytes;
+    };
+
+    uint64_t m_windowUs;
+    uint64_t m_gapUs;
+    std::deque<Burst> m_bursts;  /**< complete bursts within the window, oldest first */
+    uint64_t m_bytes;            /**< sum of the bytes of m_bursts */
+    bool m_started;
+    Burst m_current;             /**< current (incomplete) burst */
+    uint64_t m_currentLastUs;    /**< receive time of the last packet of m_current */
+    uint32_t m_currentFirstBytes; /**< size of the first packet of m_current */
+};
+
+}
+
+#endif /* RECV_RATE_ESTIMATOR_H */
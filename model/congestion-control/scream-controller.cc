@@ -0,0 +1,357 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * SCReAM controller implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "scream-controller.h"
+#include <algorithm>
+#include <cassert>
+
+namespace rmcat {
+
+/* Network congestion control */
+const uint64_t SCREAM_QDELAY_TARGET_US = 100 * 1000; /**< queuing delay target */
+const uint32_t SCREAM_MSS = 1000;             /**< segment size assumed in the window increase, in bytes */
+const uint64_t SCREAM_MIN_CWND = 3000;        /**< minimum window, in bytes */
+const double SCREAM_GAIN = 1.;                /**< gain of the window increase */
+const float SCREAM_BETA_LOSS = 0.8f;          /**< window decrease factor upon loss */
+const float SCREAM_BETA_ECN = 0.9f;           /**< window decrease factor upon ECN-CE */
+const float SCREAM_CWND_HEADROOM = 1.5f;      /**< the window may not exceed the max bytes in flight times this */
+const uint64_t SCREAM_MAX_BIF_PERIOD_US = 1000 * 1000; /**< period of the max bytes in flight */
+const uint64_t SCREAM_INIT_RTT_US = 250 * 1000; /**< RTT assumed for the initial window */
+const uint64_t SCREAM_MIN_RTT_US = 10 * 1000; /**< lower bound of the RTT in the window rate */
+const uint64_t SCREAM_FEEDBACK_TIMEOUT_US = 1000 * 1000; /**< without feedback, the window collapses */
+const uint64_t SCREAM_POST_CONGESTION_US = 5 * 1000 * 1000; /**< time to fast increase again */
+const double SCREAM_FAST_INCREASE_QDELAY = 0.25; /**< fraction of the target to fast increase again */
+
+/* Media rate control */
+const uint64_t SCREAM_RATE_UPDATE_INTERVAL_US = 200 * 1000; /**< minimum interval between rate updates */
+const float SCREAM_RAMP_UP_SPEED = 200000.f;  /**< maximum rate increase, in bps per second */
+const float SCREAM_BETA_R = 0.9f;             /**< rate decrease factor upon loss or ECN-CE */
+const float SCREAM_QDELAY_LOW = 0.1f;         /**< fraction of the target below which the rate increases */
+const float SCREAM_RATE_DECREASE = 2.f;       /**< rate decrease per second, per fraction of the target above it */
+
+static uint64_t initialCwnd(float initBw) {
+    return std::max(SCREAM_MIN_CWND, uint64_t(initBw * 1e-6 * SCREAM_INIT_RTT_US / 8.));
+}
+
+ScreamController::ScreamController() :
+    SenderBasedController{},
+    m_ackedBytesProcessed{0},
+    m_lastFeedbackUs{0},
+    m_lastFeedbackValid{false},
+    m_lastSendUs{0},
+    m_cwnd{initialCwnd(m_initBw)},
+    m_fastIncrease{true},
+    m_sRttUs{0},
+    m_sRttValid{false},
+    m_lastCongestionUs{0},
+    m_lastCongestionValid{false},
+    m_congestionSeen{false},
+    m_maxBytesInFlight{0},
+    m_maxBytesInFlightPrev{0},
+    m_maxBytesInFlightStartUs{0},
+    m_lastTimeCalcUs{0},
+    m_lastTimeCalcValid{false},
+    m_currBw{m_initBw} {}
+
+ScreamController::~ScreamController() {}
+
+void ScreamController::setCurrentBw(float newBw) {
+    m_currBw = newBw;
+}
+
+void ScreamController::reset() {
+    m_ackedBytesProcessed = 0;
+    m_lastFeedbackUs = 0;
+    m_lastFeedbackValid = false;
+    m_lastSendUs = 0;
+    m_cwnd = initialCwnd(m_initBw);
+    m_fastIncrease = true;
+    m_sRttUs = 0;
+    m_sRttValid = false;
+    m_lastCongestionUs = 0;
+    m_lastCongestionValid = false;
+    m_congestionSeen = false;
+    m_maxBytesInFlight = 0;
+    m_maxBytesInFlightPrev = 0;
+    m_maxBytesInFlightStartUs = 0;
+    m_lastTimeCalcUs = 0;
+    m_lastTimeCalcValid = false;
+    m_currBw = m_initBw;
+    SenderBasedController::reset();
+}
+
+bool ScreamController::processSendPacket(uint64_t txTimestampUs,
+                                         uint16_t sequence,
+                                         uint32_t size) { // in Bytes
+    /* First of all, call the superclass */
+    if (!SenderBasedController::processSendPacket(txTimestampUs, sequence, size)) {
+        return false;
+    }
+
+    /* Maximum bytes in flight, over periods of fixed length */
+    if (!lessThan(txTimestampUs, m_maxBytesInFlightStartUs + SCREAM_MAX_BIF_PERIOD_US)) {
+        m_maxBytesInFlightPrev = m_maxBytesInFlight;
+        m_maxBytesInFlight = 0;
+        m_maxBytesInFlightStartUs = txTimestampUs;
+    }
+    m_maxBytesInFlight = std::max(m_maxBytesInFlight, getBytesInFlight());
+    m_lastSendUs = txTimestampUs;
+
+    /* The feedback timeout starts with the first packet sent */
+    if (!m_lastFeedbackValid) {
+        m_lastFeedbackUs = txTimestampUs;
+        m_lastFeedbackValid = true;
+    }
+    /* As in NADA, the first rate update happens upon the first feedback */
+    if (!m_lastTimeCalcValid) {
+        m_lastTimeCalcUs = txTimestampUs;
+        m_lastTimeCalcValid = true;
+    }
+    return true;
+}
+
+bool ScreamController::processFeedback(uint64_t nowUs,
+                                       uint16_t sequence,
+                                       uint64_t rxTimestampUs,
+                                       uint8_t ecn) {
+    /* First of all, call the superclass */
+    if (!SenderBasedController::processFeedback(nowUs,
+                                                sequence,
+                                                rxTimestampUs,
+                                                ecn)) {
+        return false;
+    }
+    updateOnFeedback(nowUs);
+    return true;
+}
+
+bool ScreamController::processFeedbackBatch(uint64_t nowUs,
+                                            const std::vector<FeedbackItem>& feedbackBatch) {
+    /* First of all, call the superclass */
+    if (!SenderBasedController::processFeedbackBatch(nowUs, feedbackBatch)) {
+        return false;
+    }
+    updateOnFeedback(nowUs);
+    return true;
+}
+
+float ScreamController::getBandwidth(uint64_t nowUs) const {
+    return m_currBw;
+}
+
+bool ScreamController::canSend(uint64_t nowUs, uint32_t size) const {
+    /* Feedback has stopped coming: the window collapses to its minimum */
+    const bool feedbackLost = m_lastFeedbackValid &&
+                              lessThan(m_lastFeedbackUs + SCREAM_FEEDBACK_TIMEOUT_US, nowUs);
+    const uint64_t cwnd = feedbackLost ? SCREAM_MIN_CWND : m_cwnd;
+    if (getBytesInFlight() + size <= cwnd) {
+        return true;
+    }
+    /* The bytes in flight may never be acknowledged (e.g., all were lost):
+     * probe the path with one packet per RTT, so as not to stall forever */
+    return feedbackLost && lessThan(m_lastSendUs + getRttUs(), nowUs);
+}
+
+uint64_t ScreamController::getCongestionWindow() const {
+    return m_cwnd;
+}
+
+void ScreamController::saveStateFields(std::ostream& os, uint64_t nowUs) const {
+    SenderBasedController::saveStateFields(os, nowUs);
+    os << "scream " << m_cwnd << ' ' << m_fastIncrease
+       << ' ' << m_sRttValid << ' ' << m_sRttUs
+       << ' ' << m_lastCongestionValid << ' ' << (nowUs - m_lastCongestionUs)
+       << ' ' << m_lastTimeCalcValid << ' ' << (nowUs - m_lastTimeCalcUs)
+       << ' ' << m_currBw << '\n';
+}
+
+bool ScreamController::loadStateFields(std::istream& is, uint64_t nowUs) {
+    if (!SenderBasedController::loadStateFields(is, nowUs)) {
+        return false;
+    }
+    uint64_t lastCongestionAgeUs = 0;
+    uint64_t lastCalcAgeUs = 0;
+    if (!readStateTag(is, "scream") ||
+        !(is >> m_cwnd >> m_fastIncrease
+             >> m_sRttValid >> m_sRttUs
+             >> m_lastCongestionValid >> lastCongestionAgeUs
+             >> m_lastTimeCalcValid >> lastCalcAgeUs
+             >> m_currBw) ||
+        m_cwnd < SCREAM_MIN_CWND) {
+        return false;
+    }
+    m_lastCongestionUs = nowUs - lastCongestionAgeUs;
+    m_lastTimeCalcUs = nowUs - lastCalcAgeUs;
+    m_congestionSeen = false;
+    /* The superclass no longer counts the packets in transit as in flight */
+    m_ackedBytesProcessed = m_ackedBytes;
+    m_maxBytesInFlight = 0;
+    m_maxBytesInFlightPrev = m_cwnd;
+    m_maxBytesInFlightStartUs = nowUs;
+    m_lastFeedbackUs = nowUs;
+    m_lastFeedbackValid = true;
+    m_lastSendUs = nowUs;
+    return true;
+}
+
+void ScreamController::processNewPackets(bool& lossSeen, bool& ceSeen) {
+    /* A gap between consecutive sequences, starting from the newest packet
+     * processed before, is a loss */
+    bool prevValid = m_lastSeqProcessedValid;
+    uint64_t prevSequence = m_lastSeqProcessed;
+    for (size_t i = firstNewPacket(); i < m_packetHistory.size(); ++i) {
+        const uint64_t sequence = m_packetHistory.sequenceAt(i);
+        if (prevValid && sequence > prevSequence + 1) {
+            lossSeen = true;
+        }
+        if (m_packetHistory.ecnAt(i) == ECN_CE) {
+            ceSeen = true;
+        }
+        const uint64_t rttUs = m_packetHistory.rttAt(i);
+        m_sRttUs = m_sRttValid ? (7 * m_sRttUs + rttUs) / 8 : rttUs;
+        m_sRttValid = true;
+        prevSequence = sequence;
+        prevValid = true;
+    }
+    markPacketsProcessed();
+}
+
+void ScreamController::updateOnFeedback(uint64_t nowUs) {
+    bool lossSeen = false;
+    bool ceSeen = false;
+    processNewPackets(lossSeen, ceSeen);
+    updateLatestMetrics(nowUs);
+    updateWindow(nowUs, lossSeen, ceSeen);
+    m_lastFeedbackUs = nowUs;
+    m_lastFeedbackValid = true;
+
+    /* First time receiving a feedback message */
+    if (!m_lastTimeCalcValid) {
+        m_lastTimeCalcUs = nowUs;
+        m_lastTimeCalcValid = true;
+        return;
+    }
+
+    assert(lessThan(m_lastTimeCalcUs, nowUs + 1));
+    /* calculate time since last update; congestion is reacted upon at once */
+    const uint64_t deltaUs = nowUs - m_lastTimeCalcUs; // subtraction will wrap correctly
+    if (deltaUs < SCREAM_RATE_UPDATE_INTERVAL_US && !m_congestionSeen) {
+        return;
+    }
+    updateTargetBw(deltaUs);
+    logStats(nowUs, deltaUs);
+
+    m_congestionSeen = false;
+    m_lastTimeCalcUs = nowUs;
+}
+
+void ScreamController::updateWindow(uint64_t nowUs, bool lossSeen, bool ceSeen) {
+    const uint64_t bytesNewlyAcked = m_ackedBytes - m_ackedBytesProcessed;
+    m_ackedBytesProcessed = m_ackedBytes;
+
+    /* No feedback for a long time: restart from the minimum window */
+    if (m_lastFeedbackValid && lessThan(m_lastFeedbackUs + SCREAM_FEEDBACK_TIMEOUT_US, nowUs)) {
+        m_cwnd = SCREAM_MIN_CWND;
+        m_fastIncrease = true;
+    }
+
+    if (lossSeen || ceSeen) {
+        m_congestionSeen = true;
+        /* At most one reduction per smoothed RTT */
+        if (!m_lastCongestionValid || lessThan(m_lastCongestionUs + m_sRttUs, nowUs)) {
+            const float beta = lossSeen ? SCREAM_BETA_LOSS : SCREAM_BETA_ECN;
+            m_cwnd = std::max(SCREAM_MIN_CWND, uint64_t(float(m_cwnd) * beta));
+            m_fastIncrease = false;
+            m_lastCongestionUs = nowUs;
+            m_lastCongestionValid = true;
+        }
+        return;
+    }
+
+    const uint64_t qdelayUs = m_latestMetrics.qdelayUs;
+    const double offTarget = (double(SCREAM_QDELAY_TARGET_US) - double(qdelayUs)) /
+                             double(SCREAM_QDELAY_TARGET_US);
+    if (offTarget <= 0.) {
+        m_fastIncrease = false;
+    } else if (!m_fastIncrease && offTarget > 1. - SCREAM_FAST_INCREASE_QDELAY &&
+               (!m_lastCongestionValid ||
+                lessThan(m_lastCongestionUs + SCREAM_POST_CONGESTION_US, nowUs))) {
+        m_fastIncrease = true;
+    }
+
+    if (m_fastIncrease) {
+        m_cwnd += bytesNewlyAcked;
+    } else {
+        const double deltaCwnd = SCREAM_GAIN * offTarget * double(bytesNewlyAcked) *
+                                 SCREAM_MSS / double(m_cwnd);
+        m_cwnd = uint64_t(std::max(double(SCREAM_MIN_CWND), double(m_cwnd) + deltaCwnd));
+    }
+
+    /* Do not let the window inflate beyond the bytes actually in flight */
+    const uint64_t maxBytesInFlight = std::max(m_maxBytesInFlight, m_maxBytesInFlightPrev);
+    const uint64_t maxCwnd = std::max(SCREAM_MIN_CWND,
+                                      uint64_t(float(maxBytesInFlight) * SCREAM_CWND_HEADROOM));
+    m_cwnd = std::min(m_cwnd, maxCwnd);
+}
+
+void ScreamController::updateTargetBw(uint64_t deltaUs) {
+    const float deltaS = float(deltaUs) * 1e-6f;
+    if (m_congestionSeen) {
+        m_currBw *= SCREAM_BETA_R;
+    } else {
+        const uint64_t qdelayUs = m_latestMetrics.qdelayUs;
+        const float qdelayFraction = float(qdelayUs) / float(SCREAM_QDELAY_TARGET_US);
+        if (qdelayFraction < SCREAM_QDELAY_LOW) {
+            m_currBw += SCREAM_RAMP_UP_SPEED * deltaS * (1.f - qdelayFraction / SCREAM_QDELAY_LOW);
+        } else {
+            const float decrease = SCREAM_RATE_DECREASE * (qdelayFraction - SCREAM_QDELAY_LOW) * deltaS;
+            m_currBw *= std::max(0.f, 1.f - decrease);
+        }
+    }
+    /* The rate may not exceed what the window allows */
+    m_currBw = std::min(m_currBw, getWindowBw());
+    m_currBw = std::min(m_maxBw, std::max(m_minBw, m_currBw));
+}
+
+uint64_t ScreamController::getRttUs() const {
+    return std::max(SCREAM_MIN_RTT_US, m_sRttValid ? m_sRttUs : SCREAM_INIT_RTT_US);
+}
+
+float ScreamController::getWindowBw() const {
+    return float(m_cwnd) * 8.f * 1e6f / float(getRttUs());
+}
+
+void ScreamController::logStats(uint64_t nowUs, uint64_t deltaUs) const {
+    /* xcurr carries SCReAM's congestion window (in KB) */
+    StatsRecord record;
+    fillStatsRecord(nowUs, deltaUs, record);
+    record.xcurr = float(m_cwnd) / 1000.f;
+    record.srateBps = m_currBw;
+    reportStats("scream", record);
+}
+
+}
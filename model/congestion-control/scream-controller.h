@@ -0,0 +1,171 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * SCReAM controller interface for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef SCREAM_CONTROLLER_H
+#define SCREAM_CONTROLLER_H
+
+#include "sender-based-controller.h"
+
+namespace rmcat {
+
+/**
+ * Sender-side implementation of Self-Clocked Rate Adaptation for
+ * Multimedia (SCReAM), as specified in rfc8298. Unlike NADA and GCC,
+ * SCReAM is window-based: packets are only sent while the bytes in
+ * flight fit in the congestion window (see #canSend ).
+ *
+ * Network congestion control: the congestion window grows with the
+ * bytes acknowledged, fast (as in slow start) until congestion is first
+ * detected, then in proportion to how far the queuing delay is below its
+ * target (100 ms); it shrinks when the queuing delay exceeds the target.
+ * Losses and ECN-CE marks cut the window, at most once per smoothed RTT.
+ * The window is not allowed to grow much beyond the bytes actually in
+ * flight, so that it does not inflate while the sender is rate-limited.
+ *
+ * Media rate control: the target bitrate returned by #getBandwidth ramps
+ * up while the queuing delay is low, backs off as it grows, is cut upon
+ * losses and ECN-CE marks, and never exceeds the rate the window allows
+ * (window over smoothed RTT). This is a simplification of rfc8298's media
+ * rate control, as the controller has no view of the sender's RTP queue.
+ */
+class ScreamController: public SenderBasedController {
+public:
+    /** Class constructor */
+    ScreamController();
+
+    /** Class destructor */
+    virtual ~ScreamController();
+
+    /**
+     * Set the current bandwidth estimation. This can be useful in test environments
+     * to temporarily disrupt the current bandwidth estimation
+     *
+     * @param [in] newBw Bandwidth estimation to overwrite the current estimation
+     */
+    virtual void setCurrentBw(float newBw);
+
+    /**
+     * Reset the internal state of the congestion controller
+     */
+    virtual void reset();
+
+    /**
+     * SCReAM's implementation of the #processSendPacket API
+     */
+    virtual bool processSendPacket(uint64_t txTimestampUs,
+                                   uint16_t sequence,
+                                   uint32_t size); // in Bytes
+
+    /**
+     * SCReAM's implementation of the #processFeedback API: the window is
+     * updated with the packets acknowledged, and the target bitrate at
+     * regular intervals
+     */
+    virtual bool processFeedback(uint64_t nowUs,
+                                 uint16_t sequence,
+                                 uint64_t rxTimestampUs,
+                                 uint8_t ecn=0);
+
+    /**
+     * SCReAM's implementation of the #processFeedbackBatch API: the window
+     * is updated once with all packets acknowledged, then the target bitrate
+     */
+    virtual bool processFeedbackBatch(uint64_t nowUs,
+                                      const std::vector<FeedbackItem>& feedbackBatch);
+
+    /**
+     * SCReAM's implementation of the #getBandwidth API: the target bitrate
+     */
+    virtual float getBandwidth(uint64_t nowUs) const;
+
+    /**
+     * SCReAM's implementation of the #canSend API: the packet must fit in
+     * the congestion window. If no feedback has been received for a long
+     * time, the window collapses to its minimum (as in RFC 8298); if the
+     * bytes in flight do not fit in it (e.g., all were lost), one packet
+     * per RTT is allowed, so that the flow does not stall forever
+     */
+    virtual bool canSend(uint64_t nowUs, uint32_t size) const;
+
+    /** @retval The congestion window, in bytes */
+    uint64_t getCongestionWindow() const;
+
+protected:
+    /**
+     * Append SCReAM's state to a snapshot: the window, the smoothed RTT
+     * and the target bitrate. The maximum bytes in flight restarts from
+     * scratch when the snapshot is loaded
+     */
+    virtual void saveStateFields(std::ostream& os, uint64_t nowUs) const;
+    virtual bool loadStateFields(std::istream& is, uint64_t nowUs);
+
+private:
+    /**
+     * Go through the packets acknowledged since the last call (see
+     * #firstNewPacket ): update the smoothed RTT, and look for losses
+     * and ECN-CE marks
+     */
+    void processNewPackets(bool& lossSeen, bool& ceSeen);
+    /** Update the window, and the target bitrate if due, upon feedback */
+    void updateOnFeedback(uint64_t nowUs);
+    void updateWindow(uint64_t nowUs, bool lossSeen, bool ceSeen);
+    void updateTargetBw(uint64_t deltaUs);
+    void logStats(uint64_t nowUs, uint64_t deltaUs) const;
+    /** Smoothed RTT (or the initial one), bounded below, in microseconds */
+    uint64_t getRttUs() const;
+
+    /** Rate allowed by the window: window over smoothed RTT, in bps */
+    float getWindowBw() const;
+
+    /* Packets processed */
+    uint64_t m_ackedBytesProcessed; /**< value of #m_ackedBytes when last processed */
+    uint64_t m_lastFeedbackUs;   /**< last time feedback (or the first packet) was processed */
+    bool m_lastFeedbackValid;
+    uint64_t m_lastSendUs;       /**< last time a packet was sent */
+
+    /* Network congestion control */
+    uint64_t m_cwnd;             /**< congestion window, in bytes */
+    bool m_fastIncrease;         /**< whether the window grows as in slow start */
+    uint64_t m_sRttUs;           /**< smoothed round trip time */
+    bool m_sRttValid;
+    uint64_t m_lastCongestionUs; /**< time of the last loss or ECN-CE reaction */
+    bool m_lastCongestionValid;
+    bool m_congestionSeen;       /**< loss or ECN-CE mark seen since the last rate update */
+    /* Maximum bytes in flight, over the current and previous periods */
+    uint64_t m_maxBytesInFlight;
+    uint64_t m_maxBytesInFlightPrev;
+    uint64_t m_maxBytesInFlightStartUs; /**< start of the current period */
+
+    /* Media rate control */
+    uint64_t m_lastTimeCalcUs;
+    bool m_lastTimeCalcValid;
+    float m_currBw;              /**< target bitrate */
+};
+
+}
+
+#endif /* SCREAM_CONTROLLER_H */
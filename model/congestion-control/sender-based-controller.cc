@@ -26,29 +26,35 @@
  * @author Xiaoqing Zhu
  */
 #include "sender-based-controller.h"
-#include <numeric>
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include <cassert>
-#include <limits>
+#include <cstring>
+#include <algorithm>
 
 
 namespace rmcat {
 
 const int MIN_PACKET_LOGLEN = 5;             /**< minimum # of packets in log for stats to be meaningful */
+const size_t DEFAULT_MIN_FILTER_NTAPS = 15;  /**< default # of taps of the qdelay and rtt minimum filters */
+const size_t DEFAULT_IN_TRANSIT_CAPACITY = 4096;  /**< default # of in-transit packet records */
+/**
+ * Wire sequences are extended relative to the last one sent, which only
+ * resolves half the 16-bit sequence space: in-transit records further
+ * behind would have their feedback read as coming from the future
+ */
+const size_t MAX_IN_TRANSIT_CAPACITY = 1u << 15;
+const uint64_t SEQUENCE_CYCLE = 1u << 16;  /**< number of distinct sequences on the wire */
 const uint64_t MAX_INTER_PACKET_TIME_US = 500 * 1000;  /**< maximum interval between packets, in microseconds */
 const uint64_t DEFAULT_HISTORY_LENGTH_US = 500 * 1000; /**< default time window for logging history of packets, in microseconds */
 const float RMCAT_CC_DEFAULT_RINIT = 150000.; /**< Initial BW in bps: 150Kbps */
 const float RMCAT_CC_DEFAULT_RMIN = 150000.;  /**< in bps: 150Kbps */
 const float RMCAT_CC_DEFAULT_RMAX = 1500000.; /**< in bps: 1.5Mbps */
-
-InterLossState::InterLossState()
-: intervals{}
-, expectedSeq{0}
-, initialized{false}
-{
-    intervals.push_front(0);
-}
+const char* const STATE_MAGIC = "rmcat-state";  /**< first word of a snapshot */
+const uint32_t STATE_VERSION = 1;  /**< version of the snapshot format */
+const int STATE_PRECISION = 17;  /**< digits needed to write floating point values losslessly */
+const uint64_t DEFAULT_DIAG_INTERVAL_US = 10 * 1000 * 1000; /**< default interval between diagnostics summaries, in microseconds */
 
 void SenderBasedController::setDefaultId() {
     // By default, the id is the object's address
@@ -60,17 +66,39 @@ void SenderBasedController::setDefaultId() {
 SenderBasedController::SenderBasedController()
 : m_firstSend{true},
   m_lastSequence{0},
-  m_baseDelayUs{0},
-  m_inTransitPackets{},
+  m_rebaseSequence{false},
+  m_baseDelay{},
+  m_driftCompensation{false},
+  m_clockDrift{},
+  m_inTransitPackets(DEFAULT_IN_TRANSIT_CAPACITY, InTransitSlot{0, 0, 0, false, 0}),
   m_packetHistory{},
   m_pktSizeSum{0},
+  m_ceCount{0},
+  m_feedbackCount{0},
+  m_sentBytes{0},
+  m_ackedBytes{0},
+  m_recvRateEstimator{},
+  m_recvRateOverhead{0},
   m_id{},
   m_initBw{RMCAT_CC_DEFAULT_RINIT},
   m_minBw{RMCAT_CC_DEFAULT_RMIN},
   m_maxBw{RMCAT_CC_DEFAULT_RMAX},
   m_logCallback{NULL},
-  m_ilState{},
-  m_historyLengthUs{DEFAULT_HISTORY_LENGTH_US} {
+  m_statsSink{},
+  m_diagnostics{},
+  m_verboseDiagnostics{false},
+  m_lossIntervals{},
+  m_latestMetrics{},
+  m_lastSeqProcessed{0},
+  m_lastSeqProcessedValid{false},
+  m_historyLengthUs{DEFAULT_HISTORY_LENGTH_US},
+  m_owdMinFilter{DEFAULT_MIN_FILTER_NTAPS},
+  m_rttMinFilter{DEFAULT_MIN_FILTER_NTAPS},
+  m_owdMaxFilter{},
+  m_diagIntervalUs{DEFAULT_DIAG_INTERVAL_US},
+  m_diagLastUs{0},
+  m_diagLastValid{false},
+  m_diagLogged{} {
       setDefaultId();
 }
 
@@ -96,80 +124,330 @@ void SenderBasedController::setLogCallback(logCallback f) {
     m_logCallback = f;
 }
 
+void SenderBasedController::setStatsSink(std::shared_ptr<StatsSink> sink) {
+    m_statsSink = sink;
+}
+
+void SenderBasedController::setBaseDelayWindow(size_t nBuckets, uint64_t bucketUs) {
+    m_baseDelay.setWindow(nBuckets, bucketUs);
+}
+
+void SenderBasedController::setClockDriftCompensation(bool enable) {
+    m_driftCompensation = enable;
+    m_clockDrift.reset();
+}
+
+bool SenderBasedController::getClockDrift(double& driftPpm) const {
+    if (!m_driftCompensation || !m_clockDrift.valid()) {
+        return false;
+    }
+    driftPpm = m_clockDrift.getDriftPpm();
+    return true;
+}
+
+void SenderBasedController::setRecvRateEstimator(std::shared_ptr<RecvRateEstimator> estimator) {
+    m_recvRateEstimator = estimator;
+    if (m_recvRateEstimator) {
+        m_recvRateEstimator->reset();
+    }
+}
+
+void SenderBasedController::setRecvRateOverhead(uint32_t bytesPerPacket) {
+    m_recvRateOverhead = bytesPerPacket;
+}
+
+void SenderBasedController::setVerboseDiagnostics(bool verbose) {
+    m_verboseDiagnostics = verbose;
+}
+
+void SenderBasedController::setDiagnosticsInterval(uint64_t intervalUs) {
+    m_diagIntervalUs = intervalUs;
+}
+
+const SenderBasedController::Diagnostics& SenderBasedController::getDiagnostics() const {
+    return m_diagnostics;
+}
+
+void SenderBasedController::saveState(std::ostream& os, uint64_t nowUs) const {
+    const std::streamsize precision = os.precision(STATE_PRECISION);
+    os << STATE_MAGIC << ' ' << STATE_VERSION << '\n';
+    saveStateFields(os, nowUs);
+    os.precision(precision);
+}
+
+bool SenderBasedController::loadState(std::istream& is, uint64_t nowUs) {
+    std::string magic;
+    uint32_t version = 0;
+    if (!(is >> magic >> version) || magic != STATE_MAGIC || version != STATE_VERSION) {
+        std::cerr << "SenderBasedController::loadState,"
+                  << " not a snapshot, or unsupported version" << std::endl;
+        return false;
+    }
+    if (!loadStateFields(is, nowUs)) {
+        std::cerr << "SenderBasedController::loadState,"
+                  << " invalid or truncated snapshot" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SenderBasedController::readStateTag(std::istream& is, const char* tag) {
+    std::string word;
+    return (is >> word) && word == tag;
+}
+
+/*
+ * Send timestamps are written as ages, i.e., nowUs minus the timestamp,
+ * which wraps properly. Delays and sequences are written as they are
+ */
+void SenderBasedController::saveStateFields(std::ostream& os, uint64_t nowUs) const {
+    os << "sequence " << m_firstSend << ' ' << m_lastSequence << '\n';
+    os << "basedelay ";
+    m_baseDelay.saveState(os, nowUs);
+    os << "drift " << m_driftCompensation << ' ';
+    m_clockDrift.saveState(os, nowUs);
+    os << "lossintervals ";
+    m_lossIntervals.saveState(os);
+    const MetricsSnapshot& metrics = m_latestMetrics;
+    os << "metrics " << metrics.qdelayValid << ' ' << metrics.qdelayUs
+       << ' ' << metrics.rttValid << ' ' << metrics.rttUs
+       << ' ' << metrics.qdelayMaxValid << ' ' << metrics.qdelayMaxUs
+       << ' ' << metrics.lossValid << ' ' << metrics.nLoss << ' ' << metrics.plr
+       << ' ' << metrics.rrateValid << ' ' << metrics.rrateBps
+       << ' ' << metrics.markValid << ' ' << metrics.nMarked << ' ' << metrics.pmr
+       << ' ' << metrics.lossIntervalValid << ' ' << metrics.avgInterval
+       << ' ' << metrics.currentInterval << '\n';
+    os << "history " << m_packetHistory.size() << '\n';
+    for (size_t i = 0; i < m_packetHistory.size(); ++i) {
+        const PacketRecord packet = m_packetHistory.at(i);
+        os << packet.sequence << ' ' << (nowUs - packet.txTimestampUs)
+           << ' ' << packet.size << ' ' << packet.owdUs
+           << ' ' << packet.rttUs << ' ' << uint32_t(packet.ecn) << '\n';
+    }
+}
+
+bool SenderBasedController::loadStateFields(std::istream& is, uint64_t nowUs) {
+    if (!readStateTag(is, "sequence") || !(is >> m_firstSend >> m_lastSequence)) {
+        return false;
+    }
+    if (!readStateTag(is, "basedelay") || !m_baseDelay.loadState(is, nowUs)) {
+        return false;
+    }
+    if (!readStateTag(is, "drift") || !(is >> m_driftCompensation) ||
+        !m_clockDrift.loadState(is, nowUs)) {
+        return false;
+    }
+    if (!readStateTag(is, "lossintervals") || !m_lossIntervals.loadState(is)) {
+        return false;
+    }
+    MetricsSnapshot& metrics = m_latestMetrics;
+    metrics = MetricsSnapshot{};
+    if (!readStateTag(is, "metrics") ||
+        !(is >> metrics.qdelayValid >> metrics.qdelayUs
+             >> metrics.rttValid >> metrics.rttUs
+             >> metrics.qdelayMaxValid >> metrics.qdelayMaxUs
+             >> metrics.lossValid >> metrics.nLoss >> metrics.plr
+             >> metrics.rrateValid >> metrics.rrateBps
+             >> metrics.markValid >> metrics.nMarked >> metrics.pmr
+             >> metrics.lossIntervalValid >> metrics.avgInterval
+             >> metrics.currentInterval)) {
+        return false;
+    }
+    metrics.nowUs = nowUs;
+    size_t historyLen = 0;
+    if (!readStateTag(is, "history") || !(is >> historyLen)) {
+        return false;
+    }
+    clearHistory();
+    for (size_t i = 0; i < historyLen; ++i) {
+        PacketRecord packet{0, 0, 0, 0, 0, 0};
+        uint64_t ageUs = 0;
+        uint32_t ecn = 0;
+        if (!(is >> packet.sequence >> ageUs >> packet.size
+                 >> packet.owdUs >> packet.rttUs >> ecn)) {
+            return false;
+        }
+        if (packet.sequence > m_lastSequence ||
+            (!m_packetHistory.empty() && packet.sequence <= m_packetHistory.back().sequence)) {
+            return false;
+        }
+        packet.txTimestampUs = nowUs - ageUs;
+        packet.ecn = uint8_t(ecn);
+        m_packetHistory.push_back(packet);
+        m_pktSizeSum += packet.size;
+        if (packet.ecn == ECN_CE) {
+            ++m_ceCount;
+        }
+    }
+    rebuildFilters();
+    metrics.historyLen = m_packetHistory.size();
+    // The packets in the snapshot were processed before it was taken
+    m_lastSeqProcessedValid = !m_packetHistory.empty();
+    m_lastSeqProcessed = m_lastSeqProcessedValid ? m_packetHistory.back().sequence : 0;
+
+    // Packets in transit are not part of the snapshot: their feedback,
+    // if any, will be ignored
+    for (auto& slot : m_inTransitPackets) {
+        slot.valid = false;
+    }
+    m_ackedBytes = m_sentBytes;
+    m_rebaseSequence = !m_firstSend;
+    m_diagLastValid = false;
+    return true;
+}
+
 void SenderBasedController::reset() {
     m_firstSend = true;
     m_lastSequence = 0;
-    m_baseDelayUs = 0;
-    m_inTransitPackets.clear();
-    m_packetHistory.clear();
-    m_pktSizeSum = 0;
+    m_rebaseSequence = false;
+    m_baseDelay.setWindow(BaseDelayTracker::DEFAULT_N_BUCKETS, BaseDelayTracker::DEFAULT_BUCKET_US);
+    m_driftCompensation = false;
+    m_clockDrift.reset();
+    m_inTransitPackets.assign(DEFAULT_IN_TRANSIT_CAPACITY, InTransitSlot{0, 0, 0, false, 0});
+    clearHistory();
     m_initBw = RMCAT_CC_DEFAULT_RINIT;
     m_minBw = RMCAT_CC_DEFAULT_RMIN;
     m_maxBw = RMCAT_CC_DEFAULT_RMAX;
     m_logCallback = NULL;
-    m_ilState = InterLossState{};
+    m_statsSink.reset();
+    m_recvRateEstimator.reset();
+    m_recvRateOverhead = 0;
+    m_diagnostics = Diagnostics{};
+    m_verboseDiagnostics = false;
+    m_diagIntervalUs = DEFAULT_DIAG_INTERVAL_US;
+    m_diagLastUs = 0;
+    m_diagLastValid = false;
+    m_diagLogged = Diagnostics{};
+    m_lossIntervals.reset(0);
+    m_latestMetrics = MetricsSnapshot{};
+    m_lastSeqProcessed = 0;
+    m_lastSeqProcessedValid = false;
+    m_feedbackCount = 0;
+    m_sentBytes = 0;
+    m_ackedBytes = 0;
     m_historyLengthUs = DEFAULT_HISTORY_LENGTH_US;
+    setMinFilterWindow(DEFAULT_MIN_FILTER_NTAPS);
     setDefaultId();
 }
 
-//TODO (deferred): This logic is to be encapsulated within class InterLossState
-void SenderBasedController::updateInterLossData(uint16_t sequence) {
-    if (m_packetHistory.empty()) {
-        m_ilState = InterLossState{}; // Reset
-        m_ilState.expectedSeq = sequence;
+void SenderBasedController::clearHistory() {
+    m_packetHistory.clear();
+    m_pktSizeSum = 0;
+    m_ceCount = 0;
+    if (m_recvRateEstimator) {
+        m_recvRateEstimator->reset();
     }
+    m_owdMinFilter.reset();
+    m_rttMinFilter.reset();
+    m_owdMaxFilter.reset();
+}
 
-    // update state for TFRC-style inter-loss interval calculation
-    if (sequence == m_ilState.expectedSeq) {
-        assert(m_ilState.intervals[0] < std::numeric_limits<uint32_t>::max());
-        ++m_ilState.intervals[0];
-        ++m_ilState.expectedSeq;
-        return;
+void SenderBasedController::rebuildFilters() {
+    m_owdMinFilter.reset();
+    m_rttMinFilter.reset();
+    m_owdMaxFilter.reset();
+    for (size_t i = 0; i < m_packetHistory.size(); ++i) {
+        const uint64_t txTimestampUs = m_packetHistory.txTimestampAt(i);
+        m_owdMinFilter.update(m_packetHistory.owdAt(i), txTimestampUs);
+        m_rttMinFilter.update(m_packetHistory.rttAt(i), txTimestampUs);
+        m_owdMaxFilter.update(m_packetHistory.owdAt(i), txTimestampUs);
     }
-    assert(lessThan(m_ilState.expectedSeq, sequence));
-    m_ilState.intervals.push_front(1); // Start new interval; shift the existing ones
-    if (m_ilState.intervals.size() > 9) {
-        m_ilState.intervals.pop_back();
+}
+
+/*
+ * Extend a sequence received on the wire to 64 bits, as RTP receivers do:
+ * the extended sequence is the one closest to that of the last packet sent
+ * whose lower 16 bits match
+ */
+uint64_t SenderBasedController::extendSequence(uint16_t sequence) const {
+    const int16_t delta = int16_t(uint16_t(sequence - uint16_t(m_lastSequence)));
+    return m_lastSequence + int64_t(delta);
+}
+
+/*
+ * One way delay of a packet, minus the estimated clock drift trend if
+ * the compensation is enabled
+ */
+uint64_t SenderBasedController::measureOwd(uint64_t txTimestampUs, uint64_t rxTimestampUs) {
+    // This subtraction can wrap if clocks aren't synchronized, but it's OK
+    const uint64_t owdUs = rxTimestampUs - txTimestampUs;
+    if (!m_driftCompensation) {
+        return owdUs;
     }
+    m_clockDrift.update(owdUs, txTimestampUs);
+    // This subtraction will wrap properly, even if the offset is negative
+    return owdUs - uint64_t(m_clockDrift.getOffsetUs(txTimestampUs));
+}
+
+void SenderBasedController::addToLossRun(LossRun& run, uint64_t sequence) {
+    if (run.length > 0 && sequence == run.firstSeq + run.length) {
+        ++run.length;
+        return;
+    }
+    flushLossRun(run);
+    run.firstSeq = sequence;
+    run.length = 1;
+}
 
-    m_ilState.expectedSeq = sequence + 1;
-    m_ilState.initialized = true;
+void SenderBasedController::flushLossRun(LossRun& run) {
+    if (run.length > 0) {
+        m_lossIntervals.addReceived(run.firstSeq, run.length);
+        run.length = 0;
+    }
 }
 
 bool SenderBasedController::processSendPacket(uint64_t txTimestampUs,
                                               uint16_t sequence,
                                               uint32_t size) {
     if (m_firstSend) {
-        m_lastSequence = sequence - 1;
+        // Extended sequences start one cycle up, so that feedback on
+        // sequences before the first one sent does not underflow
+        m_lastSequence = SEQUENCE_CYCLE + sequence - 1;
         m_firstSend = false;
     }
 
-    ++m_lastSequence;
-
-    if (sequence != m_lastSequence) {
-        std::cerr << "SenderBasedController::ProcessSendPacket,"
-                  << " illegal sequence: " << sequence
-                  << ", should be " << m_lastSequence << std::endl;
-        return false;
+    if (m_rebaseSequence) {
+        // First packet after loading a snapshot: renumber the extended
+        // sequences so that it follows the last packet in the snapshot
+        const uint64_t delta = uint16_t(sequence - 1 - uint16_t(m_lastSequence));
+        m_lastSequence += delta;
+        m_packetHistory.shiftSequences(delta);
+        m_lossIntervals.shiftSequences(delta);
+        if (m_lastSeqProcessedValid) {
+            m_lastSeqProcessed += delta;
+        }
+        m_rebaseSequence = false;
     }
 
-    // record sent packets in local record
-    m_inTransitPackets.push_back(PacketRecord{m_lastSequence,
-                                              txTimestampUs,
-                                              size,
-                                              0,
-                                              0});
-    // Memory safety: timestamps of in-transit packets must be
-    //  within (10 * MAX_INTER_PACKET_TIME)
-    while (true) {
-        const uint64_t firstTimestampUs = m_inTransitPackets.front().txTimestampUs;
-        if (lessThan(firstTimestampUs + 10 * MAX_INTER_PACKET_TIME_US,
-                     txTimestampUs)) {
-            m_inTransitPackets.pop_front();
-        } else {
-            break;
+    ++m_lastSequence;
+
+    if (sequence != uint16_t(m_lastSequence)) {
+        ++m_diagnostics.illegalSendSequence;
+        if (m_verboseDiagnostics) {
+            std::cerr << "SenderBasedController::ProcessSendPacket,"
+                      << " illegal sequence: " << sequence
+                      << ", should be " << uint16_t(m_lastSequence) << std::endl;
         }
+        // Resynchronize on forward gaps (e.g., send records dropped by the
+        // caller) and record this packet, so that its feedback is matched.
+        // Only the skipped sequences will be accounted for as losses
+        if (!lessThan(uint16_t(m_lastSequence), sequence)) {
+            --m_lastSequence;
+            return false;
+        }
+        m_lastSequence += uint16_t(sequence - uint16_t(m_lastSequence));
     }
+
+    // record sent packets in local record. Memory safety: the ring has
+    // a fixed capacity; the oldest record using the same slot, if still
+    // valid, is overwritten
+    m_sentBytes += size;
+    const size_t mask = m_inTransitPackets.size() - 1;
+    m_inTransitPackets[m_lastSequence & mask] = InTransitSlot{txTimestampUs,
+                                                              size,
+                                                              m_lastSequence,
+                                                              true,
+                                                              m_sentBytes};
     return true;
 }
 
@@ -177,60 +455,138 @@ bool SenderBasedController::processFeedback(uint64_t nowUs,
                                             uint16_t sequence,
                                             uint64_t rxTimestampUs,
                                             uint8_t ecn) {
-    if (lessThan(m_lastSequence, sequence)) {
-        std::cerr << "SenderBasedController::ProcessFeedback,"
-                  << " strange sequence: " << sequence
-                  << " from the future" << std::endl;
+    const uint64_t extSequence = extendSequence(sequence);
+    if (m_firstSend || m_lastSequence < extSequence) {
+        ++m_diagnostics.futureFeedback;
+        if (m_verboseDiagnostics) {
+            std::cerr << "SenderBasedController::ProcessFeedback,"
+                      << " strange sequence: " << sequence
+                      << " from the future" << std::endl;
+        }
+        logDiagnostics(nowUs);
         return false;
     }
 
-    if (m_inTransitPackets.empty()) {
-        std::cerr << "SenderBasedController::ProcessFeedback,"
-                  << " sequence: " << sequence
-                  << " duplicate or out of order" << std::endl;
-        // Returning true because it is considered valid to process
-        // duplicate/out of order sequences
+    LossRun run{0, 0};
+    const bool res = ingestFeedback(nowUs, extSequence, rxTimestampUs, ecn, run);
+    flushLossRun(run);
+    collectGarbage();
+    logDiagnostics(nowUs);
+    return res;
+}
+
+bool SenderBasedController::processFeedbackBatch(uint64_t nowUs,
+                                                 const std::vector<FeedbackItem>& feedbackBatch) {
+    if (m_firstSend) {
+        // Nothing sent yet: all the feedback is from the future, and skipped
+        m_diagnostics.futureFeedback += feedbackBatch.size();
+        logDiagnostics(nowUs);
         return true;
     }
 
-    assert(m_inTransitPackets.back().sequence == m_lastSequence);
-
-    while (lessThan(m_inTransitPackets.front().sequence, sequence)) {
-        // Packet lost or out of order. Remove stale entry
-        m_inTransitPackets.pop_front();
-        // Note: we can't tell whether the media (forward path) packet
-        //     or the feedback (backward path) packet was lost.
-        // Assuming media packet was lost for the time being
+    // Append all records. Items from the future are skipped (and counted)
+    // one by one, so that they do not invalidate the rest of the batch.
+    // Consecutive sequences are accounted for in the inter-loss intervals
+    // as a single run, and the history is garbage collected only once, at
+    // the end
+    bool res = true;
+    LossRun run{0, 0};
+    for (const auto& fbItem : feedbackBatch) {
+        assert(lessThan(fbItem.rxTimestampUs, nowUs));
+        const uint64_t extSequence = extendSequence(fbItem.sequence);
+        if (m_lastSequence < extSequence) {
+            ++m_diagnostics.futureFeedback;
+            if (m_verboseDiagnostics) {
+                std::cerr << "SenderBasedController::ProcessFeedbackBatch,"
+                          << " strange sequence: " << fbItem.sequence
+                          << " from the future" << std::endl;
+            }
+            continue;
+        }
+        if (!ingestFeedback(nowUs, extSequence, fbItem.rxTimestampUs, fbItem.ecn, run)) {
+            res = false;
+            break;
+        }
     }
+    flushLossRun(run);
+    collectGarbage();
+    logDiagnostics(nowUs);
+    return res;
+}
 
-    if (lessThan(sequence, m_inTransitPackets.front().sequence)) {
-        std::cerr << "SenderBasedController::ProcessFeedback,"
-                  << " sequence: " << sequence
-                  << " out of order" << std::endl;
+/*
+ * Match the feedback of a (validated) sequence with its in-transit record,
+ * and append the resulting packet record to the history. The inter-loss
+ * accounting of the appended sequence is deferred to the caller via run,
+ * and the history is not garbage collected
+ */
+bool SenderBasedController::ingestFeedback(uint64_t nowUs,
+                                           uint64_t sequence,
+                                           uint64_t rxTimestampUs,
+                                           uint8_t ecn,
+                                           LossRun& run) {
+    const size_t mask = m_inTransitPackets.size() - 1;
+    InTransitSlot& slot = m_inTransitPackets[sequence & mask];
+    if (!slot.valid || slot.sequence != sequence) {
+        ++m_diagnostics.duplicateFeedback;
+        if (m_verboseDiagnostics) {
+            std::cerr << "SenderBasedController::ProcessFeedback,"
+                      << " sequence: " << uint16_t(sequence)
+                      << " duplicate or too old" << std::endl;
+        }
+        // Returning true because it is considered valid to process
+        // duplicate/out of order sequences
         return true;
     }
 
-    PacketRecord packet = m_inTransitPackets.front();
-    m_inTransitPackets.pop_front();
-    assert(sequence == packet.sequence);
+    PacketRecord packet{slot.sequence, slot.txTimestampUs, slot.size, 0, 0, ecn};
+    slot.valid = false;
+    // The bytes sent up to the newest packet acknowledged are no longer in flight
+    m_ackedBytes = std::max(m_ackedBytes, slot.sentBytes);
 
     if (!m_packetHistory.empty()) {
-        const PacketRecord& lastPacket = m_packetHistory.back();
+        const PacketRecord lastPacket = m_packetHistory.back();
+        if (packet.sequence < lastPacket.sequence) {
+            // Feedback out of order: the packet was considered lost when
+            // the feedback of later packets arrived
+            packet.owdUs = measureOwd(packet.txTimestampUs, rxTimestampUs);
+            packet.rttUs = nowUs - packet.txTimestampUs;
+            if (insertLatePacket(packet)) {
+                ++m_diagnostics.reorderedFeedback;
+                ++m_feedbackCount;
+                // The receive time is older than that of later packets:
+                // the estimators count the packet as received now
+                if (m_recvRateEstimator) {
+                    m_recvRateEstimator->update(rxTimestampUs, packet.size + m_recvRateOverhead);
+                }
+            } else {
+                ++m_diagnostics.tooLateFeedback;
+                if (m_verboseDiagnostics) {
+                    std::cerr << "SenderBasedController::ProcessFeedback,"
+                              << " sequence: " << uint16_t(sequence)
+                              << " out of order, older than packet history" << std::endl;
+                }
+            }
+            return true;
+        }
         if (lessThan(packet.txTimestampUs, lastPacket.txTimestampUs)) {
-            std::cerr << "SenderBasedController::ProcessFeedback,"
-                      << " sequence: " << sequence
-                      << " has decreasing timestamp " << packet.txTimestampUs
-                      << " w.r.t. sequence " << lastPacket.sequence
-                      << " with timestamp " << lastPacket.txTimestampUs
-                      << std::endl;
+            ++m_diagnostics.decreasingTimestamp;
+            if (m_verboseDiagnostics) {
+                std::cerr << "SenderBasedController::ProcessFeedback,"
+                          << " sequence: " << uint16_t(sequence)
+                          << " has decreasing timestamp " << packet.txTimestampUs
+                          << " w.r.t. sequence " << uint16_t(lastPacket.sequence)
+                          << " with timestamp " << lastPacket.txTimestampUs
+                          << std::endl;
+            }
             return false;
         }
         if (lessThan(lastPacket.txTimestampUs + MAX_INTER_PACKET_TIME_US,
                      packet.txTimestampUs)) {
             // It's been too long without receiving any feedback packet
             // Packet history is obsolete
-            m_packetHistory.clear();
-            m_pktSizeSum = 0;
+            ++m_diagnostics.historyResets;
+            clearHistory();
         }
     }
 
@@ -238,46 +594,138 @@ bool SenderBasedController::processFeedback(uint64_t nowUs,
     assert(packet.owdUs == 0);
     assert(packet.rttUs == 0);
 
-    // This subtraction can wrap if clocks aren't synchronized, but it's OK
-    packet.owdUs = rxTimestampUs - packet.txTimestampUs;
+    packet.owdUs = measureOwd(packet.txTimestampUs, rxTimestampUs);
     packet.rttUs = nowUs - packet.txTimestampUs;
 
-    if (m_packetHistory.empty() || lessThan(packet.owdUs, m_baseDelayUs)) {
-        m_baseDelayUs = packet.owdUs;
+    if (m_packetHistory.empty()) {
+        // The inter-loss intervals restart along with the history
+        flushLossRun(run);
+        m_lossIntervals.reset(packet.sequence);
     }
+    m_baseDelay.update(packet.owdUs, packet.txTimestampUs);
 
-    updateInterLossData(packet.sequence);
+    addToLossRun(run, packet.sequence);
 
     m_packetHistory.push_back(packet);
     m_pktSizeSum += packet.size;
+    ++m_feedbackCount;
+    if (packet.ecn == ECN_CE) {
+        ++m_ceCount;
+    }
+    if (m_recvRateEstimator) {
+        m_recvRateEstimator->update(rxTimestampUs, packet.size + m_recvRateOverhead);
+    }
+    m_owdMinFilter.update(packet.owdUs, packet.txTimestampUs);
+    m_rttMinFilter.update(packet.rttUs, packet.txTimestampUs);
+    m_owdMaxFilter.update(packet.owdUs, packet.txTimestampUs);
+    return true;
+}
 
-    // Garbage collect history to keep its length within limits
+// Garbage collect history to keep its length within limits
+void SenderBasedController::collectGarbage() {
+    if (m_packetHistory.empty()) {
+        return;
+    }
+    const uint64_t lastTimestampUs = m_packetHistory.back().txTimestampUs;
     while (true) {
-        const uint64_t lastTimestampUs = m_packetHistory.back().txTimestampUs;
-        const uint64_t firstTimestampUs = m_packetHistory.front().txTimestampUs;
+        const uint64_t firstTimestampUs = m_packetHistory.txTimestampAt(0);
         assert (!lessThan(lastTimestampUs, firstTimestampUs));
         if (lessThan(lastTimestampUs, firstTimestampUs + m_historyLengthUs)) {
             break;
         }
-        const uint32_t firstSize = m_packetHistory.front().size;
+        const uint32_t firstSize = m_packetHistory.sizeAt(0);
+        const bool firstMarked = m_packetHistory.ecnAt(0) == ECN_CE;
         m_packetHistory.pop_front();
         assert(m_pktSizeSum >= firstSize);
         m_pktSizeSum -= firstSize;
+        if (firstMarked) {
+            assert(m_ceCount > 0);
+            --m_ceCount;
+        }
     }
-    return true;
+    // The filters must not contain garbage-collected packets
+    m_owdMinFilter.trimToLast(m_packetHistory.size());
+    m_rttMinFilter.trimToLast(m_packetHistory.size());
+    m_owdMaxFilter.trimToLast(m_packetHistory.size());
 }
 
-bool SenderBasedController::processFeedbackBatch(uint64_t nowUs,
-                                                 const std::vector<FeedbackItem>& feedbackBatch) {
-    for (const auto& fbItem : feedbackBatch) {
-        assert(lessThan(fbItem.rxTimestampUs, nowUs));
-        if(!processFeedback(nowUs, fbItem.sequence, fbItem.rxTimestampUs, fbItem.ecn)) {
-            return false;
-        }
+/*
+ * Insert a packet whose feedback arrived after that of later packets. The
+ * packet is placed in the history according to its sequence, so that
+ * losses are no longer accounted for it. It is a rare event, so a linear
+ * search (from the back of the history) and a full rebuild of the filters
+ * are acceptable. The inter-loss intervals are not modified: the loss event
+ * has already been accounted for, and TFRC does not revert loss events.
+ *
+ * The packet is too late if it is older than the history, as the history
+ * would be after garbage collection: in a batch, the history is only
+ * garbage collected at the end, and the packets preceding this one in the
+ * batch may have made the oldest records garbage
+ */
+bool SenderBasedController::insertLatePacket(const PacketRecord& packet) {
+    assert(!m_packetHistory.empty());
+    size_t pos = m_packetHistory.size();
+    while (pos > 0 && packet.sequence < m_packetHistory.sequenceAt(pos - 1)) {
+        --pos;
     }
+    const uint64_t lastTimestampUs = m_packetHistory.back().txTimestampUs;
+    if (pos == 0 ||
+        !lessThan(lastTimestampUs, m_packetHistory.txTimestampAt(pos - 1) + m_historyLengthUs)) {
+        return false;
+    }
+    assert(m_packetHistory.sequenceAt(pos - 1) != packet.sequence);
+    m_packetHistory.insert(pos, packet);
+    m_pktSizeSum += packet.size;
+    if (packet.ecn == ECN_CE) {
+        ++m_ceCount;
+    }
+
+    // The send time is older than that of later packets: the tracker
+    // accounts for the delay in its newest bucket, without expiring any
+    m_baseDelay.update(packet.owdUs, packet.txTimestampUs);
+    rebuildFilters();
     return true;
 }
 
+/*
+ * Log a summary of the diagnostics counters, at most once per configured
+ * interval, and only if they changed since the last summary
+ */
+void SenderBasedController::logDiagnostics(uint64_t nowUs) {
+    if (m_diagIntervalUs == 0) {
+        return;
+    }
+    if (!m_diagLastValid) {
+        m_diagLastUs = nowUs;
+        m_diagLastValid = true;
+        return;
+    }
+    // This subtraction will wrap properly
+    if (nowUs - m_diagLastUs < m_diagIntervalUs) {
+        return;
+    }
+    m_diagLastUs = nowUs;
+    if (std::memcmp(&m_diagnostics, &m_diagLogged, sizeof(Diagnostics)) == 0) {
+        return;
+    }
+    m_diagLogged = m_diagnostics;
+
+    std::ostringstream os;
+    os << " diag " << m_id
+       << " ts: "      << (nowUs / 1000)
+       << " illseq: "  << m_diagnostics.illegalSendSequence
+       << " future: "  << m_diagnostics.futureFeedback
+       << " dup: "     << m_diagnostics.duplicateFeedback
+       << " reord: "   << m_diagnostics.reorderedFeedback
+       << " late: "    << m_diagnostics.tooLateFeedback
+       << " dects: "   << m_diagnostics.decreasingTimestamp
+       << " resets: "  << m_diagnostics.historyResets
+       << " empty: "   << m_diagnostics.emptyHistory
+       << " short: "   << m_diagnostics.shortHistory
+       << " simrx: "   << m_diagnostics.simultaneousRx;
+    logMessage(os.str());
+}
+
 void SenderBasedController::setHistoryLength(uint64_t lenUs) {
     m_historyLengthUs = lenUs;
 }
@@ -286,146 +734,297 @@ uint64_t SenderBasedController::getHistoryLength() const {
     return m_historyLengthUs;
 }
 
+uint64_t SenderBasedController::getFeedbackCount() const {
+    return m_feedbackCount;
+}
+
+bool SenderBasedController::canSend(uint64_t nowUs, uint32_t size) const {
+    return true;
+}
+
+uint64_t SenderBasedController::getBytesInFlight() const {
+    return m_sentBytes - m_ackedBytes;
+}
+
+void SenderBasedController::setInTransitCapacity(size_t capacity) {
+    size_t newCapacity = 1;
+    while (newCapacity < capacity && newCapacity < MAX_IN_TRANSIT_CAPACITY) {
+        newCapacity <<= 1;
+    }
+    std::vector<InTransitSlot> newRing(newCapacity, InTransitSlot{0, 0, 0, false, 0});
+    // Keep the records of the packets still in transit, if they fit
+    for (const auto& slot : m_inTransitPackets) {
+        if (!slot.valid) {
+            continue;
+        }
+        InTransitSlot& newSlot = newRing[slot.sequence & (newCapacity - 1)];
+        if (!newSlot.valid || newSlot.sequence < slot.sequence) {
+            newSlot = slot;
+        }
+    }
+    m_inTransitPackets.swap(newRing);
+}
+
+void SenderBasedController::setMinFilterWindow(size_t ntaps, uint64_t windowUs) {
+    m_owdMinFilter.setWindow(ntaps, windowUs);
+    m_rttMinFilter.setWindow(ntaps, windowUs);
+}
+
 // These functions calculate different metrics based on the feedback received.
 // Although they could be considered part of the NADA algorithm, we have
 // defined them in the superclass because they could also be useful to other
 // algorithms
-bool SenderBasedController::getCurrentQdelay(uint64_t& qdelayUs) const {
-    // 15-tab minimum filtering
-    const size_t ntab = 15;
+bool SenderBasedController::computeMetrics(uint64_t nowUs, MetricsSnapshot& metrics) const {
+    metrics = MetricsSnapshot{};
+    metrics.nowUs = nowUs;
+    metrics.historyLen = m_packetHistory.size();
+
+    // Inter-loss intervals do not depend on the current history
+    metrics.lossIntervalValid = m_lossIntervals.getLossIntervalInfo(metrics.avgInterval,
+                                                                    metrics.currentInterval);
+
     if (m_packetHistory.empty()) {
-        std::cerr << "SenderBasedController::getCurrentQdelay,"
-                  << " cannot calculate qdelay, packet history is empty"
-                  << std::endl;
         return false;
     }
 
-    uint64_t qDelayMinUs = 0;
-    size_t iter = 0;
-    for (auto rit = m_packetHistory.rbegin();
-            rit != m_packetHistory.rend();
-            ++rit) {
-        const uint64_t qDelayCurrentUs = rit->owdUs - m_baseDelayUs;
-        if (iter > 0) {
-            qDelayMinUs = std::min(qDelayMinUs, qDelayCurrentUs);
-        } else {
-            qDelayMinUs = qDelayCurrentUs;
-        }
-        if (++iter >= ntab) {
-            break;
+    // The base delay is common to all samples, so the minimum queuing delay
+    // is the minimum one way delay minus the base delay. The base delay's
+    // window normally covers the whole history, so these subtractions will
+    // wrap properly; with a shorter window, the base delay may have expired
+    // above some samples, in which case the queuing delay is zero
+    assert(!m_owdMinFilter.empty());
+    assert(!m_rttMinFilter.empty());
+    assert(!m_owdMaxFilter.empty());
+    assert(!m_baseDelay.empty());
+    const uint64_t baseDelayUs = m_baseDelay.get();
+    const uint64_t owdMinUs = m_owdMinFilter.get();
+    const uint64_t owdMaxUs = m_owdMaxFilter.get();
+    metrics.qdelayUs = lessThan(owdMinUs, baseDelayUs) ? 0 : owdMinUs - baseDelayUs;
+    metrics.qdelayValid = true;
+    metrics.rttUs = m_rttMinFilter.get();
+    metrics.rttValid = true;
+    metrics.qdelayMaxUs = lessThan(owdMaxUs, baseDelayUs) ? 0 : owdMaxUs - baseDelayUs;
+    metrics.qdelayMaxValid = true;
+
+    // A receive rate estimator decides on its own whether it has enough samples
+    if (m_recvRateEstimator) {
+        metrics.rrateValid = m_recvRateEstimator->getRate(metrics.rrateBps);
+    }
+
+    if (m_packetHistory.size() < MIN_PACKET_LOGLEN) {
+        return true;
+    }
+
+    // Loss and receive rate metrics share the ends of the history
+    const PacketRecord front = m_packetHistory.front();
+    const PacketRecord back = m_packetHistory.back();
+
+    // Extended sequences do not wrap, however long the history is
+    const uint64_t seqSpan = 1u + back.sequence - front.sequence;
+    assert(seqSpan >= m_packetHistory.size());
+    metrics.nLoss = seqSpan - m_packetHistory.size();
+    metrics.plr = float(metrics.nLoss) / float(seqSpan);
+    metrics.lossValid = true;
+
+    assert(m_ceCount <= m_packetHistory.size());
+    metrics.nMarked = m_ceCount;
+    metrics.pmr = float(m_ceCount) / float(m_packetHistory.size());
+    metrics.markValid = true;
+
+    // The history is ordered by sequence, not by receive time: if the
+    // first packet was reordered, it may have been received after the last
+    // one, in which case the receive rate is not valid
+    const uint64_t firstRxUs = front.txTimestampUs + front.owdUs;
+    const uint64_t lastRxUs = back.txTimestampUs + back.owdUs;
+    if (!m_recvRateEstimator && lessThan(firstRxUs, lastRxUs)) {
+        const uint64_t timeSpanUs = lastRxUs - firstRxUs;
+        // Technically, the first packet is out of the calculated time span
+        assert(front.size <= m_pktSizeSum);
+        const uint64_t overhead = uint64_t(m_recvRateOverhead) * (m_packetHistory.size() - 1);
+        const uint64_t bytes = m_pktSizeSum - front.size + overhead;
+        metrics.rrateBps = float(bytes * 8) * 1000.f * 1000.f / float(timeSpanUs);
+        metrics.rrateValid = true;
+    }
+    return true;
+}
+
+void SenderBasedController::updateLatestMetrics(uint64_t nowUs) {
+    MetricsSnapshot metrics;
+    computeMetrics(nowUs, metrics);
+
+    MetricsSnapshot& latest = m_latestMetrics;
+    latest.nowUs = metrics.nowUs;
+    latest.historyLen = metrics.historyLen;
+    latest.qdelayValid = metrics.qdelayValid;
+    if (metrics.qdelayValid) latest.qdelayUs = metrics.qdelayUs;
+    latest.rttValid = metrics.rttValid;
+    if (metrics.rttValid) latest.rttUs = metrics.rttUs;
+    latest.qdelayMaxValid = metrics.qdelayMaxValid;
+    if (metrics.qdelayMaxValid) latest.qdelayMaxUs = metrics.qdelayMaxUs;
+    latest.lossValid = metrics.lossValid;
+    if (metrics.lossValid) {
+        latest.nLoss = metrics.nLoss;
+        latest.plr = metrics.plr;
+    }
+    latest.rrateValid = metrics.rrateValid;
+    if (metrics.rrateValid) latest.rrateBps = metrics.rrateBps;
+    latest.markValid = metrics.markValid;
+    if (metrics.markValid) {
+        latest.nMarked = metrics.nMarked;
+        latest.pmr = metrics.pmr;
+    }
+    latest.lossIntervalValid = metrics.lossIntervalValid;
+    if (metrics.lossIntervalValid) {
+        latest.avgInterval = metrics.avgInterval;
+        latest.currentInterval = metrics.currentInterval;
+    }
+}
+
+void SenderBasedController::fillStatsRecord(uint64_t nowUs,
+                                            uint64_t deltaUs,
+                                            StatsRecord& record) const {
+    record = StatsRecord{};
+    record.timestampUs = nowUs;
+    record.deltaUs = deltaUs;
+    record.loglen = m_packetHistory.size();
+    record.qdelayUs = m_latestMetrics.qdelayUs;
+    record.rttUs = m_latestMetrics.rttUs;
+    record.ploss = m_latestMetrics.nLoss;
+    record.plr = m_latestMetrics.plr;
+    record.pmr = m_latestMetrics.pmr;
+    record.rrateBps = m_latestMetrics.rrateBps;
+    record.avgInt = m_latestMetrics.avgInterval;
+    record.currInt = m_latestMetrics.currentInterval;
+}
+
+size_t SenderBasedController::firstNewPacket() const {
+    size_t first = m_packetHistory.size();
+    while (first > 0 &&
+           (!m_lastSeqProcessedValid || m_lastSeqProcessed < m_packetHistory.sequenceAt(first - 1))) {
+        --first;
+    }
+    return first;
+}
+
+void SenderBasedController::markPacketsProcessed() {
+    if (firstNewPacket() < m_packetHistory.size()) {
+        m_lastSeqProcessed = m_packetHistory.back().sequence;
+        m_lastSeqProcessedValid = true;
+    }
+}
+
+bool SenderBasedController::getCurrentQdelay(uint64_t& qdelayUs) const {
+    MetricsSnapshot metrics;
+    computeMetrics(0, metrics);
+    if (!metrics.qdelayValid) {
+        ++m_diagnostics.emptyHistory;
+        if (m_verboseDiagnostics) {
+            std::cerr << "SenderBasedController::getCurrentQdelay,"
+                      << " cannot calculate qdelay, packet history is empty"
+                      << std::endl;
         }
+        return false;
     }
-    qdelayUs = qDelayMinUs;
+    qdelayUs = metrics.qdelayUs;
     return true;
 }
 
 bool SenderBasedController::getCurrentRTT(uint64_t& rttUs) const {
-    // 15-tab minimum filtering
-    const size_t ntab = 15;
-    if (m_packetHistory.empty()) {
-        std::cerr << "SenderBasedController::getCurrentRTT,"
-                  << " cannot calculate rtt, packet history is empty"
-                  << std::endl;
+    MetricsSnapshot metrics;
+    computeMetrics(0, metrics);
+    if (!metrics.rttValid) {
+        ++m_diagnostics.emptyHistory;
+        if (m_verboseDiagnostics) {
+            std::cerr << "SenderBasedController::getCurrentRTT,"
+                      << " cannot calculate rtt, packet history is empty"
+                      << std::endl;
+        }
         return false;
     }
+    rttUs = metrics.rttUs;
+    return true;
+}
 
-    uint64_t rttMinUs = 0;
-    size_t iter = 0;
-    for (auto rit = m_packetHistory.rbegin();
-            rit != m_packetHistory.rend();
-            ++rit) {
-        const uint64_t rttCurrentUs = rit->rttUs;
-        if (iter > 0) {
-            rttMinUs = std::min(rttMinUs, rttCurrentUs);
-        } else {
-            rttMinUs = rttCurrentUs;
-        }
-        if (++iter >= ntab) {
-            break;
+bool SenderBasedController::getMaxQdelay(uint64_t& qdelayMaxUs) const {
+    MetricsSnapshot metrics;
+    computeMetrics(0, metrics);
+    if (!metrics.qdelayMaxValid) {
+        ++m_diagnostics.emptyHistory;
+        if (m_verboseDiagnostics) {
+            std::cerr << "SenderBasedController::getMaxQdelay,"
+                      << " cannot calculate max qdelay, packet history is empty"
+                      << std::endl;
         }
+        return false;
     }
-
-    rttUs = rttMinUs;
+    qdelayMaxUs = metrics.qdelayMaxUs;
     return true;
 }
 
 bool SenderBasedController::getPktLossInfo(uint32_t& nLoss, float& plr) const {
-    if (m_packetHistory.size() < MIN_PACKET_LOGLEN) {
-        std::cerr << "SenderBasedController::getPktLossInfo,"
-                  << " packet history too short: "
-                  << m_packetHistory.size()
-                  << " < " << MIN_PACKET_LOGLEN << std::endl;
+    MetricsSnapshot metrics;
+    computeMetrics(0, metrics);
+    if (!metrics.lossValid) {
+        ++m_diagnostics.shortHistory;
+        if (m_verboseDiagnostics) {
+            std::cerr << "SenderBasedController::getPktLossInfo,"
+                      << " packet history too short: "
+                      << metrics.historyLen
+                      << " < " << MIN_PACKET_LOGLEN << std::endl;
+        }
         return false;
     }
-
-    // This will wrap properly
-    const uint16_t seqSpan = 1u + m_packetHistory.back().sequence
-                             - m_packetHistory.front().sequence;
-    assert(seqSpan >= m_packetHistory.size());
-    nLoss = seqSpan - m_packetHistory.size();
-    plr = float(nLoss) / float(seqSpan);
+    nLoss = metrics.nLoss;
+    plr = metrics.plr;
     return true;
 }
 
 bool SenderBasedController::getCurrentRecvRate(float& rrateBps) const {
-    if (m_packetHistory.size() < MIN_PACKET_LOGLEN) {
-        std::cerr << "SenderBasedController::getCurrentRecvRate,"
-                  << " packet history too short: "
-                  << m_packetHistory.size()
-                  << " < " << MIN_PACKET_LOGLEN << std::endl;
+    MetricsSnapshot metrics;
+    computeMetrics(0, metrics);
+    if (!metrics.rrateValid) {
+        if (metrics.historyLen < MIN_PACKET_LOGLEN) {
+            ++m_diagnostics.shortHistory;
+            if (m_verboseDiagnostics) {
+                std::cerr << "SenderBasedController::getCurrentRecvRate,"
+                          << " packet history too short: "
+                          << metrics.historyLen
+                          << " < " << MIN_PACKET_LOGLEN << std::endl;
+            }
+        } else {
+            ++m_diagnostics.simultaneousRx;
+            if (m_verboseDiagnostics) {
+                std::cerr << "SenderBasedController::getCurrentRecvRate,"
+                          << " cannot calculate receive rate, the first packet"
+                          << " was not received before the last one" << std::endl;
+            }
+        }
         return false;
     }
+    rrateBps = metrics.rrateBps;
+    return true;
+}
 
-    const PacketRecord& front = m_packetHistory.front();
-    const PacketRecord& back = m_packetHistory.back();
-    const uint64_t firstRxUs = front.txTimestampUs + front.owdUs;
-    const uint64_t lastRxUs = back.txTimestampUs + back.owdUs;
-    assert(lessThan(firstRxUs, lastRxUs + 1));
-    uint64_t timeSpanUs = lastRxUs - firstRxUs;
-
-    if (timeSpanUs == 0) {
-        std::cerr << "SenderBasedController::getCurrentRecvRate,"
-                  << " cannot calculate receive rate,"
-                  << " all packets were received simultaneously" << std::endl;
+bool SenderBasedController::getEcnMarkingInfo(uint32_t& nMarked, float& pmr) const {
+    MetricsSnapshot metrics;
+    computeMetrics(0, metrics);
+    if (!metrics.markValid) {
+        ++m_diagnostics.shortHistory;
+        if (m_verboseDiagnostics) {
+            std::cerr << "SenderBasedController::getEcnMarkingInfo,"
+                      << " packet history too short: "
+                      << metrics.historyLen
+                      << " < " << MIN_PACKET_LOGLEN << std::endl;
+        }
         return false;
     }
-
-    // Technically, the first packet is out of the calculated time span
-    assert(front.size <= m_pktSizeSum);
-    const uint32_t bytes = m_pktSizeSum - front.size;
-    rrateBps = float(bytes * 8) * 1000.f * 1000.f / float(timeSpanUs);
+    nMarked = metrics.nMarked;
+    pmr = metrics.pmr;
     return true;
 }
 
-
 bool SenderBasedController::getLossIntervalInfo(float& avgInterval, uint32_t& currentInterval) const {
-    if (!m_ilState.initialized) {
-        return false; // No losses yet --> no intervals
-    }
-
-    const size_t k = m_ilState.intervals.size();
-    assert(k >= 2 && k <= 9);
-
-    static std::vector<float> weights{};
-    // Values are 1, 1, 1, 1, .8, .6, .4, .2
-    if (weights.empty()) {
-        const size_t n = 8;
-        for (size_t i = 0; i < n; ++i) {
-            weights.push_back((i < n / 2) ? 1.f : 2.f * float(n - i) / float(n + 2));
-        }
-    }
-
-    const float iSum0 = std::inner_product(m_ilState.intervals.begin(),
-                                           m_ilState.intervals.end() - 1,
-                                           weights.begin(), 0.f);
-    const float iSum1 = std::inner_product(m_ilState.intervals.begin() + 1,
-                                           m_ilState.intervals.end(),
-                                           weights.begin(), 0.f);
-    const float wSum = std::accumulate(weights.begin(), weights.begin() + (k - 1), 0.f);
-    const float iAvgMax = std::max(iSum0, iSum1) / wSum;
-    avgInterval = iAvgMax;
-    currentInterval = m_ilState.intervals.front();
-    return true;
+    return m_lossIntervals.getLossIntervalInfo(avgInterval, currentInterval);
 }
 
 void SenderBasedController::logMessage(const std::string& log) const {
@@ -436,4 +1035,16 @@ void SenderBasedController::logMessage(const std::string& log) const {
     }
 }
 
+void SenderBasedController::reportStats(const char* algo, StatsRecord& record) const {
+    std::strncpy(record.algo, algo, STATS_ALGO_LEN - 1);
+    record.algo[STATS_ALGO_LEN - 1] = '\0';
+    std::strncpy(record.id, m_id.c_str(), STATS_ID_LEN - 1);
+    record.id[STATS_ID_LEN - 1] = '\0';
+    if (m_statsSink) {
+        m_statsSink->writeStats(record);
+    } else {
+        logMessage(formatStatsRecord(record));
+    }
+}
+
 }
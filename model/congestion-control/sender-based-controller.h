@@ -29,10 +29,18 @@
 #ifndef SENDER_BASED_CONTROLLER_H
 #define SENDER_BASED_CONTROLLER_H
 
+#include "windowed-filter.h"
+#include "packet-history.h"
+#include "stats-sink.h"
+#include "loss-interval-estimator.h"
+#include "base-delay-tracker.h"
+#include "clock-drift-estimator.h"
+#include "recv-rate-estimator.h"
 #include <cstdint>
+#include <iostream>
 #include <string>
-#include <deque>
 #include <vector>
+#include <memory>
 #include <tuple>
 #include <utility>
 
@@ -41,18 +49,6 @@ namespace rmcat {
 
 const uint32_t RMCAT_LOG_PRINT_PRECISION = 2;  /* default precision for logs */
 
-/**
- * This class keeps track of the length of intervals between two packet
- * loss events, in the way TCP-friendly Rate Control (TFRC) calculates it
- */
-class InterLossState {
-public:
-    InterLossState();
-    std::deque<uint32_t> intervals;
-    uint16_t expectedSeq;
-    bool initialized; // did the first loss happen?
-};
-
 /**
  * This is the base class to all congestion controllers. Any congestion
  * controller that is to use this NS3 component has to inherit from this
@@ -103,20 +99,62 @@ public:
         uint8_t ecn;
     };
 
-    /** To avoid future complexity and defects, we make the following
-     *  assumptions regarding wrapping of unsigned integers:
-     *    - sequences, uint16_t, can wrap (just like TCP)
-     *    - timestamps (microseconds), uint64_t, can wrap (despite being 64 bits long)
-     *    - delays (microseconds), uint64_t, can wrap (easily), as they are
-     *      obtained from subtraction of timestamps obtained at different endpoints,
-     *      which may have non-synchronized clocks.
+    /**
+     * Record of a packet sent, and then acknowledged via feedback.
+     * See #rmcat::PacketRecord for the assumptions on wrapping
      */
-    struct PacketRecord {
-        uint16_t sequence;
-        uint64_t txTimestampUs;
-        uint32_t size;
-        uint64_t owdUs;
-        uint64_t rttUs;
+    typedef rmcat::PacketRecord PacketRecord;
+
+    /**
+     * Consistent view of all the metrics calculated by the superclass,
+     * obtained in a single pass over the controller's state (see
+     * #computeMetrics ). Each metric (or group of metrics) comes with a
+     * flag telling whether it could be calculated; if the flag is false,
+     * the corresponding values are not valid
+     */
+    struct MetricsSnapshot {
+        uint64_t nowUs;          /**< Time at which the snapshot was taken */
+        size_t historyLen;       /**< Number of packets in the history */
+
+        bool qdelayValid;
+        uint64_t qdelayUs;       /**< See #getCurrentQdelay */
+        bool rttValid;
+        uint64_t rttUs;          /**< See #getCurrentRTT */
+        bool qdelayMaxValid;
+        uint64_t qdelayMaxUs;    /**< See #getMaxQdelay */
+
+        bool lossValid;
+        uint32_t nLoss;          /**< See #getPktLossInfo */
+        float plr;               /**< See #getPktLossInfo */
+        bool rrateValid;
+        float rrateBps;          /**< See #getCurrentRecvRate */
+        bool markValid;
+        uint32_t nMarked;        /**< See #getEcnMarkingInfo */
+        float pmr;               /**< See #getEcnMarkingInfo */
+
+        bool lossIntervalValid;
+        float avgInterval;       /**< See #getLossIntervalInfo */
+        uint32_t currentInterval; /**< See #getLossIntervalInfo */
+    };
+
+    /**
+     * Counters of the anomalies detected while processing packets and
+     * feedback, or while calculating metrics. They are cheap to update,
+     * unlike logging every single event, which can flood the logs in lossy
+     * scenarios. See #getDiagnostics , #setVerboseDiagnostics and
+     * #setDiagnosticsInterval
+     */
+    struct Diagnostics {
+        uint64_t illegalSendSequence; /**< Packets sent with an unexpected sequence */
+        uint64_t futureFeedback;      /**< Feedback on sequences not sent yet */
+        uint64_t duplicateFeedback;   /**< Feedback duplicated, or too old to be in transit */
+        uint64_t reorderedFeedback;   /**< Feedback out of order, inserted in the history */
+        uint64_t tooLateFeedback;     /**< Feedback out of order, older than the history */
+        uint64_t decreasingTimestamp; /**< Feedback on packets with decreasing send timestamps */
+        uint64_t historyResets;       /**< Packet history discarded as obsolete */
+        uint64_t emptyHistory;        /**< Metric queries failed: empty history */
+        uint64_t shortHistory;        /**< Metric queries failed: too few packets in history */
+        uint64_t simultaneousRx;      /**< Receive rate queries failed: null (or negative) time span */
     };
 
     /** Class constructor */
@@ -130,14 +168,14 @@ public:
      *
      * @param [in] id A string denoting the flow's id
      */
-    void setId(const std::string& id);
+    virtual void setId(const std::string& id);
 
     /**
      * Set the initial bandwidth estimation
      *
      * @param [in] initBw Initial bandwidth estimation
      */
-    void setInitBw(float initBw);
+    virtual void setInitBw(float initBw);
 
     /**
      * Set the minimal bandwidth. Controllers should never output
@@ -145,7 +183,7 @@ public:
      *
      * @param [in] initBw Minimal bandwidth
      */
-    void setMinBw(float minBw);
+    virtual void setMinBw(float minBw);
 
     /**
      * Set the maximal bandwidth. Controllers should never output
@@ -153,7 +191,7 @@ public:
      *
      * @param [in] initBw Maximal bandwidth
      */
-    void setMaxBw(float maxBw);
+    virtual void setMaxBw(float maxBw);
 
     /**
      * Set the current bandwidth estimation. This can be useful in test environments
@@ -170,7 +208,132 @@ public:
      * @param [in] f Logging function to be called from the congestion
      *               controller implementation
      */
-    void setLogCallback(logCallback f);
+    virtual void setLogCallback(logCallback f);
+
+    /**
+     * Set the statistics sink. Congestion controllers report a structured
+     * #StatsRecord to this sink upon each rate update. If no sink is set,
+     * the records are formatted as text lines and passed to the logging
+     * callback (see #setLogCallback )
+     *
+     * @param [in] sink Statistics sink; a null pointer restores the text
+     *                  logging path
+     */
+    virtual void setStatsSink(std::shared_ptr<StatsSink> sink);
+
+    /**
+     * Set the window over which the base delay (i.e., propagation delay
+     * plus clock offset) is estimated as the minimum one way delay. The
+     * window is divided into buckets; the minimum of a bucket expires once
+     * nBuckets newer buckets have been started, so that the base delay
+     * follows route changes and clock drift. Defaults to LEDBAT's
+     * ten one-minute buckets
+     *
+     * @param [in] nBuckets Number of buckets in the window, must be positive.
+     *                      It should be at least 2, so that the window always
+     *                      covers the packet history
+     * @param [in] bucketUs Length of a bucket, in microseconds
+     */
+    virtual void setBaseDelayWindow(size_t nBuckets, uint64_t bucketUs);
+
+    /**
+     * Enable or disable the compensation of the clock drift between the
+     * sender and the receiver. If enabled, the drift is estimated online
+     * (see #ClockDriftEstimator ), and the resulting delay trend is
+     * subtracted from the one way delays, so that it is not mistaken for
+     * queuing delay. Disabled by default
+     *
+     * @param [in] enable Whether to compensate the clock drift
+     */
+    virtual void setClockDriftCompensation(bool enable);
+
+    /**
+     * Get the current estimation of the clock drift. It is only available
+     * if the compensation is enabled (see #setClockDriftCompensation )
+     *
+     * @param [out] driftPpm Drift of the receiver's clock w.r.t. the sender's,
+     *                       in parts per million
+     * @retval False if no estimation is available yet, true otherwise
+     */
+    virtual bool getClockDrift(double& driftPpm) const;
+
+    /**
+     * Set the estimator of the receive rate (see #getCurrentRecvRate ), e.g.,
+     * a #WindowRecvRateEstimator , #EwmaRecvRateEstimator or
+     * #FrameRecvRateEstimator , with its own window, independent of the
+     * history length. If no estimator is set, the receive rate is calculated
+     * over the whole packet history
+     *
+     * @param [in] estimator Receive rate estimator; a null pointer restores
+     *                       the calculation over the packet history
+     */
+    virtual void setRecvRateEstimator(std::shared_ptr<RecvRateEstimator> estimator);
+
+    /**
+     * Set the per-packet overhead (e.g., IP, UDP and RTP headers) counted
+     * in the receive rate on top of the packet sizes passed to
+     * #processSendPacket . Zero by default
+     *
+     * @param [in] bytesPerPacket Overhead of each packet, in bytes
+     */
+    virtual void setRecvRateOverhead(uint32_t bytesPerPacket);
+
+    /**
+     * Enable or disable verbose diagnostics. If enabled, every anomaly
+     * counted in #Diagnostics is also reported individually to stderr.
+     * Disabled by default
+     *
+     * @param [in] verbose Whether to report every anomaly individually
+     */
+    virtual void setVerboseDiagnostics(bool verbose);
+
+    /**
+     * Set the interval at which a summary of the #Diagnostics counters is
+     * logged (via the logging callback). The summary is only logged if
+     * any counter has changed since the last one
+     *
+     * @param [in] intervalUs Interval, in microseconds, between summaries.
+     *                        Zero disables the summaries
+     */
+    virtual void setDiagnosticsInterval(uint64_t intervalUs);
+
+    /** @retval The current values of the diagnostics counters */
+    virtual const Diagnostics& getDiagnostics() const;
+
+    /**
+     * Write a snapshot of the controller's state to a stream, as text, so
+     * that a controller can later be warm-started from it (see #loadState ).
+     * The snapshot contains the packet history, the inter-loss intervals,
+     * the latest metrics (see #updateLatestMetrics ), the base delay and
+     * clock drift estimations, plus the state of the algorithm itself.
+     * It does not contain the configuration (e.g.,
+     * bandwidth bounds, id, callbacks), the packets still in transit, nor
+     * the state of the receive rate estimator (see #setRecvRateEstimator )
+     *
+     * Timestamps are written relative to nowUs. Thus, if the snapshot is
+     * loaded at a different time, the controller's timeline is shifted
+     * accordingly: the state is restored as if no time had elapsed
+     *
+     * @param [in,out] os Output stream
+     * @param [in] nowUs The time (in microseconds) at which this function is called
+     */
+    virtual void saveState(std::ostream& os, uint64_t nowUs) const;
+
+    /**
+     * Restore the state written by #saveState of the same algorithm.
+     * The configuration of this controller is kept. The sender may restart
+     * sequences anywhere: they are renumbered on the first packet sent
+     * after the call, as if it followed the last packet sent before the
+     * snapshot
+     *
+     * @param [in,out] is Input stream
+     * @param [in] nowUs The time (in microseconds) at which this function is
+     *                   called; it is mapped to the time passed to #saveState
+     * @retval False if the stream does not contain a valid snapshot. The
+     *         controller's state is then undefined, and the controller
+     *         must be reset (see #reset ). True otherwise
+     */
+    virtual bool loadState(std::istream& is, uint64_t nowUs);
 
     /**
      * This API call will reset the internal state of the congestion
@@ -200,9 +363,13 @@ public:
      *                  This can be changed, though
      * @retval true if all went well, false if there was an error
      *
-     * @note There are two ways this function can fail:
+     * @note A forward gap in the sequences is counted (see #Diagnostics ),
+     *       and the packet is recorded: the skipped sequences will be
+     *       accounted for as lost.
+     *       There are two ways this function can fail:
      *       - returning false: this means that a problem was detected in
-     *                          the input parameters (e.g., bad sequence)
+     *                          the input parameters (e.g., sequence going
+     *                          backwards)
      *       - asserting (crashing): this means there is a bug in the
      *                               function's logic
      */
@@ -244,13 +411,23 @@ public:
      * If aggregated feedback is received from the receiver endpoint, this function
      * offers the send application a way to process the aggregated feedback as a batch
      *
-     * This member function is not pure virtual, as contains a base implementation that
-     * calls function #processSendPacket in a loop
+     * This member function is not pure virtual, as it contains a native batch
+     * implementation: all records are appended to the history, inter-loss
+     * intervals are updated per run of consecutive sequences, and the history
+     * is garbage collected once at the end. Items from the future (or too old
+     * to be told apart from the future) are skipped and counted one by one
+     * (see Diagnostics::futureFeedback ): unlike #processFeedback , which
+     * returns false for such an item, they do not fail the batch, so that
+     * one stale item does not discard the feedback of the others.
+     * Note that it does not call #processFeedback ; subclasses that react to
+     * feedback must also override this function
      *
      * @param [in] nowUs The time (in microseconds) at which this function is called
      * @param [in] feedbackBatch A vector of items containing sequence numbers, receive
      *             timestamps (in microseconds), and ECN marking values of
      *             the aggregated feedback
+     * @retval true if all went well, false if an item was invalid (e.g., with
+     *         a decreasing send timestamp); the items after it are not processed
      */
     virtual bool processFeedbackBatch(uint64_t nowUs,
                                       const std::vector<FeedbackItem>& feedbackBatch);
@@ -266,6 +443,32 @@ public:
      */
     virtual float getBandwidth(uint64_t nowUs) const =0;
 
+    /**
+     * Window-based congestion controllers gate the packets sent, on top of
+     * the rate returned by #getBandwidth . The sender application calls this
+     * function before sending each packet: if it returns false, the packet
+     * is held back until more feedback has been processed
+     *
+     * This member function is not pure virtual: rate-based controllers
+     * need not override it, as this implementation always allows sending
+     *
+     * @param [in] nowUs The time (in microseconds) at which this function is called
+     * @param [in] size Size of the packet to be sent, in bytes
+     * @retval true if the packet can be sent now, false otherwise
+     */
+    virtual bool canSend(uint64_t nowUs, uint32_t size) const;
+
+    /**
+     * Get the number of bytes in flight, as defined in rfc8298: the size of
+     * the packets sent after the newest (i.e., highest sequence) packet
+     * acknowledged. Packets sent before it do not count, even if they were
+     * lost. Packets in transit when a snapshot is loaded do not count either.
+     * Wrappers report the wrapped controller's value
+     *
+     * @retval The number of bytes in flight
+     */
+    virtual uint64_t getBytesInFlight() const;
+
 protected:
     /** A "less than" operator for unsigned integers that supports wrapping */
     template <typename UINT>
@@ -293,12 +496,58 @@ protected:
      */
     uint64_t getHistoryLength() const;
 
+    /**
+     * Set the window of the minimum filters used to calculate the current
+     * queuing delay (see #getCurrentQdelay ) and round trip time (see
+     * #getCurrentRTT ). The window never extends beyond the packets
+     * contained in the current history
+     *
+     * @param [in] ntaps Number of most recent packets in the window (zero
+     *                   means no limit)
+     * @param [in] windowUs Time window, in microseconds, measured on the
+     *                      packets' send timestamps (zero means no limit)
+     */
+    void setMinFilterWindow(size_t ntaps, uint64_t windowUs=0);
+
+    /**
+     * Set the capacity of the buffer keeping track of in-transit packets
+     * (i.e., sent packets for which no feedback has been received yet).
+     * The buffer is indexed by sequence number, so a packet's record is
+     * kept until #capacity packets have been sent after it. Feedback
+     * arriving later than that is ignored
+     *
+     * @param [in] capacity Maximum number of in-transit packet records.
+     *                      It is rounded up to a power of two, and capped
+     *                      to half the sequence number space (32768), the
+     *                      distance within which wire sequences are told apart
+     */
+    void setInTransitCapacity(size_t capacity);
+
+    /**
+     * Number of feedback records taken into account (i.e., added to the
+     * packet history) since the last #reset . Comparing its values at
+     * different times tells whether any new feedback has arrived in between
+     *
+     * @retval The number of feedback records taken into account
+     */
+    uint64_t getFeedbackCount() const;
+
     /**
      * Function used to log messages. It calls the message logging callback
      * if has been set, otherwise it logs to stdout
      */
     void logMessage(const std::string& log) const;
 
+    /**
+     * Function used to report statistics. It fills in the algorithm name
+     * and the controller's id, then passes the record to the statistics
+     * sink if it has been set, otherwise it logs it as a text line
+     *
+     * @param [in] algo Name of the algorithm, e.g., "nada"
+     * @param [in,out] record Statistics record, all other fields filled in
+     */
+    void reportStats(const char* algo, StatsRecord& record) const;
+
     /*
      * The functions below calculate different delay and loss
      * metrics based on the received feedback. Although they can
@@ -307,8 +556,55 @@ protected:
      * to other algorithms
      * */
 
+    /**
+     * Calculate all the metrics below in one go. Unlike the individual
+     * getters, this function does not log anything when a metric cannot be
+     * calculated: it just clears the corresponding validity flag
+     *
+     * @param [in] nowUs The time (in microseconds) at which this function is called
+     * @param [out] metrics The calculated metrics, along with their validity flags
+     * @retval False if the current history is empty (no metric is valid,
+     *         except, possibly, the inter-loss intervals). True otherwise
+     */
+    bool computeMetrics(uint64_t nowUs, MetricsSnapshot& metrics) const;
+
+    /**
+     * Calculate all the metrics (see #computeMetrics ) into
+     * #m_latestMetrics . A metric that cannot be calculated keeps its
+     * previous value, but its validity flag is cleared
+     *
+     * @param [in] nowUs The time (in microseconds) at which this function is called
+     */
+    void updateLatestMetrics(uint64_t nowUs);
+
+    /**
+     * Fill in a statistics record with the common stats in #m_latestMetrics .
+     * The algorithm-specific fields (xcurr, srateBps) are left to the caller,
+     * which then passes the record to #reportStats
+     *
+     * @param [in] nowUs Time of the update
+     * @param [in] deltaUs Time since the previous update
+     * @param [out] record The statistics record
+     */
+    void fillStatsRecord(uint64_t nowUs, uint64_t deltaUs, StatsRecord& record) const;
+
+    /**
+     * Index in the history of the oldest packet acknowledged since the last
+     * call to #markPacketsProcessed . The history is ordered by sequence, so
+     * the new packets are those from this index to the back; packets
+     * inserted late (reordered) before #m_lastSeqProcessed are not new
+     *
+     * @retval The index of the first new packet (the history's size if none)
+     */
+    size_t firstNewPacket() const;
+
+    /** Mark all packets in the history as processed (see #firstNewPacket ) */
+    void markPacketsProcessed();
+
     /*
-     * Calculate current queuing delay (qdelay)
+     * Calculate current queuing delay (qdelay), as the minimum of the
+     * queuing delays observed within the min filter window
+     * (see #setMinFilterWindow )
      *
      * @param [out] qdelayUs Queuing delay in microseconds during current history length
      * @retval False if the current history is empty (output parameter is not
@@ -317,7 +613,9 @@ protected:
     bool getCurrentQdelay(uint64_t& qdelayUs) const;
 
     /**
-     * Calculate current round trip time (rtt)
+     * Calculate current round trip time (rtt), as the minimum of the
+     * round trip times observed within the min filter window
+     * (see #setMinFilterWindow )
      *
      * @param [out] rttUs Round trip time in microseconds during current history length
      * @retval False if the current history is empty (output parameter is not
@@ -325,6 +623,18 @@ protected:
      */
     bool getCurrentRTT(uint64_t& rttUs) const;
 
+    /**
+     * Calculate the maximum queuing delay experienced by any packet in the
+     * current history. As the base delay is subtracted at query time, the
+     * result is always consistent with the current base delay estimation
+     *
+     * @param [out] qdelayMaxUs Maximum queuing delay in microseconds during
+     *                          current history length
+     * @retval False if the current history is empty (output parameter is not
+     *         valid). True otherwise
+     */
+    bool getMaxQdelay(uint64_t& qdelayMaxUs) const;
+
     /**
      * Calculate current info on packet losses
      *
@@ -348,6 +658,21 @@ protected:
      */
     bool getCurrentRecvRate(float& rrateBps) const;
 
+    /**
+     * Calculate current info on ECN marking, i.e., on the packets the
+     * receiver got with the Congestion Experienced (CE) codepoint. If the
+     * path (or the sender) is not ECN-capable, no packet is ever marked
+     *
+     * @param [out] nMarked Number of CE-marked packets received during
+     *                      current history length
+     * @param [out] pmr Marking ratio (marks per packet received) for the
+     *                  current history length
+     * @retval False if the current history does not contain enough packets to
+     *         calculate the metrics (output parameters are not valid). True
+     *         otherwise
+     */
+    bool getEcnMarkingInfo(uint32_t& nMarked, float& pmr) const;
+
     /**
      * Calculate the current average inter-loss interval. A loss event is
      * the loss of one or more consecutive packets (loss burst). An
@@ -364,28 +689,91 @@ protected:
      */
     bool getLossIntervalInfo(float& avgInterval, uint32_t& currentInterval) const;
 
+    /**
+     * Write the state to a snapshot (see #saveState ). Subclasses with
+     * state of their own should call the superclass's method first, and
+     * then append their state in a section starting with a tag
+     * (see #readStateTag )
+     */
+    virtual void saveStateFields(std::ostream& os, uint64_t nowUs) const;
+
+    /**
+     * Read the state from a snapshot (see #loadState ). Subclasses
+     * overriding #saveStateFields should override this function accordingly
+     *
+     * @retval False if the stream does not contain valid state
+     */
+    virtual bool loadStateFields(std::istream& is, uint64_t nowUs);
+
+    /**
+     * Read the tag starting a section of a snapshot
+     *
+     * @retval False if the next word in the stream is not the tag
+     */
+    static bool readStateTag(std::istream& is, const char* tag);
+
     bool m_firstSend; /**< true if at least one packet has been sent */
-    uint16_t m_lastSequence; /**< sequence of the last packet sent */
+    /**
+     * Extended (64-bit) sequence of the last packet sent. Its 16 lower bits
+     * are the sequence on the wire; the upper bits count the wraps, so that
+     * sequences are unambiguous no matter how many packets are in flight or
+     * in the history (see #extendSequence )
+     */
+    uint64_t m_lastSequence;
+    /**
+     * Whether the sequences are to be renumbered on the next packet sent,
+     * after a snapshot has been loaded (see #loadState )
+     */
+    bool m_rebaseSequence;
     /**
      * Estimation of the network propagation delay, plus clock difference
-     * between sender and receiver endpoints. In microseconds
+     * between sender and receiver endpoints: minimum one way delay over a
+     * sliding window (see #setBaseDelayWindow ). It is kept when the
+     * packet history is cleared
      */
-    uint64_t m_baseDelayUs;
+    BaseDelayTracker m_baseDelay;
+    bool m_driftCompensation; /**< whether the clock drift is compensated */
+    ClockDriftEstimator m_clockDrift;
     /**
-     * Sent packets for which feedback has not been received yet
+     * Sent packets for which feedback has not been received yet. This is
+     * a fixed-capacity ring indexed by (the lower bits of) the extended
+     * sequence number; see #setInTransitCapacity
      */
-    std::deque<PacketRecord> m_inTransitPackets;
+    struct InTransitSlot {
+        uint64_t txTimestampUs;
+        uint32_t size;
+        uint64_t sequence; /**< extended sequence */
+        bool valid; /**< false if empty, or feedback already received */
+        uint64_t sentBytes; /**< value of #m_sentBytes once this packet was sent */
+    };
+    std::vector<InTransitSlot> m_inTransitPackets;
     /**
      * Packets for which feedback has already been received. Information
      * contained in these records will be used to calculate the different
      * metrics that congestion controllers use
      */
-    std::deque<PacketRecord> m_packetHistory;
+    PacketHistory m_packetHistory;
     /**
      * Maintains the sum of the size of all packets in #m_packetHistory .
      * This is done for efficiency reasons
      */
     uint32_t m_pktSizeSum;
+    /**
+     * Maintains the number of CE-marked packets in #m_packetHistory ,
+     * for the same reason
+     */
+    uint32_t m_ceCount;
+    uint64_t m_feedbackCount; /**< see #getFeedbackCount */
+    /**
+     * Bytes sent since the last #reset , and the part of them sent up to
+     * the newest packet acknowledged. Their difference is the number of
+     * bytes in flight (see #getBytesInFlight )
+     */
+    uint64_t m_sentBytes;
+    uint64_t m_ackedBytes;
+    /** Receive rate estimator; if null, the rate is calculated over the history */
+    std::shared_ptr<RecvRateEstimator> m_recvRateEstimator;
+    uint32_t m_recvRateOverhead; /**< per-packet overhead counted in the receive rate, in bytes */
 
     std::string m_id; /**< Id used for logging, and can be used for plotting */
 
@@ -394,14 +782,72 @@ protected:
     float m_maxBw;
 
     logCallback m_logCallback;
+    std::shared_ptr<StatsSink> m_statsSink;
+
+    /**
+     * Diagnostics counters. They are mutable, as they are also updated by
+     * the (const) metric calculation functions
+     */
+    mutable Diagnostics m_diagnostics;
+    bool m_verboseDiagnostics; /**< whether to report every anomaly to stderr */
+
+    LossIntervalEstimator m_lossIntervals;
 
-    InterLossState m_ilState;
+    /** Metrics as of the last call to #updateLatestMetrics */
+    MetricsSnapshot m_latestMetrics;
+    /**
+     * Extended sequence of the newest packet already processed by the
+     * subclass, if valid (see #firstNewPacket ). It is renumbered along
+     * with the history after a snapshot is loaded
+     */
+    uint64_t m_lastSeqProcessed;
+    bool m_lastSeqProcessedValid;
 
 private:
+    typedef WindowedFilter<uint64_t, WrapLess<uint64_t> > MinFilter;
+    typedef WindowedFilter<uint64_t, WrapGreater<uint64_t> > MaxFilter;
+
     uint64_t m_historyLengthUs; // in microseconds
 
+    /**
+     * Incremental minimum filters of the one way delay and round trip time
+     * of the packets in #m_packetHistory . They are kept in sync with the
+     * history, so that #getCurrentQdelay and #getCurrentRTT take O(1) time
+     */
+    MinFilter m_owdMinFilter;
+    MinFilter m_rttMinFilter;
+    /**
+     * Running maximum of the one way delay over the whole #m_packetHistory
+     * (no tap or time limit other than the history's garbage collection)
+     */
+    MaxFilter m_owdMaxFilter;
+
+    uint64_t m_diagIntervalUs;   /**< interval between diagnostics summaries */
+    uint64_t m_diagLastUs;       /**< time of last diagnostics summary check */
+    bool m_diagLastValid;        /**< whether m_diagLastUs is valid */
+    Diagnostics m_diagLogged;    /**< counters as of the last logged summary */
+
     void setDefaultId();
-    void updateInterLossData(uint16_t sequence);
+    void clearHistory();
+    void rebuildFilters();
+    /** Run of consecutive (extended) sequences pending inter-loss accounting */
+    struct LossRun {
+        uint64_t firstSeq;
+        uint32_t length;
+    };
+
+    uint64_t extendSequence(uint16_t sequence) const;
+    uint64_t measureOwd(uint64_t txTimestampUs, uint64_t rxTimestampUs);
+    bool ingestFeedback(uint64_t nowUs,
+                        uint64_t sequence,
+                        uint64_t rxTimestampUs,
+                        uint8_t ecn,
+                        LossRun& run);
+    void collectGarbage();
+    void logDiagnostics(uint64_t nowUs);
+    bool insertLatePacket(const PacketRecord& packet);
+    void addToLossRun(LossRun& run, uint64_t sequence);
+    void flushLossRun(LossRun& run);
 };
 
 }
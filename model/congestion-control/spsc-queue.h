@@ -0,0 +1,144 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Lock-free single-producer single-consumer queue for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace rmcat {
+
+/**
+ * Bounded, lock-free queue for exactly one producer thread and one
+ * consumer thread. It is a ring buffer whose capacity is a power of two;
+ * the producer only writes the tail index and the consumer only writes
+ * the head index, so no locks (nor compare-and-swap loops) are needed.
+ * Both operations are wait-free.
+ *
+ * The indices grow monotonically (wrapping is harmless, as only their
+ * difference is used) and are padded to separate cache lines to avoid
+ * false sharing between the two threads.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    /**
+     * Class constructor
+     *
+     * @param [in] capacity Maximum number of elements in the queue. It is
+     *                      rounded up to a power of two
+     */
+    explicit SpscQueue(size_t capacity)
+    : m_buffer{},
+      m_mask{0},
+      m_pad0{},
+      m_head{0},
+      m_pad1{},
+      m_tail{0},
+      m_pad2{} {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_buffer.resize(size);
+        m_mask = size - 1;
+    }
+
+    /** @retval Maximum number of elements in the queue */
+    size_t capacity() const { return m_mask + 1; }
+
+    /**
+     * Append an element to the queue. To be called from the producer thread only
+     *
+     * @param [in] item The element to append
+     * @retval False if the queue is full (the element is not appended). True otherwise
+     */
+    bool push(const T& item) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+            return false;
+        }
+        m_buffer[tail & m_mask] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Remove the oldest element from the queue. To be called from the
+     * consumer thread only
+     *
+     * @param [out] item The removed element
+     * @retval False if the queue is empty (output parameter is not valid).
+     *         True otherwise
+     */
+    bool pop(T& item) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = m_buffer[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Approximate number of elements in the queue: the value may be stale
+     * by the time it is returned if the other thread is active
+     */
+    size_t size() const {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Discard all elements. Neither thread may be using the queue
+     * while this function is called
+     */
+    void clear() {
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    std::vector<T> m_buffer;
+    size_t m_mask;
+    char m_pad0[CACHE_LINE_SIZE];
+    std::atomic<size_t> m_head; /**< Written by the consumer */
+    char m_pad1[CACHE_LINE_SIZE];
+    std::atomic<size_t> m_tail; /**< Written by the producer */
+    char m_pad2[CACHE_LINE_SIZE];
+};
+
+}
+
+#endif /* SPSC_QUEUE_H */
@@ -0,0 +1,119 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Structured statistics sinks implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "stats-sink.h"
+#include "sender-based-controller.h"
+#include <sstream>
+#include <iostream>
+#include <cinttypes>
+#include <cassert>
+
+namespace rmcat {
+
+std::string formatStatsRecord(const StatsRecord& record) {
+    std::ostringstream os;
+    os << std::fixed;
+    os.precision(RMCAT_LOG_PRINT_PRECISION);
+
+    os << " algo:"    << record.algo << " " << record.id
+       << " ts: "     << (record.timestampUs / 1000)
+       << " loglen: " << record.loglen
+       << " qdel: "   << (record.qdelayUs / 1000)
+       << " rtt: "    << (record.rttUs / 1000)
+       << " ploss: "  << record.ploss
+       << " plr: "    << record.plr
+       << " xcurr: "  << record.xcurr
+       << " rrate: "  << record.rrateBps
+       << " srate: "  << record.srateBps
+       << " avgint: " << record.avgInt
+       << " curint: " << record.currInt
+       << " delta: "  << (record.deltaUs / 1000);
+    return os.str();
+}
+
+TextStatsSink::TextStatsSink(logCallback f)
+: m_logCallback{f} {}
+
+TextStatsSink::~TextStatsSink() {}
+
+void TextStatsSink::writeStats(const StatsRecord& record) {
+    const std::string line = formatStatsRecord(record);
+    if (m_logCallback != NULL) {
+        m_logCallback(line);
+    } else {
+        std::cout << line << std::endl;
+    }
+}
+
+CsvStatsSink::CsvStatsSink(const std::string& fileName, size_t bufferRecords)
+: m_file{NULL},
+  m_buffer(bufferRecords > 0 ? bufferRecords : 1),
+  m_count{0} {
+    m_file = std::fopen(fileName.c_str(), "w");
+    if (m_file == NULL) {
+        std::cerr << "CsvStatsSink::CsvStatsSink,"
+                  << " cannot open file " << fileName
+                  << ", statistics will be discarded" << std::endl;
+        return;
+    }
+    std::fputs("algo,id,ts_us,delta_us,loglen,qdel_us,rtt_us,ploss,plr,"
+               "pmr,xcurr,rrate,srate,avgint,curint\n", m_file);
+}
+
+CsvStatsSink::~CsvStatsSink() {
+    flush();
+    if (m_file != NULL) {
+        std::fclose(m_file);
+    }
+}
+
+void CsvStatsSink::writeStats(const StatsRecord& record) {
+    assert(m_count < m_buffer.size());
+    m_buffer[m_count] = record;
+    ++m_count;
+    if (m_count == m_buffer.size()) {
+        flush();
+    }
+}
+
+void CsvStatsSink::flush() {
+    if (m_file != NULL) {
+        for (size_t i = 0; i < m_count; ++i) {
+            const StatsRecord& r = m_buffer[i];
+            std::fprintf(m_file,
+                         "%s,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu32 ",%" PRIu64 ",%" PRIu64
+                         ",%" PRIu32 ",%.6f,%.6f,%.6f,%.2f,%.2f,%.2f,%" PRIu32 "\n",
+                         r.algo, r.id, r.timestampUs, r.deltaUs, r.loglen,
+                         r.qdelayUs, r.rttUs, r.ploss, double(r.plr), double(r.pmr), double(r.xcurr),
+                         double(r.rrateBps), double(r.srateBps), double(r.avgInt), r.currInt);
+        }
+        std::fflush(m_file);
+    }
+    m_count = 0;
+}
+
+}
@@ -0,0 +1,155 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Structured statistics sinks for congestion controllers in rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef STATS_SINK_H
+#define STATS_SINK_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace rmcat {
+
+const size_t STATS_ALGO_LEN = 8;  /**< max length of the algorithm name, including terminator */
+const size_t STATS_ID_LEN = 48;   /**< max length of the flow id, including terminator */
+
+/**
+ * Statistics reported by a congestion controller upon each rate update.
+ * It is a plain old data structure, so that sinks can copy and buffer
+ * records without any allocation. Fields not applicable to an algorithm
+ * are set to zero
+ */
+struct StatsRecord {
+    char algo[STATS_ALGO_LEN]; /**< Algorithm name, e.g., "nada" */
+    char id[STATS_ID_LEN];     /**< Flow id (truncated if too long) */
+    uint64_t timestampUs;      /**< Time of the update */
+    uint64_t deltaUs;          /**< Time since previous update */
+    uint32_t loglen;           /**< Number of packets in the history */
+    uint64_t qdelayUs;         /**< Queuing delay */
+    uint64_t rttUs;            /**< Round trip time */
+    uint32_t ploss;            /**< Packets lost within the history */
+    float plr;                 /**< Packet loss ratio */
+    float pmr;                 /**< ECN marking ratio (not in the text log format) */
+    float xcurr;               /**< Aggregate congestion signal, in ms (x_curr in rmcat-nada) */
+    float rrateBps;            /**< Receive rate */
+    float srateBps;            /**< Sending rate (bandwidth estimation) */
+    float avgInt;              /**< Average inter-loss interval, in packets */
+    uint32_t currInt;          /**< Current inter-loss interval, in packets */
+};
+
+/**
+ * Interface of the consumers of the statistics records produced by the
+ * congestion controllers (see SenderBasedController::setStatsSink )
+ */
+class StatsSink {
+public:
+    virtual ~StatsSink() {}
+
+    /**
+     * Consume a statistics record. The record is only valid during the call
+     *
+     * @param [in] record The statistics record
+     */
+    virtual void writeStats(const StatsRecord& record) =0;
+
+    /** Write out any buffered records */
+    virtual void flush() {}
+};
+
+/**
+ * Sink discarding every record, e.g., to silence a controller without
+ * paying for the formatting of its log lines
+ */
+class NullStatsSink: public StatsSink {
+public:
+    virtual void writeStats(const StatsRecord&) {}
+};
+
+/**
+ * Format a record as the text line controllers have always logged, e.g.:
+ * " algo:nada <id> ts: <ms> loglen: <n> qdel: <ms> rtt: <ms> ploss: <n>
+ *   plr: <f> xcurr: <f> rrate: <f> srate: <f> avgint: <f> curint: <n> delta: <ms>"
+ * This is the format tools/process_test_logs.py parses
+ */
+std::string formatStatsRecord(const StatsRecord& record);
+
+/**
+ * Adapter to the text logging path: each record is formatted with
+ * #formatStatsRecord and passed to a logging callback
+ */
+class TextStatsSink: public StatsSink {
+public:
+    typedef void (*logCallback) (const std::string&);
+
+    /**
+     * Class constructor
+     *
+     * @param [in] f Logging function receiving the formatted lines
+     */
+    explicit TextStatsSink(logCallback f);
+    virtual ~TextStatsSink();
+
+    virtual void writeStats(const StatsRecord& record);
+
+private:
+    logCallback m_logCallback;
+};
+
+/**
+ * Buffered writer of statistics records to a CSV file (one header line,
+ * then one line per record). Records are copied into a preallocated buffer
+ * and only formatted when the buffer is full, when #flush is called, or
+ * upon destruction, which keeps formatting out of the rate update path
+ */
+class CsvStatsSink: public StatsSink {
+public:
+    /**
+     * Class constructor
+     *
+     * @param [in] fileName Name of the CSV file to create
+     * @param [in] bufferRecords Number of records buffered before writing
+     */
+    explicit CsvStatsSink(const std::string& fileName, size_t bufferRecords=1024);
+    virtual ~CsvStatsSink();
+
+    virtual void writeStats(const StatsRecord& record);
+    virtual void flush();
+
+private:
+    CsvStatsSink(const CsvStatsSink&) = delete;
+    CsvStatsSink& operator=(const CsvStatsSink&) = delete;
+
+    FILE* m_file;
+    std::vector<StatsRecord> m_buffer;
+    size_t m_count;
+};
+
+}
+
+#endif /* STATS_SINK_H */
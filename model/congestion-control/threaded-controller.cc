@@ -0,0 +1,219 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Thread-safe wrapper of a sender-based controller implementation for
+ * rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "threaded-controller.h"
+#include <cassert>
+
+namespace rmcat {
+
+const size_t ThreadedController::DEFAULT_QUEUE_CAPACITY;
+
+ThreadedController::ThreadedController(std::unique_ptr<SenderBasedController> controller,
+                                       size_t queueCapacity)
+: SenderBasedController{},
+  m_controller{std::move(controller)},
+  m_sendQueue{queueCapacity},
+  m_bandwidth{0.f},
+  m_sendOverflows{0},
+  m_queuedBytes{0},
+  m_drainedBytes{0},
+  m_settledBytes{0} {
+    assert(m_controller);
+    publish(0);
+}
+
+ThreadedController::~ThreadedController() {}
+
+void ThreadedController::setId(const std::string& id) {
+    SenderBasedController::setId(id);
+    m_controller->setId(id);
+}
+
+void ThreadedController::setInitBw(float initBw) {
+    SenderBasedController::setInitBw(initBw);
+    m_controller->setInitBw(initBw);
+    publish(0);
+}
+
+void ThreadedController::setMinBw(float minBw) {
+    SenderBasedController::setMinBw(minBw);
+    m_controller->setMinBw(minBw);
+}
+
+void ThreadedController::setMaxBw(float maxBw) {
+    SenderBasedController::setMaxBw(maxBw);
+    m_controller->setMaxBw(maxBw);
+}
+
+void ThreadedController::setLogCallback(logCallback f) {
+    SenderBasedController::setLogCallback(f);
+    m_controller->setLogCallback(f);
+}
+
+void ThreadedController::setStatsSink(std::shared_ptr<StatsSink> sink) {
+    SenderBasedController::setStatsSink(sink);
+    m_controller->setStatsSink(sink);
+}
+
+void ThreadedController::setBaseDelayWindow(size_t nBuckets, uint64_t bucketUs) {
+    SenderBasedController::setBaseDelayWindow(nBuckets, bucketUs);
+    m_controller->setBaseDelayWindow(nBuckets, bucketUs);
+}
+
+void ThreadedController::setClockDriftCompensation(bool enable) {
+    SenderBasedController::setClockDriftCompensation(enable);
+    m_controller->setClockDriftCompensation(enable);
+}
+
+void ThreadedController::setRecvRateEstimator(std::shared_ptr<RecvRateEstimator> estimator) {
+    // Only the wrapped controller owns the estimator: it is not thread-safe
+    m_controller->setRecvRateEstimator(estimator);
+}
+
+void ThreadedController::setRecvRateOverhead(uint32_t bytesPerPacket) {
+    SenderBasedController::setRecvRateOverhead(bytesPerPacket);
+    m_controller->setRecvRateOverhead(bytesPerPacket);
+}
+
+void ThreadedController::setVerboseDiagnostics(bool verbose) {
+    SenderBasedController::setVerboseDiagnostics(verbose);
+    m_controller->setVerboseDiagnostics(verbose);
+}
+
+void ThreadedController::setDiagnosticsInterval(uint64_t intervalUs) {
+    SenderBasedController::setDiagnosticsInterval(intervalUs);
+    m_controller->setDiagnosticsInterval(intervalUs);
+}
+
+const SenderBasedController::Diagnostics& ThreadedController::getDiagnostics() const {
+    return m_controller->getDiagnostics();
+}
+
+bool ThreadedController::getClockDrift(double& driftPpm) const {
+    return m_controller->getClockDrift(driftPpm);
+}
+
+void ThreadedController::reset() {
+    SenderBasedController::reset();
+    m_controller->reset();
+    m_sendQueue.clear();
+    m_sendOverflows.store(0, std::memory_order_relaxed);
+    m_queuedBytes.store(0, std::memory_order_relaxed);
+    m_drainedBytes = 0;
+    publish(0);
+}
+
+void ThreadedController::saveState(std::ostream& os, uint64_t nowUs) const {
+    m_controller->saveState(os, nowUs);
+}
+
+bool ThreadedController::loadState(std::istream& is, uint64_t nowUs) {
+    drainSendRecords();
+    const bool res = m_controller->loadState(is, nowUs);
+    publish(nowUs);
+    return res;
+}
+
+void ThreadedController::setCurrentBw(float newBw) {
+    m_controller->setCurrentBw(newBw);
+    publish(0);
+}
+
+bool ThreadedController::processSendPacket(uint64_t txTimestampUs,
+                                           uint16_t sequence,
+                                           uint32_t size) {
+    // The bytes are added before the record can be popped (see
+    // #getBytesInFlight ), and taken back if it does not fit
+    m_queuedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (!m_sendQueue.push(SendRecord{txTimestampUs, size, sequence})) {
+        m_queuedBytes.fetch_sub(size, std::memory_order_relaxed);
+        m_sendOverflows.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool ThreadedController::processFeedback(uint64_t nowUs,
+                                         uint16_t sequence,
+                                         uint64_t rxTimestampUs,
+                                         uint8_t ecn) {
+    drainSendRecords();
+    const bool res = m_controller->processFeedback(nowUs, sequence, rxTimestampUs, ecn);
+    publish(nowUs);
+    return res;
+}
+
+bool ThreadedController::processFeedbackBatch(uint64_t nowUs,
+                                              const std::vector<FeedbackItem>& feedbackBatch) {
+    drainSendRecords();
+    const bool res = m_controller->processFeedbackBatch(nowUs, feedbackBatch);
+    publish(nowUs);
+    return res;
+}
+
+float ThreadedController::getBandwidth(uint64_t nowUs) const {
+    return m_bandwidth.load(std::memory_order_relaxed);
+}
+
+/*
+ * The queued bytes of a send record are added before it is pushed, and the
+ * settled bytes are published after the record has been popped. Loading
+ * the settled bytes first (acquire) thus guarantees the queued bytes loaded
+ * next already include every record they account for: the difference
+ * cannot underflow. It may transiently count a record that does not fit in
+ * the queue, until its bytes are taken back
+ */
+uint64_t ThreadedController::getBytesInFlight() const {
+    const uint64_t settledBytes = m_settledBytes.load(std::memory_order_acquire);
+    return m_queuedBytes.load(std::memory_order_relaxed) - settledBytes;
+}
+
+uint64_t ThreadedController::getSendOverflows() const {
+    return m_sendOverflows.load(std::memory_order_relaxed);
+}
+
+/*
+ * Hand the queued send records over to the wrapped controller. Feedback can
+ * only refer to packets whose send record was queued before the feedback
+ * was received, so draining the queue first guarantees the wrapped
+ * controller knows about all of them
+ */
+void ThreadedController::drainSendRecords() {
+    SendRecord record;
+    while (m_sendQueue.pop(record)) {
+        m_controller->processSendPacket(record.txTimestampUs, record.sequence, record.size);
+        m_drainedBytes += record.size;
+    }
+}
+
+void ThreadedController::publish(uint64_t nowUs) {
+    m_bandwidth.store(m_controller->getBandwidth(nowUs), std::memory_order_relaxed);
+    m_settledBytes.store(m_drainedBytes - m_controller->getBytesInFlight(), std::memory_order_release);
+}
+
+}
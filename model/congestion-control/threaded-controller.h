@@ -0,0 +1,168 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Thread-safe wrapper of a sender-based controller for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef THREADED_CONTROLLER_H
+#define THREADED_CONTROLLER_H
+
+#include "sender-based-controller.h"
+#include "spsc-queue.h"
+#include <atomic>
+#include <memory>
+
+namespace rmcat {
+
+/**
+ * This class makes any congestion controller usable from a real-time media
+ * engine, where the send path and the feedback path run on different
+ * threads. It wraps (and owns) another controller, and splits the calls
+ * between two threads, none of them taking any lock:
+ *
+ *  - Pacer thread: #processSendPacket . The send record is pushed into a
+ *    single-producer single-consumer queue (see #SpscQueue ); the wrapped
+ *    controller is not touched
+ *  - Network thread: #processFeedback , #processFeedbackBatch and
+ *    #setCurrentBw . The queued send records are first handed over to the
+ *    wrapped controller, then the feedback is processed, and finally the
+ *    bandwidth estimate is published
+ *  - Any thread: #getBandwidth and #getBytesInFlight , which read the
+ *    published estimates
+ *
+ * The configuration calls (#setId , #setInitBw , etc.) and #reset are
+ * forwarded to the wrapped controller. They are not thread-safe: they must
+ * be called while neither the pacer nor the network thread are active.
+ *
+ * If the network thread falls so far behind that the queue fills up, the
+ * send records that do not fit are dropped (see #getSendOverflows ), and
+ * the wrapped controller will account for those packets as lost. The queue
+ * capacity should be well above the number of packets sent between two
+ * feedback messages.
+ * Window-based controllers are not supported: #canSend is not forwarded
+ * (it always allows sending), as the wrapped controller's window cannot be
+ * read from the pacer thread without a lock.
+ */
+class ThreadedController: public SenderBasedController
+{
+public:
+    static const size_t DEFAULT_QUEUE_CAPACITY = 1u << 16; /**< default # of queued send records */
+
+    /**
+     * Class constructor
+     *
+     * @param [in] controller The controller to wrap, whose ownership is taken
+     * @param [in] queueCapacity Maximum number of send records waiting to be
+     *                           handed over to the wrapped controller
+     */
+    explicit ThreadedController(std::unique_ptr<SenderBasedController> controller,
+                                size_t queueCapacity=DEFAULT_QUEUE_CAPACITY);
+
+    /** Class destructor */
+    virtual ~ThreadedController();
+
+    /* Configuration: forwarded to the wrapped controller (not thread-safe) */
+    virtual void setId(const std::string& id);
+    virtual void setInitBw(float initBw);
+    virtual void setMinBw(float minBw);
+    virtual void setMaxBw(float maxBw);
+    virtual void setLogCallback(logCallback f);
+    virtual void setStatsSink(std::shared_ptr<StatsSink> sink);
+    virtual void setBaseDelayWindow(size_t nBuckets, uint64_t bucketUs);
+    virtual void setClockDriftCompensation(bool enable);
+    virtual void setRecvRateEstimator(std::shared_ptr<RecvRateEstimator> estimator);
+    virtual void setRecvRateOverhead(uint32_t bytesPerPacket);
+    virtual void setVerboseDiagnostics(bool verbose);
+    virtual void setDiagnosticsInterval(uint64_t intervalUs);
+    virtual void reset();
+
+    /** Get the wrapped controller's diagnostics counters (network thread) */
+    virtual const Diagnostics& getDiagnostics() const;
+
+    /**
+     * Snapshots (see SenderBasedController::saveState ) are taken from,
+     * and loaded into, the wrapped controller. They must be called on the
+     * network thread. Send records still queued are not part of the
+     * snapshot; they are processed before loading one
+     */
+    virtual void saveState(std::ostream& os, uint64_t nowUs) const;
+    virtual bool loadState(std::istream& is, uint64_t nowUs);
+
+    /** Get the wrapped controller's clock drift estimation (network thread) */
+    virtual bool getClockDrift(double& driftPpm) const;
+
+    /** Set the wrapped controller's bandwidth estimation (network thread) */
+    virtual void setCurrentBw(float newBw);
+
+    /** Queue the send record for the network thread (pacer thread) */
+    virtual bool processSendPacket(uint64_t txTimestampUs,
+                                   uint16_t sequence,
+                                   uint32_t size); // in Bytes
+
+    /** Process feedback with the wrapped controller (network thread) */
+    virtual bool processFeedback(uint64_t nowUs,
+                                 uint16_t sequence,
+                                 uint64_t rxTimestampUs,
+                                 uint8_t ecn=0);
+
+    /** Process aggregated feedback with the wrapped controller (network thread) */
+    virtual bool processFeedbackBatch(uint64_t nowUs,
+                                      const std::vector<FeedbackItem>& feedbackBatch);
+
+    /** Get the last published bandwidth estimation (any thread) */
+    virtual float getBandwidth(uint64_t nowUs) const;
+
+    /**
+     * Get the bytes in flight (any thread): those of the send records still
+     * queued, plus the wrapped controller's bytes in flight, as published
+     * after the last feedback
+     */
+    virtual uint64_t getBytesInFlight() const;
+
+    /** @retval Number of send records dropped because the queue was full (any thread) */
+    uint64_t getSendOverflows() const;
+
+private:
+    struct SendRecord {
+        uint64_t txTimestampUs;
+        uint32_t size;
+        uint16_t sequence;
+    };
+
+    void drainSendRecords();
+    /** Publish the wrapped controller's bandwidth estimation and bytes in flight */
+    void publish(uint64_t nowUs);
+
+    std::unique_ptr<SenderBasedController> m_controller;
+    SpscQueue<SendRecord> m_sendQueue;
+    std::atomic<float> m_bandwidth;
+    std::atomic<uint64_t> m_sendOverflows;
+    std::atomic<uint64_t> m_queuedBytes;  /**< bytes queued so far (written by the pacer thread) */
+    uint64_t m_drainedBytes;              /**< bytes handed over to the wrapped controller so far */
+    std::atomic<uint64_t> m_settledBytes; /**< bytes handed over and no longer in flight */
+};
+
+}
+
+#endif /* THREADED_CONTROLLER_H */
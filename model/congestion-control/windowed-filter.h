@@ -0,0 +1,186 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Incremental windowed min/max filter for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef WINDOWED_FILTER_H
+#define WINDOWED_FILTER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <cassert>
+
+namespace rmcat {
+
+/**
+ * "Less than" comparison for unsigned integers that supports wrapping,
+ * in the same way as SenderBasedController::lessThan
+ */
+template <typename UINT>
+struct WrapLess {
+    bool operator() (UINT lhs, UINT rhs) const {
+        const UINT noWrapSubtract = rhs - lhs;
+        const UINT wrapSubtract = lhs - rhs;
+        return noWrapSubtract < wrapSubtract;
+    }
+};
+
+/** "Greater than" counterpart of #WrapLess */
+template <typename UINT>
+struct WrapGreater {
+    bool operator() (UINT lhs, UINT rhs) const {
+        return WrapLess<UINT>{}(rhs, lhs);
+    }
+};
+
+/**
+ * This class keeps track of the best value (e.g., the minimum, or the
+ * maximum) of a stream of samples over a sliding window. The window can
+ * be bounded by a number of samples (taps), by time, or by both.
+ *
+ * The filter is implemented as a monotonic deque: samples that can never
+ * become the best value of the window (because a newer sample is at least
+ * as good) are discarded upon insertion. Thus, both updating the filter
+ * and querying it take O(1) amortized time, regardless of the window size.
+ *
+ * The template parameter Compare defines what "best" means: Compare(a, b)
+ * returns true if a is strictly better than b (e.g., std::less yields a
+ * min filter).
+ */
+template <typename T, typename Compare>
+class WindowedFilter {
+public:
+    /**
+     * Class constructor
+     *
+     * @param [in] maxTaps Maximum number of (most recent) samples in the
+     *                     window. Zero means no limit
+     * @param [in] windowUs Maximum age, in microseconds, of the samples in
+     *                      the window w.r.t. the most recent one. Zero
+     *                      means no limit
+     */
+    WindowedFilter(size_t maxTaps=0, uint64_t windowUs=0)
+    : m_samples{},
+      m_maxTaps{maxTaps},
+      m_windowUs{windowUs},
+      m_count{0},
+      m_compare{} {}
+
+    /**
+     * Change the window of the filter. Samples falling out of the new
+     * window will be discarded upon the next update
+     *
+     * @param [in] maxTaps Maximum number of samples (zero means no limit)
+     * @param [in] windowUs Maximum age of the samples, in microseconds
+     *                      (zero means no limit)
+     */
+    void setWindow(size_t maxTaps, uint64_t windowUs) {
+        m_maxTaps = maxTaps;
+        m_windowUs = windowUs;
+    }
+
+    /**
+     * Add a new sample to the filter
+     *
+     * @param [in] value Value of the sample
+     * @param [in] timestampUs Time (in microseconds) associated with the
+     *                         sample. Timestamps of consecutive samples
+     *                         must not decrease; they can wrap
+     */
+    void update(T value, uint64_t timestampUs) {
+        while (!m_samples.empty() && !m_compare(m_samples.back().value, value)) {
+            m_samples.pop_back();
+        }
+        m_samples.push_back(Sample{value, timestampUs, m_count});
+        ++m_count;
+        expire();
+    }
+
+    /**
+     * Restrict the window to the last n samples added, on top of the
+     * configured window. This allows to keep the filter in sync with a
+     * container whose oldest elements are garbage collected
+     *
+     * @param [in] n Number of most recent samples to keep
+     */
+    void trimToLast(size_t n) {
+        while (!m_samples.empty() && m_count - m_samples.front().index > n) {
+            m_samples.pop_front();
+        }
+    }
+
+    /** Discard all samples */
+    void reset() {
+        m_samples.clear();
+        m_count = 0;
+    }
+
+    /** @retval True if there are no samples in the window */
+    bool empty() const {
+        return m_samples.empty();
+    }
+
+    /**
+     * Get the best value in the window. The filter must not be empty
+     *
+     * @retval The best sample value in the current window
+     */
+    T get() const {
+        assert(!m_samples.empty());
+        return m_samples.front().value;
+    }
+
+private:
+    struct Sample {
+        T value;
+        uint64_t timestampUs;
+        uint64_t index;
+    };
+
+    void expire() {
+        const Sample& last = m_samples.back();
+        while (true) {
+            const Sample& first = m_samples.front();
+            const bool tooMany = m_maxTaps > 0 && last.index - first.index >= m_maxTaps;
+            // This subtraction will wrap properly
+            const bool tooOld = m_windowUs > 0 && last.timestampUs - first.timestampUs >= m_windowUs;
+            if (!tooMany && !tooOld) {
+                break;
+            }
+            m_samples.pop_front();
+        }
+    }
+
+    std::deque<Sample> m_samples; /**< Candidate samples, best first */
+    size_t m_maxTaps;
+    uint64_t m_windowUs;
+    uint64_t m_count; /**< Number of samples added since last reset */
+    Compare m_compare;
+};
+
+}
+
+#endif /* WINDOWED_FILTER_H */
@@ -0,0 +1,126 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * ECN-marking queue implementation for rmcat ns3 module.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "ecn-marking-queue.h"
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/node.h"
+#include "ns3/ppp-header.h"
+#include "ns3/ipv4-header.h"
+
+NS_LOG_COMPONENT_DEFINE ("EcnMarkingQueue");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (EcnMarkingQueue);
+
+const uint16_t PPP_PROTOCOL_IPV4 = 0x0021;
+
+TypeId EcnMarkingQueue::GetTypeId (void)
+{
+    static TypeId tid = TypeId ("ns3::EcnMarkingQueue")
+        .SetParent<Queue> ()
+        .SetGroupName ("Network")
+        .AddConstructor<EcnMarkingQueue> ()
+        .AddAttribute ("MarkingThreshold",
+                       "Bytes in the queue from which ECN-capable packets are marked",
+                       UintegerValue (0),
+                       MakeUintegerAccessor (&EcnMarkingQueue::m_markingThreshold),
+                       MakeUintegerChecker<uint32_t> ());
+    return tid;
+}
+
+EcnMarkingQueue::EcnMarkingQueue ()
+: m_packets{},
+  m_markingThreshold{0},
+  m_nMarked{0}
+{}
+
+EcnMarkingQueue::~EcnMarkingQueue ()
+{}
+
+uint32_t EcnMarkingQueue::GetNMarked () const
+{
+    return m_nMarked;
+}
+
+bool EcnMarkingQueue::DoEnqueue (Ptr<QueueItem> item)
+{
+    NS_ASSERT (m_packets.size () == GetNPackets ());
+    if (GetNBytes () >= m_markingThreshold) {
+        Mark (item->GetPacket ());
+    }
+    m_packets.push (item);
+    return true;
+}
+
+Ptr<QueueItem> EcnMarkingQueue::DoDequeue (void)
+{
+    NS_ASSERT (m_packets.size () == GetNPackets ());
+    if (m_packets.empty ()) {
+        return 0;
+    }
+    auto item = m_packets.front ();
+    m_packets.pop ();
+    return item;
+}
+
+Ptr<QueueItem> EcnMarkingQueue::DoRemove (void)
+{
+    return DoDequeue ();
+}
+
+Ptr<const QueueItem> EcnMarkingQueue::DoPeek (void) const
+{
+    NS_ASSERT (m_packets.size () == GetNPackets ());
+    if (m_packets.empty ()) {
+        return 0;
+    }
+    return m_packets.front ();
+}
+
+void EcnMarkingQueue::Mark (Ptr<Packet> packet)
+{
+    PppHeader ppp{};
+    packet->RemoveHeader (ppp);
+    if (ppp.GetProtocol () == PPP_PROTOCOL_IPV4) {
+        Ipv4Header ipHeader{};
+        packet->RemoveHeader (ipHeader);
+        if (ipHeader.GetEcn () != Ipv4Header::ECN_NotECT &&
+            ipHeader.GetEcn () != Ipv4Header::ECN_CE) {
+            ipHeader.SetEcn (Ipv4Header::ECN_CE);
+            ++m_nMarked;
+        }
+        if (Node::ChecksumEnabled ()) {
+            ipHeader.EnableChecksum ();
+        }
+        packet->AddHeader (ipHeader);
+    }
+    packet->AddHeader (ppp);
+}
+
+}
@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * ECN-marking queue for the bottleneck of rmcat ns3 module's topologies.
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#ifndef ECN_MARKING_QUEUE_H
+#define ECN_MARKING_QUEUE_H
+
+#include "ns3/queue.h"
+#include <queue>
+
+namespace ns3 {
+
+/**
+ * Drop-tail queue of a point-to-point device that sets the Congestion
+ * Experienced (CE) codepoint of the ECN-capable IPv4 packets enqueued
+ * while the queue holds at least a given number of bytes (step marking).
+ * Packets that are not ECN-capable are only dropped when the queue is full.
+ * ns-3.26's queue discs do not mark packets, hence this queue.
+ */
+class EcnMarkingQueue : public Queue
+{
+public:
+    static TypeId GetTypeId (void);
+
+    /** Class constructor */
+    EcnMarkingQueue ();
+
+    /** Class destructor */
+    virtual ~EcnMarkingQueue ();
+
+    /** @retval Number of packets marked so far */
+    uint32_t GetNMarked () const;
+
+private:
+    virtual bool DoEnqueue (Ptr<QueueItem> item);
+    virtual Ptr<QueueItem> DoDequeue (void);
+    virtual Ptr<QueueItem> DoRemove (void);
+    virtual Ptr<const QueueItem> DoPeek (void) const;
+
+    /**
+     * Set the CE codepoint of a packet if it is ECN-capable
+     *
+     * @param [in,out] packet Packet, starting with its PPP header
+     */
+    void Mark (Ptr<Packet> packet);
+
+    std::queue<Ptr<QueueItem> > m_packets;
+    uint32_t m_markingThreshold; // in bytes
+    uint32_t m_nMarked;
+};
+
+}
+
+#endif /* ECN_MARKING_QUEUE_H */
@@ -29,14 +29,56 @@
 #include "ns3/rmcat-sender.h"
 #include "ns3/rmcat-receiver.h"
 #include "ns3/nada-controller.h"
+#include "ns3/nada-fixed-controller.h"
+#include "ns3/gcc-controller.h"
+#include "ns3/scream-controller.h"
+#include "ns3/bbr-controller.h"
+#include "ns3/coupled-controller.h"
 #include <memory>
 #include <limits>
+#include <fstream>
 #include <sys/stat.h>
 
 NS_LOG_COMPONENT_DEFINE ("Topo");
 
 namespace ns3 {
 
+/*
+ * Congestion control algorithm of the RMCAT flows. It can be set, e.g.,
+ * from the command line (--RmcatCcAlgo=gcc) or the environment
+ * (NS_GLOBAL_VALUE="RmcatCcAlgo=gcc") to run the same test cases with
+ * another algorithm than NADA
+ */
+static GlobalValue g_ccAlgo = GlobalValue ("RmcatCcAlgo",
+                                           "Congestion control algorithm of the RMCAT flows: "
+                                           "nada, gcc (see rmcat::GccController), "
+                                           "scream (see rmcat::ScreamController), "
+                                           "or bbr (see rmcat::BbrController)",
+                                           StringValue ("nada"),
+                                           MakeStringChecker ());
+
+/*
+ * Parameters of the NADA controllers. It can be set, e.g., from the
+ * command line (--RmcatNadaConfig=file) to sweep the parameters without
+ * recompiling, or to give flows different priorities
+ */
+static GlobalValue g_nadaConfig = GlobalValue ("RmcatNadaConfig",
+                                               "File with the parameters of the NADA controllers "
+                                               "(see rmcat::NadaParams::load). Empty: default parameters",
+                                               StringValue (""),
+                                               MakeStringChecker ());
+
+/*
+ * Arithmetic of the NADA controllers: the reference floating-point one,
+ * the fixed-point one, whose logs are reproducible bit by bit, or both side
+ * by side, to report their divergence (see rmcat::NadaFixedController)
+ */
+static GlobalValue g_nadaArith = GlobalValue ("RmcatNadaArith",
+                                              "Arithmetic of the NADA controllers: "
+                                              "float, fixed, or validate (fixed, checked against float)",
+                                              StringValue ("float"),
+                                              MakeStringChecker ());
+
 /* Implementations of utility functions */
 
 static Ipv4Address GetIpv4AddressOfNode (Ptr<Node> node,
@@ -172,10 +214,44 @@ ApplicationContainer Topo::InstallCBR (Ptr<Node> sender,
     return apps;
 }
 
+/*
+ * NADA controller of a flow, as configured by the RmcatNadaConfig and
+ * RmcatNadaArith global values
+ */
+static std::shared_ptr<rmcat::SenderBasedController> CreateNadaController (const std::string& flowId)
+{
+    StringValue nadaConfig;
+    StringValue nadaArith;
+    g_nadaConfig.GetValue (nadaConfig);
+    g_nadaArith.GetValue (nadaArith);
+    rmcat::NadaParams params;
+    if (!nadaConfig.Get ().empty ()) {
+        std::ifstream config{nadaConfig.Get ().c_str ()};
+        NS_ABORT_MSG_UNLESS (config && params.load (config, flowId),
+                             "Invalid NADA configuration file: " << nadaConfig.Get ());
+    }
+    if (nadaArith.Get () == "fixed" || nadaArith.Get () == "validate") {
+        // Rather than silently running another algorithm than configured
+        NS_ABORT_MSG_IF (params.adaptiveDelta || params.dgrad != 0.f,
+                         "NADA arithmetic " << nadaArith.Get ()
+                         << " supports neither adaptiveDelta nor dgrad: " << nadaConfig.Get ());
+        auto fixed = std::make_shared<rmcat::NadaFixedController> (params);
+        fixed->setValidation (nadaArith.Get () == "validate");
+        return fixed;
+    }
+    NS_ABORT_MSG_UNLESS (nadaArith.Get () == "float", "Invalid NADA arithmetic: " << nadaArith.Get ());
+    if (nadaConfig.Get ().empty ()) {
+        return std::make_shared<rmcat::NadaController> ();
+    }
+    return std::make_shared<rmcat::ConfigurableNadaController> (params);
+}
+
 ApplicationContainer Topo::InstallRMCAT (const std::string& flowId,
                                          Ptr<Node> sender,
                                          Ptr<Node> receiver,
-                                         uint16_t serverPort)
+                                         uint16_t serverPort,
+                                         std::shared_ptr<rmcat::FlowStateExchange> fse,
+                                         float priority)
 {
 
     auto rmcatAppSend = CreateObject<RmcatSender> ();
@@ -187,7 +263,23 @@ ApplicationContainer Topo::InstallRMCAT (const std::string& flowId,
     rmcatAppSend->Setup (serverIP, serverPort);
 
     /* configure congestion controller */
-    auto controller = std::make_shared<rmcat::NadaController> ();
+    std::shared_ptr<rmcat::SenderBasedController> controller;
+    StringValue ccAlgo;
+    g_ccAlgo.GetValue (ccAlgo);
+    if (ccAlgo.Get () == "gcc") {
+        controller = std::make_shared<rmcat::GccController> ();
+    } else if (ccAlgo.Get () == "scream") {
+        controller = std::make_shared<rmcat::ScreamController> ();
+    } else if (ccAlgo.Get () == "bbr") {
+        controller = std::make_shared<rmcat::BbrController> ();
+    } else if (ccAlgo.Get () == "nada") {
+        controller = CreateNadaController (flowId);
+    } else {
+        NS_ABORT_MSG ("Invalid congestion control algorithm: " << ccAlgo.Get ());
+    }
+    if (fse) {
+        controller = std::make_shared<rmcat::CoupledController> (fse, controller, priority);
+    }
     controller->setLogCallback (logFromController);
     controller->setId (flowId);
     rmcatAppSend->SetController (controller);
@@ -42,6 +42,8 @@
 #include "ns3/traffic-control-helper.h"
 
 #include "ns3/rmcat-constants.h"
+#include "ns3/flow-state-exchange.h"
+#include <memory>
 
 namespace ns3 {
 
@@ -111,6 +113,12 @@ protected:
      *                          application
      * @param [in]     serverPort UDP port where the receiver application is
      *                            to read media packets
+     * @param [in]     fse Flow State Exchange group the flow's controller is
+     *                     coupled to (see rmcat::CoupledController ), e.g.,
+     *                     shared by the flows from the same sender node.
+     *                     Null if the flow is not coupled
+     * @param [in]     priority Weight of the flow's share of the group's
+     *                          aggregate rate
      *
      * @retval A container with the two applications (sender and receiver)
      */
@@ -118,7 +126,9 @@ protected:
     static ApplicationContainer InstallRMCAT (const std::string& flowId,
                                               Ptr<Node> sender,
                                               Ptr<Node> receiver,
-                                              uint16_t serverPort);
+                                              uint16_t serverPort,
+                                              std::shared_ptr<rmcat::FlowStateExchange> fse = nullptr,
+                                              float priority = 1.f);
 
 
     /**
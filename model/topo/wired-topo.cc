@@ -37,7 +37,10 @@ WiredTopo::WiredTopo ()
 WiredTopo::~WiredTopo ()
 {}
 
-void WiredTopo::Build (uint64_t bandwidthBps, uint32_t msDelay, uint32_t msQDelay)
+void WiredTopo::Build (uint64_t bandwidthBps,
+                       uint32_t msDelay,
+                       uint32_t msQDelay,
+                       uint32_t msMarkingThreshold)
 {
     // Set up bottleneck link
     m_bottleneckNodes.Create (2);
@@ -50,9 +53,18 @@ void WiredTopo::Build (uint64_t bandwidthBps, uint32_t msDelay, uint32_t msQDela
     // At least one full packet with default size must fit
     NS_ASSERT (m_bufSize >= DEFAULT_PACKET_SIZE + IPV4_UDP_OVERHEAD);
 
-    bottleneckLinkHlpr.SetQueue ("ns3::DropTailQueue",
-                                 "Mode", StringValue ("QUEUE_MODE_BYTES"),
-                                 "MaxBytes", UintegerValue (m_bufSize));
+    if (msMarkingThreshold > 0) {
+        const uint32_t markingThreshold = bandwidthBps * msMarkingThreshold / 8 / 1000;
+        NS_ASSERT (markingThreshold < m_bufSize);
+        bottleneckLinkHlpr.SetQueue ("ns3::EcnMarkingQueue",
+                                     "Mode", StringValue ("QUEUE_MODE_BYTES"),
+                                     "MaxBytes", UintegerValue (m_bufSize),
+                                     "MarkingThreshold", UintegerValue (markingThreshold));
+    } else {
+        bottleneckLinkHlpr.SetQueue ("ns3::DropTailQueue",
+                                     "Mode", StringValue ("QUEUE_MODE_BYTES"),
+                                     "MaxBytes", UintegerValue (m_bufSize));
+    }
 
     m_bottleneckDevices = bottleneckLinkHlpr.Install (m_bottleneckNodes);
 
@@ -120,7 +132,9 @@ ApplicationContainer WiredTopo::InstallCBR (uint16_t serverPort,
 ApplicationContainer WiredTopo::InstallRMCAT (const std::string& flowId,
                                               uint16_t serverPort,
                                               uint32_t pDelayMs,
-                                              bool forward)
+                                              bool forward,
+                                              std::shared_ptr<rmcat::FlowStateExchange> fse,
+                                              float priority)
 {
     auto appNodes = SetupAppNodes (pDelayMs, true);
 
@@ -133,7 +147,17 @@ ApplicationContainer WiredTopo::InstallRMCAT (const std::string& flowId,
     return Topo::InstallRMCAT (flowId,
                                sender,
                                receiver,
-                               serverPort);
+                               serverPort,
+                               fse,
+                               priority);
+}
+
+void WiredTopo::SetBottleneckDelay (uint32_t msDelay)
+{
+    Ptr<PointToPointChannel> channel = DynamicCast<PointToPointChannel> (m_bottleneckDevices.Get (0)->GetChannel ());
+    NS_ASSERT (channel != NULL);
+    // Same share of the total delay as in Build
+    channel->SetAttribute ("Delay", TimeValue (MicroSeconds (msDelay * 1000 * 9 / 10)));
 }
 
 void WiredTopo::SetupAppNode (Ptr<Node> node, int bottleneckIdx, uint32_t pDelayMs)
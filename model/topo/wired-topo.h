@@ -69,8 +69,15 @@ public:
      *                     right nodes
      * @param [in] msQDelay Capacity of the queue at the bottleneck
      *                      link (in ms)
+     * @param [in] msMarkingThreshold Queue occupancy (in ms) from which the
+     *                                bottleneck marks ECN-capable packets
+     *                                (see #EcnMarkingQueue ). Zero: the
+     *                                bottleneck does not mark packets
      */
-    void Build (uint64_t bandwidthBps, uint32_t msDelay, uint32_t msQDelay);
+    void Build (uint64_t bandwidthBps,
+                uint32_t msDelay,
+                uint32_t msQDelay,
+                uint32_t msMarkingThreshold = 0);
 
     /**
      * Install a one-way bulk TCP flow in a pair of (left-to-right) nodes
@@ -124,13 +131,28 @@ public:
      *             will act as sender and the right node (ID=1) will
      *             act as receiver; if false (backward direction),
      *             the roles are swapped.
+     * @param [in] fse Flow State Exchange group the flow is coupled to,
+     *                 null if not coupled (see Topo::InstallRMCAT )
+     * @param [in] priority Weight of the flow's share in the group
      *
      * @retval A container with the two applications (sender and receiver)
      */
     ApplicationContainer InstallRMCAT (const std::string& flowId,
                                        uint16_t serverPort,
                                        uint32_t pDelayMs,
-                                       bool forward);
+                                       bool forward,
+                                       std::shared_ptr<rmcat::FlowStateExchange> fse = nullptr,
+                                       float priority = 1.f);
+
+    /**
+     * Change the propagation delay of the bottleneck link, e.g., to emulate
+     * a route change during the simulation. The new delay is applied to
+     * packets transmitted from then on
+     *
+     * @param [in] msDelay New total propagation delay (in ms) between left
+     *                     and right nodes, as passed to #Build
+     */
+    void SetBottleneckDelay (uint32_t msDelay);
 
 private:
     void SetupAppNode (Ptr<Node> node, int subnet, uint32_t pDelayMs);
@@ -27,6 +27,8 @@
 
 #include "rmcat-common-test.h"
 #include "ns3/log.h"
+#include "ns3/global-value.h"
+#include "ns3/string.h"
 
 using namespace ns3;
 
@@ -41,6 +43,7 @@ RmcatTestCase::RmcatTestCase (uint64_t capacity,
 , m_capacity{capacity}   // bottleneck capacity
 , m_delay{delay}         // one-way propagation delay
 , m_qdelay{qdelay}       // bottleneck queue depth
+, m_ccAlgo{}
 {
 
     // name of log file same as test case descriptions
@@ -70,6 +73,14 @@ void RmcatTestCase::DoSetup ()
     // for logging
     m_ofs.open (m_logfile.c_str (), std::ios_base::out);
     m_sb = std::clog.rdbuf (m_ofs.rdbuf ());
+
+    // the controllers are created when the RMCAT flows are installed
+    if (!m_ccAlgo.empty ()) {
+        StringValue ccAlgo;
+        GlobalValue::GetValueByName ("RmcatCcAlgo", ccAlgo);
+        m_prevCcAlgo = ccAlgo.Get ();
+        GlobalValue::Bind ("RmcatCcAlgo", StringValue (m_ccAlgo));
+    }
 }
 
 void RmcatTestCase::DoTeardown ()
@@ -77,4 +88,20 @@ void RmcatTestCase::DoTeardown ()
     // close up output file stream
     std::clog.rdbuf (m_sb);
     m_ofs.close ();
+    if (!m_ccAlgo.empty ()) {
+        GlobalValue::Bind ("RmcatCcAlgo", StringValue (m_prevCcAlgo));
+    }
+}
+
+void RmcatTestCase::SetCcAlgo (const std::string& algo)
+{
+    m_ccAlgo = algo;
+    // keep the logs of different algorithms apart
+    std::stringstream ss;
+    ss << GetName ();
+    if (algo != "nada") {
+        ss << "-" << algo;
+    }
+    ss << ".log";
+    m_logfile = ss.str ();
 }
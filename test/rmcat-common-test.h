@@ -30,6 +30,7 @@
 
 #include "ns3/test.h"
 #include <fstream>
+#include <string>
 
 /* default simulation parameters */
 const uint32_t RMCAT_TC_BG_TSTART = 40;
@@ -69,6 +70,10 @@ public:
     virtual void DoSetup ();
     virtual void DoTeardown ();
 
+    /* configure the congestion control algorithm of the RMCAT flows: nada, gcc, scream or bbr
+     * (see RmcatCcAlgo, and RMCAT_ALGOS in tools/process_test_logs.py) */
+    void SetCcAlgo (const std::string& algo);
+
 protected:
 
     bool m_debug;           // debugging mode
@@ -81,6 +86,9 @@ protected:
     uint64_t m_capacity;   // bottleneck capacity (in bps)
     uint32_t m_delay;      // one-way propagation delay (in ms)
     uint32_t m_qdelay;     // bottleneck queue depth (in ms)
+
+    std::string m_ccAlgo;  // congestion control algorithm of RMCAT flows (empty: RmcatCcAlgo's value)
+    std::string m_prevCcAlgo;  // value of RmcatCcAlgo before the test case
 };
 
 #endif /* RMCAT_COMMON_TEST_H */
@@ -0,0 +1,2672 @@
+/******************************************************************************
+ * Copyright 2016-2017 Cisco Systems, Inc.                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ *                                                                            *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ ******************************************************************************/
+
+/**
+ * @file
+ * Test suite for rmcat congestion controllers, exercised directly
+ * (i.e., without running a network simulation).
+ *
+ * @version 0.1.1
+ * @author Jiantao Fu
+ * @author Sergio Mena
+ * @author Xiaoqing Zhu
+ */
+
+#include "ns3/test.h"
+#include "ns3/nada-controller.h"
+#include "ns3/nada-bank.h"
+#include "ns3/nada-fixed-controller.h"
+#include "ns3/gcc-controller.h"
+#include "ns3/scream-controller.h"
+#include "ns3/bbr-controller.h"
+#include "ns3/coupled-controller.h"
+#include "ns3/delay-gradient-estimator.h"
+#include "ns3/dummy-controller.h"
+#include "ns3/threaded-controller.h"
+#include "ns3/stats-sink.h"
+#include "ns3/base-delay-tracker.h"
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <deque>
+#include <random>
+
+using namespace ns3;
+
+static void NoLog (const std::string&) {}
+
+/*
+ * Stress test of the thread-safe controller wrapper: a pacer thread sends
+ * packets (and hands them over to a simulated network path), while the
+ * network thread (the test's thread) processes their feedback, and a third
+ * thread keeps reading the bandwidth estimation
+ */
+class ThreadedControllerStressTestCase : public TestCase
+{
+public:
+    ThreadedControllerStressTestCase ();
+    virtual void DoRun ();
+};
+
+ThreadedControllerStressTestCase::ThreadedControllerStressTestCase ()
+: TestCase{"rmcat-threaded-controller-stress"}
+{}
+
+void ThreadedControllerStressTestCase::DoRun ()
+{
+    typedef rmcat::SenderBasedController::FeedbackItem FeedbackItem;
+    const uint32_t nPackets = 300000;     // wraps the 16-bit sequence several times
+    const uint64_t gapUs = 200;           // 40 Mbps with 1000-byte packets
+    const uint64_t owdUs = 50000;         // 50ms
+    const uint32_t lossPeriod = 101;      // one in 101 packets is lost
+    const size_t maxBatch = 500;
+    const float minBw = 150000.f;
+    const float maxBw = 50000000.f;
+
+    std::unique_ptr<rmcat::SenderBasedController> nada{new rmcat::NadaController{}};
+    rmcat::ThreadedController controller{std::move (nada)};
+    controller.setLogCallback (NoLog);
+    controller.setMinBw (minBw);
+    controller.setMaxBw (maxBw);
+    controller.setCurrentBw (minBw);
+
+    // Simulated network path, from the pacer thread to the network thread.
+    // Its capacity bounds the packets in flight below the controller's
+    // in-transit capacity, so that no feedback arrives too late
+    rmcat::SpscQueue<FeedbackItem> path{1u << 11};
+    std::atomic<bool> sendDone{false};
+    std::atomic<bool> fbDone{false};
+    std::atomic<uint32_t> sendErrors{0};
+    std::atomic<uint32_t> bwErrors{0};
+    std::atomic<uint32_t> inFlightErrors{0};
+
+    std::thread pacer{[&] () {
+        uint16_t sequence = 0;
+        for (uint32_t i = 0; i < nPackets; ++i, ++sequence) {
+            const uint64_t txTimestampUs = 1000000 + i * gapUs;
+            if (!controller.processSendPacket (txTimestampUs, sequence, 1000)) {
+                ++sendErrors;
+            }
+            if (i % lossPeriod == 0) {
+                continue;
+            }
+            const FeedbackItem item{sequence, txTimestampUs + owdUs, 0};
+            while (!path.push (item)) {
+                std::this_thread::yield ();
+            }
+        }
+        sendDone = true;
+    }};
+
+    std::thread reader{[&] () {
+        while (!fbDone) {
+            const float bw = controller.getBandwidth (0);
+            if (bw < minBw || bw > maxBw) {
+                ++bwErrors;
+            }
+            if (controller.getBytesInFlight () > uint64_t (nPackets) * 1000) {
+                ++inFlightErrors;
+            }
+        }
+    }};
+
+    // Network thread
+    uint32_t fbErrors = 0;
+    uint32_t nFeedback = 0;
+    std::vector<FeedbackItem> batch;
+    while (true) {
+        const bool lastRound = sendDone;
+        FeedbackItem item;
+        while (batch.size () < maxBatch && path.pop (item)) {
+            batch.push_back (item);
+        }
+        if (!batch.empty ()) {
+            const uint64_t nowUs = batch.back ().rxTimestampUs + 1;
+            if (!controller.processFeedbackBatch (nowUs, batch)) {
+                ++fbErrors;
+            }
+            nFeedback += batch.size ();
+            batch.clear ();
+        } else if (lastRound) {
+            break;
+        }
+    }
+    fbDone = true;
+    pacer.join ();
+    reader.join ();
+
+    const uint32_t nLost = (nPackets + lossPeriod - 1) / lossPeriod;
+    NS_TEST_ASSERT_MSG_EQ (nFeedback, nPackets - nLost, "All feedback should have been processed");
+    NS_TEST_ASSERT_MSG_EQ (sendErrors.load (), 0, "No send record should have been rejected");
+    NS_TEST_ASSERT_MSG_EQ (controller.getSendOverflows (), 0, "No send record should have been dropped");
+    NS_TEST_ASSERT_MSG_EQ (fbErrors, 0, "No feedback batch should have been rejected");
+    NS_TEST_ASSERT_MSG_EQ (bwErrors.load (), 0, "Published bandwidth should stay within [Rmin, Rmax]");
+    NS_TEST_ASSERT_MSG_EQ (inFlightErrors.load (), 0, "Published bytes in flight should never underflow");
+    const float bw = controller.getBandwidth (0);
+    NS_TEST_ASSERT_MSG_GT (bw, minBw, "Bandwidth should have ramped up on a loss-light, queue-free path");
+}
+
+/*
+ * Send records that do not fit in the queue are dropped and counted; the
+ * wrapped controller resynchronizes and keeps processing feedback
+ */
+class ThreadedControllerOverflowTestCase : public TestCase
+{
+public:
+    ThreadedControllerOverflowTestCase ();
+    virtual void DoRun ();
+};
+
+ThreadedControllerOverflowTestCase::ThreadedControllerOverflowTestCase ()
+: TestCase{"rmcat-threaded-controller-overflow"}
+{}
+
+void ThreadedControllerOverflowTestCase::DoRun ()
+{
+    const size_t capacity = 16;
+    const uint32_t extra = 4;
+    std::unique_ptr<rmcat::SenderBasedController> nada{new rmcat::NadaController{}};
+    rmcat::ThreadedController controller{std::move (nada), capacity};
+    controller.setLogCallback (NoLog);
+
+    uint16_t sequence = 0;
+    uint64_t txTimestampUs = 1000000;
+    for (uint32_t i = 0; i < capacity + extra; ++i, ++sequence, txTimestampUs += 1000) {
+        controller.processSendPacket (txTimestampUs, sequence, 1000);
+    }
+    NS_TEST_ASSERT_MSG_EQ (controller.getSendOverflows (), extra, "Send records beyond capacity should be dropped");
+    NS_TEST_ASSERT_MSG_EQ (controller.getBytesInFlight (), capacity * 1000, "Queued send records should be in flight");
+
+    // Feedback of the first packet drains the queue
+    bool res = controller.processFeedback (txTimestampUs + 50000, 0, 1000000 + 50000);
+    NS_TEST_ASSERT_MSG_EQ (res, true, "Feedback of a queued packet should be accepted");
+
+    // Packets sent after the overflow are still processed
+    for (uint32_t i = 0; i < capacity; ++i, ++sequence, txTimestampUs += 1000) {
+        controller.processSendPacket (txTimestampUs, sequence, 1000);
+    }
+    NS_TEST_ASSERT_MSG_EQ (controller.getBytesInFlight (), (2 * capacity - 1) * 1000,
+                           "Bytes in flight should add the queued ones to the wrapped controller's");
+
+    // The first packet after the gap is recorded: its feedback is matched
+    const uint16_t firstAfterGap = uint16_t (capacity + extra);
+    res = controller.processFeedback (txTimestampUs + 50000, firstAfterGap, 1000000 + firstAfterGap * 1000 + 50000);
+    NS_TEST_ASSERT_MSG_EQ (res, true, "Feedback of the first packet after the gap should be accepted");
+    NS_TEST_ASSERT_MSG_EQ (controller.getDiagnostics ().illegalSendSequence, 1, "The gap should be counted once");
+    NS_TEST_ASSERT_MSG_EQ (controller.getDiagnostics ().duplicateFeedback, 0,
+                           "Feedback of the first packet after the gap should not be mistaken for a duplicate");
+    NS_TEST_ASSERT_MSG_EQ (controller.getBytesInFlight (), (capacity - 1) * 1000,
+                           "Packets up to the first one after the gap should no longer be in flight");
+
+    res = controller.processFeedback (txTimestampUs + 50000, sequence - 1, txTimestampUs + 49000);
+    NS_TEST_ASSERT_MSG_EQ (res, true, "Feedback after an overflow should be accepted");
+    NS_TEST_ASSERT_MSG_EQ (controller.getBytesInFlight (), 0, "Newest packet acknowledged: nothing should be in flight");
+}
+
+/*
+ * Bytes in flight are read while send records are drained: feedback on
+ * each packet is processed as soon as it is handed over to the wrapped
+ * controller, possibly before the pacer thread returns from sending it.
+ * The published value must never underflow
+ */
+class ThreadedControllerInFlightTestCase : public TestCase
+{
+public:
+    ThreadedControllerInFlightTestCase ();
+    virtual void DoRun ();
+};
+
+ThreadedControllerInFlightTestCase::ThreadedControllerInFlightTestCase ()
+: TestCase{"rmcat-threaded-controller-in-flight"}
+{}
+
+void ThreadedControllerInFlightTestCase::DoRun ()
+{
+    const uint32_t nPackets = 100000;
+    const uint32_t pktSize = 1000;
+    const uint32_t maxOutstanding = 64;   // well below the queue capacity: no overflow
+    const uint64_t owdUs = 1000;
+
+    std::unique_ptr<rmcat::SenderBasedController> nada{new rmcat::NadaController{}};
+    rmcat::ThreadedController controller{std::move (nada), 4 * maxOutstanding};
+    controller.setLogCallback (NoLog);
+
+    std::atomic<uint32_t> nAcked{0};
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> inFlightErrors{0};
+
+    std::thread pacer{[&] () {
+        uint16_t sequence = 0;
+        for (uint32_t i = 0; i < nPackets; ++i, ++sequence) {
+            while (i - nAcked.load () >= maxOutstanding) {
+                std::this_thread::yield ();
+            }
+            controller.processSendPacket (1000000 + uint64_t (i) * 10, sequence, pktSize);
+        }
+    }};
+
+    std::thread reader{[&] () {
+        while (!done) {
+            if (controller.getBytesInFlight () > uint64_t (nPackets) * pktSize) {
+                ++inFlightErrors;
+            }
+        }
+    }};
+
+    // Network thread: poll for the feedback of the next packet, which is
+    // accepted as soon as its send record has been drained
+    uint16_t sequence = 0;
+    for (uint32_t i = 0; i < nPackets;) {
+        const uint64_t rxTimestampUs = 1000000 + uint64_t (i) * 10 + owdUs;
+        if (controller.processFeedback (rxTimestampUs + 1, sequence, rxTimestampUs)) {
+            ++sequence;
+            nAcked = ++i;
+        } else {
+            std::this_thread::yield ();
+        }
+    }
+    done = true;
+    pacer.join ();
+    reader.join ();
+
+    NS_TEST_ASSERT_MSG_EQ (controller.getSendOverflows (), 0, "No send record should have been dropped");
+    NS_TEST_ASSERT_MSG_EQ (inFlightErrors.load (), 0, "Published bytes in flight should never underflow");
+    NS_TEST_ASSERT_MSG_EQ (controller.getBytesInFlight (), 0, "All packets acknowledged: nothing should be in flight");
+}
+
+/*
+ * The text adapter keeps the log line format parsed by the tools, and the
+ * CSV writer outputs one line per record, whether buffered or flushed
+ */
+class StatsSinkTestCase : public TestCase
+{
+public:
+    StatsSinkTestCase ();
+    virtual void DoRun ();
+};
+
+StatsSinkTestCase::StatsSinkTestCase ()
+: TestCase{"rmcat-stats-sink"}
+{}
+
+void StatsSinkTestCase::DoRun ()
+{
+    rmcat::StatsRecord record = rmcat::StatsRecord{};
+    std::strcpy (record.algo, "nada");
+    std::strcpy (record.id, "rmcat_0");
+    record.timestampUs = 158114000;
+    record.deltaUs = 100000;
+    record.loglen = 60;
+    record.qdelayUs = 286000;
+    record.rttUs = 386000;
+    record.ploss = 0;
+    record.plr = 0.f;
+    record.xcurr = 4.72f;
+    record.rrateBps = 863655.56f;
+    record.srateBps = 916165.81f;
+    record.avgInt = 437.1f;
+    record.currInt = 997;
+
+    const std::string expected = " algo:nada rmcat_0 ts: 158114 loglen: 60 qdel: 286 rtt: 386"
+                                 " ploss: 0 plr: 0.00 xcurr: 4.72 rrate: 863655.56"
+                                 " srate: 916165.81 avgint: 437.10 curint: 997 delta: 100";
+    NS_TEST_ASSERT_MSG_EQ (rmcat::formatStatsRecord (record), expected, "Text log format should not change");
+
+    const std::string fileName = "rmcat-stats-sink-test.stats.csv";
+    const size_t nRecords = 10;
+    {
+        rmcat::CsvStatsSink sink{fileName, 4};  // forces several flushes
+        for (size_t i = 0; i < nRecords; ++i) {
+            sink.writeStats (record);
+        }
+    }
+    std::ifstream ifs{fileName.c_str ()};
+    std::string line;
+    size_t nLines = 0;
+    std::string firstRecord;
+    while (std::getline (ifs, line)) {
+        if (nLines == 1) {
+            firstRecord = line;
+        }
+        ++nLines;
+    }
+    ifs.close ();
+    std::remove (fileName.c_str ());
+    NS_TEST_ASSERT_MSG_EQ (nLines, nRecords + 1, "CSV file should contain a header and one line per record");
+    NS_TEST_ASSERT_MSG_EQ (firstRecord.substr (0, 42), "nada,rmcat_0,158114000,100000,60,286000,38",
+                           "CSV record should contain the raw values");
+}
+
+/*
+ * Anomalies are counted rather than reported one by one, and the wrapper
+ * exposes the counters of the wrapped controller
+ */
+class DiagnosticsTestCase : public TestCase
+{
+public:
+    DiagnosticsTestCase ();
+    virtual void DoRun ();
+};
+
+DiagnosticsTestCase::DiagnosticsTestCase ()
+: TestCase{"rmcat-controller-diagnostics"}
+{}
+
+void DiagnosticsTestCase::DoRun ()
+{
+    std::unique_ptr<rmcat::SenderBasedController> nada{new rmcat::NadaController{}};
+    rmcat::ThreadedController controller{std::move (nada)};
+    controller.setLogCallback (NoLog);
+
+    // Items from the future are skipped one by one: they do not fail a batch
+    typedef rmcat::SenderBasedController::FeedbackItem FeedbackItem;
+    std::vector<FeedbackItem> batch;
+    batch.push_back (FeedbackItem{0, 1000000, 0});
+    bool res = controller.processFeedbackBatch (1000001, batch);
+    NS_TEST_ASSERT_MSG_EQ (res, true, "Batch received before sending should be skipped, not failed");
+
+    uint64_t txTimestampUs = 1000000;
+    for (uint16_t sequence = 0; sequence < 10; ++sequence, txTimestampUs += 1000) {
+        controller.processSendPacket (txTimestampUs, sequence, 1000);
+    }
+    const uint64_t nowUs = txTimestampUs + 50000;
+    controller.processFeedback (nowUs, 0, 1000000 + 50000);
+    controller.processFeedback (nowUs, 2, 1002000 + 50000);
+    controller.processFeedback (nowUs, 1, 1001000 + 50000);  // reordered
+    controller.processFeedback (nowUs, 2, 1002000 + 50000);  // duplicate
+    controller.processFeedback (nowUs, 2, 1002000 + 50000);  // duplicate
+    res = controller.processFeedback (nowUs, 20, nowUs - 1); // not sent yet
+    NS_TEST_ASSERT_MSG_EQ (res, false, "Feedback from the future should be rejected");
+    batch.clear ();
+    batch.push_back (FeedbackItem{20, nowUs - 1, 0});        // not sent yet
+    batch.push_back (FeedbackItem{3, 1003000 + 50000, 0});
+    res = controller.processFeedbackBatch (nowUs, batch);
+    NS_TEST_ASSERT_MSG_EQ (res, true, "Feedback from the future should be skipped within a batch");
+
+    const rmcat::SenderBasedController::Diagnostics& diag = controller.getDiagnostics ();
+    NS_TEST_ASSERT_MSG_EQ (diag.reorderedFeedback, 1, "Reordered feedback should be counted");
+    NS_TEST_ASSERT_MSG_EQ (diag.duplicateFeedback, 2, "Duplicate feedback should be counted");
+    NS_TEST_ASSERT_MSG_EQ (diag.futureFeedback, 3, "Feedback from the future should be counted");
+    NS_TEST_ASSERT_MSG_EQ (diag.illegalSendSequence, 0, "No illegal send sequence should be counted");
+
+    controller.reset ();
+    NS_TEST_ASSERT_MSG_EQ (controller.getDiagnostics ().duplicateFeedback, 0, "Reset should clear the counters");
+}
+
+/*
+ * Controller exposing the metrics calculated by the superclass, with a
+ * history long enough to hold more packets than the 16-bit sequence space
+ */
+class MetricsProbeController : public rmcat::SenderBasedController
+{
+public:
+    explicit MetricsProbeController (uint64_t historyLengthUs)
+    {
+        setHistoryLength (historyLengthUs);
+    }
+    virtual void setCurrentBw (float newBw) {}
+    virtual float getBandwidth (uint64_t nowUs) const { return m_initBw; }
+
+    bool GetPktLossInfo (uint32_t& nLoss, float& plr) const { return getPktLossInfo (nLoss, plr); }
+    bool GetCurrentRecvRate (float& rrateBps) const { return getCurrentRecvRate (rrateBps); }
+    bool GetCurrentQdelay (uint64_t& qdelayUs) const { return getCurrentQdelay (qdelayUs); }
+    bool GetEcnMarkingInfo (uint32_t& nMarked, float& pmr) const { return getEcnMarkingInfo (nMarked, pmr); }
+    size_t GetHistorySize () const { return m_packetHistory.size (); }
+    void SetInTransitCapacity (size_t capacity) { setInTransitCapacity (capacity); }
+    void SetMinFilterWindow (size_t ntaps, uint64_t windowUs) { setMinFilterWindow (ntaps, windowUs); }
+    bool GetCurrentRTT (uint64_t& rttUs) const { return getCurrentRTT (rttUs); }
+    bool GetMaxQdelay (uint64_t& qdelayMaxUs) const { return getMaxQdelay (qdelayMaxUs); }
+    bool GetLossIntervalInfo (float& avgInterval, uint32_t& currentInterval) const
+    {
+        return getLossIntervalInfo (avgInterval, currentInterval);
+    }
+    bool ComputeMetrics (uint64_t nowUs, MetricsSnapshot& metrics) const { return computeMetrics (nowUs, metrics); }
+    const rmcat::PacketHistory& GetHistory () const { return m_packetHistory; }
+    uint64_t GetBaseDelay () const { return m_baseDelay.get (); }
+};
+
+/*
+ * On a forward gap in the sent sequences, the packet revealing the gap is
+ * recorded: its feedback is matched, and only the skipped sequences are
+ * accounted for as lost
+ */
+class SendGapTestCase : public TestCase
+{
+public:
+    SendGapTestCase ();
+    virtual void DoRun ();
+};
+
+SendGapTestCase::SendGapTestCase ()
+: TestCase{"rmcat-controller-send-gap"}
+{}
+
+void SendGapTestCase::DoRun ()
+{
+    const uint16_t nBefore = 10;
+    const uint16_t nSkipped = 5;
+    const uint64_t owdUs = 50000;
+    MetricsProbeController controller{500000};
+    controller.setLogCallback (NoLog);
+
+    for (uint16_t sequence = 0; sequence < nBefore; ++sequence) {
+        controller.processSendPacket (1000000 + sequence * 1000, sequence, 1000);
+    }
+    const uint16_t afterGap = nBefore + nSkipped;
+    const uint64_t txAfterGapUs = 1000000 + afterGap * 1000;
+    const bool sent = controller.processSendPacket (txAfterGapUs, afterGap, 1000);
+    NS_TEST_ASSERT_MSG_EQ (sent, true, "The packet revealing the gap should be recorded");
+    NS_TEST_ASSERT_MSG_EQ (controller.getDiagnostics ().illegalSendSequence, 1, "The gap should be counted");
+
+    for (uint16_t sequence = 0; sequence < nBefore; ++sequence) {
+        const uint64_t rxTimestampUs = 1000000 + sequence * 1000 + owdUs;
+        controller.processFeedback (rxTimestampUs + 1, sequence, rxTimestampUs);
+    }
+    uint32_t nLoss = 0;
+    float plr = 0.f;
+    NS_TEST_ASSERT_MSG_EQ (controller.GetPktLossInfo (nLoss, plr), true, "Loss info should be available");
+    NS_TEST_ASSERT_MSG_EQ (nLoss, 0, "No loss before the feedback of the packet after the gap");
+
+    const bool res = controller.processFeedback (txAfterGapUs + owdUs + 1, afterGap, txAfterGapUs + owdUs);
+    NS_TEST_ASSERT_MSG_EQ (res, true, "Feedback of the packet after the gap should be accepted");
+    NS_TEST_ASSERT_MSG_EQ (controller.getDiagnostics ().duplicateFeedback, 0,
+                           "Feedback of the packet after the gap should not be mistaken for a duplicate");
+    NS_TEST_ASSERT_MSG_EQ (controller.GetHistorySize (), nBefore + 1, "The packet after the gap should be in the history");
+    NS_TEST_ASSERT_MSG_EQ (controller.GetPktLossInfo (nLoss, plr), true, "Loss info should be available");
+    NS_TEST_ASSERT_MSG_EQ (nLoss, nSkipped, "Only the skipped sequences should be lost");
+    NS_TEST_ASSERT_MSG_EQ (controller.getBytesInFlight (), 0, "Nothing should be in flight");
+}
+
+/*
+ * At high rates, the history holds so many packets that 16-bit sequences
+ * wrap within it: loss and receive rate metrics must still be correct
+ */
+class HighRateMetricsTestCase : public TestCase
+{
+public:
+    HighRateMetricsTestCase ();
+    virtual void DoRun ();
+};
+
+HighRateMetricsTestCase::HighRateMetricsTestCase ()
+: TestCase{"rmcat-controller-high-rate-metrics"}
+{}
+
+void HighRateMetricsTestCase::DoRun ()
+{
+    const uint64_t rateBps = 400000000;   // 400 Mbps
+    const uint32_t pktSize = 1000;
+    const uint64_t gapUs = uint64_t (pktSize) * 8 * 1000000 / rateBps;  // 20us
+    const uint64_t historyUs = 2000000;   // 2s, i.e., 100000 packets
+    const uint64_t owdUs = 20000;         // 20ms
+    const uint32_t nPackets = 200000;     // 4s
+    const uint32_t lossPeriod = 100;      // one in 100 packets is lost
+
+    MetricsProbeController controller{historyUs};
+    controller.setLogCallback (NoLog);
+
+    uint16_t sequence = 0;
+    uint32_t fbErrors = 0;
+    for (uint32_t i = 0; i < nPackets; ++i, ++sequence) {
+        const uint64_t txTimestampUs = 1000000 + i * gapUs;
+        controller.processSendPacket (txTimestampUs, sequence, pktSize);
+        if (i % lossPeriod == lossPeriod - 1) {
+            continue;
+        }
+        const uint64_t rxTimestampUs = txTimestampUs + owdUs;
+        if (!controller.processFeedback (rxTimestampUs + owdUs, sequence, rxTimestampUs)) {
+            ++fbErrors;
+        }
+    }
+    NS_TEST_ASSERT_MSG_EQ (fbErrors, 0, "No feedback should have been rejected");
+    NS_TEST_ASSERT_MSG_GT (controller.GetHistorySize (), 65536, "History should span several sequence wraps");
+
+    uint32_t nLoss = 0;
+    float plr = 0.f;
+    NS_TEST_ASSERT_MSG_EQ (controller.GetPktLossInfo (nLoss, plr), true, "Loss info should be available");
+    NS_TEST_ASSERT_MSG_EQ_TOL (plr, 1.f / lossPeriod, 0.001f, "Loss ratio should match the actual losses");
+    NS_TEST_ASSERT_MSG_EQ_TOL (float (nLoss), float (controller.GetHistorySize ()) / (lossPeriod - 1), 2.f,
+                               "Number of losses should match the history's span");
+
+    float rrateBps = 0.f;
+    NS_TEST_ASSERT_MSG_EQ (controller.GetCurrentRecvRate (rrateBps), true, "Receive rate should be available");
+    const float expectedBps = float (rateBps) * (lossPeriod - 1) / lossPeriod;
+    NS_TEST_ASSERT_MSG_EQ_TOL (rrateBps, expectedBps, expectedBps * 0.01f, "Receive rate should match the actual rate");
+    NS_TEST_ASSERT_MSG_EQ (controller.getDiagnostics ().duplicateFeedback, 0, "No feedback should be mistaken for a duplicate");
+}
+
+/*
+ * With more than 32768 packets outstanding, the feedback of the oldest ones
+ * cannot be told apart from feedback from the future: the in-transit ring
+ * is capped so that they are forgotten, and a batch containing them still
+ * processes the rest of its items
+ */
+class OutstandingWrapTestCase : public TestCase
+{
+public:
+    OutstandingWrapTestCase ();
+    virtual void DoRun ();
+};
+
+OutstandingWrapTestCase::OutstandingWrapTestCase ()
+: TestCase{"rmcat-controller-outstanding-wrap"}
+{}
+
+void OutstandingWrapTestCase::DoRun ()
+{
+    const uint32_t nPackets = 40000;
+    const uint64_t gapUs = 10;
+    const uint64_t owdUs = 20000;
+    MetricsProbeController controller{1000000};
+    controller.setLogCallback (NoLog);
+    controller.SetInTransitCapacity (1u << 16);  // capped to 32768
+
+    for (uint32_t i = 0; i < nPackets; ++i) {
+        controller.processSendPacket (1000000 + i * gapUs, uint16_t (i), 1000);
+    }
+    const uint64_t nowUs = 1000000 + nPackets * gapUs + 2 * owdUs;
+    std::vector<rmcat::SenderBasedController::FeedbackItem> batch;
+    // Too old: 40000 packets behind, i.e., 25536 ahead in 16-bit sequences
+    for (uint32_t i = 0; i < 100; ++i) {
+        batch.push_back (rmcat::SenderBasedController::FeedbackItem{uint16_t (i), 1000000 + i * gapUs + owdUs, 0});
+    }
+    // Oldest packet still in transit: 32767 behind the last one sent
+    const uint32_t oldest = nPackets - 32768;
+    batch.push_back (rmcat::SenderBasedController::FeedbackItem{uint16_t (oldest), 1000000 + oldest * gapUs + owdUs, 0});
+    for (uint32_t i = nPackets - 100; i < nPackets; ++i) {
+        batch.push_back (rmcat::SenderBasedController::FeedbackItem{uint16_t (i), 1000000 + i * gapUs + owdUs, 0});
+    }
+    NS_TEST_ASSERT_MSG_EQ (controller.processFeedbackBatch (nowUs, batch), true, "Batch should not be rejected as a whole");
+    const rmcat::SenderBasedController::Diagnostics& diag = controller.getDiagnostics ();
+    NS_TEST_ASSERT_MSG_EQ (diag.futureFeedback, 100, "Feedback too old to be resolved should be skipped and counted");
+    NS_TEST_ASSERT_MSG_EQ (diag.duplicateFeedback, 0, "No feedback should be mistaken for a duplicate");
+    NS_TEST_ASSERT_MSG_EQ (controller.GetHistorySize (), 101, "Packets in transit should be added to the history");
+    uint64_t qdelayUs = 0;
+    NS_TEST_ASSERT_MSG_EQ (controller.GetCurrentQdelay (qdelayUs), true, "Queuing delay should be available");
+    NS_TEST_ASSERT_MSG_EQ (qdelayUs, 0, "One way delays should have been matched with the right packets");
+}
+
+/*
+ * Path that loses, marks, reorders and duplicates packets, and holds a few
+ * of them back for longer than the history. Its queue fills and drains, its
+ * base delay decreases, then increases, and the sender pauses for long
+ * enough to reset the history. Sequences and send timestamps wrap early on.
+ * The receiver reports the packets received every 50ms, in sequence order
+ */
+struct LossyPathPacket
+{
+    uint64_t txTimestampUs;
+    uint16_t sequence;
+    uint32_t size;
+    bool lost;
+    uint64_t rxTimestampUs;
+    uint8_t ecn;
+};
+
+struct LossyPathEvent
+{
+    uint64_t nowUs;
+    uint32_t packet;   // packet sent, if there is no feedback
+    std::vector<rmcat::SenderBasedController::FeedbackItem> feedback;
+};
+
+struct LossyPath
+{
+    std::vector<LossyPathPacket> packets;
+    std::vector<LossyPathEvent> events;   // in time order
+};
+
+static LossyPath MakeLossyPath (uint32_t nPackets, uint32_t seed)
+{
+    const uint64_t startUs = uint64_t (0) - 2000000;  // wraps after 2s
+    const uint16_t startSequence = 65536 - 1000;      // wraps after 1000 packets
+    const uint64_t gapUs = 2000;
+    const uint64_t pauseUs = 700000;
+    const uint64_t reportUs = 50000;
+    const uint64_t reverseUs = 20000;
+
+    std::mt19937 rng{seed};
+    std::uniform_real_distribution<double> coin{0., 1.};
+    std::uniform_int_distribution<uint32_t> pktSize{200, 1200};
+    std::uniform_int_distribution<uint64_t> jitterUs{0, 3000};
+
+    // Times are relative to the start (so that they can be sorted) until
+    // the events are built. Reports are received in (report time, packet)
+    std::vector<std::pair<uint64_t, uint32_t> > reported;
+    std::vector<uint64_t> relTxUs;
+    LossyPath path;
+    uint64_t txUs = 0;
+    for (uint32_t i = 0; i < nPackets; ++i, txUs += gapUs) {
+        if (i == nPackets / 2) {
+            txUs += pauseUs;
+        }
+        const uint64_t baseUs = i < nPackets * 2 / 5 ? 40000 : (i < nPackets * 7 / 10 ? 25000 : 60000);
+        // The queue fills and drains every second
+        const uint64_t phaseUs = txUs % 1000000;
+        const uint64_t queueUs = (phaseUs < 500000 ? 500000 - phaseUs : phaseUs - 500000) * 40000 / 500000;
+        uint64_t owdUs = baseUs + queueUs + jitterUs (rng);
+        const double dice = coin (rng);
+        if (dice < 0.005) {
+            owdUs += 400000 + uint64_t (coin (rng) * 500000);  // held back
+        } else if (dice < 0.05) {
+            owdUs += 1000 + uint64_t (coin (rng) * 30000);     // reordered
+        }
+        const uint32_t size = pktSize (rng);
+        const bool lost = coin (rng) < 0.03;
+        const uint8_t ecn = coin (rng) < 0.03 ? rmcat::ECN_CE : rmcat::ECN_ECT0;
+        path.packets.push_back (LossyPathPacket{startUs + txUs, uint16_t (startSequence + i), size,
+                                                lost, startUs + txUs + owdUs, ecn});
+        relTxUs.push_back (txUs);
+        if (lost) {
+            continue;
+        }
+        const uint64_t reportTimeUs = (txUs + owdUs + reportUs - 1) / reportUs * reportUs;
+        reported.push_back (std::make_pair (reportTimeUs, i));
+        if (coin (rng) < 0.01) {
+            reported.push_back (std::make_pair (reportTimeUs + reportUs, i));  // duplicate
+        }
+    }
+    std::stable_sort (reported.begin (), reported.end (),
+                      [] (const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) {
+                          return a.first < b.first;
+                      });
+
+    size_t next = 0;
+    for (uint32_t i = 0; i < nPackets || next < reported.size ();) {
+        const uint64_t reportTimeUs = next < reported.size () ? reported[next].first : 0;
+        if (i < nPackets && (next == reported.size () || relTxUs[i] <= reportTimeUs + reverseUs)) {
+            path.events.push_back (LossyPathEvent{path.packets[i].txTimestampUs, i, {}});
+            ++i;
+            continue;
+        }
+        LossyPathEvent event{startUs + reportTimeUs + reverseUs, 0, {}};
+        for (; next < reported.size () && reported[next].first == reportTimeUs; ++next) {
+            const LossyPathPacket& packet = path.packets[reported[next].second];
+            event.feedback.push_back (rmcat::SenderBasedController::FeedbackItem{packet.sequence,
+                                                                                 packet.rxTimestampUs,
+                                                                                 packet.ecn});
+        }
+        path.events.push_back (event);
+    }
+    return path;
+}
+
+/*
+ * Metrics calculated by scanning the whole history, as the controllers did
+ * before maintaining them incrementally
+ */
+struct ScannedMetrics
+{
+    uint64_t qdelayUs;
+    uint64_t rttUs;
+    uint64_t qdelayMaxUs;
+    uint32_t nLoss;
+    float plr;
+    uint32_t nMarked;
+    float pmr;
+    bool rrateValid;
+    float rrateBps;
+};
+
+static ScannedMetrics ScanHistory (const rmcat::PacketHistory& history, uint64_t baseDelayUs,
+                                   size_t ntaps, uint64_t windowUs, uint32_t recvRateOverhead)
+{
+    const rmcat::WrapLess<uint64_t> less{};
+    ScannedMetrics metrics{0, 0, 0, 0, 0.f, 0, 0.f, false, 0.f};
+    uint64_t bytes = 0;
+    const uint64_t lastTxUs = history.back ().txTimestampUs;
+    bool inWindow = true;
+    for (size_t i = history.size (); i > 0; --i) {
+        const rmcat::PacketRecord packet = history.at (i - 1);
+        const uint64_t qdelayUs = less (packet.owdUs, baseDelayUs) ? 0 : packet.owdUs - baseDelayUs;
+        metrics.qdelayMaxUs = std::max (metrics.qdelayMaxUs, qdelayUs);
+        if ((ntaps > 0 && history.size () - i >= ntaps) ||
+            (windowUs > 0 && lastTxUs - packet.txTimestampUs >= windowUs)) {
+            inWindow = false;
+        }
+        if (inWindow) {
+            const bool first = i == history.size ();
+            metrics.qdelayUs = first ? qdelayUs : std::min (metrics.qdelayUs, qdelayUs);
+            metrics.rttUs = first ? packet.rttUs : std::min (metrics.rttUs, packet.rttUs);
+        }
+        if (i > 1) {
+            metrics.nLoss += packet.sequence - history.sequenceAt (i - 2) - 1;
+            bytes += packet.size + recvRateOverhead;
+        }
+        metrics.nMarked += packet.ecn == rmcat::ECN_CE ? 1 : 0;
+    }
+    metrics.plr = float (metrics.nLoss) / float (metrics.nLoss + history.size ());
+    metrics.pmr = float (metrics.nMarked) / float (history.size ());
+    // Technically, the first packet is out of the time span
+    const uint64_t firstRxUs = history.front ().txTimestampUs + history.front ().owdUs;
+    const uint64_t lastRxUs = history.back ().txTimestampUs + history.back ().owdUs;
+    if (less (firstRxUs, lastRxUs)) {
+        metrics.rrateValid = true;
+        metrics.rrateBps = float (bytes * 8) * 1000.f * 1000.f / float (lastRxUs - firstRxUs);
+    }
+    return metrics;
+}
+
+/*
+ * The windowed filters hold the best sample of the window, as a scan of all
+ * the samples in the window does, with wrapping values and timestamps, and
+ * when trimmed. The controller's qdelay and RTT match a scan of the last
+ * packets of the history, on a lossy path that reorders packets
+ */
+class WindowedFilterTestCase : public TestCase
+{
+public:
+    WindowedFilterTestCase ();
+    virtual void DoRun ();
+};
+
+WindowedFilterTestCase::WindowedFilterTestCase ()
+: TestCase{"rmcat-controller-windowed-filter"}
+{}
+
+template <typename Compare>
+static uint32_t CountFilterMismatches (size_t maxTaps, uint64_t windowUs)
+{
+    rmcat::WindowedFilter<uint64_t, Compare> filter{maxTaps, windowUs};
+    std::mt19937 rng{1};
+    std::uniform_int_distribution<uint64_t> value{0, 100000};
+    std::uniform_int_distribution<uint64_t> gap{0, 3000};
+    const uint64_t valueOffsetUs = uint64_t (0) - 50000;
+    uint64_t timestampUs = uint64_t (0) - 1000000;
+    std::vector<std::pair<uint64_t, uint64_t> > samples;  // (value, timestamp)
+    size_t first = 0;  // older samples have been trimmed
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < 20000; ++i) {
+        timestampUs += gap (rng);
+        samples.push_back (std::make_pair (valueOffsetUs + value (rng), timestampUs));
+        filter.update (samples.back ().first, timestampUs);
+        if (i % 1000 == 999) {
+            const size_t keep = gap (rng) % 50;
+            filter.trimToLast (keep);
+            first = std::max (first, samples.size () - std::min (keep, samples.size ()));
+        }
+        bool found = false;
+        uint64_t best = 0;
+        for (size_t j = samples.size (); j > first; --j) {
+            if ((maxTaps > 0 && samples.size () - j >= maxTaps) ||
+                (windowUs > 0 && timestampUs - samples[j - 1].second >= windowUs)) {
+                break;
+            }
+            if (!found || Compare{} (samples[j - 1].first, best)) {
+                best = samples[j - 1].first;
+                found = true;
+            }
+        }
+        if (filter.empty () == found || (found && filter.get () != best)) {
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+void WindowedFilterTestCase::DoRun ()
+{
+    typedef rmcat::WrapLess<uint64_t> Less;
+    typedef rmcat::WrapGreater<uint64_t> Greater;
+    // The first window is the controller's default one
+    const size_t taps[] = {15, 0, 8, 0};
+    const uint64_t windowsUs[] = {0, 100000, 30000, 0};
+    for (size_t i = 0; i < 4; ++i) {
+        NS_TEST_ASSERT_MSG_EQ (CountFilterMismatches<Less> (taps[i], windowsUs[i]), 0,
+                               "Min filter should hold the minimum of its window");
+        NS_TEST_ASSERT_MSG_EQ (CountFilterMismatches<Greater> (taps[i], windowsUs[i]), 0,
+                               "Max filter should hold the maximum of its window");
+    }
+
+    const LossyPath path = MakeLossyPath (6000, 1);
+    for (size_t i = 0; i < 4; ++i) {
+        MetricsProbeController controller{500000};
+        controller.setLogCallback (NoLog);
+        if (i > 0) {
+            controller.SetMinFilterWindow (taps[i], windowsUs[i]);
+        }
+        uint32_t checks = 0;
+        uint32_t mismatches = 0;
+        for (const auto& event : path.events) {
+            if (event.feedback.empty ()) {
+                const LossyPathPacket& packet = path.packets[event.packet];
+                controller.processSendPacket (packet.txTimestampUs, packet.sequence, packet.size);
+                continue;
+            }
+            controller.processFeedbackBatch (event.nowUs, event.feedback);
+            if (controller.GetHistory ().empty ()) {
+                continue;
+            }
+            const ScannedMetrics scanned = ScanHistory (controller.GetHistory (), controller.GetBaseDelay (),
+                                                        taps[i], windowsUs[i], 0);
+            uint64_t qdelayUs = 0;
+            uint64_t rttUs = 0;
+            controller.GetCurrentQdelay (qdelayUs);
+            controller.GetCurrentRTT (rttUs);
+            ++checks;
+            if (qdelayUs != scanned.qdelayUs || rttUs != scanned.rttUs) {
+                ++mismatches;
+            }
+        }
+        const rmcat::SenderBasedController::Diagnostics& diag = controller.getDiagnostics ();
+        NS_TEST_ASSERT_MSG_GT (checks, 200, "Metrics should have been checked throughout the path");
+        NS_TEST_ASSERT_MSG_GT (diag.reorderedFeedback, 0, "Path should reorder packets");
+        NS_TEST_ASSERT_MSG_GT (diag.historyResets, 0, "Path should reset the history");
+        NS_TEST_ASSERT_MSG_EQ (mismatches, 0, "Qdelay and RTT should match a scan of the history");
+    }
+}
+
+/*
+ * Late packets, i.e., reordered by the network or whose feedback arrives out
+ * of order, have older receive and send times than the packets before them.
+ * The receive rate estimators count them as received at the newest receive
+ * time, and the base delay tracker accounts for their delay without
+ * expiring any bucket. The receive rate calculated on the history is not
+ * valid while its first packet was received after its last one
+ */
+class LateFeedbackTestCase : public TestCase
+{
+public:
+    LateFeedbackTestCase ();
+    virtual void DoRun ();
+};
+
+LateFeedbackTestCase::LateFeedbackTestCase ()
+: TestCase{"rmcat-controller-late-feedback"}
+{}
+
+/*
+ * Feed a 1Mbps flow in which one in 20 packets is overtaken by the next
+ * ones, and return the receive rates queried after each feedback report
+ * (zero if not valid). Reports list the packets received every 20ms in
+ * sequence order, so receive times can go backwards. If clampRx is set, the
+ * receive times reported are never older than the newest one reported
+ */
+static std::vector<float> RecvRatesWithLatePackets (std::shared_ptr<rmcat::RecvRateEstimator> estimator,
+                                                    bool clampRx, uint64_t& reordered)
+{
+    const uint32_t nPackets = 600;
+    const uint32_t pktSize = 1000;
+    const uint64_t gapUs = 8000;
+    const uint64_t owdUs = 50000;
+    const uint64_t lateUs = 30000;
+    const uint64_t reportUs = 20000;
+
+    MetricsProbeController controller{500000};
+    controller.setLogCallback (NoLog);
+    controller.setRecvRateEstimator (estimator);
+    std::vector<std::pair<uint64_t, uint32_t> > reported;  // (report time, packet)
+    for (uint32_t i = 0; i < nPackets; ++i) {
+        const uint64_t txTimestampUs = 1000000 + i * gapUs;
+        controller.processSendPacket (txTimestampUs, uint16_t (i), pktSize);
+        const uint64_t rxTimestampUs = txTimestampUs + owdUs + (i % 20 == 10 ? lateUs : 0);
+        reported.push_back (std::make_pair ((rxTimestampUs + reportUs - 1) / reportUs * reportUs, i));
+    }
+    std::sort (reported.begin (), reported.end ());
+
+    std::vector<float> rates;
+    uint64_t newestRxUs = 0;
+    for (size_t next = 0; next < reported.size ();) {
+        const uint64_t reportTimeUs = reported[next].first;
+        std::vector<rmcat::SenderBasedController::FeedbackItem> batch;
+        for (; next < reported.size () && reported[next].first == reportTimeUs; ++next) {
+            const uint32_t i = reported[next].second;
+            uint64_t rxTimestampUs = 1000000 + i * gapUs + owdUs + (i % 20 == 10 ? lateUs : 0);
+            newestRxUs = std::max (newestRxUs, rxTimestampUs);
+            if (clampRx) {
+                rxTimestampUs = newestRxUs;
+            }
+            batch.push_back (rmcat::SenderBasedController::FeedbackItem{uint16_t (i), rxTimestampUs, 0});
+        }
+        controller.processFeedbackBatch (reportTimeUs + owdUs, batch);
+        float rrateBps = 0.f;
+        rates.push_back (controller.GetCurrentRecvRate (rrateBps) ? rrateBps : 0.f);
+    }
+    reordered = controller.getDiagnostics ().reorderedFeedback;
+    return rates;
+}
+
+void LateFeedbackTestCase::DoRun ()
+{
+    std::vector<std::shared_ptr<rmcat::RecvRateEstimator> > estimators[2];
+    for (size_t i = 0; i < 2; ++i) {
+        estimators[i].push_back (std::make_shared<rmcat::WindowRecvRateEstimator> ());
+        estimators[i].push_back (std::make_shared<rmcat::EwmaRecvRateEstimator> ());
+        estimators[i].push_back (std::make_shared<rmcat::FrameRecvRateEstimator> ());
+    }
+    for (size_t e = 0; e < estimators[0].size (); ++e) {
+        uint64_t reordered = 0;
+        const std::vector<float> rates = RecvRatesWithLatePackets (estimators[0][e], false, reordered);
+        const std::vector<float> clampedRates = RecvRatesWithLatePackets (estimators[1][e], true, reordered);
+        NS_TEST_ASSERT_MSG_GT (reordered, 0, "Feedback should have arrived out of order");
+        NS_TEST_ASSERT_MSG_EQ ((rates == clampedRates), true,
+                               "Late packets should count as received at the newest receive time");
+        NS_TEST_ASSERT_MSG_GT (rates.back (), 0.f, "Receive rate should be valid");
+    }
+
+    // A late delay sample, far older than the window, may lower the base
+    // delay, but it does not expire the minimum of the window
+    const uint64_t bucketUs = 1000000;
+    rmcat::BaseDelayTracker tracker{4, bucketUs};
+    uint64_t nowUs = 10 * bucketUs;
+    tracker.update (40000, nowUs);
+    for (nowUs += 10000; nowUs < 12 * bucketUs; nowUs += 10000) {
+        tracker.update (50000, nowUs);
+    }
+    tracker.update (45000, nowUs - 8 * bucketUs);
+    NS_TEST_ASSERT_MSG_EQ (tracker.get (), 40000, "Late sample should not expire older buckets");
+    tracker.update (30000, nowUs - 8 * bucketUs);
+    NS_TEST_ASSERT_MSG_EQ (tracker.get (), 30000, "Late sample should lower the base delay");
+    // The late sample is kept as long as the newest bucket, started at 11s
+    for (; nowUs < 14 * bucketUs + bucketUs / 2; nowUs += 10000) {
+        tracker.update (50000, nowUs);
+    }
+    NS_TEST_ASSERT_MSG_EQ (tracker.get (), 30000, "Late sample should be kept within the window");
+    for (; nowUs < 16 * bucketUs; nowUs += 10000) {
+        tracker.update (50000, nowUs);
+    }
+    NS_TEST_ASSERT_MSG_EQ (tracker.get (), 50000, "Late sample should expire with its bucket");
+
+    // The first packet of the history is received 40ms after the next ones
+    MetricsProbeController controller{500000};
+    controller.setLogCallback (NoLog);
+    uint64_t txTimestampUs = 1000000;
+    std::vector<rmcat::SenderBasedController::FeedbackItem> batch;
+    for (uint16_t sequence = 0; sequence < 10; ++sequence, txTimestampUs += 1000) {
+        controller.processSendPacket (txTimestampUs, sequence, 1000);
+        batch.push_back (rmcat::SenderBasedController::FeedbackItem{sequence,
+                                                                    txTimestampUs + (sequence == 0 ? 50000 : 10000),
+                                                                    0});
+    }
+    controller.processFeedbackBatch (txTimestampUs + 100000, batch);
+    float rrateBps = 0.f;
+    NS_TEST_ASSERT_MSG_EQ (controller.GetCurrentRecvRate (rrateBps), false,
+                           "Receive rate should not be valid over a negative time span");
+    NS_TEST_ASSERT_MSG_EQ (controller.getDiagnostics ().simultaneousRx, 1, "Failed query should be counted");
+    for (uint16_t sequence = 10; sequence < 1000; ++sequence, txTimestampUs += 1000) {
+        controller.processSendPacket (txTimestampUs, sequence, 1000);
+        controller.processFeedback (txTimestampUs + 100000, sequence, txTimestampUs + 10000);
+    }
+    NS_TEST_ASSERT_MSG_EQ (controller.GetCurrentRecvRate (rrateBps), true,
+                           "Receive rate should be valid once the first packet is garbage collected");
+    NS_TEST_ASSERT_MSG_EQ_TOL (rrateBps, 8000000.f, 800000.f, "Receive rate should match the actual rate");
+}
+
+/*
+ * The maximum qdelay is that of the packet with the largest one way delay
+ * in the history, as a scan of the history finds, also while the base
+ * delay decreases and increases, and after late packets are inserted
+ */
+class MaxQdelayTestCase : public TestCase
+{
+public:
+    MaxQdelayTestCase ();
+    virtual void DoRun ();
+};
+
+MaxQdelayTestCase::MaxQdelayTestCase ()
+: TestCase{"rmcat-controller-max-qdelay"}
+{}
+
+void MaxQdelayTestCase::DoRun ()
+{
+    const LossyPath path = MakeLossyPath (6000, 2);
+    MetricsProbeController controller{500000};
+    controller.setLogCallback (NoLog);
+    uint32_t checks = 0;
+    uint32_t mismatches = 0;
+    uint64_t minBaseDelayUs = std::numeric_limits<uint64_t>::max ();
+    uint64_t maxBaseDelayUs = 0;
+    for (const auto& event : path.events) {
+        if (event.feedback.empty ()) {
+            const LossyPathPacket& packet = path.packets[event.packet];
+            controller.processSendPacket (packet.txTimestampUs, packet.sequence, packet.size);
+            continue;
+        }
+        controller.processFeedbackBatch (event.nowUs, event.feedback);
+        if (controller.GetHistory ().empty ()) {
+            continue;
+        }
+        const ScannedMetrics scanned = ScanHistory (controller.GetHistory (), controller.GetBaseDelay (), 0, 0, 0);
+        uint64_t qdelayMaxUs = 0;
+        controller.GetMaxQdelay (qdelayMaxUs);
+        ++checks;
+        if (qdelayMaxUs != scanned.qdelayMaxUs) {
+            ++mismatches;
+        }
+        minBaseDelayUs = std::min (minBaseDelayUs, controller.GetBaseDelay ());
+        maxBaseDelayUs = std::max (maxBaseDelayUs, controller.GetBaseDelay ());
+    }
+    NS_TEST_ASSERT_MSG_GT (checks, 200, "Max qdelay should have been checked throughout the path");
+    NS_TEST_ASSERT_MSG_GT (controller.getDiagnostics ().reorderedFeedback, 0, "Path should reorder packets");
+    NS_TEST_ASSERT_MSG_GT (maxBaseDelayUs - minBaseDelayUs, 10000, "Base delay should have changed");
+    NS_TEST_ASSERT_MSG_EQ (mismatches, 0, "Max qdelay should match a scan of the history");
+}
+
+/*
+ * The in-transit ring matches feedback with the packets sent, under
+ * reordering, duplicates, and packets held back for longer than the ring
+ * or the history covers. The history then holds, in sequence order, the
+ * records of exactly the packets whose feedback was accepted, and every
+ * anomaly is counted once
+ */
+class InTransitRingTestCase : public TestCase
+{
+public:
+    InTransitRingTestCase ();
+    virtual void DoRun ();
+};
+
+InTransitRingTestCase::InTransitRingTestCase ()
+: TestCase{"rmcat-controller-in-transit-ring"}
+{}
+
+void InTransitRingTestCase::DoRun ()
+{
+    const uint32_t nPackets = 6000;
+    const LossyPath path = MakeLossyPath (nPackets, 3);
+    const uint16_t firstSequence = path.packets.front ().sequence;
+    // The smaller ring forgets the packets held back
+    const size_t capacities[] = {4096, 128};
+    for (size_t c = 0; c < 2; ++c) {
+        MetricsProbeController controller{500000};
+        controller.setLogCallback (NoLog);
+        controller.SetInTransitCapacity (capacities[c]);
+
+        std::vector<bool> reported (nPackets, false);
+        std::vector<bool> accepted (nPackets, false);
+        uint32_t lastSent = 0;
+        uint32_t newest = 0;
+        uint64_t expectedDuplicates = 0;
+        uint64_t expectedLate = 0;
+        uint64_t forgotten = 0;
+        uint32_t checks = 0;
+        uint32_t mismatches = 0;
+        for (const auto& event : path.events) {
+            if (event.feedback.empty ()) {
+                const LossyPathPacket& packet = path.packets[event.packet];
+                controller.processSendPacket (packet.txTimestampUs, packet.sequence, packet.size);
+                lastSent = event.packet;
+                continue;
+            }
+            for (const auto& item : event.feedback) {
+                const uint32_t i = uint16_t (item.sequence - firstSequence);
+                if (lastSent - i >= capacities[c]) {
+                    ++forgotten;
+                    ++expectedDuplicates;
+                } else if (reported[i]) {
+                    ++expectedDuplicates;
+                } else {
+                    accepted[i] = true;
+                    if (i < newest) {
+                        ++expectedLate;
+                    }
+                    newest = std::max (newest, i);
+                }
+                reported[i] = true;
+            }
+            controller.processFeedbackBatch (event.nowUs, event.feedback);
+
+            const rmcat::PacketHistory& history = controller.GetHistory ();
+            const rmcat::SenderBasedController::Diagnostics& diag = controller.getDiagnostics ();
+            ++checks;
+            bool match = diag.duplicateFeedback == expectedDuplicates &&
+                         diag.reorderedFeedback + diag.tooLateFeedback == expectedLate;
+            if (history.empty ()) {
+                mismatches += match ? 0 : 1;
+                continue;
+            }
+            // Records match the packets sent, with extended sequences
+            // consistent with the ones on the wire
+            const uint32_t first = uint16_t (history.front ().sequence - firstSequence);
+            std::vector<bool> inHistory (nPackets, false);
+            for (size_t k = 0; k < history.size (); ++k) {
+                const rmcat::PacketRecord record = history.at (k);
+                const uint32_t i = uint16_t (record.sequence - firstSequence);
+                if (i >= nPackets) {
+                    match = false;
+                    break;
+                }
+                const LossyPathPacket& packet = path.packets[i];
+                match = match && record.sequence - history.front ().sequence == i - first &&
+                        (k == 0 || history.sequenceAt (k - 1) < record.sequence) &&
+                        record.txTimestampUs == packet.txTimestampUs && record.size == packet.size &&
+                        record.owdUs == packet.rxTimestampUs - packet.txTimestampUs && record.ecn == packet.ecn;
+                inHistory[i] = true;
+            }
+            // No packet accepted within the span of the history is missing
+            const uint32_t last = uint16_t (history.back ().sequence - firstSequence);
+            for (uint32_t i = first; i <= last; ++i) {
+                match = match && inHistory[i] == accepted[i];
+            }
+            mismatches += match ? 0 : 1;
+        }
+        const rmcat::SenderBasedController::Diagnostics& diag = controller.getDiagnostics ();
+        NS_TEST_ASSERT_MSG_GT (checks, 200, "History should have been checked throughout the path");
+        NS_TEST_ASSERT_MSG_GT (diag.reorderedFeedback, 0, "Path should reorder packets");
+        NS_TEST_ASSERT_MSG_GT (diag.historyResets, 0, "Path should reset the history");
+        if (c == 1) {
+            NS_TEST_ASSERT_MSG_GT (forgotten, 0, "Ring should forget the packets held back");
+        } else {
+            NS_TEST_ASSERT_MSG_GT (diag.tooLateFeedback, 0, "Packets held back should be older than the history");
+        }
+        NS_TEST_ASSERT_MSG_EQ (mismatches, 0, "History and counters should match the feedback accepted");
+    }
+}
+
+/*
+ * A metrics snapshot holds the values of the individual metrics queries,
+ * and these match a scan of the history, throughout the lossy path
+ */
+class MetricsSnapshotTestCase : public TestCase
+{
+public:
+    MetricsSnapshotTestCase ();
+    virtual void DoRun ();
+};
+
+MetricsSnapshotTestCase::MetricsSnapshotTestCase ()
+: TestCase{"rmcat-controller-metrics-snapshot"}
+{}
+
+void MetricsSnapshotTestCase::DoRun ()
+{
+    typedef rmcat::SenderBasedController::MetricsSnapshot MetricsSnapshot;
+    const size_t minHistory = 5;  // for loss, marking and receive rate metrics
+    const LossyPath path = MakeLossyPath (6000, 4);
+    const uint32_t overheads[] = {0, 40};
+    for (size_t o = 0; o < 2; ++o) {
+        MetricsProbeController controller{500000};
+        controller.setLogCallback (NoLog);
+        controller.setRecvRateOverhead (overheads[o]);
+        uint32_t checks = 0;
+        uint32_t mismatches = 0;
+        for (const auto& event : path.events) {
+            if (event.feedback.empty ()) {
+                const LossyPathPacket& packet = path.packets[event.packet];
+                controller.processSendPacket (packet.txTimestampUs, packet.sequence, packet.size);
+                continue;
+            }
+            controller.processFeedbackBatch (event.nowUs, event.feedback);
+            MetricsSnapshot metrics;
+            const bool valid = controller.ComputeMetrics (event.nowUs, metrics);
+            const rmcat::PacketHistory& history = controller.GetHistory ();
+            bool match = valid == !history.empty () && metrics.nowUs == event.nowUs &&
+                         metrics.historyLen == history.size ();
+
+            // The individual queries return the snapshot's values
+            uint64_t qdelayUs = 0;
+            uint64_t rttUs = 0;
+            uint64_t qdelayMaxUs = 0;
+            uint32_t nLoss = 0;
+            float plr = 0.f;
+            float rrateBps = 0.f;
+            uint32_t nMarked = 0;
+            float pmr = 0.f;
+            float avgInterval = 0.f;
+            uint32_t currentInterval = 0;
+            match = match && controller.GetCurrentQdelay (qdelayUs) == metrics.qdelayValid &&
+                    controller.GetCurrentRTT (rttUs) == metrics.rttValid &&
+                    controller.GetMaxQdelay (qdelayMaxUs) == metrics.qdelayMaxValid &&
+                    controller.GetPktLossInfo (nLoss, plr) == metrics.lossValid &&
+                    controller.GetCurrentRecvRate (rrateBps) == metrics.rrateValid &&
+                    controller.GetEcnMarkingInfo (nMarked, pmr) == metrics.markValid &&
+                    controller.GetLossIntervalInfo (avgInterval, currentInterval) == metrics.lossIntervalValid;
+            match = match && (!metrics.qdelayValid || qdelayUs == metrics.qdelayUs) &&
+                    (!metrics.rttValid || rttUs == metrics.rttUs) &&
+                    (!metrics.qdelayMaxValid || qdelayMaxUs == metrics.qdelayMaxUs) &&
+                    (!metrics.lossValid || (nLoss == metrics.nLoss && plr == metrics.plr)) &&
+                    (!metrics.rrateValid || rrateBps == metrics.rrateBps) &&
+                    (!metrics.markValid || (nMarked == metrics.nMarked && pmr == metrics.pmr)) &&
+                    (!metrics.lossIntervalValid || (avgInterval == metrics.avgInterval &&
+                                                    currentInterval == metrics.currentInterval));
+
+            // The snapshot's values match a scan of the history
+            if (!history.empty ()) {
+                const ScannedMetrics scanned = ScanHistory (history, controller.GetBaseDelay (), 15, 0, overheads[o]);
+                const bool longEnough = history.size () >= minHistory;
+                match = match && metrics.qdelayValid && metrics.qdelayUs == scanned.qdelayUs &&
+                        metrics.rttValid && metrics.rttUs == scanned.rttUs &&
+                        metrics.qdelayMaxValid && metrics.qdelayMaxUs == scanned.qdelayMaxUs &&
+                        metrics.lossValid == longEnough && metrics.markValid == longEnough &&
+                        metrics.rrateValid == (longEnough && scanned.rrateValid);
+                if (longEnough) {
+                    match = match && metrics.nLoss == scanned.nLoss && metrics.plr == scanned.plr &&
+                            metrics.nMarked == scanned.nMarked && metrics.pmr == scanned.pmr &&
+                            (!scanned.rrateValid || metrics.rrateBps == scanned.rrateBps);
+                }
+            }
+            ++checks;
+            mismatches += match ? 0 : 1;
+        }
+        NS_TEST_ASSERT_MSG_GT (checks, 200, "Metrics should have been checked throughout the path");
+        NS_TEST_ASSERT_MSG_GT (controller.getDiagnostics ().reorderedFeedback, 0, "Path should reorder packets");
+        NS_TEST_ASSERT_MSG_EQ (mismatches, 0, "Metrics snapshot should match the queries and a scan of the history");
+    }
+}
+
+/*
+ * Ingesting a feedback report as a batch leaves the controller in the same
+ * state as ingesting its items one by one: same history, metrics, inter-loss
+ * intervals, bytes in flight and counters, also when the report contains
+ * feedback from the future
+ */
+class FeedbackBatchTestCase : public TestCase
+{
+public:
+    FeedbackBatchTestCase ();
+    virtual void DoRun ();
+};
+
+FeedbackBatchTestCase::FeedbackBatchTestCase ()
+: TestCase{"rmcat-controller-feedback-batch"}
+{}
+
+static bool SameMetrics (const rmcat::SenderBasedController::MetricsSnapshot& lhs,
+                         const rmcat::SenderBasedController::MetricsSnapshot& rhs)
+{
+    return lhs.historyLen == rhs.historyLen &&
+           lhs.qdelayValid == rhs.qdelayValid && lhs.qdelayUs == rhs.qdelayUs &&
+           lhs.rttValid == rhs.rttValid && lhs.rttUs == rhs.rttUs &&
+           lhs.qdelayMaxValid == rhs.qdelayMaxValid && lhs.qdelayMaxUs == rhs.qdelayMaxUs &&
+           lhs.lossValid == rhs.lossValid && lhs.nLoss == rhs.nLoss && lhs.plr == rhs.plr &&
+           lhs.rrateValid == rhs.rrateValid && lhs.rrateBps == rhs.rrateBps &&
+           lhs.markValid == rhs.markValid && lhs.nMarked == rhs.nMarked && lhs.pmr == rhs.pmr &&
+           lhs.lossIntervalValid == rhs.lossIntervalValid && lhs.avgInterval == rhs.avgInterval &&
+           lhs.currentInterval == rhs.currentInterval;
+}
+
+static bool SameHistory (const rmcat::PacketHistory& lhs, const rmcat::PacketHistory& rhs)
+{
+    if (lhs.size () != rhs.size ()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size (); ++i) {
+        const rmcat::PacketRecord l = lhs.at (i);
+        const rmcat::PacketRecord r = rhs.at (i);
+        if (l.sequence != r.sequence || l.txTimestampUs != r.txTimestampUs || l.size != r.size ||
+            l.owdUs != r.owdUs || l.rttUs != r.rttUs || l.ecn != r.ecn) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool SameState (const MetricsProbeController& lhs, const MetricsProbeController& rhs, uint64_t nowUs)
+{
+    typedef rmcat::SenderBasedController::Diagnostics Diagnostics;
+    rmcat::SenderBasedController::MetricsSnapshot lhsMetrics;
+    rmcat::SenderBasedController::MetricsSnapshot rhsMetrics;
+    lhs.ComputeMetrics (nowUs, lhsMetrics);
+    rhs.ComputeMetrics (nowUs, rhsMetrics);
+    const Diagnostics& lhsDiag = lhs.getDiagnostics ();
+    const Diagnostics& rhsDiag = rhs.getDiagnostics ();
+    return SameHistory (lhs.GetHistory (), rhs.GetHistory ()) && SameMetrics (lhsMetrics, rhsMetrics) &&
+           lhs.getBytesInFlight () == rhs.getBytesInFlight () &&
+           std::memcmp (&lhsDiag, &rhsDiag, sizeof (Diagnostics)) == 0;
+}
+
+void FeedbackBatchTestCase::DoRun ()
+{
+    LossyPath path = MakeLossyPath (6000, 5);
+    // One in ten reports also contains feedback on a packet not sent yet
+    uint32_t lastSent = 0;
+    uint32_t nReports = 0;
+    for (auto& event : path.events) {
+        if (event.feedback.empty ()) {
+            lastSent = event.packet;
+        } else if (++nReports % 10 == 0 && lastSent + 5 < path.packets.size ()) {
+            const LossyPathPacket& future = path.packets[lastSent + 5];
+            event.feedback.insert (event.feedback.begin () + event.feedback.size () / 2,
+                                   rmcat::SenderBasedController::FeedbackItem{future.sequence,
+                                                                              event.nowUs - 1,
+                                                                              future.ecn});
+        }
+    }
+
+    MetricsProbeController batched{500000};
+    MetricsProbeController itemized{500000};
+    batched.setLogCallback (NoLog);
+    itemized.setLogCallback (NoLog);
+    uint32_t checks = 0;
+    uint32_t mismatches = 0;
+    for (const auto& event : path.events) {
+        if (event.feedback.empty ()) {
+            const LossyPathPacket& packet = path.packets[event.packet];
+            batched.processSendPacket (packet.txTimestampUs, packet.sequence, packet.size);
+            itemized.processSendPacket (packet.txTimestampUs, packet.sequence, packet.size);
+            continue;
+        }
+        batched.processFeedbackBatch (event.nowUs, event.feedback);
+        for (const auto& item : event.feedback) {
+            itemized.processFeedback (event.nowUs, item.sequence, item.rxTimestampUs, item.ecn);
+        }
+        ++checks;
+        mismatches += SameState (batched, itemized, event.nowUs) ? 0 : 1;
+    }
+    const rmcat::SenderBasedController::Diagnostics& diag = batched.getDiagnostics ();
+    NS_TEST_ASSERT_MSG_GT (checks, 200, "State should have been compared throughout the path");
+    NS_TEST_ASSERT_MSG_GT (diag.futureFeedback, 0, "Feedback from the future should have been skipped");
+    NS_TEST_ASSERT_MSG_GT (diag.reorderedFeedback, 0, "Path should reorder packets");
+    NS_TEST_ASSERT_MSG_GT (diag.duplicateFeedback, 0, "Path should duplicate feedback");
+    NS_TEST_ASSERT_MSG_GT (diag.historyResets, 0, "Path should reset the history");
+    NS_TEST_ASSERT_MSG_EQ (mismatches, 0, "Batch and per-item feedback should leave the same state");
+
+    // Within a batch, a late packet is too late if the packets before it
+    // are garbage collected by the newer packets preceding it in the batch,
+    // even though the history is only garbage collected at the end
+    MetricsProbeController batchedLate{500000};
+    MetricsProbeController itemizedLate{500000};
+    batchedLate.setLogCallback (NoLog);
+    itemizedLate.setLogCallback (NoLog);
+    std::vector<rmcat::SenderBasedController::FeedbackItem> batches[2];
+    for (uint16_t sequence = 0; sequence < 252; ++sequence) {
+        const uint64_t txTimestampUs = 1000000 + sequence * 2000;
+        batchedLate.processSendPacket (txTimestampUs, sequence, 1000);
+        itemizedLate.processSendPacket (txTimestampUs, sequence, 1000);
+        if (sequence != 2) {
+            batches[sequence < 250 ? 0 : 1].push_back (rmcat::SenderBasedController::FeedbackItem{sequence,
+                                                                                                  txTimestampUs + 10000,
+                                                                                                  0});
+        }
+    }
+    // Packet 1 is garbage collected by packet 251, 500ms younger
+    batches[1].push_back (rmcat::SenderBasedController::FeedbackItem{2, 1000000 + 2 * 2000 + 505000, 0});
+    const uint64_t nowUs = 1000000 + 252 * 2000 + 20000;
+    for (size_t b = 0; b < 2; ++b) {
+        batchedLate.processFeedbackBatch (nowUs, batches[b]);
+        for (const auto& item : batches[b]) {
+            itemizedLate.processFeedback (nowUs, item.sequence, item.rxTimestampUs, item.ecn);
+        }
+    }
+    NS_TEST_ASSERT_MSG_EQ (itemizedLate.getDiagnostics ().tooLateFeedback, 1, "Late packet should be too late");
+    NS_TEST_ASSERT_MSG_EQ (SameState (batchedLate, itemizedLate, nowUs), true,
+                           "Batch and per-item feedback should reject the same late packets");
+}
+
+/*
+ * The base delay follows an increase of the path delay once the buckets
+ * holding the older minimum have expired, and decreases immediately
+ */
+class BaseDelayTrackerTestCase : public TestCase
+{
+public:
+    BaseDelayTrackerTestCase ();
+    virtual void DoRun ();
+};
+
+BaseDelayTrackerTestCase::BaseDelayTrackerTestCase ()
+: TestCase{"rmcat-base-delay-tracker"}
+{}
+
+void BaseDelayTrackerTestCase::DoRun ()
+{
+    const size_t nBuckets = 4;
+    const uint64_t bucketUs = 1000000;  // 1s
+    const uint64_t stepUs = 10000;      // one sample every 10ms
+    rmcat::BaseDelayTracker tracker{nBuckets, bucketUs};
+    NS_TEST_ASSERT_MSG_EQ (tracker.empty (), true, "Tracker should start empty");
+
+    uint64_t nowUs = 0;
+    for (; nowUs < 10 * bucketUs; nowUs += stepUs) {
+        tracker.update (50000 + (nowUs / stepUs) % 7 * 1000, nowUs);
+    }
+    NS_TEST_ASSERT_MSG_EQ (tracker.get (), 50000, "Base delay should be the minimum delay");
+
+    // Path delay increases by 100ms: the old minimum is kept for a while...
+    const uint64_t changeUs = nowUs;
+    for (; nowUs < changeUs + (nBuckets - 1) * bucketUs; nowUs += stepUs) {
+        tracker.update (150000, nowUs);
+    }
+    NS_TEST_ASSERT_MSG_EQ (tracker.get (), 50000, "Base delay should not expire before the window");
+    // ...until it expires
+    for (; nowUs < changeUs + (nBuckets + 1) * bucketUs; nowUs += stepUs) {
+        tracker.update (150000, nowUs);
+    }
+    NS_TEST_ASSERT_MSG_EQ (tracker.get (), 150000, "Base delay should follow a path delay increase");
+
+    tracker.update (120000, nowUs);
+    NS_TEST_ASSERT_MSG_EQ (tracker.get (), 120000, "Base delay should follow a decrease immediately");
+
+    // A long gap without samples expires all older buckets at once
+    nowUs += 2 * nBuckets * bucketUs;
+    tracker.update (130000, nowUs);
+    NS_TEST_ASSERT_MSG_EQ (tracker.get (), 130000, "Buckets older than the window should expire");
+}
+
+/*
+ * A receiver clock running 50 ppm faster than the sender's adds 15ms of
+ * fake queuing delay over 300s, unless the drift is compensated
+ */
+class ClockDriftTestCase : public TestCase
+{
+public:
+    ClockDriftTestCase ();
+    virtual void DoRun ();
+};
+
+ClockDriftTestCase::ClockDriftTestCase ()
+: TestCase{"rmcat-controller-clock-drift"}
+{}
+
+void ClockDriftTestCase::DoRun ()
+{
+    const double driftPpm = 50.;
+    const uint64_t gapUs = 10000;           // 100 packets per second
+    const uint64_t owdUs = 50000;           // 50ms
+    const uint64_t maxQueuingUs = 20000;    // queuing delay varies in [0, 20ms),
+    const uint32_t emptyPeriod = 10;        // and the queue is empty every 10 packets
+    const uint32_t nPackets = 30000;        // 300s
+
+    const uint64_t historyUs = 500000;      // 500ms, the default
+    MetricsProbeController plain{historyUs};
+    MetricsProbeController compensated{historyUs};
+    plain.setLogCallback (NoLog);
+    compensated.setLogCallback (NoLog);
+    compensated.setClockDriftCompensation (true);
+
+    uint16_t sequence = 0;
+    for (uint32_t i = 0; i < nPackets; ++i, ++sequence) {
+        const uint64_t txTimestampUs = 1000000 + i * gapUs;
+        const uint64_t queuingUs = (i % emptyPeriod == 0) ? 0 : (i * 7919) % maxQueuingUs;
+        const uint64_t trueRxUs = txTimestampUs + owdUs + queuingUs;
+        const uint64_t rxTimestampUs = trueRxUs + uint64_t (double (trueRxUs) * driftPpm * 1e-6);
+        plain.processSendPacket (txTimestampUs, sequence, 1000);
+        compensated.processSendPacket (txTimestampUs, sequence, 1000);
+        plain.processFeedback (trueRxUs + owdUs, sequence, rxTimestampUs);
+        compensated.processFeedback (trueRxUs + owdUs, sequence, rxTimestampUs);
+    }
+
+    double estimatedPpm = 0.;
+    NS_TEST_ASSERT_MSG_EQ (plain.getClockDrift (estimatedPpm), false, "No drift should be estimated if disabled");
+    NS_TEST_ASSERT_MSG_EQ (compensated.getClockDrift (estimatedPpm), true, "Drift should have been estimated");
+    NS_TEST_ASSERT_MSG_EQ_TOL (estimatedPpm, driftPpm, 2., "Estimated drift should match the actual drift");
+
+    uint64_t plainQdelayUs = 0;
+    uint64_t compensatedQdelayUs = 0;
+    plain.GetCurrentQdelay (plainQdelayUs);
+    compensated.GetCurrentQdelay (compensatedQdelayUs);
+    NS_TEST_ASSERT_MSG_GT (plainQdelayUs, 10000, "Drift should add fake queuing delay");
+    NS_TEST_ASSERT_MSG_LT (compensatedQdelayUs, 1000, "Compensated queuing delay should stay close to zero");
+}
+
+/*
+ * ECN marks reported in the feedback make NADA back off, even if the
+ * marking queue keeps the queuing delay low
+ */
+class EcnMarkingTestCase : public TestCase
+{
+public:
+    EcnMarkingTestCase ();
+    virtual void DoRun ();
+};
+
+EcnMarkingTestCase::EcnMarkingTestCase ()
+: TestCase{"rmcat-controller-ecn-marking"}
+{}
+
+void EcnMarkingTestCase::DoRun ()
+{
+    const uint64_t gapUs = 8000;            // 1000 bytes every 8ms: 1Mbps
+    const uint64_t owdUs = 50000;           // 50ms, no queuing delay
+    const uint64_t fbPeriodUs = 100000;     // 100ms
+    const uint32_t markPeriod = 20;         // one in 20 packets is marked
+    const uint32_t nPackets = 3750;         // 30s
+
+    rmcat::NadaController unmarked{};
+    rmcat::NadaController marked{};
+    MetricsProbeController probe{500000};
+    unmarked.setLogCallback (NoLog);
+    marked.setLogCallback (NoLog);
+    probe.setLogCallback (NoLog);
+
+    std::vector<rmcat::SenderBasedController::FeedbackItem> notEct{};
+    std::vector<rmcat::SenderBasedController::FeedbackItem> ect{};
+    uint64_t nextFbUs = 1000000 + fbPeriodUs;
+    uint16_t sequence = 0;
+    for (uint32_t i = 0; i < nPackets; ++i, ++sequence) {
+        const uint64_t txTimestampUs = 1000000 + i * gapUs;
+        const uint64_t rxTimestampUs = txTimestampUs + owdUs;
+        if (rxTimestampUs >= nextFbUs) {
+            unmarked.processFeedbackBatch (nextFbUs, notEct);
+            marked.processFeedbackBatch (nextFbUs, ect);
+            probe.processFeedbackBatch (nextFbUs, ect);
+            notEct.clear ();
+            ect.clear ();
+            nextFbUs += fbPeriodUs;
+        }
+        unmarked.processSendPacket (txTimestampUs, sequence, 1000);
+        marked.processSendPacket (txTimestampUs, sequence, 1000);
+        probe.processSendPacket (txTimestampUs, sequence, 1000);
+        const uint8_t ecn = (i % markPeriod == 0) ? rmcat::ECN_CE : rmcat::ECN_ECT0;
+        notEct.push_back (rmcat::SenderBasedController::FeedbackItem{sequence, rxTimestampUs, rmcat::ECN_NOT_ECT});
+        ect.push_back (rmcat::SenderBasedController::FeedbackItem{sequence, rxTimestampUs, ecn});
+    }
+
+    uint32_t nMarked = 0;
+    float pmr = 0.f;
+    NS_TEST_ASSERT_MSG_EQ (probe.GetEcnMarkingInfo (nMarked, pmr), true, "Marking info should be available");
+    NS_TEST_ASSERT_MSG_GT (nMarked, 0, "Marked packets should be counted");
+    NS_TEST_ASSERT_MSG_EQ_TOL (pmr, 1.f / markPeriod, 0.01f, "Marking ratio should match the actual marks");
+
+    const uint64_t nowUs = nextFbUs;
+    NS_TEST_ASSERT_MSG_LT (marked.getBandwidth (nowUs), unmarked.getBandwidth (nowUs) * .5f,
+                           "Marks should make the rate back off");
+}
+
+/*
+ * Video frames reach the receiver as bursts: the receive rate estimators
+ * must stay close to the actual rate wherever the frame period they are
+ * queried at
+ */
+class RecvRateEstimatorTestCase : public TestCase
+{
+public:
+    RecvRateEstimatorTestCase ();
+    virtual void DoRun ();
+};
+
+RecvRateEstimatorTestCase::RecvRateEstimatorTestCase ()
+: TestCase{"rmcat-controller-recv-rate-estimators"}
+{}
+
+/*
+ * Feed a 1Mbps flow of bursty frames, and return the maximum relative
+ * error of the receive rate, queried at every packet once the windows are full
+ */
+static float MaxRecvRateError (std::shared_ptr<rmcat::RecvRateEstimator> estimator,
+                               uint32_t overhead)
+{
+    const uint32_t pktSize = 1000;
+    const uint32_t pktsPerFrame = 4;
+    const uint64_t frameUs = 32000;       // 4000 bytes every 32ms: 1Mbps
+    const uint64_t burstGapUs = 100;      // packets of a frame are back to back
+    const uint64_t owdUs = 50000;         // 50ms
+    const uint32_t nFrames = 300;         // 9.6s
+    const uint32_t warmupFrames = 30;
+    const float expectedBps = 1000000.f * (pktSize + overhead) / pktSize;
+
+    MetricsProbeController controller{500000};
+    controller.setLogCallback (NoLog);
+    controller.setRecvRateEstimator (estimator);
+    controller.setRecvRateOverhead (overhead);
+
+    float maxError = 0.f;
+    uint16_t sequence = 0;
+    for (uint32_t f = 0; f < nFrames; ++f) {
+        for (uint32_t p = 0; p < pktsPerFrame; ++p, ++sequence) {
+            const uint64_t txTimestampUs = 1000000 + f * frameUs + p * burstGapUs;
+            const uint64_t rxTimestampUs = txTimestampUs + owdUs;
+            controller.processSendPacket (txTimestampUs, sequence, pktSize);
+            controller.processFeedback (rxTimestampUs + owdUs, sequence, rxTimestampUs);
+            float rrateBps = 0.f;
+            if (f >= warmupFrames && controller.GetCurrentRecvRate (rrateBps)) {
+                maxError = std::max (maxError, std::fabs (rrateBps - expectedBps) / expectedBps);
+            }
+        }
+    }
+    return maxError;
+}
+
+void RecvRateEstimatorTestCase::DoRun ()
+{
+    const uint32_t overhead = 40;  // IPv4 + UDP + RTP
+    NS_TEST_ASSERT_MSG_LT (MaxRecvRateError (std::make_shared<rmcat::WindowRecvRateEstimator> (), 0), .05f,
+                           "Windowed receive rate should stay close to the actual rate");
+    NS_TEST_ASSERT_MSG_LT (MaxRecvRateError (std::make_shared<rmcat::EwmaRecvRateEstimator> (), 0), .05f,
+                           "EWMA receive rate should stay close to the actual rate");
+    NS_TEST_ASSERT_MSG_LT (MaxRecvRateError (std::make_shared<rmcat::FrameRecvRateEstimator> (), 0), .01f,
+                           "Frame-aware receive rate should not oscillate within the frame period");
+    NS_TEST_ASSERT_MSG_LT (MaxRecvRateError (std::make_shared<rmcat::FrameRecvRateEstimator> (), overhead), .01f,
+                           "Receive rate should count the per-packet overhead");
+}
+
+/*
+ * A controller warm-started from a snapshot behaves as the original one
+ * would have, even if its timeline and sequences are different
+ */
+class WarmStartTestCase : public TestCase
+{
+public:
+    WarmStartTestCase ();
+    virtual void DoRun ();
+};
+
+WarmStartTestCase::WarmStartTestCase ()
+: TestCase{"rmcat-controller-warm-start"}
+{}
+
+void WarmStartTestCase::DoRun ()
+{
+    typedef rmcat::SenderBasedController::FeedbackItem FeedbackItem;
+    const uint64_t gapUs = 8000;            // 1000 bytes every 8ms: 1Mbps
+    const uint64_t owdUs = 50000;           // 50ms, plus up to 10ms of queuing delay
+    const uint64_t fbPeriodUs = 100000;     // 100ms
+    const uint64_t pauseUs = 200000;        // no packets in flight when the snapshot is taken
+    const uint32_t lossPeriod = 50;         // one in 50 packets is lost
+    const uint32_t nPackets = 2500;         // 20s before, and 20s after, the snapshot
+    const uint64_t shiftUs = 1000000000;    // the restored controller runs 1000s later...
+    const uint16_t seqShift = 12345;        // ...and sends other sequences
+
+    rmcat::NadaController original{};
+    rmcat::NadaController restored{};
+    original.setLogCallback (NoLog);
+    restored.setLogCallback (NoLog);
+
+    std::vector<FeedbackItem> fbOriginal{};
+    std::vector<FeedbackItem> fbRestored{};
+    uint64_t offsetUs = 1000000;
+    uint64_t nextFbUs = offsetUs + fbPeriodUs;
+    bool loaded = false;
+    std::string snapshot{};
+    uint16_t sequence = 0;
+    for (uint32_t i = 0; i < 2 * nPackets; ++i, ++sequence) {
+        if (i == nPackets) {
+            // Pause: the feedback of all packets arrives, then the snapshot is taken
+            const uint64_t nowUs = offsetUs + i * gapUs + pauseUs;
+            original.processFeedbackBatch (nowUs, fbOriginal);
+            fbOriginal.clear ();
+            fbRestored.clear ();
+            std::ostringstream os{};
+            original.saveState (os, nowUs);
+            snapshot = os.str ();
+            std::istringstream is{snapshot};
+            loaded = restored.loadState (is, nowUs + shiftUs);
+            NS_TEST_ASSERT_MSG_EQ (loaded, true, "Snapshot should be loaded");
+
+            std::ostringstream os2{};
+            restored.saveState (os2, nowUs + shiftUs);
+            NS_TEST_ASSERT_MSG_EQ (os2.str (), snapshot, "Snapshot of the restored controller should be the same");
+            NS_TEST_ASSERT_MSG_EQ (restored.getBandwidth (nowUs + shiftUs), original.getBandwidth (nowUs),
+                                   "Restored controller should start at the same rate");
+            offsetUs += pauseUs;
+            nextFbUs = nowUs + fbPeriodUs;
+        }
+        const uint64_t txTimestampUs = offsetUs + i * gapUs;
+        const uint64_t rxTimestampUs = txTimestampUs + owdUs + (i % 100) * 100;
+        if (rxTimestampUs >= nextFbUs) {
+            original.processFeedbackBatch (nextFbUs, fbOriginal);
+            if (loaded) {
+                restored.processFeedbackBatch (nextFbUs + shiftUs, fbRestored);
+            }
+            fbOriginal.clear ();
+            fbRestored.clear ();
+            nextFbUs += fbPeriodUs;
+        }
+        original.processSendPacket (txTimestampUs, sequence, 1000);
+        if (loaded) {
+            restored.processSendPacket (txTimestampUs + shiftUs, uint16_t (sequence + seqShift), 1000);
+        }
+        if (i % lossPeriod == lossPeriod - 1) {
+            continue;
+        }
+        fbOriginal.push_back (FeedbackItem{sequence, rxTimestampUs, 0});
+        fbRestored.push_back (FeedbackItem{uint16_t (sequence + seqShift), rxTimestampUs + shiftUs, 0});
+    }
+
+    const rmcat::SenderBasedController::Diagnostics& diag = restored.getDiagnostics ();
+    NS_TEST_ASSERT_MSG_EQ (diag.illegalSendSequence, 0, "Sequences should be renumbered");
+    NS_TEST_ASSERT_MSG_EQ (diag.duplicateFeedback, 0, "No feedback should be ignored");
+    NS_TEST_ASSERT_MSG_EQ (diag.decreasingTimestamp, 0, "Timestamps should be shifted");
+    NS_TEST_ASSERT_MSG_EQ (diag.historyResets, 0, "History should not be considered obsolete");
+    const float bw = original.getBandwidth (nextFbUs);
+    NS_TEST_ASSERT_MSG_EQ_TOL (restored.getBandwidth (nextFbUs + shiftUs), bw, bw * 0.001f,
+                               "Restored controller should follow the original one");
+
+    // A truncated snapshot is rejected
+    rmcat::NadaController truncated{};
+    std::istringstream is{snapshot.substr (0, snapshot.size () / 2)};
+    NS_TEST_ASSERT_MSG_EQ (truncated.loadState (is, 0), false, "Truncated snapshot should be rejected");
+}
+
+/*
+ * NADA's parameters can be set at run time: with the default values, the
+ * configurable controller behaves as the default one, and the rate it
+ * converges to is proportional to the flow's priority
+ */
+class NadaParamsTestCase : public TestCase
+{
+public:
+    NadaParamsTestCase ();
+    virtual void DoRun ();
+};
+
+NadaParamsTestCase::NadaParamsTestCase ()
+: TestCase{"rmcat-controller-nada-params"}
+{}
+
+/* Feed a path with a constant queuing delay; return the final rate */
+static float RunNadaOnQueuedPath (rmcat::SenderBasedController& controller)
+{
+    const uint64_t gapUs = 8000;            // 1000 bytes every 8ms: 1Mbps
+    const uint64_t owdUs = 70000;           // 50ms, plus 20ms of queuing delay
+    const uint64_t fbPeriodUs = 100000;     // 100ms
+    const uint32_t nPackets = 7500;         // 60s
+
+    controller.setLogCallback (NoLog);
+    // The base delay is learnt from the first packet, before the queue builds up
+    controller.processSendPacket (0, 0, 1000);
+    controller.processFeedback (100000, 0, 50000);
+
+    std::vector<rmcat::SenderBasedController::FeedbackItem> feedback{};
+    uint64_t nextFbUs = 1000000 + fbPeriodUs;
+    uint16_t sequence = 1;
+    for (uint32_t i = 0; i < nPackets; ++i, ++sequence) {
+        const uint64_t txTimestampUs = 1000000 + i * gapUs;
+        const uint64_t rxTimestampUs = txTimestampUs + owdUs;
+        if (rxTimestampUs >= nextFbUs) {
+            controller.processFeedbackBatch (nextFbUs, feedback);
+            feedback.clear ();
+            nextFbUs += fbPeriodUs;
+        }
+        controller.processSendPacket (txTimestampUs, sequence, 1000);
+        feedback.push_back (rmcat::SenderBasedController::FeedbackItem{sequence, rxTimestampUs, 0});
+    }
+    return controller.getBandwidth (nextFbUs);
+}
+
+void NadaParamsTestCase::DoRun ()
+{
+    rmcat::NadaParams params{};
+    NS_TEST_ASSERT_MSG_EQ (params.kappa, rmcat::NadaDefaultParams::kappa, "Parameters should default to the draft's values");
+    NS_TEST_ASSERT_MSG_EQ (params.deltaUs, rmcat::NadaDefaultParams::deltaUs, "Parameters should default to the draft's values");
+
+    std::istringstream config{"# all flows\n"
+                              "kappa 0.4\n"
+                              "\n"
+                              "flow_a prio 1.5\n"
+                              "flow_b prio 3\n"};
+    NS_TEST_ASSERT_MSG_EQ (params.load (config, "flow_a"), true, "Configuration should be valid");
+    NS_TEST_ASSERT_MSG_EQ (params.kappa, 0.4f, "Parameter for all flows should be set");
+    NS_TEST_ASSERT_MSG_EQ (params.prio, 1.5f, "Parameter for this flow should be set");
+    std::istringstream unknown{"kapa 0.4\n"};
+    NS_TEST_ASSERT_MSG_EQ (params.load (unknown), false, "Unknown parameters should be rejected");
+    std::istringstream noValue{"kappa\n"};
+    NS_TEST_ASSERT_MSG_EQ (params.load (noValue), false, "Parameters without value should be rejected");
+
+    // Out-of-range values: negative durations, divisors set to zero, NaN
+    NS_TEST_ASSERT_MSG_EQ (params.set ("deltaUs", -1.), false, "Negative durations should be rejected");
+    NS_TEST_ASSERT_MSG_EQ (params.set ("deltaUs", 0.), false, "Null update interval should be rejected");
+    NS_TEST_ASSERT_MSG_EQ (params.set ("tau", 0.), false, "Null tau should be rejected");
+    NS_TEST_ASSERT_MSG_EQ (params.set ("plrref", 0.), false, "Null plrref should be rejected");
+    NS_TEST_ASSERT_MSG_EQ (params.set ("pmrref", 0.), false, "Null pmrref should be rejected");
+    NS_TEST_ASSERT_MSG_EQ (params.set ("alpha", 1.5), false, "Smoothing factors above one should be rejected");
+    NS_TEST_ASSERT_MSG_EQ (params.set ("kappa", std::nan ("")), false, "NaN should be rejected");
+    NS_TEST_ASSERT_MSG_EQ (params.kappa, 0.4f, "Rejected values should leave the parameter unchanged");
+    NS_TEST_ASSERT_MSG_EQ (params.deltaUs, rmcat::NadaDefaultParams::deltaUs,
+                           "Rejected values should leave the parameter unchanged");
+    std::istringstream outOfRange{"kappa 0.5\n"
+                                  "qepsUs -10000\n"};
+    NS_TEST_ASSERT_MSG_EQ (params.load (outOfRange), false, "Out-of-range values should be rejected");
+    NS_TEST_ASSERT_MSG_EQ (params.set ("qepsUs", 0.), true, "Null qeps should be valid");
+
+    rmcat::NadaController fixed{};
+    rmcat::ConfigurableNadaController configurable{};
+    const float fixedBw = RunNadaOnQueuedPath (fixed);
+    const float configurableBw = RunNadaOnQueuedPath (configurable);
+    NS_TEST_ASSERT_MSG_EQ_TOL (configurableBw, fixedBw, fixedBw * 1e-6f,
+                               "Default parameters should give the same rate at compile time and at run time");
+
+    rmcat::NadaParams prioParams{};
+    prioParams.prio = 1.5f;
+    rmcat::ConfigurableNadaController prio{prioParams};
+    const float prioBw = RunNadaOnQueuedPath (prio);
+    NS_TEST_ASSERT_MSG_EQ_TOL (prioBw / fixedBw, 1.5f, 0.05f, "Rate should be proportional to the priority");
+}
+
+/*
+ * The flows of a NADA bank behave exactly as NADA controllers fed with the
+ * same packets and feedback: same rates, and interchangeable snapshots
+ */
+class NadaBankTestCase : public TestCase
+{
+public:
+    NadaBankTestCase ();
+    virtual void DoRun ();
+};
+
+NadaBankTestCase::NadaBankTestCase ()
+: TestCase{"rmcat-controller-nada-bank"}
+{}
+
+void NadaBankTestCase::DoRun ()
+{
+    typedef rmcat::SenderBasedController::FeedbackItem FeedbackItem;
+    const size_t nFlows = 4;
+    const uint64_t gapUs = 8000;            // 1000 bytes every 8ms: 1Mbps
+    const uint64_t owdUs = 50000;           // 50ms, plus up to 80ms of queuing delay
+    const uint64_t maxQdelayUs = 80000;
+    const uint64_t fbPeriodUs = 100000;     // 100ms
+    const uint32_t nPackets = 5000;         // 40s
+
+    rmcat::NadaBank bank{};
+    std::vector<std::shared_ptr<rmcat::NadaBankFlow> > flows{};
+    std::vector<std::shared_ptr<rmcat::NadaController> > controllers{};
+    for (size_t f = 0; f < nFlows; ++f) {
+        flows.push_back (bank.addFlow ());
+        controllers.push_back (std::make_shared<rmcat::NadaController> ());
+        flows[f]->setLogCallback (NoLog);
+        controllers[f]->setLogCallback (NoLog);
+    }
+    NS_TEST_ASSERT_MSG_EQ (bank.size (), nFlows, "Bank should contain all flows");
+
+    std::vector<std::vector<FeedbackItem> > feedback (nFlows);
+    uint64_t nextFbUs = 1000000 + fbPeriodUs;
+    uint16_t sequence = 0;
+    for (uint32_t i = 0; i < nPackets; ++i, ++sequence) {
+        const uint64_t txTimestampUs = 1000000 + i * gapUs;
+        if (txTimestampUs + owdUs + maxQdelayUs >= nextFbUs) {
+            for (size_t f = 0; f < nFlows; ++f) {
+                flows[f]->processFeedbackBatch (nextFbUs, feedback[f]);
+                controllers[f]->processFeedbackBatch (nextFbUs, feedback[f]);
+                feedback[f].clear ();
+            }
+            bank.runPending ();
+            NS_TEST_ASSERT_MSG_EQ (bank.pendingCount (), 0, "All updates should have run");
+            for (size_t f = 0; f < nFlows; ++f) {
+                NS_TEST_ASSERT_MSG_EQ (flows[f]->getBandwidth (nextFbUs), controllers[f]->getBandwidth (nextFbUs),
+                                       "Flow of the bank should have the controller's rate");
+            }
+            nextFbUs += fbPeriodUs;
+        }
+        for (size_t f = 0; f < nFlows; ++f) {
+            flows[f]->processSendPacket (txTimestampUs, sequence, 1000);
+            controllers[f]->processSendPacket (txTimestampUs, sequence, 1000);
+            // Flow 0: no losses; 1: losses in the first half; 2: ECN marks; 3: both
+            const bool lossy = f == 3 || (f == 1 && i < nPackets / 2);
+            if (lossy && i % (20 + 10 * f) == 0) {
+                continue;
+            }
+            const uint8_t ecn = ((f & 2) && i % 30 == 0) ? 0x3 : 0;
+            const uint64_t qdelayUs = ((i * (f + 1)) % 400) * maxQdelayUs / 400;
+            feedback[f].push_back (FeedbackItem{sequence, txTimestampUs + owdUs + qdelayUs, ecn});
+        }
+    }
+
+    // A pending update is run when the rate is queried
+    for (size_t f = 0; f < nFlows; ++f) {
+        flows[f]->processFeedbackBatch (nextFbUs, feedback[f]);
+        controllers[f]->processFeedbackBatch (nextFbUs, feedback[f]);
+    }
+    NS_TEST_ASSERT_MSG_EQ (bank.pendingCount (), nFlows, "Updates should be pending");
+    NS_TEST_ASSERT_MSG_EQ (flows[3]->getBandwidth (nextFbUs), controllers[3]->getBandwidth (nextFbUs),
+                           "Pending update should run before the rate is returned");
+    NS_TEST_ASSERT_MSG_EQ (bank.pendingCount (), 0, "All updates should have run");
+
+    // Snapshots are interchangeable
+    std::ostringstream flowState{};
+    std::ostringstream controllerState{};
+    flows[1]->saveState (flowState, nextFbUs);
+    controllers[1]->saveState (controllerState, nextFbUs);
+    NS_TEST_ASSERT_MSG_EQ (flowState.str (), controllerState.str (), "Snapshots should be the same");
+    rmcat::NadaController restored{};
+    std::istringstream is{flowState.str ()};
+    NS_TEST_ASSERT_MSG_EQ (restored.loadState (is, nextFbUs), true, "Snapshot of the flow should be loaded");
+    NS_TEST_ASSERT_MSG_EQ (restored.getBandwidth (nextFbUs), controllers[1]->getBandwidth (nextFbUs),
+                           "Restored controller should have the flow's rate");
+
+    // Reset flows start over from the initial rate
+    flows[2]->reset ();
+    controllers[2]->reset ();
+    NS_TEST_ASSERT_MSG_EQ (flows[2]->getBandwidth (nextFbUs), controllers[2]->getBandwidth (nextFbUs),
+                           "Reset flow should have the initial rate");
+}
+
+/*
+ * The fixed-point NADA follows the floating-point one: on a path with a
+ * constant queuing delay, and, in validation mode, on a path with losses,
+ * ECN marks, and queuing delays high enough for the non-linear warping
+ */
+class NadaFixedTestCase : public TestCase
+{
+public:
+    NadaFixedTestCase ();
+    virtual void DoRun ();
+};
+
+NadaFixedTestCase::NadaFixedTestCase ()
+: TestCase{"rmcat-controller-nada-fixed"}
+{}
+
+void NadaFixedTestCase::DoRun ()
+{
+    rmcat::NadaController floating{};
+    rmcat::NadaFixedController fixed{};
+    const float floatingBw = RunNadaOnQueuedPath (floating);
+    const float fixedBw = RunNadaOnQueuedPath (fixed);
+    NS_TEST_ASSERT_MSG_EQ_TOL (fixedBw, floatingBw, floatingBw * 0.001f,
+                               "Fixed-point rate should be the floating-point one");
+
+    typedef rmcat::SenderBasedController::FeedbackItem FeedbackItem;
+    const uint64_t gapUs = 8000;            // 1000 bytes every 8ms: 1Mbps
+    const uint64_t owdUs = 50000;           // 50ms, plus up to 150ms of queuing delay
+    const uint64_t maxQdelayUs = 150000;
+    const uint64_t fbPeriodUs = 100000;     // 100ms
+    const uint32_t nPackets = 5000;         // 40s
+
+    rmcat::NadaFixedController validated{};
+    validated.setLogCallback (NoLog);
+    validated.setValidation (true, 0.005f);
+    std::vector<FeedbackItem> feedback{};
+    uint64_t nextFbUs = 1000000 + fbPeriodUs;
+    uint16_t sequence = 0;
+    for (uint32_t i = 0; i < nPackets; ++i, ++sequence) {
+        const uint64_t txTimestampUs = 1000000 + i * gapUs;
+        if (txTimestampUs + owdUs + maxQdelayUs >= nextFbUs) {
+            validated.processFeedbackBatch (nextFbUs, feedback);
+            feedback.clear ();
+            nextFbUs += fbPeriodUs;
+        }
+        validated.processSendPacket (txTimestampUs, sequence, 1000);
+        if (i % 40 == 0) {
+            continue;
+        }
+        const uint8_t ecn = (i % 70 == 0) ? 0x3 : 0;
+        const uint64_t qdelayUs = (i % 500) * maxQdelayUs / 500;
+        feedback.push_back (FeedbackItem{sequence, txTimestampUs + owdUs + qdelayUs, ecn});
+    }
+    const rmcat::NadaFixedController::Divergence& divergence = validated.getDivergence ();
+    NS_TEST_ASSERT_MSG_GT (divergence.updates, 0, "Rates should be compared");
+    NS_TEST_ASSERT_MSG_EQ (divergence.divergent, 0, "Rates should not diverge");
+
+    // The integer state is saved and restored exactly
+    std::ostringstream os{};
+    validated.saveState (os, nextFbUs);
+    rmcat::NadaFixedController restored{};
+    std::istringstream is{os.str ()};
+    NS_TEST_ASSERT_MSG_EQ (restored.loadState (is, nextFbUs), true, "Snapshot should be loaded");
+    std::ostringstream os2{};
+    restored.saveState (os2, nextFbUs);
+    NS_TEST_ASSERT_MSG_EQ (os2.str (), os.str (), "Snapshot of the restored controller should be the same");
+}
+
+/*
+ * With the adaptive update interval, NADA updates its rate as often as
+ * feedback arrives on a short RTT path, but not more often than the
+ * default on a long one. Without new feedback, there is no update at all
+ */
+class NadaAdaptiveDeltaTestCase : public TestCase
+{
+public:
+    NadaAdaptiveDeltaTestCase ();
+    virtual void DoRun ();
+};
+
+NadaAdaptiveDeltaTestCase::NadaAdaptiveDeltaTestCase ()
+: TestCase{"rmcat-controller-nada-adaptive-delta"}
+{}
+
+/* Counts the rate updates of a controller */
+class CountingStatsSink : public rmcat::StatsSink
+{
+public:
+    CountingStatsSink () : m_count{0} {}
+    virtual void writeStats (const rmcat::StatsRecord&) { ++m_count; }
+    size_t m_count;
+};
+
+/*
+ * Feed a path with the given one-way delay, feedback every fbPeriodUs (but
+ * empty from idleUs on), for 10s. Return the number of rate updates
+ */
+static size_t CountNadaUpdates (const rmcat::NadaParams& params, uint64_t owdUs,
+                                uint64_t fbPeriodUs, uint64_t idleUs)
+{
+    const uint64_t gapUs = 8000;            // 1000 bytes every 8ms: 1Mbps
+    const uint64_t durationUs = 10000000;   // 10s
+
+    rmcat::ConfigurableNadaController controller{params};
+    auto sink = std::make_shared<CountingStatsSink> ();
+    controller.setStatsSink (sink);
+    std::vector<rmcat::SenderBasedController::FeedbackItem> feedback{};
+    uint64_t nextFbUs = fbPeriodUs;
+    uint16_t sequence = 0;
+    for (uint64_t txTimestampUs = 0; txTimestampUs < durationUs; txTimestampUs += gapUs, ++sequence) {
+        while (txTimestampUs + owdUs >= nextFbUs) {
+            if (nextFbUs >= idleUs) {
+                feedback.clear ();
+            }
+            controller.processFeedbackBatch (nextFbUs + owdUs, feedback);
+            feedback.clear ();
+            nextFbUs += fbPeriodUs;
+        }
+        controller.processSendPacket (txTimestampUs, sequence, 1000);
+        feedback.push_back (rmcat::SenderBasedController::FeedbackItem{sequence, txTimestampUs + owdUs, 0});
+    }
+    return sink->m_count;
+}
+
+void NadaAdaptiveDeltaTestCase::DoRun ()
+{
+    const uint64_t never = std::numeric_limits<uint64_t>::max ();
+    rmcat::NadaParams fixedParams{};
+    rmcat::NadaParams adaptiveParams{};
+    NS_TEST_ASSERT_MSG_EQ (adaptiveParams.set ("adaptiveDelta", 1), true, "Adaptive interval should be configurable");
+
+    // Short RTT (10ms), feedback every 25ms. With the default interval
+    // (100ms, applied with 50% leniency), one in two feedback messages
+    // triggers an update; with the adaptive one, all of them
+    const double fixedShort = CountNadaUpdates (fixedParams, 5000, 25000, never);
+    const double adaptiveShort = CountNadaUpdates (adaptiveParams, 5000, 25000, never);
+    NS_TEST_ASSERT_MSG_EQ_TOL (fixedShort, 200., 2., "Default interval should be 50ms");
+    NS_TEST_ASSERT_MSG_EQ_TOL (adaptiveShort, 400., 2., "Adaptive interval should follow the feedback");
+
+    // Long RTT (300ms): the default interval is the upper bound
+    const double adaptiveLong = CountNadaUpdates (adaptiveParams, 150000, 25000, never);
+    NS_TEST_ASSERT_MSG_EQ_TOL (adaptiveLong, fixedShort, 2., "Adaptive interval should be bounded");
+
+    // Feedback stops arriving after 5s: no more updates
+    const double fixedIdle = CountNadaUpdates (fixedParams, 5000, 25000, 5000000);
+    NS_TEST_ASSERT_MSG_EQ_TOL (fixedIdle, fixedShort / 2., 2., "No update should run without new feedback");
+}
+
+/*
+ * GCC converges to the capacity of a bottleneck without building up a
+ * standing queue, backs off upon random losses, and can be warm-started
+ * from a snapshot
+ */
+class GccTestCase : public TestCase
+{
+public:
+    GccTestCase ();
+    virtual void DoRun ();
+};
+
+GccTestCase::GccTestCase ()
+: TestCase{"rmcat-controller-gcc"}
+{}
+
+/* Outcome of a run on a bottleneck */
+struct BottleneckResult
+{
+    float rateBps;     // final bandwidth estimation
+    double qdelayMs;   // mean queuing delay over the second half of the run
+};
+
+/*
+ * Closed loop: the controller's rate paces 1000-byte packets into a
+ * drop-tail bottleneck (300ms queue), followed by 50ms of propagation
+ * delay and random losses. Feedback is aggregated every 100ms. Packets
+ * held back by a window-based controller are retried every 10ms
+ */
+static BottleneckResult RunOnBottleneck (rmcat::SenderBasedController& controller,
+                                         double capacityBps, uint32_t lossPercent,
+                                         uint64_t durationUs)
+{
+    const uint64_t propUs = 50000;          // 50ms
+    const uint64_t fbPeriodUs = 100000;     // 100ms
+    const uint64_t maxQdelayUs = 300000;    // 300ms
+    const uint64_t serviceUs = uint64_t (8000. * 1e6 / capacityBps);
+
+    struct InFlight
+    {
+        uint16_t sequence;
+        uint64_t rxTimestampUs;
+        bool lost;
+    };
+    std::deque<InFlight> inFlight;
+    std::vector<rmcat::SenderBasedController::FeedbackItem> feedback{};
+    std::mt19937 rng{1};
+    uint64_t nextTxUs = 0;
+    uint64_t nextFbUs = fbPeriodUs;
+    uint64_t linkFreeUs = 0;
+    uint16_t sequence = 0;
+    double qdelaySumMs = 0.;
+    size_t qdelayCount = 0;
+    while (std::min (nextTxUs, nextFbUs) < durationUs) {
+        if (nextTxUs <= nextFbUs) {
+            const uint64_t nowUs = nextTxUs;
+            if (!controller.canSend (nowUs, 1000)) {
+                nextTxUs = nowUs + 10000;
+                continue;
+            }
+            controller.processSendPacket (nowUs, sequence, 1000);
+            const uint64_t startUs = std::max (nowUs, linkFreeUs);
+            const bool lost = (startUs - nowUs > maxQdelayUs) || (rng () % 100 < lossPercent);
+            if (!lost) {
+                linkFreeUs = startUs + serviceUs;
+                if (nowUs >= durationUs / 2) {
+                    qdelaySumMs += double (startUs - nowUs) / 1000.;
+                    ++qdelayCount;
+                }
+            }
+            inFlight.push_back (InFlight{sequence, linkFreeUs + propUs, lost});
+            ++sequence;
+            nextTxUs = nowUs + uint64_t (8000. * 1e6 / controller.getBandwidth (nowUs));
+        } else {
+            while (!inFlight.empty () && inFlight.front ().rxTimestampUs <= nextFbUs) {
+                if (!inFlight.front ().lost) {
+                    feedback.push_back (rmcat::SenderBasedController::FeedbackItem{inFlight.front ().sequence,
+                                                                                   inFlight.front ().rxTimestampUs, 0});
+                }
+                inFlight.pop_front ();
+            }
+            controller.processFeedbackBatch (nextFbUs + propUs, feedback);
+            feedback.clear ();
+            nextFbUs += fbPeriodUs;
+        }
+    }
+    return BottleneckResult{controller.getBandwidth (durationUs),
+                            qdelayCount > 0 ? qdelaySumMs / double (qdelayCount) : 0.};
+}
+
+void GccTestCase::DoRun ()
+{
+    const uint64_t durationUs = 60000000;  // 60s
+
+    // 1Mbps bottleneck, starting at 800Kbps
+    rmcat::GccController gcc{};
+    gcc.setInitBw (800000.f);
+    gcc.reset ();
+    gcc.setLogCallback (NoLog);
+    const BottleneckResult bottleneck = RunOnBottleneck (gcc, 1e6, 0, durationUs);
+    NS_TEST_ASSERT_MSG_GT (bottleneck.rateBps, 700000.f, "Rate should converge to the bottleneck's capacity");
+    NS_TEST_ASSERT_MSG_LT (bottleneck.rateBps, 1100000.f, "Rate should converge to the bottleneck's capacity");
+    NS_TEST_ASSERT_MSG_LT (bottleneck.qdelayMs, 20., "No standing queue should build up");
+
+    // Warm start: same rate as the controller the snapshot was taken from
+    std::stringstream state;
+    gcc.saveState (state, durationUs);
+    rmcat::GccController warm{};
+    warm.setLogCallback (NoLog);
+    NS_TEST_ASSERT_MSG_EQ (warm.loadState (state, 0), true, "Snapshot should be valid");
+    NS_TEST_ASSERT_MSG_EQ (warm.getBandwidth (0), gcc.getBandwidth (durationUs),
+                           "Warm-started controller should start at the snapshot's rate");
+
+    // No bottleneck, but 20% random losses
+    rmcat::GccController lossy{};
+    lossy.setInitBw (800000.f);
+    lossy.reset ();
+    lossy.setLogCallback (NoLog);
+    const BottleneckResult losses = RunOnBottleneck (lossy, 10e6, 20, durationUs);
+    NS_TEST_ASSERT_MSG_LT (losses.rateBps, 300000.f, "Rate should back off upon losses");
+}
+
+/*
+ * SCReAM: the congestion window gates the packets sent, and reopens upon
+ * feedback (or after a long time without any). In closed loop, the target
+ * bitrate converges to the bottleneck's capacity with a short queue, and
+ * backs off upon random losses
+ */
+class ScreamTestCase : public TestCase
+{
+public:
+    ScreamTestCase ();
+    virtual void DoRun ();
+};
+
+ScreamTestCase::ScreamTestCase ()
+: TestCase{"rmcat-controller-scream"}
+{}
+
+void ScreamTestCase::DoRun ()
+{
+    // Window: send 1000-byte packets every ms until the window is full
+    rmcat::ScreamController window{};
+    window.setInitBw (800000.f);
+    window.reset ();
+    window.setLogCallback (NoLog);
+    uint64_t nowUs = 0;
+    uint16_t sequence = 0;
+    while (window.canSend (nowUs, 1000)) {
+        NS_TEST_ASSERT_MSG_EQ (window.processSendPacket (nowUs, sequence++, 1000), true,
+                               "Packet should be accepted");
+        nowUs += 1000;
+    }
+    NS_TEST_ASSERT_MSG_GT (sequence, 0, "The initial window should let packets through");
+    NS_TEST_ASSERT_MSG_EQ (window.getBytesInFlight (), uint64_t (sequence) * 1000,
+                           "All packets sent should be in flight");
+    NS_TEST_ASSERT_MSG_GT (window.getBytesInFlight () + 1000, window.getCongestionWindow (),
+                           "Sending should only be blocked when the window is full");
+
+    // Feedback on the first half of the packets: the window reopens
+    const uint16_t acked = sequence / 2;
+    std::vector<rmcat::SenderBasedController::FeedbackItem> feedback{};
+    for (uint16_t i = 0; i < acked; ++i) {
+        feedback.push_back (rmcat::SenderBasedController::FeedbackItem{i, 50000 + i * 1000u, 0});
+    }
+    nowUs = 100000;
+    NS_TEST_ASSERT_MSG_EQ (window.processFeedbackBatch (nowUs, feedback), true, "Feedback should be valid");
+    NS_TEST_ASSERT_MSG_EQ (window.getBytesInFlight (), uint64_t (sequence - acked) * 1000,
+                           "Acknowledged bytes should no longer be in flight");
+    NS_TEST_ASSERT_MSG_EQ (window.canSend (nowUs, 1000), true, "The window should have reopened");
+    while (window.canSend (nowUs, 1000)) {
+        window.processSendPacket (nowUs, sequence++, 1000);
+        nowUs += 1000;
+    }
+
+    // Feedback stops coming: the window collapses, and the path is only
+    // probed with one packet per RTT
+    nowUs += 2000000;
+    NS_TEST_ASSERT_MSG_GT (window.getBytesInFlight () + 1000, 3000,
+                           "Bytes in flight should not fit in the minimum window");
+    NS_TEST_ASSERT_MSG_EQ (window.canSend (nowUs, 1000), true,
+                           "A probe should be allowed if feedback stops coming");
+    window.processSendPacket (nowUs, sequence++, 1000);
+    NS_TEST_ASSERT_MSG_EQ (window.canSend (nowUs + 1000, 1000), false,
+                           "Only one probe should be allowed per RTT");
+    NS_TEST_ASSERT_MSG_EQ (window.canSend (nowUs + 1000000, 1000), true,
+                           "Another probe should be allowed after an RTT");
+
+    // 1Mbps bottleneck, starting at 800Kbps
+    const uint64_t durationUs = 60000000;  // 60s
+    rmcat::ScreamController scream{};
+    scream.setInitBw (800000.f);
+    scream.reset ();
+    scream.setLogCallback (NoLog);
+    const BottleneckResult bottleneck = RunOnBottleneck (scream, 1e6, 0, durationUs);
+    NS_TEST_ASSERT_MSG_GT (bottleneck.rateBps, 700000.f, "Rate should converge to the bottleneck's capacity");
+    NS_TEST_ASSERT_MSG_LT (bottleneck.rateBps, 1100000.f, "Rate should converge to the bottleneck's capacity");
+    NS_TEST_ASSERT_MSG_LT (bottleneck.qdelayMs, 50., "The queuing delay should stay well below the target");
+
+    // Warm start: same rate and window as the controller the snapshot was taken from
+    std::stringstream state;
+    scream.saveState (state, durationUs);
+    rmcat::ScreamController warm{};
+    warm.setLogCallback (NoLog);
+    NS_TEST_ASSERT_MSG_EQ (warm.loadState (state, 0), true, "Snapshot should be valid");
+    NS_TEST_ASSERT_MSG_EQ (warm.getBandwidth (0), scream.getBandwidth (durationUs),
+                           "Warm-started controller should start at the snapshot's rate");
+    NS_TEST_ASSERT_MSG_EQ (warm.getCongestionWindow (), scream.getCongestionWindow (),
+                           "Warm-started controller should start with the snapshot's window");
+    NS_TEST_ASSERT_MSG_EQ (warm.getBytesInFlight (), 0, "Packets in transit should not be in flight");
+
+    // No bottleneck, but 20% random losses
+    rmcat::ScreamController lossy{};
+    lossy.setInitBw (800000.f);
+    lossy.reset ();
+    lossy.setLogCallback (NoLog);
+    const BottleneckResult losses = RunOnBottleneck (lossy, 10e6, 20, durationUs);
+    NS_TEST_ASSERT_MSG_LT (losses.rateBps, 300000.f, "Rate should back off upon losses");
+}
+
+/*
+ * BBR-style controller: in closed loop, its bottleneck bandwidth and
+ * propagation RTT estimations converge to the bottleneck's, random losses
+ * do not make its rate collapse, and it can be warm-started from a snapshot
+ */
+class BbrTestCase : public TestCase
+{
+public:
+    BbrTestCase ();
+    virtual void DoRun ();
+};
+
+BbrTestCase::BbrTestCase ()
+: TestCase{"rmcat-controller-bbr"}
+{}
+
+void BbrTestCase::DoRun ()
+{
+    const uint64_t durationUs = 60000000;  // 60s
+
+    // 1Mbps bottleneck, starting at the default initial rate
+    rmcat::BbrController bbr{};
+    bbr.setLogCallback (NoLog);
+    const BottleneckResult bottleneck = RunOnBottleneck (bbr, 1e6, 0, durationUs);
+    NS_TEST_ASSERT_MSG_GT (bbr.getBottleneckBw (), 900000.f, "Bottleneck bandwidth should be the capacity");
+    NS_TEST_ASSERT_MSG_LT (bbr.getBottleneckBw (), 1100000.f, "Bottleneck bandwidth should be the capacity");
+    NS_TEST_ASSERT_MSG_GT (bottleneck.rateBps, 700000.f, "Rate should cycle around the capacity");
+    NS_TEST_ASSERT_MSG_LT (bottleneck.rateBps, 1300000.f, "Rate should cycle around the capacity");
+    uint64_t minRttUs = 0;
+    NS_TEST_ASSERT_MSG_EQ (bbr.getMinRtt (minRttUs), true, "Propagation RTT should have been measured");
+    NS_TEST_ASSERT_MSG_GT (minRttUs, 90000, "Propagation RTT should be the path's (100ms)");
+    NS_TEST_ASSERT_MSG_LT (minRttUs, 150000, "Propagation RTT should not include queuing delay");
+
+    // Warm start: same rate and model as the controller the snapshot was taken from
+    std::stringstream state;
+    bbr.saveState (state, durationUs);
+    rmcat::BbrController warm{};
+    warm.setLogCallback (NoLog);
+    NS_TEST_ASSERT_MSG_EQ (warm.loadState (state, 0), true, "Snapshot should be valid");
+    NS_TEST_ASSERT_MSG_EQ (warm.getBandwidth (0), bbr.getBandwidth (durationUs),
+                           "Warm-started controller should start at the snapshot's rate");
+    NS_TEST_ASSERT_MSG_EQ (warm.getBottleneckBw (), bbr.getBottleneckBw (),
+                           "Warm-started controller should start with the snapshot's model");
+
+    // No bottleneck, but 20% random losses: the rate keeps up with the
+    // delivery rate, it is not cut as with loss-based controllers
+    rmcat::BbrController lossy{};
+    lossy.setInitBw (800000.f);
+    lossy.reset ();
+    lossy.setLogCallback (NoLog);
+    const BottleneckResult losses = RunOnBottleneck (lossy, 10e6, 20, durationUs);
+    NS_TEST_ASSERT_MSG_GT (losses.rateBps, 800000.f, "Rate should not collapse upon random losses");
+}
+
+/*
+ * Flows coupled by a Flow State Exchange share the aggregate rate in
+ * proportion to their priorities, up to their desired rates, and leave
+ * the group when they stop updating it
+ */
+class FseTestCase : public TestCase
+{
+public:
+    FseTestCase ();
+    virtual void DoRun ();
+};
+
+FseTestCase::FseTestCase ()
+: TestCase{"rmcat-controller-fse"}
+{}
+
+/*
+ * Same closed loop as RunOnBottleneck, with several flows sharing the
+ * bottleneck, each starting at its own time. Return the mean queuing
+ * delay over the second half of the run
+ */
+static double RunFlowsOnBottleneck (const std::vector<std::shared_ptr<rmcat::SenderBasedController> >& controllers,
+                                    const std::vector<uint64_t>& startUs,
+                                    double capacityBps, uint64_t durationUs)
+{
+    const uint64_t propUs = 50000;          // 50ms
+    const uint64_t fbPeriodUs = 100000;     // 100ms
+    const uint64_t maxQdelayUs = 300000;    // 300ms
+    const uint64_t serviceUs = uint64_t (8000. * 1e6 / capacityBps);
+    const size_t nFlows = controllers.size ();
+
+    struct InFlight
+    {
+        uint16_t sequence;
+        uint64_t rxTimestampUs;
+        bool lost;
+    };
+    std::vector<std::deque<InFlight> > inFlight (nFlows);
+    std::vector<rmcat::SenderBasedController::FeedbackItem> feedback{};
+    std::vector<uint64_t> nextTxUs{startUs};
+    std::vector<uint64_t> nextFbUs (nFlows);
+    std::vector<uint16_t> sequence (nFlows, 0);
+    for (size_t i = 0; i < nFlows; ++i) {
+        nextFbUs[i] = startUs[i] + fbPeriodUs;
+    }
+    uint64_t linkFreeUs = 0;
+    double qdelaySumMs = 0.;
+    size_t qdelayCount = 0;
+    while (true) {
+        // Next event: the earliest packet sent or feedback received
+        size_t flow = 0;
+        bool isTx = true;
+        uint64_t nowUs = std::numeric_limits<uint64_t>::max ();
+        for (size_t i = 0; i < nFlows; ++i) {
+            if (nextTxUs[i] < nowUs) {
+                nowUs = nextTxUs[i];
+                flow = i;
+                isTx = true;
+            }
+            if (nextFbUs[i] < nowUs) {
+                nowUs = nextFbUs[i];
+                flow = i;
+                isTx = false;
+            }
+        }
+        if (nowUs >= durationUs) {
+            break;
+        }
+        rmcat::SenderBasedController& controller = *controllers[flow];
+        if (isTx) {
+            controller.processSendPacket (nowUs, sequence[flow], 1000);
+            const uint64_t txStartUs = std::max (nowUs, linkFreeUs);
+            const bool lost = txStartUs - nowUs > maxQdelayUs;
+            if (!lost) {
+                linkFreeUs = txStartUs + serviceUs;
+                if (nowUs >= durationUs / 2) {
+                    qdelaySumMs += double (txStartUs - nowUs) / 1000.;
+                    ++qdelayCount;
+                }
+            }
+            inFlight[flow].push_back (InFlight{sequence[flow], linkFreeUs + propUs, lost});
+            ++sequence[flow];
+            nextTxUs[flow] = nowUs + uint64_t (8000. * 1e6 / controller.getBandwidth (nowUs));
+        } else {
+            std::deque<InFlight>& packets = inFlight[flow];
+            while (!packets.empty () && packets.front ().rxTimestampUs <= nowUs) {
+                if (!packets.front ().lost) {
+                    feedback.push_back (rmcat::SenderBasedController::FeedbackItem{packets.front ().sequence,
+                                                                                   packets.front ().rxTimestampUs, 0});
+                }
+                packets.pop_front ();
+            }
+            controller.processFeedbackBatch (nowUs + propUs, feedback);
+            feedback.clear ();
+            nextFbUs[flow] += fbPeriodUs;
+        }
+    }
+    return qdelayCount > 0 ? qdelaySumMs / double (qdelayCount) : 0.;
+}
+
+void FseTestCase::DoRun ()
+{
+    // Allocation: dummy controllers keep the rate they are set to
+    auto fse = std::make_shared<rmcat::FlowStateExchange> ();
+    auto dummyA = std::make_shared<rmcat::DummyController> ();
+    auto dummyB = std::make_shared<rmcat::DummyController> ();
+    dummyA->setInitBw (1000000.f);
+    dummyB->setInitBw (1000000.f);
+    const size_t idA = fse->registerFlow (*dummyA, 1.f, 10e6f);
+    const size_t idB = fse->registerFlow (*dummyB, 3.f, 10e6f);
+    fse->update (idA, 0);
+    NS_TEST_ASSERT_MSG_EQ (fse->getActiveFlows (), 1, "First flow should have joined the group");
+    NS_TEST_ASSERT_MSG_EQ (dummyA->getBandwidth (0), 1000000.f, "A single flow should get the aggregate rate");
+    fse->update (idB, 0);
+    NS_TEST_ASSERT_MSG_EQ (fse->getAggregateBw (), 2000000.f, "Joining flow should add its rate to the aggregate");
+    NS_TEST_ASSERT_MSG_EQ (dummyA->getBandwidth (0), 500000.f, "Shares should be proportional to the priorities");
+    NS_TEST_ASSERT_MSG_EQ (dummyB->getBandwidth (0), 1500000.f, "Shares should be proportional to the priorities");
+    dummyA->setCurrentBw (900000.f);
+    fse->update (idA, 100000);
+    NS_TEST_ASSERT_MSG_EQ (fse->getAggregateBw (), 2400000.f, "Controller's change should apply to the aggregate");
+    NS_TEST_ASSERT_MSG_EQ (dummyA->getBandwidth (0), 600000.f, "Change should be shared among the flows");
+    NS_TEST_ASSERT_MSG_EQ (dummyB->getBandwidth (0), 1800000.f, "Change should be shared among the flows");
+    fse->setDesiredBw (idB, 1000000.f);
+    fse->update (idB, 100000);
+    NS_TEST_ASSERT_MSG_EQ (dummyB->getBandwidth (0), 1000000.f, "Share should not exceed the desired rate");
+    NS_TEST_ASSERT_MSG_EQ (dummyA->getBandwidth (0), 1400000.f, "Leftover should go to the other flows");
+    fse->update (idA, 100000 + rmcat::FlowStateExchange::DEFAULT_FLOW_TIMEOUT_US + 1);
+    NS_TEST_ASSERT_MSG_EQ (fse->isActive (idB), false, "Flow not updating the group should leave it");
+    NS_TEST_ASSERT_MSG_EQ (fse->getAggregateBw (), 1400000.f, "Leaving flow should remove its share from the aggregate");
+    const uint64_t wrapUs = std::numeric_limits<uint64_t>::max () - 1000;
+    fse->update (idB, wrapUs);
+    fse->update (idA, wrapUs + 500);
+    NS_TEST_ASSERT_MSG_EQ (fse->isActive (idB), true, "Flow should not expire when its timeout wraps around");
+    fse->update (idA, wrapUs + rmcat::FlowStateExchange::DEFAULT_FLOW_TIMEOUT_US + 1);
+    NS_TEST_ASSERT_MSG_EQ (fse->isActive (idB), false, "Flow should expire after timestamps wrap around");
+    fse->unregisterFlow (idA);
+    fse->unregisterFlow (idB);
+
+    // The wrapper reports the wrapped controller's bytes in flight
+    rmcat::CoupledController wrapper{fse, dummyA};
+    wrapper.processSendPacket (0, 0, 1000);
+    wrapper.processSendPacket (1000, 1, 1000);
+    NS_TEST_ASSERT_MSG_EQ (wrapper.getBytesInFlight (), 2000, "Bytes in flight should be the wrapped controller's");
+
+    // Closed loop: NADA flows on a 3Mbps bottleneck, the second one
+    // starting after 10s with twice the priority of the first one
+    const uint64_t durationUs = 60000000;  // 60s
+    std::vector<std::shared_ptr<rmcat::SenderBasedController> > nadas;
+    std::vector<std::shared_ptr<rmcat::SenderBasedController> > coupled;
+    for (size_t i = 0; i < 2; ++i) {
+        nadas.push_back (std::make_shared<rmcat::NadaController> ());
+        coupled.push_back (std::make_shared<rmcat::CoupledController> (fse, nadas[i], float (i + 1)));
+        coupled[i]->setMaxBw (3e6f);
+        coupled[i]->setLogCallback (NoLog);
+    }
+    std::vector<uint64_t> startUs;
+    startUs.push_back (0);
+    startUs.push_back (10000000);
+    const double qdelayMs = RunFlowsOnBottleneck (coupled, startUs, 3e6, durationUs);
+    const float bw0 = coupled[0]->getBandwidth (durationUs);
+    const float bw1 = coupled[1]->getBandwidth (durationUs);
+    NS_TEST_ASSERT_MSG_EQ (fse->getActiveFlows (), 2, "Both flows should be in the group");
+    NS_TEST_ASSERT_MSG_EQ_TOL (bw1 / bw0, 2.f, 0.01f, "Rates should be proportional to the priorities");
+    NS_TEST_ASSERT_MSG_EQ_TOL (bw0 + bw1, fse->getAggregateBw (), 1.f, "Flows should share the aggregate rate");
+    NS_TEST_ASSERT_MSG_GT (bw0 + bw1, 2400000.f, "Aggregate rate should approach the capacity");
+    NS_TEST_ASSERT_MSG_LT (bw0 + bw1, 3300000.f, "Aggregate rate should not exceed the capacity by far");
+    NS_TEST_ASSERT_MSG_LT (qdelayMs, 30., "Queuing delay should stay low");
+}
+
+/*
+ * Delay gradient estimator: zero on a constant delay, and the rate at
+ * which the delay grows otherwise, in both modes. The incremental
+ * least-squares fit matches a fit recalculated from scratch. The gradient
+ * term of NADA vanishes once the queue is stable: it converges as without it
+ */
+class DelayGradientTestCase : public TestCase
+{
+public:
+    DelayGradientTestCase ();
+    virtual void DoRun ();
+};
+
+DelayGradientTestCase::DelayGradientTestCase ()
+: TestCase{"rmcat-controller-delay-gradient"}
+{}
+
+void DelayGradientTestCase::DoRun ()
+{
+    // Groups of 2 packets, 1ms apart, every 20ms: constant delay for 10s,
+    // then the delay grows by 0.1ms per ms sent for 20s
+    const uint64_t groupUs = 20000;
+    const uint64_t firstGrowingUs = 10000000;
+    const uint64_t durationUs = 30000000;
+    for (const auto mode : {rmcat::DelayGradientEstimator::MODE_TRENDLINE,
+                            rmcat::DelayGradientEstimator::MODE_KALMAN}) {
+        rmcat::DelayGradientEstimator estimator{mode};
+        size_t updates = 0;
+        for (uint64_t txUs = 1000; txUs < durationUs; txUs += groupUs) {
+            for (uint64_t burstUs = 0; burstUs <= 1000; burstUs += 1000) {
+                const uint64_t sentUs = txUs + burstUs;
+                const uint64_t growthUs = sentUs > firstGrowingUs ? (sentUs - firstGrowingUs) / 10 : 0;
+                if (estimator.addPacket (sentUs, sentUs + 50000 + growthUs)) {
+                    ++updates;
+                }
+            }
+            if (txUs + groupUs == firstGrowingUs) {
+                NS_TEST_ASSERT_MSG_EQ_TOL (estimator.getGradient (), 0., 1e-6, "Gradient should be zero on a constant delay");
+            }
+        }
+        NS_TEST_ASSERT_MSG_EQ (updates, durationUs / groupUs - 2, "Estimation should be updated once per group");
+        NS_TEST_ASSERT_MSG_EQ_TOL (estimator.getSendDeltaMs (), 20., 1e-6, "Inter-departure time should be that of the groups");
+        // The trendline's gradient is per unit of arrival time: 0.1 / 1.1
+        const double expected = mode == rmcat::DelayGradientEstimator::MODE_KALMAN ? 0.1 : 0.1 / 1.1;
+        NS_TEST_ASSERT_MSG_EQ_TOL (estimator.getGradient (), expected, expected * 0.05, "Gradient should follow the delay growth");
+        estimator.reset ();
+        NS_TEST_ASSERT_MSG_EQ (estimator.getGradient (), 0., "Gradient should be zero after a reset");
+        NS_TEST_ASSERT_MSG_EQ (estimator.getNumDeltas (), 0, "Delay variations should be forgotten after a reset");
+    }
+
+    // Incremental fit vs. fit from scratch, on jittered one-packet groups
+    rmcat::DelayGradientEstimator trendline{};
+    std::mt19937 rng{1};
+    std::vector<uint64_t> tx;
+    std::vector<uint64_t> arrival;
+    double accumulatedMs = 0.;
+    double smoothedMs = 0.;
+    std::deque<std::pair<double, double> > window;
+    double maxErr = 0.;
+    for (size_t i = 0; i < 5000; ++i) {
+        tx.push_back (uint64_t (i) * 10000 + rng () % 3000);
+        arrival.push_back (tx.back () + 50000 + uint64_t (20000. * (1. + std::sin (double (i) / 100.))) + rng () % 5000);
+        if (!trendline.addPacket (tx.back (), arrival.back ())) {
+            continue;
+        }
+        const size_t k = i - 1;
+        accumulatedMs += (double (int64_t (arrival[k] - arrival[k - 1])) - double (int64_t (tx[k] - tx[k - 1]))) / 1000.;
+        smoothedMs = 0.9 * smoothedMs + 0.1 * accumulatedMs;
+        window.push_back (std::make_pair (double (arrival[k] - arrival[0]) / 1000., smoothedMs));
+        if (window.size () > rmcat::DelayGradientEstimator::DEFAULT_TRENDLINE_WINDOW) {
+            window.pop_front ();
+        }
+        if (window.size () < rmcat::DelayGradientEstimator::DEFAULT_TRENDLINE_WINDOW) {
+            continue;
+        }
+        double xAvg = 0.;
+        double yAvg = 0.;
+        for (const auto& point : window) {
+            xAvg += point.first / double (window.size ());
+            yAvg += point.second / double (window.size ());
+        }
+        double numerator = 0.;
+        double denominator = 0.;
+        for (const auto& point : window) {
+            numerator += (point.first - xAvg) * (point.second - yAvg);
+            denominator += (point.first - xAvg) * (point.first - xAvg);
+        }
+        maxErr = std::max (maxErr, std::fabs (trendline.getGradient () - numerator / denominator));
+    }
+    NS_TEST_ASSERT_MSG_LT (maxErr, 1e-9, "Incremental fit should match the fit from scratch");
+
+    // NADA on a 1Mbps bottleneck, with and without the gradient term
+    rmcat::NadaParams params{};
+    rmcat::ConfigurableNadaController plain{params};
+    plain.setLogCallback (NoLog);
+    const BottleneckResult plainResult = RunOnBottleneck (plain, 1e6, 0, 60000000);
+    NS_TEST_ASSERT_MSG_EQ (params.set ("dgrad", 200.), true, "dgrad should be a parameter");
+    rmcat::ConfigurableNadaController gradient{params};
+    gradient.setLogCallback (NoLog);
+    const BottleneckResult gradientResult = RunOnBottleneck (gradient, 1e6, 0, 60000000);
+    NS_TEST_ASSERT_MSG_EQ_TOL (gradientResult.rateBps, plainResult.rateBps, 10000.f,
+                               "Rate should converge to the bottleneck's capacity, as without the gradient term");
+    NS_TEST_ASSERT_MSG_EQ_TOL (gradientResult.qdelayMs, plainResult.qdelayMs, 1.,
+                               "Queuing delay should converge as without the gradient term");
+}
+
+class RmcatControllerTestSuite : public TestSuite
+{
+public:
+    RmcatControllerTestSuite ();
+};
+
+RmcatControllerTestSuite::RmcatControllerTestSuite ()
+  : TestSuite{"rmcat-controller", UNIT}
+{
+    AddTestCase (new ThreadedControllerStressTestCase{}, TestCase::QUICK);
+    AddTestCase (new ThreadedControllerOverflowTestCase{}, TestCase::QUICK);
+    AddTestCase (new ThreadedControllerInFlightTestCase{}, TestCase::QUICK);
+    AddTestCase (new StatsSinkTestCase{}, TestCase::QUICK);
+    AddTestCase (new DiagnosticsTestCase{}, TestCase::QUICK);
+    AddTestCase (new SendGapTestCase{}, TestCase::QUICK);
+    AddTestCase (new HighRateMetricsTestCase{}, TestCase::QUICK);
+    AddTestCase (new OutstandingWrapTestCase{}, TestCase::QUICK);
+    AddTestCase (new WindowedFilterTestCase{}, TestCase::QUICK);
+    AddTestCase (new LateFeedbackTestCase{}, TestCase::QUICK);
+    AddTestCase (new MaxQdelayTestCase{}, TestCase::QUICK);
+    AddTestCase (new InTransitRingTestCase{}, TestCase::QUICK);
+    AddTestCase (new MetricsSnapshotTestCase{}, TestCase::QUICK);
+    AddTestCase (new FeedbackBatchTestCase{}, TestCase::QUICK);
+    AddTestCase (new BaseDelayTrackerTestCase{}, TestCase::QUICK);
+    AddTestCase (new ClockDriftTestCase{}, TestCase::QUICK);
+    AddTestCase (new EcnMarkingTestCase{}, TestCase::QUICK);
+    AddTestCase (new RecvRateEstimatorTestCase{}, TestCase::QUICK);
+    AddTestCase (new WarmStartTestCase{}, TestCase::QUICK);
+    AddTestCase (new NadaParamsTestCase{}, TestCase::QUICK);
+    AddTestCase (new NadaBankTestCase{}, TestCase::QUICK);
+    AddTestCase (new NadaFixedTestCase{}, TestCase::QUICK);
+    AddTestCase (new NadaAdaptiveDeltaTestCase{}, TestCase::QUICK);
+    AddTestCase (new GccTestCase{}, TestCase::QUICK);
+    AddTestCase (new ScreamTestCase{}, TestCase::QUICK);
+    AddTestCase (new BbrTestCase{}, TestCase::QUICK);
+    AddTestCase (new FseTestCase{}, TestCase::QUICK);
+    AddTestCase (new DelayGradientTestCase{}, TestCase::QUICK);
+}
+
+static RmcatControllerTestSuite rmcatControllerTestSuite;
@@ -63,11 +63,24 @@
 class RmcatWifiTestSuite : public TestSuite
 {
 public:
-    RmcatWifiTestSuite ();
+    /* The test cases are run with the given congestion control algorithm */
+    RmcatWifiTestSuite (const std::string& name, const std::string& ccAlgo);
+
+private:
+    void AddRmcatTestCase (RmcatWifiTestCase* tc);
+
+    std::string m_ccAlgo;
 };
 
-RmcatWifiTestSuite :: RmcatWifiTestSuite ()
-    : TestSuite{"rmcat-wifi", UNIT}
+void RmcatWifiTestSuite::AddRmcatTestCase (RmcatWifiTestCase* tc)
+{
+    tc->SetCcAlgo (m_ccAlgo);
+    AddTestCase (tc, TestCase::QUICK);
+}
+
+RmcatWifiTestSuite :: RmcatWifiTestSuite (const std::string& name, const std::string& ccAlgo)
+    : TestSuite{name, UNIT},
+      m_ccAlgo{ccAlgo}
 {
     // ----------------
     // Default test case parameters
@@ -192,13 +205,13 @@ RmcatWifiTestSuite :: RmcatWifiTestSuite ()
      * (Section 4.1. in rmcat-wireless-tests draft)
      * to test suite
      */
-    AddTestCase (tc41a, TestCase::QUICK);
-    AddTestCase (tc41b, TestCase::QUICK);
-    AddTestCase (tc41c, TestCase::QUICK);
-    AddTestCase (tc41d, TestCase::QUICK);
-    AddTestCase (tc41e, TestCase::QUICK);
-    AddTestCase (tc41f, TestCase::QUICK);
-    AddTestCase (tc41g, TestCase::QUICK);
+    AddRmcatTestCase (tc41a);
+    AddRmcatTestCase (tc41b);
+    AddRmcatTestCase (tc41c);
+    AddRmcatTestCase (tc41d);
+    AddRmcatTestCase (tc41e);
+    AddRmcatTestCase (tc41f);
+    AddRmcatTestCase (tc41g);
 
     // -----------------------
     // Test Case 4.2.x: Wireless Bottleneck
@@ -252,9 +265,9 @@ RmcatWifiTestSuite :: RmcatWifiTestSuite ()
         /* Add test cases to test suite */
         // You can comment out these lines if you wish to reduce the time
         //    it takes to run the suite, as these test cases take a while
-        AddTestCase (tc42a,TestCase::QUICK);
-        AddTestCase (tc42b,TestCase::QUICK);
-        AddTestCase (tc42c,TestCase::QUICK);
+        AddRmcatTestCase (tc42a);
+        AddRmcatTestCase (tc42b);
+        AddRmcatTestCase (tc42c);
     }
 
     // -----------------------
@@ -313,8 +326,10 @@ RmcatWifiTestSuite :: RmcatWifiTestSuite ()
      * (Section 4.2. in rmcat-wireless-tests draft)
      * to test suite
      */
-    AddTestCase (tc42d,TestCase::QUICK);
-    AddTestCase (tc42e,TestCase::QUICK);
+    AddRmcatTestCase (tc42d);
+    AddRmcatTestCase (tc42e);
 }
 
-static RmcatWifiTestSuite rmcatWifiTestSuite;
+static RmcatWifiTestSuite rmcatWifiTestSuite{"rmcat-wifi", "nada"};
+static RmcatWifiTestSuite rmcatWifiGccTestSuite{"rmcat-wifi-gcc", "gcc"};
+static RmcatWifiTestSuite rmcatWifiScreamTestSuite{"rmcat-wifi-scream", "scream"};
@@ -47,9 +47,39 @@ NS_LOG_COMPONENT_DEFINE ("RmcatSimTestWired");
 // TODO (deferred):  Audio + Video combined
 // TODO (deferred):  align topology implementation with wifi case
 
-static void SenderPauseResume (Ptr<RmcatSender> send, bool pause)
+static void SenderPauseResume (Ptr<RmcatSender> send, bool pause, bool restoreState)
 {
-    send->PauseResume (pause);
+    send->PauseResume (pause, restoreState);
+}
+
+static void SenderWarmStart (Ptr<RmcatSender> from, Ptr<RmcatSender> to)
+{
+    to->SetWarmStartState (from->GetControllerState ());
+}
+
+static void LogFromController (const std::string& msg)
+{
+    NS_LOG_INFO ("controller_log: " << msg);
+}
+
+EcnStatsSink::EcnStatsSink ()
+: rmcat::TextStatsSink{LogFromController},
+  m_nMarkedRecords{0}
+{}
+
+void EcnStatsSink::writeStats (const rmcat::StatsRecord& record)
+{
+    if (record.pmr > 0.f) {
+        ++m_nMarkedRecords;
+    }
+    rmcat::TextStatsSink::writeStats (record);
+}
+
+/* Keep track of the largest backlog of a sender's rate shaping buffer */
+static void SampleBufferBytes (Ptr<RmcatSender> sender, uint32_t* maxBytes)
+{
+    *maxBytes = std::max (*maxBytes, sender->GetBufferBytes ());
+    Simulator::Schedule (MilliSeconds (100), &SampleBufferBytes, sender, maxBytes);
 }
 
 /* Constructor */
@@ -65,7 +95,27 @@ RmcatWiredTestCase::RmcatWiredTestCase (uint64_t capacity, // bottleneck capacit
   m_numInitOnFlows{0},
   m_simTime{RMCAT_TC_SIMTIME},
   m_pauseFid{0},
-  m_codecType{SYNCODEC_TYPE_FIXFPS}
+  m_pauseRestoresState{false},
+  m_warmStart{false},
+  m_warmStartFromFid{0},
+  m_warmStartToFid{0},
+  m_codecType{SYNCODEC_TYPE_FIXFPS},
+  m_rmax{RMCAT_TC_RMAX},
+  m_baseDelayBuckets{0},
+  m_baseDelayBucketS{0},
+  m_clockDriftPpm{0.},
+  m_driftCompensation{false},
+  m_rrateType{RRATE_ESTIMATOR_HISTORY},
+  m_rrateOverhead{false},
+  m_nadaConfig{},
+  m_nadaArith{"float"},
+  m_fsePriorities{},
+  m_ecnThresholdMs{0},
+  m_ecnSinks{},
+  m_useBuffer{USE_BUFFER},
+  m_maxBufferBytes{},
+  m_delayChangeTime{0},
+  m_delayChangeMs{0}
 {}
 
 
@@ -99,7 +149,8 @@ void RmcatWiredTestCase::SetBW (const std::vector<uint32_t>& times,
 void RmcatWiredTestCase::SetPauseResumeTimes (size_t fid,
                                               const std::vector<uint32_t> & ptimes,
                                               const std::vector<uint32_t> & rtimes,
-                                              bool fwd)
+                                              bool fwd,
+                                              bool restoreState)
 {
     NS_ASSERT (fwd); // Only fwd direction supported for now
     NS_ASSERT (fid < m_numFlowsFw);
@@ -108,6 +159,7 @@ void RmcatWiredTestCase::SetPauseResumeTimes (size_t fid,
     m_pauseFid = fid;
     m_pauseTimes = ptimes;
     m_resumeTimes = rtimes;
+    m_pauseRestoresState = restoreState;
 }
 
 /*
@@ -177,7 +229,7 @@ void RmcatWiredTestCase::SetTCPShortFlows (size_t numFlows,
 void RmcatWiredTestCase::DoSetup ()
 {
     RmcatTestCase::DoSetup ();
-    m_topo.Build (m_capacity, m_delay, m_qdelay);
+    m_topo.Build (m_capacity, m_delay, m_qdelay, m_ecnThresholdMs);
     ns3::LogComponentEnable ("RmcatSimTestWired", LOG_LEVEL_INFO);
 }
 
@@ -207,6 +259,16 @@ void RmcatWiredTestCase::DoRun ()
     std::vector<Ptr<BulkSendApplication> > tcpLongSend (m_numTcpFlows);
     std::vector<Ptr<BulkSendApplication> > tcpShortSend;
 
+    /* The controllers read their parameters from a file when installed */
+    if (!m_nadaConfig.empty ()) {
+        const std::string configFile = CreateTempDirFilename ("nada-params.conf");
+        std::ofstream config{configFile.c_str ()};
+        config << m_nadaConfig;
+        config.close ();
+        GlobalValue::Bind ("RmcatNadaConfig", StringValue (configFile));
+    }
+    GlobalValue::Bind ("RmcatNadaArith", StringValue (m_nadaArith));
+
     SetUpPath (m_timesFw, m_capacitiesFw, true);     // time-varying available BW
     SetUpRMCAT (sendFw, ptimersFw, rtimersFw, true); // instantiate forward RMCAT flows
     SetUpTCPLong (m_numTcpFlows, tcpLongSend);       // instantiate background long lived TCP flows
@@ -224,6 +286,12 @@ void RmcatWiredTestCase::DoRun ()
     SetUpPath (m_timesBw, m_capacitiesBw, false);
     SetUpRMCAT (sendBw, ptimersBw, rtimersBw, false);
 
+    /* Change of the bottleneck's propagation delay */
+    if (m_delayChangeTime > 0) {
+        Simulator::Schedule (Seconds (m_delayChangeTime), &WiredTopo::SetBottleneckDelay,
+                             &m_topo, m_delayChangeMs);
+    }
+
     /* Populate routing table */
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
 
@@ -231,7 +299,26 @@ void RmcatWiredTestCase::DoRun ()
     NS_LOG_INFO ("Run Simulation.");
     Simulator::Stop (Seconds (m_simTime));
     Simulator::Run ();
+
+    /* Over an ECN-marking bottleneck, the marks reach the controllers */
+    for (size_t i = 0; i < m_ecnSinks.size (); ++i) {
+        NS_TEST_EXPECT_MSG_GT (m_ecnSinks[i]->GetNMarkedRecords (), 0,
+                               "ECN marks should reach the controller of flow " << i);
+    }
+    m_ecnSinks.clear ();
+
+    /* Without rate shaping buffer, held-back packets do not pile up at the senders */
+    for (size_t i = 0; i < m_maxBufferBytes.size (); ++i) {
+        NS_TEST_EXPECT_MSG_LT (m_maxBufferBytes[i], m_rmax / 8,
+                               "Sender of flow " << i << " should not hold a second's worth of packets");
+    }
+    m_maxBufferBytes.clear ();
+
     Simulator::Destroy ();
+    if (!m_nadaConfig.empty ()) {
+        GlobalValue::Bind ("RmcatNadaConfig", StringValue (""));
+    }
+    GlobalValue::Bind ("RmcatNadaArith", StringValue ("float"));
     NS_LOG_INFO ("Done.");
 }
 
@@ -282,6 +369,26 @@ void RmcatWiredTestCase::SetUpPath (const std::vector<uint32_t>& times,
 /*
  *  Instantiate RMCAT flows
  */
+void RmcatWiredTestCase::SetUpRecvRateEstimator (rmcat::SenderBasedController& controller)
+{
+    switch (m_rrateType) {
+        case RRATE_ESTIMATOR_WINDOW:
+            controller.setRecvRateEstimator (std::make_shared<rmcat::WindowRecvRateEstimator> ());
+            break;
+        case RRATE_ESTIMATOR_EWMA:
+            controller.setRecvRateEstimator (std::make_shared<rmcat::EwmaRecvRateEstimator> ());
+            break;
+        case RRATE_ESTIMATOR_FRAME:
+            controller.setRecvRateEstimator (std::make_shared<rmcat::FrameRecvRateEstimator> ());
+            break;
+        default:
+            break;
+    }
+    if (m_rrateOverhead) {
+        controller.setRecvRateOverhead (IPV4_UDP_OVERHEAD + RTP_HEADER_SIZE);
+    }
+}
+
 void RmcatWiredTestCase::SetUpRMCAT (std::vector<Ptr<RmcatSender> >& send,
                                      std::vector<std::shared_ptr<Timer> >& ptimers,
                                      std::vector<std::shared_ptr<Timer> >& rtimers,
@@ -323,6 +430,18 @@ void RmcatWiredTestCase::SetUpRMCAT (std::vector<Ptr<RmcatSender> >& send,
         ss0 << "bwd_";
     }
 
+    // coupled flows share a Flow State Exchange group
+    std::shared_ptr<rmcat::FlowStateExchange> fse;
+    if (fwd && m_fsePriorities.size () > 0) {
+        NS_ASSERT (m_fsePriorities.size () == numFlows);
+        fse = std::make_shared<rmcat::FlowStateExchange> ();
+    }
+
+    // without rate shaping buffer, the senders' backlog is sampled
+    if (fwd && !m_useBuffer) {
+        m_maxBufferBytes.assign (numFlows, 0);
+    }
+
     for (size_t i = 0; i < numFlows; ++i) {
         // configure per-flow RTT
         if (fwd && m_pDelays.size () > 0) {
@@ -335,13 +454,35 @@ void RmcatWiredTestCase::SetUpRMCAT (std::vector<Ptr<RmcatSender> >& send,
         ApplicationContainer rmcatApps = m_topo.InstallRMCAT (ss.str (),          // Flow ID
                                                               basePort + (i * 2), // port number
                                                               pDelayMs,           // path RTT
-                                                              fwd);               // direction indicator
+                                                              fwd,                // direction indicator
+                                                              fse,                // coupling group
+                                                              fse ? m_fsePriorities[i] : 1.f);
 
         send[i] = DynamicCast<RmcatSender> (rmcatApps.Get (0));
         send[i]->SetCodecType (m_codecType);
         send[i]->SetRinit (RMCAT_TC_RINIT);
         send[i]->SetRmin (RMCAT_TC_RMIN);
-        send[i]->SetRmax (RMCAT_TC_RMAX);
+        send[i]->SetRmax (m_rmax);
+        send[i]->GetController ()->setClockDriftCompensation (m_driftCompensation);
+        if (m_ecnThresholdMs > 0) {
+            send[i]->SetEcnCapable (true);
+            if (fwd) {
+                auto sink = std::make_shared<EcnStatsSink> ();
+                send[i]->GetController ()->setStatsSink (sink);
+                m_ecnSinks.push_back (sink);
+            }
+        }
+        send[i]->SetUseBuffer (m_useBuffer);
+        if (fwd && !m_useBuffer) {
+            Simulator::Schedule (Seconds (0), &SampleBufferBytes, send[i], &m_maxBufferBytes[i]);
+        }
+        SetUpRecvRateEstimator (*send[i]->GetController ());
+        Ptr<RmcatReceiver> recv = DynamicCast<RmcatReceiver> (rmcatApps.Get (1));
+        recv->SetClockDrift (m_clockDriftPpm);
+        if (m_baseDelayBuckets > 0) {
+            send[i]->GetController ()->setBaseDelayWindow (m_baseDelayBuckets,
+                                                           uint64_t (m_baseDelayBucketS) * 1000 * 1000);
+        }
         send[i]->SetStartTime (Seconds (0));
         send[i]->SetStopTime (Seconds (m_simTime-1));
     }
@@ -383,8 +524,8 @@ void RmcatWiredTestCase::SetUpRMCAT (std::vector<Ptr<RmcatSender> >& send,
             ptimer->SetFunction (&SenderPauseResume);
             rtimer->SetFunction (&SenderPauseResume);
 
-            ptimer->SetArguments (send[fid], true);  // pause
-            rtimer->SetArguments (send[fid], false);  // resume
+            ptimer->SetArguments (send[fid], true, false);  // pause
+            rtimer->SetArguments (send[fid], false, m_pauseRestoresState);  // resume
 
             ptimer->SetDelay (Seconds (m_pauseTimes[i]));
             rtimer->SetDelay (Seconds (m_resumeTimes[i]));
@@ -396,6 +537,22 @@ void RmcatWiredTestCase::SetUpRMCAT (std::vector<Ptr<RmcatSender> >& send,
             rtimers[i] = std::shared_ptr<Timer>{rtimer};
         }
     }
+
+    /*
+     * Configure warm start of a forward flow: the state is taken from the
+     * other flow's controller right before the flow starts (events at the
+     * same time run in the order they were scheduled)
+     */
+    if (fwd && m_warmStart) {
+        NS_ASSERT (m_warmStartFromFid < numFlows);
+        NS_ASSERT (m_warmStartToFid < numFlows);
+        NS_ASSERT (m_startTimesFw.size () == numFlows);
+        const uint32_t fromStart = m_startTimesFw[m_warmStartFromFid];
+        const uint32_t toStart = m_startTimesFw[m_warmStartToFid];
+        NS_ASSERT (fromStart < toStart);
+        Simulator::Schedule (Seconds (toStart), &SenderWarmStart,
+                             send[m_warmStartFromFid], send[m_warmStartToFid]);
+    }
 }
 
 /*
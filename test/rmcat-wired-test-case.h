@@ -33,6 +33,7 @@
 #include "ns3/rmcat-sender.h"
 #include "ns3/rmcat-receiver.h"
 #include "ns3/rmcat-constants.h"
+#include "ns3/stats-sink.h"
 #include "ns3/bulk-send-application.h"
 #include "ns3/application-container.h"
 #include "ns3/log.h"
@@ -42,6 +43,22 @@
 
 using namespace ns3;
 
+/**
+ * Statistics sink of the RMCAT flows over an ECN-marking bottleneck: it
+ * logs the records as the controllers would, and counts those reporting
+ * a non-zero marking ratio, i.e., the marks that reached the controller
+ */
+class EcnStatsSink : public rmcat::TextStatsSink
+{
+public:
+    EcnStatsSink ();
+    virtual void writeStats (const rmcat::StatsRecord& record);
+    uint32_t GetNMarkedRecords () const { return m_nMarkedRecords; };
+
+private:
+    uint32_t m_nMarkedRecords;
+};
+
 /**
  * Defines common configuration parameters of a RMCAT
  * wired test case;
@@ -71,6 +88,29 @@ public:
     void SetCapacity (uint64_t capacity) {m_capacity = capacity; };
     void SetSimTime (uint32_t simTime) {m_simTime = simTime; };
     void SetCodec (SyncodecType codecType) { m_codecType = codecType; };
+    void SetRmax (uint64_t rmax) { m_rmax = rmax; };
+    void SetBaseDelayWindow (size_t nBuckets, uint32_t bucketS) { m_baseDelayBuckets = nBuckets; m_baseDelayBucketS = bucketS; };
+
+    /* configure a drift of the receivers' clocks, and whether senders compensate it */
+    void SetClockDrift (double ppm, bool compensate) { m_clockDriftPpm = ppm; m_driftCompensation = compensate; };
+
+    /* configure the senders' receive rate estimator, and whether it counts the IP/UDP/RTP overhead */
+    void SetRecvRateEstimator (RecvRateEstimatorType type, bool countOverhead) { m_rrateType = type; m_rrateOverhead = countOverhead; };
+
+    /*
+     * configure an ECN-marking bottleneck, marking from the given queuing
+     * delay (in ms), and ECN-capable RMCAT flows
+     */
+    void SetEcnMarking (uint32_t msThreshold) { m_ecnThresholdMs = msThreshold; };
+
+    /*
+     * configure the RMCAT senders without rate shaping buffer, and check
+     * that the packets held back by their controllers do not pile up
+     */
+    void SetNoBuffer () { m_useBuffer = false; };
+
+    /* configure a change of the bottleneck's propagation delay (e.g., route change) */
+    void SetDelayChange (uint32_t time, uint32_t delay) { m_delayChangeTime = time; m_delayChangeMs = delay; };
     void SetPropDelays (const std::vector<uint32_t>& pDelays) { m_pDelays = pDelays; } ;
 
     /* configure time-varying BW */
@@ -78,11 +118,27 @@ public:
                 const std::vector<uint64_t>& capacities,
                 bool fwd);
 
-    /* configure pause time of a given flow */
+    /* configure pause time of a given flow, and whether it resumes from its controller's state */
     void SetPauseResumeTimes (size_t fid,
                               const std::vector<uint32_t> & ptimes,
                               const std::vector<uint32_t> & rtimes,
-                              bool fwd);
+                              bool fwd,
+                              bool restoreState = false);
+
+    /* configure the parameters of the NADA controllers (see rmcat::NadaParams::load) */
+    void SetNadaConfig (const std::string& config) { m_nadaConfig = config; };
+
+    /* configure the arithmetic of the NADA controllers: float, fixed or validate */
+    void SetNadaArith (const std::string& arith) { m_nadaArith = arith; };
+
+    /*
+     * couple the forward RMCAT flows in a Flow State Exchange group (see
+     * rmcat::FlowStateExchange), with the given per-flow priorities
+     */
+    void SetCoupledFlows (const std::vector<float>& priorities) { m_fsePriorities = priorities; };
+
+    /* configure a forward flow to warm-start from another forward flow's controller state */
+    void SetWarmStart (size_t fromFid, size_t toFid) { m_warmStart = true; m_warmStartFromFid = fromFid; m_warmStartToFid = toFid; };
 
     /* configure RMCAT flows and their arrival/departure pattern */
     void SetRMCATFlows (size_t numFlows,
@@ -113,6 +169,8 @@ protected:
                      std::vector<std::shared_ptr<Timer> >& rtimers,
                      bool fwd);
 
+    void SetUpRecvRateEstimator (rmcat::SenderBasedController& controller);
+
     void SetUpTCPLong (size_t numFlows,
                        std::vector<Ptr<BulkSendApplication> >& tcpSend);
 
@@ -159,8 +217,46 @@ private:
     size_t m_pauseFid;
     std::vector<uint32_t> m_pauseTimes;
     std::vector<uint32_t> m_resumeTimes;
+    bool m_pauseRestoresState;
+
+    /* warm start of a forward RMCAT flow, from the state taken when it starts */
+    bool m_warmStart;
+    size_t m_warmStartFromFid;
+    size_t m_warmStartToFid;
 
     SyncodecType m_codecType;
+    uint64_t m_rmax;            // maximum rate of RMCAT flows (in bps)
+
+    /* base delay window of RMCAT flows (zero: controller's default) */
+    size_t m_baseDelayBuckets;
+    uint32_t m_baseDelayBucketS;   // bucket length (in seconds)
+
+    /* clock drift of RMCAT receivers (in ppm) and its compensation at senders */
+    double m_clockDriftPpm;
+    bool m_driftCompensation;
+
+    /* receive rate estimation at RMCAT senders */
+    RecvRateEstimatorType m_rrateType;
+    bool m_rrateOverhead;
+
+    /* parameters of the NADA controllers (empty: defaults) */
+    std::string m_nadaConfig;
+    std::string m_nadaArith;
+
+    /* priorities of the coupled forward RMCAT flows (empty: not coupled) */
+    std::vector<float> m_fsePriorities;
+
+    /* ECN marking threshold of the bottleneck (in ms, zero: no marking) */
+    uint32_t m_ecnThresholdMs;
+    std::vector<std::shared_ptr<EcnStatsSink> > m_ecnSinks;  // one per forward RMCAT flow
+
+    /* rate shaping buffer of the RMCAT senders */
+    bool m_useBuffer;
+    std::vector<uint32_t> m_maxBufferBytes;  // sampled, one per forward RMCAT flow (no buffer only)
+
+    /* propagation delay change (zero time: no change) */
+    uint32_t m_delayChangeTime;    // time of the change (in seconds)
+    uint32_t m_delayChangeMs;      // new one-way propagation delay (in ms)
 };
 
 #endif /* RMCAT_WIRED_TEST_CASE_H */
@@ -44,11 +44,35 @@
 class RmcatTestSuite : public TestSuite
 {
 public:
-  RmcatTestSuite ();
+  /* The test cases are run with the given congestion control algorithm */
+  RmcatTestSuite (const std::string& name, const std::string& ccAlgo);
+
+private:
+  void AddRmcatTestCase (RmcatWiredTestCase* tc);
+  /* Test cases of NADA's features are only run with NADA */
+  void AddNadaTestCase (RmcatWiredTestCase* tc);
+
+  std::string m_ccAlgo;
 };
 
-RmcatTestSuite::RmcatTestSuite ()
-  : TestSuite{"rmcat-wired", UNIT}
+void RmcatTestSuite::AddRmcatTestCase (RmcatWiredTestCase* tc)
+{
+    tc->SetCcAlgo (m_ccAlgo);
+    AddTestCase (tc, TestCase::QUICK);
+}
+
+void RmcatTestSuite::AddNadaTestCase (RmcatWiredTestCase* tc)
+{
+    if (m_ccAlgo == "nada") {
+        AddRmcatTestCase (tc);
+    } else {
+        delete tc;
+    }
+}
+
+RmcatTestSuite::RmcatTestSuite (const std::string& name, const std::string& ccAlgo)
+  : TestSuite{name, UNIT},
+    m_ccAlgo{ccAlgo}
 {
     // ----------------
     // Default test case parameters
@@ -117,6 +141,12 @@ RmcatTestSuite::RmcatTestSuite ()
     tc51g->SetBW (timeTC51, bwTC51, true); // FWD path
     tc51g->SetCodec (SYNCODEC_TYPE_HYBRID); // hybrid (trace/statistics) video source
 
+    RmcatWiredTestCase * tc51h = new RmcatWiredTestCase{bw, pdel, qdel, "rmcat-test-case-5.1-trace-frame-rrate"};
+    tc51h->SetSimTime (100); // simulation time: 100s
+    tc51h->SetBW (timeTC51, bwTC51, true); // FWD path
+    tc51h->SetCodec (SYNCODEC_TYPE_TRACE); // trace-based video source
+    tc51h->SetRecvRateEstimator (RRATE_ESTIMATOR_FRAME, true); // frame-aware, with IP/UDP/RTP overhead
+
     // -----------------------
     // Test Case 5.2: Variable Available Capacity with Multiple Flows
     // -----------------------
@@ -169,6 +199,16 @@ RmcatTestSuite::RmcatTestSuite ()
     tc54->SetSimTime (simT); // default simulation time: 120s
     tc54->SetRMCATFlows (3, tstartTC54, tstopTC54, true);    // Forward path
 
+    // Coupled congestion control (modified from TC5.4): the three flows
+    // share a Flow State Exchange group, with equal priorities
+    std::vector<float> prioTC54;
+    prioTC54.push_back (1.); prioTC54.push_back (1.); prioTC54.push_back (1.);
+    RmcatWiredTestCase * tc54fse = new RmcatWiredTestCase{bw, pdel, qdel, "rmcat-test-case-5.4-fse-fixfps"};
+    tc54fse->SetCapacity (3.5 * (1u << 20));  // bottleneck capacity: 3.5 Mbps (same as TC5.4)
+    tc54fse->SetSimTime (simT); // default simulation time: 120s (same as TC5.4)
+    tc54fse->SetRMCATFlows (3, tstartTC54, tstopTC54, true);    // Forward path
+    tc54fse->SetCoupledFlows (prioTC54);
+
     // -----------------------
     // Test Case 5.5: Round Trip Time Fairness
     // -----------------------
@@ -239,26 +279,128 @@ RmcatTestSuite::RmcatTestSuite ()
     tc58->SetRMCATFlows (3, t0s, t0s, true);  // Forward path
     tc58->SetPauseResumeTimes (fid8, tpauseTC58, tresumeTC58, true);
 
+    // -----------------------
+    // High bitrate: a single flow over a 200 Mbps bottleneck. The packet
+    // history spans many more packets than the 16-bit sequence space
+    // -----------------------
+    RmcatWiredTestCase * tcHigh = new RmcatWiredTestCase{200 * (1u << 20), pdel, qdel, "rmcat-test-case-high-rate-fixfps"};
+    tcHigh->SetRmax (200 * (1u << 20)); // R_max raised to the bottleneck capacity
+    tcHigh->SetSimTime (simT);
+
+    // -----------------------
+    // Route change: the bottleneck's propagation delay increases mid-run.
+    // With a base delay window of 10 x 3s, the stale base delay expires
+    // after 30s at most, and the flow's rate recovers
+    // -----------------------
+    RmcatWiredTestCase * tcRoute = new RmcatWiredTestCase{bw, pdel, qdel, "rmcat-test-case-route-change-fixfps"};
+    tcRoute->SetCapacity (2 * (1u << 20)); // Bottleneck capacity: 2Mbps
+    tcRoute->SetSimTime (simT);
+    tcRoute->SetDelayChange (40, 150);     // At 40s, one-way delay: 50ms --> 150ms
+    tcRoute->SetBaseDelayWindow (10, 3);
+
+    // -----------------------
+    // Clock drift: the receiver's clock runs 50 ppm faster than the
+    // sender's, i.e., 15ms of fake queuing delay after 300s. The sender
+    // estimates the drift and compensates it
+    // -----------------------
+    RmcatWiredTestCase * tcDrift = new RmcatWiredTestCase{bw, pdel, qdel, "rmcat-test-case-clock-drift-fixfps"};
+    tcDrift->SetCapacity (2 * (1u << 20)); // Bottleneck capacity: 2Mbps
+    tcDrift->SetSimTime (300);             // Simulation time: 300s
+    tcDrift->SetClockDrift (50., true);
+
+    // -----------------------
+    // Weighted fairness (modified from TC5.4): the second flow has twice
+    // the priority of the first one, so it should get twice the rate
+    // -----------------------
+    RmcatWiredTestCase * tcPrio = new RmcatWiredTestCase{bw, pdel, qdel, "rmcat-test-case-prio-fixfps"};
+    tcPrio->SetCapacity (2 * (1u << 20));  // bottleneck capacity: 2 Mbps
+    tcPrio->SetSimTime (simT);
+    tcPrio->SetRMCATFlows (2, t0s, t0s, true);  // Forward path
+    tcPrio->SetNadaConfig ("rmcat_fixfps_fwd_1 prio 2\n");
+
+    // -----------------------
+    // Warm start: a flow takes over from another one, starting from its
+    // controller's state rather than from the initial rate. Then it is
+    // paused, and resumes from its controller's state
+    // -----------------------
+    std::vector<uint32_t> tstartWarm;
+    std::vector<uint32_t> tstopWarm;
+    tstartWarm.push_back (0);   tstopWarm.push_back (60);
+    tstartWarm.push_back (60);  tstopWarm.push_back (119);
+    std::vector<uint32_t> tpauseWarm;
+    std::vector<uint32_t> tresumeWarm;
+    tpauseWarm.push_back (80);
+    tresumeWarm.push_back (90);
+
+    RmcatWiredTestCase * tcWarm = new RmcatWiredTestCase{bw, pdel, qdel, "rmcat-test-case-warm-start-fixfps"};
+    tcWarm->SetCapacity (2 * (1u << 20)); // Bottleneck capacity: 2Mbps
+    tcWarm->SetSimTime (simT);
+    tcWarm->SetRMCATFlows (2, tstartWarm, tstopWarm, true);     // Forward path
+    tcWarm->SetWarmStart (0, 1);
+    tcWarm->SetPauseResumeTimes (1, tpauseWarm, tresumeWarm, true, true);
+
+    // -----------------------
+    // Fixed-point NADA (modified from TC5.1), checked against the
+    // floating-point one during the whole run
+    // -----------------------
+    RmcatWiredTestCase * tcFixed = new RmcatWiredTestCase{bw, pdel, qdel, "rmcat-test-case-fixed-point-fixfps"};
+    tcFixed->SetSimTime (100); // simulation time: 100s
+    tcFixed->SetBW (timeTC51, bwTC51, true); // FWD path
+    tcFixed->SetNadaArith ("validate");
+
+    // -----------------------
+    // ECN (modified from TC5.1): the bottleneck marks the ECN-capable
+    // packets once 10ms worth of packets are queued, and the marks make
+    // their way to the sender's controller
+    // -----------------------
+    RmcatWiredTestCase * tcEcn = new RmcatWiredTestCase{bw, pdel, qdel, "rmcat-test-case-ecn-fixfps"};
+    tcEcn->SetCapacity (1u << 20); // Bottleneck capacity: 1Mbps
+    tcEcn->SetSimTime (simT);
+    tcEcn->SetEcnMarking (10);
+
+    // -----------------------
+    // No rate shaping buffer: a single flow, whose packets are each sent as
+    // soon as it is produced. Packets held back by window-based controllers
+    // must not pile up at the sender
+    // -----------------------
+    RmcatWiredTestCase * tcNoBuf = new RmcatWiredTestCase{bw, pdel, qdel, "rmcat-test-case-no-buffer-fixfps"};
+    tcNoBuf->SetCapacity (1u << 20); // Bottleneck capacity: 1Mbps
+    tcNoBuf->SetSimTime (simT);
+    tcNoBuf->SetNoBuffer ();
+
     // -------------------------------
     // Add test cases to test suite
     // -------------------------------
 
-    AddTestCase (tc51a, TestCase::QUICK);
-    AddTestCase (tc51b, TestCase::QUICK);
-    AddTestCase (tc51c, TestCase::QUICK);
-    AddTestCase (tc51d, TestCase::QUICK);
-    AddTestCase (tc51e, TestCase::QUICK);
-    AddTestCase (tc51f, TestCase::QUICK);
-    AddTestCase (tc51g, TestCase::QUICK);
-
-    AddTestCase (tc52, TestCase::QUICK);
-
-    AddTestCase (tc53, TestCase::QUICK);
-    AddTestCase (tc54, TestCase::QUICK);
-    AddTestCase (tc55, TestCase::QUICK);
-    AddTestCase (tc56, TestCase::QUICK);
-    AddTestCase (tc57, TestCase::QUICK);
-    AddTestCase (tc58, TestCase::QUICK);
+    AddRmcatTestCase (tc51a);
+    AddRmcatTestCase (tc51b);
+    AddRmcatTestCase (tc51c);
+    AddRmcatTestCase (tc51d);
+    AddRmcatTestCase (tc51e);
+    AddRmcatTestCase (tc51f);
+    AddRmcatTestCase (tc51g);
+    AddRmcatTestCase (tc51h);
+
+    AddRmcatTestCase (tc52);
+
+    AddRmcatTestCase (tc53);
+    AddRmcatTestCase (tc54);
+    AddRmcatTestCase (tc54fse);
+    AddRmcatTestCase (tc55);
+    AddRmcatTestCase (tc56);
+    AddRmcatTestCase (tc57);
+    AddRmcatTestCase (tc58);
+    AddRmcatTestCase (tcHigh);
+    AddRmcatTestCase (tcRoute);
+    AddRmcatTestCase (tcDrift);
+    AddNadaTestCase (tcPrio);
+    AddRmcatTestCase (tcWarm);
+    AddNadaTestCase (tcFixed);
+    AddNadaTestCase (tcEcn);
+    AddRmcatTestCase (tcNoBuf);
 }
 
-static RmcatTestSuite rmcatTestSuite;
+static RmcatTestSuite rmcatTestSuite{"rmcat-wired", "nada"};
+static RmcatTestSuite rmcatGccTestSuite{"rmcat-wired-gcc", "gcc"};
+static RmcatTestSuite rmcatScreamTestSuite{"rmcat-wired-scream", "scream"};
+static RmcatTestSuite rmcatBbrTestSuite{"rmcat-wired-bbr", "bbr"};
@@ -21,9 +21,13 @@ import os
 import sys
 import re
 import json
+import csv
 
 SEP = '\t'
 
+# algorithms of the rmcat flows, as in the algo field of their stats
+RMCAT_ALGOS = ('nada', 'gcc', 'scream', 'bbr')
+
 def process_row(row, width):
         if row is not None:
             vals = [str(v) for v in row]
@@ -40,12 +44,12 @@ def process_controller_log(line, test_logs):
         #Controller's debug log, ignore
         return
 
-    'parsing nada-specific stats'
+    'parsing rmcat stats (see RMCAT_ALGOS); all rmcat flows are stored under the nada key'
     # ts: 158114 loglen: 60 qdel: 286 rtt: 386 ploss: 0 plr: 0.00 xcurr: 4.72 rrate: 863655.56 srate: 916165.81 avgint: 437.10 curint: 997 delta: 100
-    match = re.search(r'algo:nada (\S+) ts: (\d+) loglen: (\d+)', line)
+    match = re.search(r'algo:(?:{}) (\S+) ts: (\d+) loglen: (\d+)'.format('|'.join(RMCAT_ALGOS)), line)
     match_d = re.search(r'qdel: (\d+(?:\.\d*)?|\.\d+) rtt: (\d+(?:\.\d*)?|\.\d+)', line)
     match_p = re.search(r'ploss: (\d+) plr: (\d+(?:\.\d*)?|\.\d+)', line)
-    match_x = re.search(r'xcurr: (\d+(?:\.\d*)?|\.\d+)', line)
+    match_x = re.search(r'xcurr: (-?\d+(?:\.\d*)?|-?\.\d+)', line)
     match_r = re.search(r'rrate: (\d+(?:\.\d*)?|\.\d+) srate: (\d+(?:\.\d*)?|\.\d+)', line)
     match_l = re.search(r'avgint: (\d+(?:\.\d*)?|\.\d+) curint: (\d+(?:\.\d*)?|\.\d+)', line)
     match_D = re.search(r'delta: (\d+(?:\.\d*)?|\.\d+)', line)
@@ -88,11 +92,43 @@ def process_tcp_log(line, test_logs):
         return
     assert False, "Error: Unrecognized tcp log line: <{}>".format(line)
 
+def process_stats_csv(abs_fn, test_logs):
+    'parsing stats written by CsvStatsSink: no regex matching needed'
+    with open(abs_fn) as f_csv:
+        for rec in csv.DictReader(f_csv):
+            if rec['algo'] not in RMCAT_ALGOS:
+                continue
+            obj = rec['id']
+            if obj not in test_logs['nada']:
+                test_logs['nada'][obj] = []
+            # same units as the text log: seconds for ts, ms for delays
+            test_logs['nada'][obj].append([int(rec['ts_us']) // 1000 / 1000.,
+                                           float(int(rec['qdel_us']) // 1000),
+                                           float(int(rec['rtt_us']) // 1000),
+                                           int(rec['ploss']),
+                                           float(rec['plr']),
+                                           float(rec['xcurr']),
+                                           float(rec['rrate']),
+                                           float(rec['srate']),
+                                           int(rec['loglen']),
+                                           float(rec['avgint']),
+                                           int(rec['curint']),
+                                           float(int(rec['delta_us']) // 1000)])
+
 def process_log(dirname, filename, all_logs):
     abs_fn = os.path.join(dirname, filename)
     if not os.path.isfile(abs_fn):
         print("Skipping file {} (not a regular file)".format(filename))
         return
+    match = re.match(r'([a-zA-Z0-9_\.-]+)\.stats\.csv$', filename)
+    if match is not None:
+        print("Processing stats file {}...".format(filename))
+        test_name = match.group(1).replace(".", "_").replace("-", "_") + "_stats"
+        test_logs = {'nada': {}, 'tcp': {} }
+        all_logs[test_name] = test_logs
+        process_stats_csv(abs_fn, test_logs)
+        saveto_matfile(dirname, filename, test_logs)
+        return
     match = re.match(r'([a-zA-Z0-9_\.-]+).log', filename)
     if match is None:
         print("Skipping file {} (not a log file)".format(filename))